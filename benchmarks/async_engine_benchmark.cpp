@@ -0,0 +1,152 @@
+// Compares listing filters with blocking engine calls against AsyncEngine, on a
+// SimulatedBfe whose calls take a fixed round trip latency: each layer is enumerated
+// and the app ids of a set of paths resolved, as listing by application does. Blocking,
+// each round trip and resolution waits for the last; awaited, they overlap.
+#include <engine/async_engine.h>
+#include <engine/simulated_bfe.h>
+
+using namespace wfpk;
+
+namespace
+{
+constexpr size_t kLayerCount = 16;
+constexpr size_t kFiltersPerLayer = 500;
+constexpr size_t kAppCount = 32;
+constexpr std::chrono::milliseconds kRoundTripLatency{2};
+// Modelled cost of FwpmGetAppIdFromFileName, which resolves the path on each call
+constexpr std::chrono::milliseconds kResolveLatency{1};
+
+using Session = SimulatedBfe::Session;
+
+auto resolveAppId(const std::string &appPath) -> std::vector<UINT8>
+{
+    std::this_thread::sleep_for(kResolveLatency);
+    return {appPath.begin(), appPath.end()};
+}
+
+struct Listing
+{
+    size_t filterCount{0};
+    size_t appIdCount{0};
+};
+
+Listing listBlocking(Session &session, const std::vector<GUID> &layers,
+                     const std::vector<std::string> &appPaths)
+{
+    Listing listing;
+    for(const auto &layer : layers)
+    {
+        session.enumerateFiltersForLayer(layer, [&](auto) { ++listing.filterCount; });
+    }
+    for(const auto &appPath : appPaths)
+    {
+        listing.appIdCount += !resolveAppId(appPath).empty();
+    }
+    return listing;
+}
+
+Async<Listing> listAsync(AsyncEngine<Session> &engine, const std::vector<GUID> &layers,
+                         const std::vector<std::string> &appPaths)
+{
+    // Everything is started before anything is awaited
+    std::vector<Async<AsyncEngine<Session>::Filters>> enums;
+    for(const auto &layer : layers)
+    {
+        enums.push_back(engine.enumerateAsync(layer));
+    }
+    std::vector<Async<std::vector<UINT8>>> appIds;
+    for(const auto &appPath : appPaths)
+    {
+        appIds.push_back(engine.runAsync([&appPath] { return resolveAppId(appPath); }));
+    }
+
+    Listing listing;
+    for(auto &layerFilters : enums)
+    {
+        listing.filterCount += (co_await layerFilters).size();
+    }
+    for(auto &appId : appIds)
+    {
+        listing.appIdCount += !(co_await appId).empty();
+    }
+    co_return listing;
+}
+
+template <typename FuncT> double millisecondsFor(FuncT func)
+{
+    const auto start = std::chrono::steady_clock::now();
+    func();
+    const std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+}
+
+int main()
+{
+    SimulatedBfe bfe;
+    std::vector<GUID> layers;
+    for(unsigned long i = 0; i < kLayerCount; ++i)
+    {
+        layers.push_back(GUID{i + 1});
+        FWPM_FILTER filter{};
+        filter.layerKey = layers.back();
+        filter.subLayerKey = PIA_SUBLAYER_KEY;
+        filter.action.type = FWP_ACTION_BLOCK;
+        for(size_t j = 0; j < kFiltersPerLayer; ++j)
+        {
+            FilterId id{};
+            bfe.engine().tryAdd(filter, id);
+        }
+    }
+    std::vector<std::string> appPaths;
+    for(size_t i = 0; i < kAppCount; ++i)
+    {
+        appPaths.push_back(std::format("C:\\Program Files\\App{}\\app.exe", i));
+    }
+    bfe.setLatency(kRoundTripLatency);
+
+    std::cout << std::format("{} layers of {} filters and {} app ids, {} ms per round trip\n",
+                             kLayerCount, kFiltersPerLayer, kAppCount, kRoundTripLatency.count());
+    std::cout << std::format("{:>24} {:>10} {:>10} {:>10}\n", "listing", "sessions", "time (ms)",
+                             "speedup");
+
+    auto pSession = bfe.openSession();
+    Listing blocking;
+    const double blockingTime =
+        millisecondsFor([&] { blocking = listBlocking(*pSession, layers, appPaths); });
+    std::cout << std::format("{:>24} {:>10} {:>10.1f} {:>9.1f}x\n", "blocking", 1, blockingTime,
+                             1.0);
+
+    for(size_t sessionCount : {1, 2, 4, 8})
+    {
+        SessionPool<Session> sessions{[&] { return bfe.openSession(); }, sessionCount};
+        // A thread per session, and as many again to resolve app ids meanwhile
+        AsyncEngine engine{sessions, 2 * sessionCount};
+
+        // Sessions are opened beforehand, as a long lived pool's would be
+        std::vector<Async<AsyncEngine<Session>::Filters>> warmUp;
+        for(size_t i = 0; i < sessionCount; ++i)
+        {
+            warmUp.push_back(engine.enumerateAsync(layers.front()));
+        }
+        for(auto &layerFilters : warmUp)
+        {
+            layerFilters.get();
+        }
+
+        Listing awaited;
+        const double awaitedTime =
+            millisecondsFor([&] { awaited = listAsync(engine, layers, appPaths).get(); });
+        if(awaited.filterCount != blocking.filterCount ||
+           awaited.appIdCount != blocking.appIdCount)
+        {
+            std::cerr << "Listings differ\n";
+            return 1;
+        }
+        std::cout << std::format("{:>24} {:>10} {:>10.1f} {:>9.1f}x\n", "AsyncEngine",
+                                 sessionCount, awaitedTime, blockingTime / awaitedTime);
+    }
+
+    return 0;
+}
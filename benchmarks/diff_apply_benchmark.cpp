@@ -0,0 +1,111 @@
+// Compares a full re-load (delete every PIA filter, then add them all again)
+// against a diff-based apply, for a 50k filter policy with varying amounts of change.
+// Runs against MemoryEngine, where every call counts as one BFE round trip.
+#include <apply/filter_diff.h>
+#include <apply/filter_batch.h>
+#include <engine/memory_engine.h>
+
+using namespace wfpk;
+
+namespace
+{
+constexpr size_t kFilterCount = 50'000;
+
+FWPM_DISPLAY_DATA benchDisplayData{const_cast<wchar_t *>(L"benchmark"), nullptr};
+
+const std::vector<GUID> benchLayers = {FWPM_LAYER_ALE_AUTH_CONNECT_V4};
+
+// One block filter per address, the first `changedCount` addresses differ
+// from the base policy.
+void fillBatch(FilterBatch &batch, size_t changedCount)
+{
+    for(UINT32 i = 0; i < kFilterCount; ++i)
+    {
+        const UINT32 address = (i < changedCount ? 0xAC100000 : 0x0A000000) + i;
+
+        FWPM_FILTER_CONDITION condition{};
+        condition.fieldKey = FWPM_CONDITION_IP_REMOTE_ADDRESS;
+        condition.matchType = FWP_MATCH_EQUAL;
+        condition.conditionValue.type = FWP_V4_ADDR_MASK;
+        condition.conditionValue.v4AddrMask = batch.store(FWP_V4_ADDR_AND_MASK{address, ~0U});
+
+        FWPM_FILTER filter{};
+        filter.providerKey = &PIA_PROVIDER_KEY;
+        filter.subLayerKey = PIA_SUBLAYER_KEY;
+        filter.layerKey = FWPM_LAYER_ALE_AUTH_CONNECT_V4;
+        filter.action.type = FWP_ACTION_BLOCK;
+        filter.weight.type = FWP_UINT8;
+        filter.weight.uint8 = 10;
+
+        batch.add(filter, {&condition, 1});
+    }
+}
+
+struct Measurement
+{
+    size_t roundTrips{};
+    double milliseconds{};
+};
+
+template <typename FuncT> Measurement measure(MemoryEngine &engine, FuncT func)
+{
+    engine.resetRoundTrips();
+    const auto start = std::chrono::steady_clock::now();
+    func();
+    const std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    return {engine.roundTrips(), elapsed.count()};
+}
+
+// What `wfpk delete -f pia` followed by `wfpk load` costs today
+Measurement fullReload(const FilterBatch &base, const FilterBatch &desired)
+{
+    MemoryEngine engine;
+    FilterApplier{engine}.apply(base.filters());
+
+    return measure(engine, [&] {
+        for(const auto &pFilter : installedPiaFilters(engine, benchLayers))
+        {
+            engine.deleteFilterById(pFilter->filterId);
+        }
+        FilterApplier{engine}.apply(desired.filters());
+    });
+}
+
+Measurement diffApply(const FilterBatch &base, const FilterBatch &desired)
+{
+    MemoryEngine engine;
+    FilterApplier{engine}.apply(base.filters());
+
+    return measure(engine,
+                   [&] { DiffApplier{engine, benchLayers}.apply(desired.filters()); });
+}
+}
+
+int main()
+{
+    FilterBatch base{benchDisplayData, "benchmark"};
+    fillBatch(base, 0);
+
+    std::cout << std::format("{} filters\n", kFilterCount);
+    std::cout << std::format("{:>8} {:>14} {:>14} {:>14} {:>12} {:>12}\n", "changed",
+                             "full (trips)", "diff (trips)", "trips saved", "full (ms)",
+                             "diff (ms)");
+
+    for(const double changedFraction : {0.01, 0.10, 1.00})
+    {
+        FilterBatch desired{benchDisplayData, "benchmark"};
+        fillBatch(desired, static_cast<size_t>(kFilterCount * changedFraction));
+
+        const auto full = fullReload(base, desired);
+        const auto diff = diffApply(base, desired);
+
+        std::cout << std::format("{:>7.0f}% {:>14} {:>14} {:>14} {:>12.1f} {:>12.1f}\n",
+                                 changedFraction * 100, full.roundTrips, diff.roundTrips,
+                                 full.roundTrips - diff.roundTrips, full.milliseconds,
+                                 diff.milliseconds);
+    }
+
+    return 0;
+}
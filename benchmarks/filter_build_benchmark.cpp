@@ -0,0 +1,59 @@
+// Compares lowering a large ruleset on one thread against FilterBuilder's workers.
+#include <apply/filter_builder.h>
+#include <parser/parser.h>
+
+using namespace wfpk;
+
+namespace
+{
+constexpr size_t kRuleCount = 100'000;
+
+FWPM_DISPLAY_DATA benchDisplayData{const_cast<wchar_t *>(L"benchmark"), nullptr};
+
+std::string rules()
+{
+    std::string rules;
+    for(size_t i = 0; i < kRuleCount; ++i)
+    {
+        const size_t high = i / 256 % 256;
+        const size_t low = i % 256;
+        rules += std::format("block out proto tcp to {{10.{}.{}.0/24, 172.16.{}.{}}} port "
+                             "{{80, 443}}\n",
+                             high, low, high, low);
+    }
+    return rules;
+}
+
+template <typename FuncT> double measureMs(FuncT func)
+{
+    const auto start = std::chrono::steady_clock::now();
+    func();
+    const std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+}
+
+int main()
+{
+    const auto ast = Parser{rules()}.parse();
+
+    std::vector<std::pair<size_t, double>> results;
+    for(const size_t workers : {1, 2, 4, 8})
+    {
+        const FilterBuilder builder{benchDisplayData, "benchmark", {}, WeightAllocator{}, workers};
+        results.emplace_back(builder.workerCount(kRuleCount),
+                             measureMs([&] { builder.build(*ast); }));
+    }
+
+    std::cout.clear();
+
+    std::cout << std::format("{} rules\n", kRuleCount);
+    std::cout << std::format("{:>8} {:>12}\n", "workers", "build (ms)");
+    for(const auto &[workers, milliseconds] : results)
+    {
+        std::cout << std::format("{:>8} {:>12.1f}\n", workers, milliseconds);
+    }
+
+    return 0;
+}
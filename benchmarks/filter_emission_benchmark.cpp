@@ -0,0 +1,92 @@
+// Compares installing a blocklist as one filter per address (how WfpExecutor used to
+// lower a rule) against one multi-condition filter per rule.
+// Runs against MemoryEngine, where every call counts as one BFE round trip.
+#include <apply/filter_applier.h>
+#include <apply/filter_batch.h>
+#include <engine/memory_engine.h>
+#include <visitors/wfp_executor.h>
+#include <parser/parser.h>
+
+using namespace wfpk;
+
+namespace
+{
+FWPM_DISPLAY_DATA benchDisplayData{const_cast<wchar_t *>(L"benchmark"), nullptr};
+
+std::vector<std::string> blocklist(size_t count)
+{
+    std::vector<std::string> addresses;
+    for(size_t i = 0; i < count; ++i)
+    {
+        addresses.push_back(std::format("10.{}.{}.1", i / 256, i % 256));
+    }
+    return addresses;
+}
+
+// A rule per address, so every address gets its own filter
+std::string perAddressRules(const std::vector<std::string> &addresses)
+{
+    std::string rules;
+    for(const auto &address : addresses)
+    {
+        rules += std::format("block out to {}\n", address);
+    }
+    return rules;
+}
+
+// A single rule listing every address
+std::string singleRule(const std::vector<std::string> &addresses)
+{
+    std::string rules = "block out to {";
+    for(size_t i = 0; i < addresses.size(); ++i)
+    {
+        rules += (i == 0 ? "" : ", ") + addresses[i];
+    }
+    return rules + "}";
+}
+
+struct Measurement
+{
+    size_t filterCount{};
+    size_t roundTrips{};
+    double milliseconds{};
+};
+
+Measurement install(const std::string &rules)
+{
+    FilterBatch batch{benchDisplayData, "benchmark"};
+    auto tree = Parser{rules}.parse();
+    tree->accept(WfpExecutor{batch});
+
+    MemoryEngine engine;
+    const auto start = std::chrono::steady_clock::now();
+    FilterApplier{engine}.apply(batch.filters());
+    const std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+
+    return {engine.filterCount(), engine.roundTrips(), elapsed.count()};
+}
+}
+
+int main()
+{
+    std::cout << std::format("{:>10} {:>10} {:>12} {:>12} {:>12}\n", "addresses", "emission",
+                             "filters", "trips", "apply (ms)");
+
+    for(const size_t addressCount : {1'000, 10'000, 50'000})
+    {
+        const auto addresses = blocklist(addressCount);
+
+        for(const auto &[name, rules] :
+            {std::pair{"per-addr", perAddressRules(addresses)},
+             std::pair{"per-rule", singleRule(addresses)}})
+        {
+            const auto result = install(rules);
+            std::cout << std::format("{:>10} {:>10} {:>12} {:>12} {:>12.1f}\n", addressCount,
+                                     name, result.filterCount, result.roundTrips,
+                                     result.milliseconds);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+// Compares holding 100k enumerated filters as shared_ptrs into their pages against
+// decoding them into a FilterMirror: bytes per filter, and the time to select PIA's
+// block filters from each.
+#include <engine/filter_mirror.h>
+
+using namespace wfpk;
+
+namespace
+{
+constexpr size_t kFilterCount = 100'000;
+
+// What the BFE hands out per filter: the filter, its condition array and payloads, its
+// display strings and the page's pointer to it
+constexpr wchar_t kFilterName[] = L"Private Internet Access Firewall";
+constexpr wchar_t kFilterDescription[] = L"Implements privacy filtering features";
+
+struct EnumeratedFilter
+{
+    FWPM_FILTER filter{};
+    UINT64 weight{};
+    FWP_V4_ADDR_AND_MASK addrMask{};
+    FWPM_FILTER_CONDITION conditions[2]{};
+};
+
+constexpr size_t kEnumeratedBytes = sizeof(FWPM_FILTER) + 2 * sizeof(FWPM_FILTER_CONDITION) +
+                                    sizeof(UINT64) + sizeof(FWP_V4_ADDR_AND_MASK) +
+                                    sizeof(kFilterName) + sizeof(kFilterDescription) +
+                                    sizeof(GUID) + sizeof(FWPM_FILTER *);
+
+template <typename FuncT> double millisecondsFor(FuncT func)
+{
+    const auto start = std::chrono::steady_clock::now();
+    func();
+    const std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+}
+
+int main()
+{
+    GUID otherProvider{0x1234};
+    std::vector<EnumeratedFilter> page(kFilterCount);
+    for(size_t i = 0; i < kFilterCount; ++i)
+    {
+        auto &entry = page[i];
+        auto &filter = entry.filter;
+        filter.filterId = i + 1;
+        filter.filterKey.Data1 = static_cast<unsigned long>(i);
+        filter.displayData.name = const_cast<wchar_t *>(kFilterName);
+        filter.displayData.description = const_cast<wchar_t *>(kFilterDescription);
+        filter.providerKey = i % 4 ? &PIA_PROVIDER_KEY : &otherProvider;
+        filter.layerKey = FWPM_LAYER_ALE_AUTH_CONNECT_V4;
+        filter.subLayerKey = PIA_SUBLAYER_KEY;
+        filter.action.type = i % 3 ? FWP_ACTION_BLOCK : FWP_ACTION_PERMIT;
+        entry.weight = i;
+        filter.weight.type = FWP_UINT64;
+        filter.weight.uint64 = &entry.weight;
+
+        entry.addrMask = {0x0A000000 + static_cast<UINT32>(i), ~0U};
+        entry.conditions[0].fieldKey = FWPM_CONDITION_IP_REMOTE_ADDRESS;
+        entry.conditions[0].conditionValue.type = FWP_V4_ADDR_MASK;
+        entry.conditions[0].conditionValue.v4AddrMask = &entry.addrMask;
+        entry.conditions[1].fieldKey = FWPM_CONDITION_IP_REMOTE_PORT;
+        entry.conditions[1].conditionValue.type = FWP_UINT16;
+        entry.conditions[1].conditionValue.uint16 = 443;
+        filter.numFilterConditions = 2;
+        filter.filterCondition = entry.conditions;
+    }
+
+    // Views sharing ownership of the page, as enumeration hands them out
+    std::shared_ptr<EnumeratedFilter> pPage{page.data(), [](EnumeratedFilter *) {}};
+    std::vector<std::shared_ptr<FWPM_FILTER>> views;
+    views.reserve(kFilterCount);
+    for(auto &entry : page)
+    {
+        views.emplace_back(pPage, &entry.filter);
+    }
+
+    FilterMirror mirror;
+    const double decode = millisecondsFor([&] {
+        mirror.reserve(kFilterCount);
+        for(const auto &pFilter : views)
+        {
+            mirror.add(*pFilter);
+        }
+    });
+
+    const FilterQuery query{.providerKey = PIA_PROVIDER_KEY, .actionTypes = {FWP_ACTION_BLOCK}};
+    size_t viewMatches{0};
+    const double viewSelect = millisecondsFor([&] {
+        viewMatches = std::ranges::count_if(
+            views, [&](const auto &pFilter) { return query.matches(*pFilter); });
+    });
+    size_t mirrorMatches{0};
+    const double mirrorSelect =
+        millisecondsFor([&] { mirrorMatches = mirror.select(query).size(); });
+
+    std::cout << std::format("{} filters, 2 conditions each (decoded in {:.1f} ms)\n",
+                             kFilterCount, decode);
+    std::cout << std::format("{:>24} {:>14} {:>12}\n", "layout", "bytes/filter", "select (ms)");
+    std::cout << std::format("{:>24} {:>14} {:>12.2f}\n", "shared_ptr views",
+                             kEnumeratedBytes + sizeof(std::shared_ptr<FWPM_FILTER>), viewSelect);
+    std::cout << std::format("{:>24} {:>14} {:>12.2f}\n", "FilterMirror",
+                             mirror.bytesUsed() / kFilterCount, mirrorSelect);
+    std::cout << std::format("Same selection: {} ({} filters)\n", viewMatches == mirrorMatches,
+                             mirrorMatches);
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+// Compares ranking a sublayer of 100k enumerated filters by weight in a
+// std::multiset of shared_ptrs (as listing used to) against SortedFilters, and the
+// cost of walking each in weight order afterwards.
+#include <engine/sorted_filters.h>
+#include <set>
+
+using namespace wfpk;
+
+namespace
+{
+constexpr size_t kFilterCount = 100'000;
+
+// Ranks by the decoded weight, so both containers produce the same order
+struct WeightCompare
+{
+    bool operator()(const std::shared_ptr<FWPM_FILTER> &lhs,
+                    const std::shared_ptr<FWPM_FILTER> &rhs) const
+    {
+        return filterWeight(*lhs) > filterWeight(*rhs);
+    }
+};
+
+template <typename FuncT> double millisecondsFor(FuncT func)
+{
+    const auto start = std::chrono::steady_clock::now();
+    func();
+    const std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+}
+
+int main()
+{
+    // One allocation for every filter, like an enumerated page - with weights spread
+    // over the whole 64-bit range, as a weight allocator assigns them
+    std::vector<FWPM_FILTER> filters(kFilterCount);
+    std::vector<UINT64> weights(kFilterCount);
+    UINT64 state{0x9E3779B97F4A7C15};
+    for(size_t i = 0; i < kFilterCount; ++i)
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        weights[i] = state;
+        filters[i].filterId = i + 1;
+        filters[i].weight.type = FWP_UINT64;
+        filters[i].weight.uint64 = &weights[i];
+    }
+    // Views sharing ownership of the page, as enumeration hands them out
+    std::shared_ptr<FWPM_FILTER> pPage{filters.data(), [](FWPM_FILTER *) {}};
+
+    UINT64 setChecksum{0};
+    std::multiset<std::shared_ptr<FWPM_FILTER>, WeightCompare> filterSet;
+    const double setSort = millisecondsFor([&] {
+        for(auto &filter : filters)
+        {
+            filterSet.insert(std::shared_ptr<FWPM_FILTER>{pPage, &filter});
+        }
+    });
+    const double setWalk = millisecondsFor([&] {
+        for(const auto &pFilter : filterSet)
+        {
+            setChecksum = setChecksum * 31 + pFilter->filterId;
+        }
+    });
+
+    UINT64 sortedChecksum{0};
+    SortedFilters sorted;
+    const double sortedSort = millisecondsFor([&] {
+        sorted.reserve(filters.size());
+        for(const auto &filter : filters)
+        {
+            sorted.add(filter);
+        }
+        sorted.sort();
+    });
+    const double sortedWalk = millisecondsFor([&] {
+        for(const auto &entry : sorted)
+        {
+            sortedChecksum = sortedChecksum * 31 + entry.pFilter->filterId;
+        }
+    });
+
+    std::cout << std::format("{} filters\n", kFilterCount);
+    std::cout << std::format("{:>24} {:>12} {:>12}\n", "container", "sort (ms)", "walk (ms)");
+    std::cout << std::format("{:>24} {:>12.2f} {:>12.2f}\n", "multiset<shared_ptr>", setSort,
+                             setWalk);
+    std::cout << std::format("{:>24} {:>12.2f} {:>12.2f}\n", "SortedFilters", sortedSort,
+                             sortedWalk);
+    std::cout << std::format("Same order: {}\n", setChecksum == sortedChecksum);
+
+    return 0;
+}
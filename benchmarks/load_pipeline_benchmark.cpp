@@ -0,0 +1,110 @@
+// Compares a sequential load (parse and lower everything, then apply) with LoadPipeline,
+// against an in-memory engine that sleeps to stand in for BFE round trips.
+#include <pipeline/load_pipeline.h>
+#include <apply/filter_plan.h>
+#include <engine/memory_engine.h>
+#include <sstream>
+
+using namespace wfpk;
+
+namespace
+{
+constexpr size_t kRuleCount = 50'000;
+// Modelled cost of adding a filter - the BFE's time, not ours, so the thread sleeps
+constexpr std::chrono::microseconds kAddLatency{10};
+constexpr size_t kAddsPerSleep = 100;
+
+FWPM_DISPLAY_DATA benchDisplayData{const_cast<wchar_t *>(L"benchmark"), nullptr};
+
+// MemoryEngine plus a round trip latency on each add
+class SlowEngine
+{
+public:
+    DWORD tryAdd(const FWPM_FILTER &filter, FilterId &id)
+    {
+        // Sleep in batches, as sleeps this short aren't honoured
+        if(++_adds % kAddsPerSleep == 0)
+        {
+            std::this_thread::sleep_for(kAddLatency * kAddsPerSleep);
+        }
+        return _engine.tryAdd(filter, id);
+    }
+    DWORD deleteFilterById(FilterId filterId)
+    {
+        return _engine.deleteFilterById(filterId);
+    }
+    DWORD deleteFilterByKey(const GUID &filterKey)
+    {
+        return _engine.deleteFilterByKey(filterKey);
+    }
+    auto filterByKey(const GUID &filterKey) -> std::shared_ptr<FWPM_FILTER>
+    {
+        return _engine.filterByKey(filterKey);
+    }
+    void beginTransaction()
+    {
+        _engine.beginTransaction();
+    }
+    void commitTransaction()
+    {
+        _engine.commitTransaction();
+    }
+    DWORD abortTransaction()
+    {
+        return _engine.abortTransaction();
+    }
+
+private:
+    MemoryEngine _engine;
+    size_t _adds{0};
+};
+
+std::string rules()
+{
+    std::string rules;
+    for(size_t i = 0; i < kRuleCount; ++i)
+    {
+        const size_t high = i / 256 % 256;
+        const size_t low = i % 256;
+        rules += std::format("block out proto tcp to {{10.{}.{}.0/24, 172.16.{}.{}}} port "
+                             "{{80, 443}}\n",
+                             high, low, high, low);
+    }
+    return rules;
+}
+
+template <typename FuncT> double measureMs(FuncT func)
+{
+    const auto start = std::chrono::steady_clock::now();
+    func();
+    const std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+}
+
+int main()
+{
+    const std::string source = rules();
+
+    const double sequentialMs = measureMs([&] {
+        SlowEngine engine;
+        auto plan = planRuleset(source, benchDisplayData, "benchmark");
+        FilterApplier{engine}.apply(plan.batch.filters());
+    });
+
+    PipelineStats stats;
+    const double pipelinedMs = measureMs([&] {
+        SlowEngine engine;
+        std::istringstream stream{source};
+        stats = LoadPipeline{engine, benchDisplayData, "benchmark"}.run(stream).stats;
+    });
+
+    std::cout << std::format("{} rules, {}us per add\n", kRuleCount, kAddLatency.count());
+    std::cout << std::format("{:>12} {:>12}\n", "load", "total (ms)");
+    std::cout << std::format("{:>12} {:>12.1f}\n", "sequential", sequentialMs);
+    std::cout << std::format("{:>12} {:>12.1f}\n\n", "pipelined", pipelinedMs);
+    std::cout << stats.toString();
+
+    return 0;
+}
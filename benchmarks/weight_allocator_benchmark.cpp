@@ -0,0 +1,67 @@
+// Times weighting large rulesets: working out each filter's specificity from its
+// conditions and allocating its weight.
+#include <apply/weight_allocator.h>
+#include <apply/filter_batch.h>
+
+using namespace wfpk;
+
+namespace
+{
+FWPM_DISPLAY_DATA benchDisplayData{const_cast<wchar_t *>(L"benchmark"), nullptr};
+
+// One filter per rule with a mix of address, port and protocol conditions
+void fillBatch(FilterBatch &batch, size_t ruleCount)
+{
+    for(UINT32 i = 0; i < ruleCount; ++i)
+    {
+        FWPM_FILTER_CONDITION conditions[3]{};
+        conditions[0].fieldKey = FWPM_CONDITION_IP_REMOTE_ADDRESS;
+        conditions[0].conditionValue.type = FWP_V4_ADDR_MASK;
+        conditions[0].conditionValue.v4AddrMask =
+            batch.store(FWP_V4_ADDR_AND_MASK{0x0A000000 + i, ~0U << (i % 24)});
+        conditions[1].fieldKey = FWPM_CONDITION_IP_REMOTE_PORT;
+        conditions[1].conditionValue.type = FWP_UINT16;
+        conditions[1].conditionValue.uint16 = static_cast<UINT16>(i);
+        conditions[2].fieldKey = FWPM_CONDITION_IP_PROTOCOL;
+        conditions[2].conditionValue.type = FWP_UINT8;
+        conditions[2].conditionValue.uint8 = IPPROTO_TCP;
+
+        FWPM_FILTER filter{};
+        filter.layerKey = FWPM_LAYER_ALE_AUTH_CONNECT_V4;
+        filter.action.type = FWP_ACTION_BLOCK;
+
+        batch.add(filter, {conditions, 1 + i % 3});
+    }
+}
+}
+
+int main()
+{
+    std::cout << std::format("{:>10} {:>12} {:>12}\n", "rules", "policy", "weigh (ms)");
+
+    for(const size_t ruleCount : {100'000, 1'000'000})
+    {
+        FilterBatch batch{benchDisplayData, "benchmark"};
+        fillBatch(batch, ruleCount);
+
+        for(const auto policy : {WeightPolicy::RuleOrder, WeightPolicy::Specificity})
+        {
+            const WeightAllocator allocator{policy};
+
+            UINT64 checksum{};
+            const auto start = std::chrono::steady_clock::now();
+            for(size_t ruleIndex = 0; ruleIndex < batch.size(); ++ruleIndex)
+            {
+                checksum += allocator.weightFor(ruleIndex, batch.filters()[ruleIndex]);
+            }
+            const std::chrono::duration<double, std::milli> elapsed =
+                std::chrono::steady_clock::now() - start;
+
+            std::cout << std::format("{:>10} {:>12} {:>12.1f} (checksum {})\n", ruleCount,
+                                     policy == WeightPolicy::RuleOrder ? "order" : "specificity",
+                                     elapsed.count(), checksum % 1000);
+        }
+    }
+
+    return 0;
+}
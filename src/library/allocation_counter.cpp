@@ -0,0 +1,31 @@
+// Replaces the global operator new to count heap allocations (see allocation_stats.h).
+// Not part of wfpklib, so programs linking it keep the standard allocator - only those
+// linking wfpk_allocation_counter count.
+#include <allocation_stats.h>
+#include <cstdlib>
+#include <new>
+
+// Replacing the plain forms is enough: the array and nothrow forms call these by default.
+// Over-aligned allocations are left to the standard library and go uncounted.
+void *operator new(std::size_t size)
+{
+    wfpk::recordAllocation(size);
+
+    // malloc(0) may return nullptr, operator new must not
+    if(void *pMemory = std::malloc(size ? size : 1))
+    {
+        return pMemory;
+    }
+
+    throw std::bad_alloc{};
+}
+
+void operator delete(void *pMemory) noexcept
+{
+    std::free(pMemory);
+}
+
+void operator delete(void *pMemory, std::size_t) noexcept
+{
+    std::free(pMemory);
+}
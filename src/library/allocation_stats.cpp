@@ -0,0 +1,24 @@
+#include <allocation_stats.h>
+#include <atomic>
+
+namespace wfpk
+{
+namespace
+{
+// Relaxed - these are statistics, not synchronization
+std::atomic<size_t> gAllocationCount{0};
+std::atomic<size_t> gAllocationBytes{0};
+}
+
+void recordAllocation(size_t bytes)
+{
+    gAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    gAllocationBytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+AllocationStats allocationStats()
+{
+    return {gAllocationCount.load(std::memory_order_relaxed),
+            gAllocationBytes.load(std::memory_order_relaxed)};
+}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstddef>
+#include <format>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace wfpk
+{
+// Heap allocations made through the global operator new (all threads)
+struct AllocationStats
+{
+    size_t count{};
+    size_t bytes{};
+
+    AllocationStats operator-(const AllocationStats &other) const
+    {
+        return {count - other.count, bytes - other.bytes};
+    }
+};
+
+// Allocations made since the program started - if the program counts them. Counting
+// replaces the global operator new, which a library shouldn't impose on every program
+// linking it: only programs that also link wfpk_allocation_counter (see
+// allocation_counter.cpp) count, everywhere else this stays zero.
+AllocationStats allocationStats();
+// Whether the program counts allocations - any that does has allocated by now
+inline bool allocationsCounted()
+{
+    return allocationStats().count > 0;
+}
+// Called by the operator new replacement for each allocation
+void recordAllocation(size_t bytes);
+
+// Records the allocations made by named phases (in the order they ran),
+// the allocation counterpart to PhaseTimings.
+// Allocations on other threads during a phase are counted too.
+class PhaseAllocations
+{
+public:
+    template <typename FuncT>
+        requires std::invocable<FuncT>
+    auto measure(const std::string &phase, FuncT func) -> std::invoke_result_t<FuncT>
+    {
+        const auto before = allocationStats();
+        auto record = [&] { _phases.emplace_back(phase, allocationStats() - before); };
+
+        if constexpr(std::is_void_v<std::invoke_result_t<FuncT>>)
+        {
+            func();
+            record();
+        }
+        else
+        {
+            auto result = func();
+            record();
+            return result;
+        }
+    }
+
+    auto phases() const -> const std::vector<std::pair<std::string, AllocationStats>> &
+    {
+        return _phases;
+    }
+
+    // e.g "parse: 1200 (48.0KB), lower: 310 (512.5KB)"
+    std::string toString() const
+    {
+        std::string result;
+        for(const auto &[phase, stats] : _phases)
+        {
+            if(!result.empty())
+            {
+                result += ", ";
+            }
+            result += std::format("{}: {} ({:.1f}KB)", phase, stats.count, stats.bytes / 1024.0);
+        }
+
+        return result;
+    }
+
+private:
+    std::vector<std::pair<std::string, AllocationStats>> _phases;
+};
+}
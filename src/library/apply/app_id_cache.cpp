@@ -0,0 +1,267 @@
+#include <apply/app_id_cache.h>
+#include <fstream>
+#include <cstring>
+#include <mutex>
+
+namespace wfpk
+{
+namespace
+{
+constexpr std::string_view kMagic{"WFPKAPID"};
+constexpr uint32_t kVersion = 1;
+
+// Fields are written in host byte order - the cache never leaves the machine
+template <typename T> void put(std::ostream &out, const T &value)
+{
+    out.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void putBytes(std::ostream &out, std::string_view bytes)
+{
+    put(out, static_cast<uint32_t>(bytes.size()));
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+template <typename T> bool get(std::istream &in, T &value)
+{
+    return static_cast<bool>(in.read(reinterpret_cast<char *>(&value), sizeof(value)));
+}
+
+template <typename ContainerT> bool getBytes(std::istream &in, ContainerT &bytes)
+{
+    uint32_t size{};
+    if(!get(in, size))
+    {
+        return false;
+    }
+    bytes.resize(size);
+    return size == 0 || static_cast<bool>(in.read(reinterpret_cast<char *>(bytes.data()), size));
+}
+}
+
+auto defaultAppIdCachePath() -> std::filesystem::path
+{
+    return wfpkDataDirectory() / "appids.cache";
+}
+
+std::string AppIdCacheStats::toString() const
+{
+    return std::format("{} hits, {} misses ({} stale, {} failed)", hits, misses, stale,
+                       failures);
+}
+
+std::string normalizeAppPath(std::string_view appPath)
+{
+    return toLowercase(
+        std::filesystem::path{appPath}.lexically_normal().make_preferred().string());
+}
+
+AppIdCache::AppIdCache(AppIdResolver resolver, std::filesystem::path cachePath)
+    : _resolver{std::move(resolver)}
+    , _cachePath{std::move(cachePath)}
+{
+    if(!_cachePath.empty())
+    {
+        load();
+    }
+}
+
+auto AppIdCache::resolve(const std::string &appPath) -> std::vector<UINT8>
+{
+    const std::string key = normalizeAppPath(appPath);
+    auto version = fileVersion(appPath);
+
+    if(version)
+    {
+        std::shared_lock lock{_mutex};
+        if(auto it = _entries.find(key); it != _entries.end())
+        {
+            const auto &entry = it->second;
+            if(entry.fileSize == version->fileSize &&
+               entry.lastWriteTime == version->lastWriteTime)
+            {
+                ++_hits;
+                return entry.appId;
+            }
+            ++_stale;
+        }
+    }
+
+    // Resolved without the lock held, so other lookups (and misses) aren't held up
+    ++_misses;
+    auto appId = _resolver(appPath);
+    if(appId.empty())
+    {
+        ++_failures;
+        return appId;
+    }
+
+    if(version)
+    {
+        version->appId = appId;
+        std::unique_lock lock{_mutex};
+        _entries.insert_or_assign(key, std::move(*version));
+        _dirty = true;
+    }
+
+    return appId;
+}
+
+auto AppIdCache::stats() const -> AppIdCacheStats
+{
+    return {_hits, _misses, _stale, _failures};
+}
+
+size_t AppIdCache::size() const
+{
+    std::shared_lock lock{_mutex};
+    return _entries.size();
+}
+
+auto AppIdCache::fileVersion(const std::string &appPath) -> std::optional<Entry>
+{
+    // App paths are UTF-8 - a path built from a std::string would take them to be in
+    // the ANSI code page
+    const std::filesystem::path path{stringToWideString(appPath)};
+
+    std::error_code error;
+    const auto fileSize = std::filesystem::file_size(path, error);
+    if(error)
+    {
+        return {};
+    }
+    const auto lastWriteTime = std::filesystem::last_write_time(path, error);
+    if(error)
+    {
+        return {};
+    }
+
+    return Entry{fileSize, static_cast<int64_t>(lastWriteTime.time_since_epoch().count())};
+}
+
+void AppIdCache::load()
+{
+    std::ifstream file{_cachePath, std::ios::binary};
+    if(!file.is_open())
+    {
+        return;
+    }
+
+    std::string magic(kMagic.size(), '\0');
+    uint32_t version{};
+    uint32_t count{};
+    if(!file.read(magic.data(), magic.size()) || magic != kMagic || !get(file, version) ||
+       version != kVersion || !get(file, count))
+    {
+        return;
+    }
+
+    std::unordered_map<std::string, Entry> entries;
+    for(uint32_t i = 0; i < count; ++i)
+    {
+        std::string path;
+        Entry entry;
+        if(!getBytes(file, path) || !get(file, entry.fileSize) ||
+           !get(file, entry.lastWriteTime) || !getBytes(file, entry.appId))
+        {
+            // A damaged cache is only a slower load, start afresh
+            return;
+        }
+        entries.insert_or_assign(std::move(path), std::move(entry));
+    }
+
+    std::unique_lock lock{_mutex};
+    _entries = std::move(entries);
+}
+
+void AppIdCache::save()
+{
+    std::unique_lock lock{_mutex};
+    if(!_dirty || _cachePath.empty())
+    {
+        return;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(_cachePath.parent_path(), error);
+
+    auto savePath = _cachePath;
+    savePath += ".save";
+    {
+        std::ofstream file{savePath, std::ios::binary | std::ios::trunc};
+        file.write(kMagic.data(), kMagic.size());
+        put(file, kVersion);
+        put(file, static_cast<uint32_t>(_entries.size()));
+        for(const auto &[path, entry] : _entries)
+        {
+            putBytes(file, path);
+            put(file, entry.fileSize);
+            put(file, entry.lastWriteTime);
+            putBytes(file, {reinterpret_cast<const char *>(entry.appId.data()),
+                            entry.appId.size()});
+        }
+        file.flush();
+
+        if(!file)
+        {
+            throw std::runtime_error{
+                std::format("Failed to write app id cache {}", savePath.string())};
+        }
+    }
+
+    std::filesystem::rename(savePath, _cachePath, error);
+    if(error)
+    {
+        throw std::runtime_error{
+            std::format("Failed to write app id cache {}: {}", _cachePath.string(),
+                        error.message())};
+    }
+    _dirty = false;
+}
+
+auto resolveAppIds(std::span<const std::string> appPaths, const AppIdResolver &resolver,
+                   size_t maxWorkers) -> std::unordered_map<std::string, std::vector<UINT8>>
+{
+    std::vector<std::vector<UINT8>> appIds(appPaths.size());
+    std::vector<std::exception_ptr> errors(appPaths.size());
+    std::atomic<size_t> next{0};
+
+    // Each worker takes the next unresolved path, as resolving some takes far longer
+    // than others (e.g a path on a network share)
+    auto work = [&] {
+        for(size_t i = next++; i < appPaths.size(); i = next++)
+        {
+            try
+            {
+                appIds[i] = resolver(appPaths[i]);
+            }
+            catch(...)
+            {
+                errors[i] = std::current_exception();
+            }
+        }
+    };
+
+    {
+        const size_t workerCount = std::max<size_t>((std::min)(appPaths.size(), maxWorkers), 1);
+        std::vector<std::jthread> workers;
+        for(size_t i = 1; i < workerCount; ++i)
+        {
+            workers.emplace_back(work);
+        }
+        work();
+    }
+
+    std::unordered_map<std::string, std::vector<UINT8>> result;
+    for(size_t i = 0; i < appPaths.size(); ++i)
+    {
+        if(errors[i])
+        {
+            std::rethrow_exception(errors[i]);
+        }
+        result.emplace(appPaths[i], std::move(appIds[i]));
+    }
+
+    return result;
+}
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <visitors/wfp_executor.h>
+#include <atomic>
+#include <shared_mutex>
+#include <thread>
+
+namespace wfpk
+{
+// Where wfpk keeps its app id cache: %ProgramData%\wfpk\appids.cache
+auto defaultAppIdCachePath() -> std::filesystem::path;
+
+struct AppIdCacheStats
+{
+    size_t hits{0};
+    size_t misses{0};
+    // Misses for paths that were cached, but whose file has changed since
+    size_t stale{0};
+    // Misses the resolver couldn't resolve (these aren't cached)
+    size_t failures{0};
+
+    // e.g: 120 hits, 3 misses (1 stale, 0 failed)
+    std::string toString() const;
+};
+
+// Caches the app ids an AppIdResolver produces (FwpmGetAppIdFromFileName resolves the
+// path to a device path on every call) in memory and on disk.
+// Entries are keyed by normalized path and remember the file's size and last write
+// time - an entry whose file has since changed is a miss, and is resolved again.
+// Paths that don't name a file are never cached.
+//
+// Lookups are thread safe, and misses are resolved outside the lock so several can
+// be in flight at once (see resolveAppIds()).
+class AppIdCache
+{
+public:
+    // Entries are loaded from cachePath if it exists - an empty path keeps the cache
+    // in memory only. A cache file that can't be read is ignored.
+    explicit AppIdCache(AppIdResolver resolver, std::filesystem::path cachePath = {});
+
+public:
+    auto resolve(const std::string &appPath) -> std::vector<UINT8>;
+    // An AppIdResolver backed by this cache, which must outlive it
+    auto resolver() -> AppIdResolver
+    {
+        return [this](const std::string &appPath) { return resolve(appPath); };
+    }
+
+    auto stats() const -> AppIdCacheStats;
+    size_t size() const;
+
+    // Write the cache out if anything was added since it was loaded. It's written aside
+    // then renamed over the cache file, so a reader never sees it half written.
+    // Throws a std::runtime_error on failure.
+    void save();
+
+private:
+    struct Entry
+    {
+        uintmax_t fileSize{0};
+        int64_t lastWriteTime{0};
+        std::vector<UINT8> appId;
+    };
+
+    // The file's size and last write time, or nullopt if it's not a file
+    static auto fileVersion(const std::string &appPath) -> std::optional<Entry>;
+    void load();
+
+private:
+    AppIdResolver _resolver;
+    std::filesystem::path _cachePath;
+    mutable std::shared_mutex _mutex;
+    // By normalized path
+    std::unordered_map<std::string, Entry> _entries;
+    bool _dirty{false};
+    std::atomic<size_t> _hits{0};
+    std::atomic<size_t> _misses{0};
+    std::atomic<size_t> _stale{0};
+    std::atomic<size_t> _failures{0};
+};
+
+// Paths are compared case-insensitively with consistent separators, as Windows does
+std::string normalizeAppPath(std::string_view appPath);
+
+// Resolve each of a set of distinct app paths, spread across up to maxWorkers threads.
+// Throws the first error raised by the resolver.
+auto resolveAppIds(std::span<const std::string> appPaths, const AppIdResolver &resolver,
+                   size_t maxWorkers = std::thread::hardware_concurrency())
+    -> std::unordered_map<std::string, std::vector<UINT8>>;
+}
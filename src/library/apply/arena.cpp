@@ -0,0 +1,38 @@
+#include <apply/arena.h>
+#include <algorithm>
+
+namespace wfpk
+{
+void Arena::adopt(Arena &&other)
+{
+    // Keep allocating from our current block, the other arena's blocks are just kept alive
+    std::ranges::move(other._blocks, std::back_inserter(_blocks));
+    _bytesUsed += other._bytesUsed;
+
+    other._blocks.clear();
+    other._pCursor = nullptr;
+    other._remaining = 0;
+    other._bytesUsed = 0;
+}
+
+void *Arena::allocateBytes(size_t size, size_t alignment)
+{
+    void *pCursor = _pCursor;
+    if(!_pCursor || !std::align(alignment, size, pCursor, _remaining))
+    {
+        // Oversized requests get a block of their own
+        const size_t blockSize = (std::max)(_blockSize, size + alignment);
+        _blocks.push_back(std::make_unique_for_overwrite<std::byte[]>(blockSize));
+
+        pCursor = _blocks.back().get();
+        _remaining = blockSize;
+        std::align(alignment, size, pCursor, _remaining);
+    }
+
+    _pCursor = static_cast<std::byte *>(pCursor) + size;
+    _remaining -= size;
+    _bytesUsed += size;
+
+    return pCursor;
+}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace wfpk
+{
+// A bump allocator for filter storage (condition arrays, payloads, display strings).
+// Memory is handed out from large blocks and only released when the arena is destroyed,
+// so pointers into it stay valid for its lifetime - including across moves.
+// Only trivially destructible types may be allocated, as nothing is ever destroyed.
+// Not thread safe - give each thread its own arena and adopt() them afterwards.
+class Arena
+{
+public:
+    static constexpr size_t kDefaultBlockSize = 64 * 1024;
+
+public:
+    explicit Arena(size_t blockSize = kDefaultBlockSize)
+        : _blockSize{blockSize}
+    {}
+    Arena(Arena &&) = default;
+    Arena &operator=(Arena &&) = default;
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+public:
+    // Uninitialized storage for count objects of T
+    template <typename T> T *allocate(size_t count = 1)
+    {
+        static_assert(std::is_trivially_destructible_v<T>);
+        return static_cast<T *>(allocateBytes(sizeof(T) * count, alignof(T)));
+    }
+
+    template <typename T> T *copy(const T &value)
+    {
+        T *pValue = allocate<T>();
+        *pValue = value;
+        return pValue;
+    }
+
+    template <typename T> T *copyArray(std::span<const T> values)
+    {
+        if(values.empty())
+        {
+            return nullptr;
+        }
+
+        T *pValues = allocate<T>(values.size());
+        std::uninitialized_copy(values.begin(), values.end(), pValues);
+        return pValues;
+    }
+
+    // Take ownership of another arena's blocks, pointers into it remain valid
+    void adopt(Arena &&other);
+
+    // Number of blocks allocated from the heap (including adopted ones)
+    size_t blockCount() const
+    {
+        return _blocks.size();
+    }
+    size_t bytesUsed() const
+    {
+        return _bytesUsed;
+    }
+
+private:
+    void *allocateBytes(size_t size, size_t alignment);
+
+private:
+    size_t _blockSize{};
+    std::vector<std::unique_ptr<std::byte[]>> _blocks;
+    std::byte *_pCursor{};
+    size_t _remaining{};
+    size_t _bytesUsed{};
+};
+}
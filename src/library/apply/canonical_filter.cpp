@@ -0,0 +1,150 @@
+#include <apply/canonical_filter.h>
+
+namespace wfpk
+{
+namespace
+{
+// Flags that affect how a filter behaves - others (such as INDEXED) are hints
+// the BFE is free to change.
+constexpr UINT32 BehaviourFlags = FWPM_FILTER_FLAG_PERSISTENT | FWPM_FILTER_FLAG_BOOTTIME;
+
+template <typename T>
+    requires std::is_trivially_copyable_v<T>
+void append(std::string &out, const T &value)
+{
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+void appendBytes(std::string &out, const UINT8 *data, size_t size)
+{
+    append(out, static_cast<UINT32>(size));
+    out.append(reinterpret_cast<const char *>(data), size);
+}
+
+// FWP_VALUE and FWP_CONDITION_VALUE share the same layout for the types below
+template <typename ValueT> void appendValue(std::string &out, const ValueT &value)
+{
+    append(out, static_cast<UINT32>(value.type));
+
+    switch(value.type)
+    {
+        case FWP_UINT8: append(out, value.uint8); break;
+        case FWP_UINT16: append(out, value.uint16); break;
+        case FWP_UINT32: append(out, value.uint32); break;
+        case FWP_UINT64: append(out, *value.uint64); break;
+        case FWP_INT8: append(out, value.int8); break;
+        case FWP_INT16: append(out, value.int16); break;
+        case FWP_INT32: append(out, value.int32); break;
+        case FWP_INT64: append(out, *value.int64); break;
+        case FWP_FLOAT: append(out, value.float32); break;
+        case FWP_DOUBLE: append(out, *value.double64); break;
+        case FWP_BYTE_ARRAY16_TYPE: append(out, *value.byteArray16); break;
+        case FWP_BYTE_ARRAY6_TYPE: append(out, *value.byteArray6); break;
+        case FWP_BYTE_BLOB_TYPE:
+            appendBytes(out, value.byteBlob->data, value.byteBlob->size);
+            break;
+        case FWP_SECURITY_DESCRIPTOR_TYPE: appendBytes(out, value.sd->data, value.sd->size); break;
+        case FWP_UNICODE_STRING_TYPE: {
+            std::wstring_view str{value.unicodeString};
+            appendBytes(out, reinterpret_cast<const UINT8 *>(str.data()),
+                        str.size() * sizeof(wchar_t));
+            break;
+        }
+        default: break;
+    }
+}
+
+std::string conditionContent(const FWPM_FILTER_CONDITION &condition)
+{
+    std::string out;
+    append(out, condition.fieldKey);
+    append(out, static_cast<UINT32>(condition.matchType));
+
+    const auto &value = condition.conditionValue;
+    switch(value.type)
+    {
+        case FWP_V4_ADDR_MASK:
+            append(out, static_cast<UINT32>(value.type));
+            append(out, value.v4AddrMask->addr);
+            append(out, value.v4AddrMask->mask);
+            break;
+        case FWP_V6_ADDR_MASK:
+            append(out, static_cast<UINT32>(value.type));
+            append(out, value.v6AddrMask->addr);
+            append(out, value.v6AddrMask->prefixLength);
+            break;
+        case FWP_RANGE_TYPE:
+            append(out, static_cast<UINT32>(value.type));
+            appendValue(out, value.rangeValue->valueLow);
+            appendValue(out, value.rangeValue->valueHigh);
+            break;
+        default: appendValue(out, value);
+    }
+
+    return out;
+}
+
+std::string canonicalContent(const FWPM_FILTER &filter, bool withWeight)
+{
+    std::string out;
+    out.reserve(64 + filter.numFilterConditions * 32);
+
+    append(out, filter.layerKey);
+    append(out, filter.subLayerKey);
+    append(out, filter.action.type);
+    if(filter.action.type & FWP_ACTION_FLAG_CALLOUT)
+    {
+        append(out, filter.action.calloutKey);
+    }
+    append(out, filter.flags & BehaviourFlags);
+    if(withWeight)
+    {
+        appendValue(out, filter.weight);
+    }
+
+    // Conditions are order-independent in WFP, so sort them
+    std::vector<std::string> conditions;
+    conditions.reserve(filter.numFilterConditions);
+    for(UINT32 i = 0; i < filter.numFilterConditions; ++i)
+    {
+        conditions.push_back(conditionContent(filter.filterCondition[i]));
+    }
+    std::ranges::sort(conditions);
+
+    append(out, filter.numFilterConditions);
+    for(const auto &condition : conditions)
+    {
+        appendBytes(out, reinterpret_cast<const UINT8 *>(condition.data()), condition.size());
+    }
+
+    return out;
+}
+}
+
+std::string canonicalFilterContent(const FWPM_FILTER &filter)
+{
+    return canonicalContent(filter, true);
+}
+
+std::string canonicalFilterIdentity(const FWPM_FILTER &filter)
+{
+    return canonicalContent(filter, false);
+}
+
+bool sameWeight(const FWP_VALUE &first, const FWP_VALUE &second)
+{
+    if(first.type != second.type)
+    {
+        return false;
+    }
+
+    switch(first.type)
+    {
+        case FWP_UINT8: return first.uint8 == second.uint8;
+        case FWP_UINT64:
+            return first.uint64 && second.uint64 ? *first.uint64 == *second.uint64
+                                                 : first.uint64 == second.uint64;
+        default: return true;
+    }
+}
+}
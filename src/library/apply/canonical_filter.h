@@ -0,0 +1,22 @@
+#pragma once
+
+#include <wfp_objects.h>
+
+namespace wfpk
+{
+// Encode the parts of a filter that determine its behaviour (layer, sublayer,
+// action, weight, persistence and conditions) into a byte string.
+// Two filters with the same canonical content are interchangeable, regardless of
+// their ids, keys, display data or the order of their conditions.
+// Works equally on filters we're about to add and filters enumerated from the BFE.
+std::string canonicalFilterContent(const FWPM_FILTER &filter);
+
+// The canonical content without the weight: what a filter matches and does, but not
+// how it ranks. Re-weighting a filter (e.g because a rule was inserted above it)
+// leaves its identity unchanged.
+std::string canonicalFilterIdentity(const FWPM_FILTER &filter);
+
+// Whether two weights are the same - a uint8 weight and the same value as a uint64
+// aren't, as the BFE expands a uint8 weight.
+bool sameWeight(const FWP_VALUE &first, const FWP_VALUE &second);
+}
@@ -0,0 +1,19 @@
+#include <apply/ephemeral_filters.h>
+#include <apply/filter_key.h>
+
+namespace wfpk
+{
+auto ephemeralFilters(std::span<const FWPM_FILTER> filters, std::string_view rulesetName)
+    -> std::vector<FWPM_FILTER>
+{
+    std::vector<FWPM_FILTER> result{filters.begin(), filters.end()};
+    for(auto &filter : result)
+    {
+        filter.flags &= ~(FWPM_FILTER_FLAG_PERSISTENT | FWPM_FILTER_FLAG_BOOTTIME);
+        // Flags are part of a filter's canonical content, so this is a different key
+        filter.filterKey = filterKeyFor(rulesetName, filter);
+    }
+
+    return result;
+}
+}
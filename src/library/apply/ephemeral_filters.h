@@ -0,0 +1,15 @@
+#pragma once
+
+#include <wfp_objects.h>
+#include <span>
+#include <string_view>
+
+namespace wfpk
+{
+// Copies of filters to add from a dynamic session (see SessionKind::Dynamic): no
+// longer persistent - which a dynamic session can't add - and keyed to match, so they
+// don't collide with the same filters installed persistently.
+// The copies share the originals' conditions and display data, which must outlive them.
+auto ephemeralFilters(std::span<const FWPM_FILTER> filters, std::string_view rulesetName)
+    -> std::vector<FWPM_FILTER>;
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <engine/transaction.h>
+#include <apply/canonical_filter.h>
+#include <functional>
+#include <span>
+#include <unordered_set>
+
+namespace wfpk
+{
+// Invoked with the number of filters added so far and the total to be added
+using ProgressFunc = std::function<void(size_t done, size_t total)>;
+
+// Invoked within an apply's transaction just before it commits, so any changes it
+// makes are committed (or rolled back) along with the filters. May throw, which
+// rolls back the whole apply.
+using CommitHook = std::function<void()>;
+
+// Add a filter within a transaction, which may already be installed: keys leave the
+// weight out (see filterKeyFor()), so a filter installed under the same key may be
+// weighted differently - e.g a rule has since been inserted above it. As the BFE can't
+// re-weight a filter in place, that filter is deleted and this one added instead.
+// Returns FWP_E_ALREADY_EXISTS if the filter is installed as it is, or if its key is in
+// addedKeys - it repeats a filter added from higher up the ruleset, which pre-empts it.
+// Keys added are recorded in addedKeys.
+template <KeyedFilterEngine EngineT>
+DWORD addOrReweight(EngineT &engine, const FWPM_FILTER &filter, FilterId &id,
+                    std::unordered_set<GUID> &addedKeys)
+{
+    DWORD status = engine.tryAdd(filter, id);
+    if(status == FWP_E_ALREADY_EXISTS && filter.filterKey != ZeroGuid &&
+       !addedKeys.contains(filter.filterKey))
+    {
+        const auto pInstalled = engine.filterByKey(filter.filterKey);
+        if(pInstalled && !sameWeight(pInstalled->weight, filter.weight))
+        {
+            status = engine.deleteFilterByKey(filter.filterKey);
+            if(status == ERROR_SUCCESS)
+            {
+                status = engine.tryAdd(filter, id);
+            }
+        }
+    }
+
+    if(status == ERROR_SUCCESS && filter.filterKey != ZeroGuid)
+    {
+        addedKeys.insert(filter.filterKey);
+    }
+    return status;
+}
+
+struct ApplyResult
+{
+    // Ids of the filters added by this apply
+    std::vector<FilterId> filterIds;
+    // and their keys (ZeroGuid where the BFE generated the key)
+    std::vector<GUID> filterKeys;
+    // Filters skipped because a filter with the same (content-derived) key and weight is
+    // already installed
+    size_t alreadyInstalledCount{0};
+    // Time spent in each phase of the apply (begin, add, commit)
+    PhaseTimings timings;
+};
+
+// Applies a set of filters to an engine as a single transaction - either every
+// filter is added or, on any failure, none of them are.
+// This also means a single commit for the whole set rather than one per filter.
+// Filters with a key that is already installed are skipped, which makes
+// re-applying a ruleset idempotent - or replaced, if they've since been re-weighted.
+template <KeyedFilterEngine EngineT> class FilterApplier
+{
+public:
+    explicit FilterApplier(EngineT &engine, ProgressFunc progressFunc = {},
+                           size_t progressInterval = 1000)
+        : _engine{engine}
+        , _progressFunc{std::move(progressFunc)}
+        , _progressInterval{std::max<size_t>(progressInterval, 1)}
+    {}
+
+public:
+    void beforeCommit(CommitHook hook)
+    {
+        _beforeCommit = std::move(hook);
+    }
+
+    // Throws a WfpError if any filter fails to be added (or the commit fails),
+    // the transaction is rolled back before the error propagates.
+    auto apply(std::span<const FWPM_FILTER> filters) -> ApplyResult
+    {
+        ApplyResult result;
+        result.filterIds.reserve(filters.size());
+        result.filterKeys.reserve(filters.size());
+
+        std::optional<Transaction<EngineT>> transaction;
+        result.timings.measure("begin", [&] { transaction.emplace(_engine); });
+
+        result.timings.measure("add", [&] {
+            std::unordered_set<GUID> addedKeys;
+            addedKeys.reserve(filters.size());
+            for(size_t index = 0; index < filters.size(); ++index)
+            {
+                const auto &filter = filters[index];
+
+                FilterId id{};
+                DWORD status = addOrReweight(_engine, filter, id, addedKeys);
+                if(status == FWP_E_ALREADY_EXISTS && filter.filterKey != ZeroGuid)
+                {
+                    // Keys are derived from content, so this filter (or a copy of it from
+                    // higher up the ruleset) is already installed
+                    ++result.alreadyInstalledCount;
+                }
+                else if(status != ERROR_SUCCESS)
+                {
+                    // Destroying the transaction rolls back every filter added so far
+                    transaction.reset();
+                    throw WfpError{std::format("Failed to add filter {} of {}, rolled back:",
+                                               index + 1, filters.size()),
+                                   status};
+                }
+                else
+                {
+                    result.filterIds.push_back(id);
+                    result.filterKeys.push_back(filter.filterKey);
+                }
+
+                reportProgress(index + 1, filters.size());
+            }
+        });
+
+        result.timings.measure("commit", [&] {
+            if(_beforeCommit)
+            {
+                _beforeCommit();
+            }
+            transaction->commit();
+        });
+
+        return result;
+    }
+
+private:
+    void reportProgress(size_t done, size_t total) const
+    {
+        if(_progressFunc && (done % _progressInterval == 0 || done == total))
+        {
+            _progressFunc(done, total);
+        }
+    }
+
+private:
+    EngineT &_engine;
+    ProgressFunc _progressFunc;
+    size_t _progressInterval{};
+    CommitHook _beforeCommit;
+};
+}
@@ -0,0 +1,68 @@
+#include <apply/filter_batch.h>
+#include <apply/filter_key.h>
+#include <cwchar>
+
+namespace wfpk
+{
+namespace
+{
+wchar_t *copyString(Arena &arena, const wchar_t *pStr)
+{
+    const std::wstring_view str{pStr ? pStr : L""};
+    // Include the null terminator
+    return arena.copyArray(std::span{str.data(), str.size() + 1});
+}
+}
+
+FilterBatch::FilterBatch(const FWPM_DISPLAY_DATA &displayData, std::string rulesetName)
+    : _rulesetName{std::move(rulesetName)}
+{
+    _displayData.name = copyString(_arena, displayData.name);
+    _displayData.description = copyString(_arena, displayData.description);
+}
+
+void FilterBatch::add(FWPM_FILTER filter, std::span<const FWPM_FILTER_CONDITION> conditions)
+{
+    filter.displayData = _displayData;
+    filter.filterCondition = _arena.copyArray(conditions);
+    filter.numFilterConditions = static_cast<UINT32>(conditions.size());
+    filter.filterKey = filterKeyFor(_rulesetName, filter);
+
+    _filters.push_back(filter);
+}
+
+void FilterBatch::append(FilterBatch &&other)
+{
+    if(other._rulesetName != _rulesetName)
+    {
+        throw std::invalid_argument{std::format("Cannot append filters for ruleset {} to {}",
+                                                other._rulesetName, _rulesetName)};
+    }
+
+    // The other batch's filters keep pointing into its (now our) arena
+    _filters.insert(_filters.end(), other._filters.begin(), other._filters.end());
+    _arena.adopt(std::move(other._arena));
+    other._filters.clear();
+}
+
+auto FilterBatch::store(const FWP_V4_ADDR_AND_MASK &addrMask) -> FWP_V4_ADDR_AND_MASK *
+{
+    return _arena.copy(addrMask);
+}
+
+auto FilterBatch::store(const FWP_V6_ADDR_AND_MASK &addrMask) -> FWP_V6_ADDR_AND_MASK *
+{
+    return _arena.copy(addrMask);
+}
+
+auto FilterBatch::store(UINT64 value) -> UINT64 *
+{
+    return _arena.copy(value);
+}
+
+auto FilterBatch::store(const FWP_BYTE_BLOB &blob) -> FWP_BYTE_BLOB *
+{
+    return _arena.copy(
+        FWP_BYTE_BLOB{blob.size, _arena.copyArray(std::span<const UINT8>{blob.data, blob.size})});
+}
+}
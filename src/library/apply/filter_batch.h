@@ -0,0 +1,65 @@
+#pragma once
+
+#include <wfp_objects.h>
+#include <apply/arena.h>
+#include <span>
+
+namespace wfpk
+{
+// Owns a set of ready-to-apply FWPM_FILTERs along with all the storage their
+// pointers refer to (display data, condition arrays and condition payloads).
+// That storage lives in an Arena, so the filters remain valid for the lifetime of
+// the batch, including after it is moved.
+class FilterBatch
+{
+public:
+    // The display data is copied and shared by every filter in the batch.
+    // Filter keys are derived from the ruleset name and each filter's content.
+    FilterBatch(const FWPM_DISPLAY_DATA &displayData, std::string rulesetName);
+    FilterBatch(FilterBatch &&) = default;
+    FilterBatch &operator=(FilterBatch &&) = default;
+    FilterBatch(const FilterBatch &) = delete;
+    FilterBatch &operator=(const FilterBatch &) = delete;
+
+public:
+    // Add a filter - the conditions are copied into the batch, condition payloads
+    // must already be owned by the batch (see store()).
+    // The filter key is set to filterKeyFor(rulesetName, filter).
+    void add(FWPM_FILTER filter, std::span<const FWPM_FILTER_CONDITION> conditions);
+
+    // Move another batch's filters (and their storage) onto the end of this one.
+    // Both batches must be for the same ruleset.
+    void append(FilterBatch &&other);
+
+    // Store a condition payload, the returned pointer is valid for the lifetime of the batch
+    auto store(const FWP_V4_ADDR_AND_MASK &addrMask) -> FWP_V4_ADDR_AND_MASK *;
+    auto store(const FWP_V6_ADDR_AND_MASK &addrMask) -> FWP_V6_ADDR_AND_MASK *;
+    // The blob's data is copied too
+    auto store(const FWP_BYTE_BLOB &blob) -> FWP_BYTE_BLOB *;
+    // e.g a 64-bit weight
+    auto store(UINT64 value) -> UINT64 *;
+
+    auto filters() const -> std::span<const FWPM_FILTER>
+    {
+        return _filters;
+    }
+    size_t size() const
+    {
+        return _filters.size();
+    }
+    const std::string &rulesetName() const
+    {
+        return _rulesetName;
+    }
+    const Arena &arena() const
+    {
+        return _arena;
+    }
+
+private:
+    std::string _rulesetName;
+    Arena _arena;
+    FWPM_DISPLAY_DATA _displayData{};
+    std::vector<FWPM_FILTER> _filters;
+};
+}
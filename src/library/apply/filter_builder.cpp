@@ -0,0 +1,76 @@
+#include <apply/filter_builder.h>
+
+namespace wfpk
+{
+size_t FilterBuilder::workerCount(size_t ruleCount) const
+{
+    return std::clamp<size_t>(ruleCount / kMinRulesPerWorker, 1, _maxWorkers);
+}
+
+auto FilterBuilder::build(const RulesetNode &ruleset) const -> FilterBatch
+{
+    const auto &rules = ruleset.children();
+    const size_t workers = workerCount(rules.size());
+
+    std::vector<FilterBatch> parts;
+    parts.reserve(workers);
+    for(size_t i = 0; i < workers; ++i)
+    {
+        parts.emplace_back(_displayData, _rulesetName);
+    }
+
+    std::vector<std::exception_ptr> errors(workers);
+
+    // Lower rules [first, last) into parts[worker]
+    auto lowerRules = [&](size_t worker, size_t first, size_t last) {
+        try
+        {
+            WfpExecutor executor{parts[worker], _appIdResolver, _weights, first,
+                                 _interfaceResolver};
+            for(size_t i = first; i < last; ++i)
+            {
+                rules[i]->accept(executor);
+            }
+        }
+        catch(...)
+        {
+            errors[worker] = std::current_exception();
+        }
+    };
+
+    const size_t rulesPerWorker = (rules.size() + workers - 1) / workers;
+    auto rangeFor = [&](size_t worker) {
+        const size_t first = (std::min)(worker * rulesPerWorker, rules.size());
+        return std::pair{first, (std::min)(first + rulesPerWorker, rules.size())};
+    };
+
+    {
+        // The calling thread takes the first run of rules itself
+        std::vector<std::jthread> threads;
+        for(size_t worker = 1; worker < workers; ++worker)
+        {
+            const auto [first, last] = rangeFor(worker);
+            threads.emplace_back(lowerRules, worker, first, last);
+        }
+
+        const auto [first, last] = rangeFor(0);
+        lowerRules(0, first, last);
+    }
+
+    for(const auto &error : errors)
+    {
+        if(error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+    FilterBatch batch{std::move(parts.front())};
+    for(size_t worker = 1; worker < workers; ++worker)
+    {
+        batch.append(std::move(parts[worker]));
+    }
+
+    return batch;
+}
+}
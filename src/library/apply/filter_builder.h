@@ -0,0 +1,50 @@
+#pragma once
+
+#include <apply/filter_batch.h>
+#include <visitors/wfp_executor.h>
+#include <thread>
+
+namespace wfpk
+{
+// Lowers a whole ruleset into a FilterBatch, splitting the rules across worker threads.
+// Each worker lowers a contiguous run of rules into its own batch (and arena), and the
+// results are appended in rule order - so the output is the same as a serial lowering.
+// Each worker numbers its rules from its first rule's index, so weights are too.
+//
+// The AppIdResolver and InterfaceResolver are called from the worker threads, so they
+// must be thread safe.
+class FilterBuilder
+{
+public:
+    // Runs of fewer rules than this aren't worth a thread of their own
+    static constexpr size_t kMinRulesPerWorker = 256;
+
+public:
+    FilterBuilder(const FWPM_DISPLAY_DATA &displayData, std::string rulesetName,
+                  AppIdResolver appIdResolver = {}, WeightAllocator weights = WeightAllocator{},
+                  size_t maxWorkers = std::thread::hardware_concurrency(),
+                  InterfaceResolver interfaceResolver = {})
+        : _displayData{displayData}
+        , _rulesetName{std::move(rulesetName)}
+        , _appIdResolver{std::move(appIdResolver)}
+        , _interfaceResolver{std::move(interfaceResolver)}
+        , _weights{weights}
+        , _maxWorkers{std::max<size_t>(maxWorkers, 1)}
+    {}
+
+public:
+    // Throws the first error raised by any worker
+    auto build(const RulesetNode &ruleset) const -> FilterBatch;
+
+    // How many workers build() will use for the given number of rules
+    size_t workerCount(size_t ruleCount) const;
+
+private:
+    FWPM_DISPLAY_DATA _displayData{};
+    std::string _rulesetName;
+    AppIdResolver _appIdResolver;
+    InterfaceResolver _interfaceResolver;
+    WeightAllocator _weights;
+    size_t _maxWorkers{};
+};
+}
@@ -0,0 +1,145 @@
+#include <apply/filter_diff.h>
+#include <unordered_set>
+
+namespace wfpk
+{
+auto diffFilters(const FilterMirror &installed, std::span<const FWPM_FILTER> desired)
+    -> FilterDiff
+{
+    FilterDiff diff;
+
+    const auto installedKeys = installed.keys();
+    std::unordered_map<GUID, FilterMirror::Row> installedRows;
+    installedRows.reserve(installed.size());
+    for(FilterMirror::Row row = 0; row < installed.size(); ++row)
+    {
+        installedRows.emplace(installedKeys[row], row);
+    }
+
+    // Match on key. Keys leave the weight out, so a filter found by key that has since
+    // been re-weighted is still replaced - the BFE can't change a filter's weight in place.
+    std::unordered_set<GUID> desiredKeys;
+    desiredKeys.reserve(desired.size());
+    std::unordered_set<FilterMirror::Row> matchedRows;
+    std::vector<const FWPM_FILTER *> unmatchedDesired;
+    for(const auto &filter : desired)
+    {
+        if(filter.filterKey != ZeroGuid)
+        {
+            // A repeat of a filter earlier in the same ruleset - one copy is enough
+            if(!desiredKeys.insert(filter.filterKey).second)
+            {
+                continue;
+            }
+            auto it = installedRows.find(filter.filterKey);
+            if(it != installedRows.end() &&
+               sameWeight(installed.filter(it->second).weight, filter.weight))
+            {
+                matchedRows.insert(it->second);
+                ++diff.unchangedCount;
+                continue;
+            }
+        }
+        unmatchedDesired.push_back(&filter);
+    }
+
+    // Match the remainder on content
+    std::unordered_map<std::string, std::vector<FilterId>> installedByContent;
+    for(FilterMirror::Row row = 0; row < installed.size(); ++row)
+    {
+        if(!matchedRows.contains(row))
+        {
+            installedByContent[canonicalFilterContent(installed.filter(row))].push_back(
+                installed.ids()[row]);
+        }
+    }
+
+    for(const auto *pFilter : unmatchedDesired)
+    {
+        auto it = installedByContent.find(canonicalFilterContent(*pFilter));
+        if(it != installedByContent.end() && !it->second.empty())
+        {
+            // Already installed - keep it
+            it->second.pop_back();
+            ++diff.unchangedCount;
+        }
+        else
+        {
+            diff.toAdd.push_back(pFilter);
+        }
+    }
+
+    // Whatever wasn't matched is no longer wanted
+    for(const auto &[content, filterIds] : installedByContent)
+    {
+        diff.toDelete.insert(diff.toDelete.end(), filterIds.begin(), filterIds.end());
+    }
+    // Keep deletes in a deterministic order
+    std::ranges::sort(diff.toDelete);
+
+    return diff;
+}
+
+auto retainInstalledWeights(const FilterMirror &installed, std::span<const FWPM_FILTER> desired,
+                            std::vector<UINT64> &weights) -> std::vector<FWPM_FILTER>
+{
+    std::vector<FWPM_FILTER> result{desired.begin(), desired.end()};
+    const bool allocated = std::ranges::all_of(desired, [](const FWPM_FILTER &filter) {
+        return filter.weight.type == FWP_UINT64 &&
+               *filter.weight.uint64 > WeightAllocator::kDefaultLowest &&
+               *filter.weight.uint64 < WeightAllocator::kDefaultHighest;
+    });
+    if(!allocated)
+    {
+        return result;
+    }
+
+    std::unordered_map<GUID, UINT64> installedWeights;
+    installedWeights.reserve(installed.size());
+    for(FilterMirror::Row row = 0; row < installed.size(); ++row)
+    {
+        if(installed.weightTypes()[row] == FWP_UINT64)
+        {
+            installedWeights.emplace(installed.keys()[row], installed.weights()[row]);
+        }
+    }
+
+    std::vector<UINT64> desiredWeights;
+    std::vector<std::optional<UINT64>> installedWeightOf;
+    desiredWeights.reserve(desired.size());
+    installedWeightOf.reserve(desired.size());
+    for(const auto &filter : desired)
+    {
+        desiredWeights.push_back(*filter.weight.uint64);
+        auto it = installedWeights.find(filter.filterKey);
+        installedWeightOf.push_back(filter.filterKey != ZeroGuid && it != installedWeights.end()
+                                        ? std::optional{it->second}
+                                        : std::nullopt);
+    }
+
+    auto retained = WeightAllocator::retain(desiredWeights, installedWeightOf);
+    if(!retained)
+    {
+        return result;
+    }
+
+    weights = std::move(*retained);
+    for(size_t i = 0; i < result.size(); ++i)
+    {
+        result[i].weight.uint64 = &weights[i];
+    }
+    return result;
+}
+
+auto diffFilters(const std::vector<std::shared_ptr<FWPM_FILTER>> &installed,
+                 std::span<const FWPM_FILTER> desired) -> FilterDiff
+{
+    FilterMirror mirror;
+    mirror.reserve(installed.size());
+    for(const auto &pFilter : installed)
+    {
+        mirror.add(*pFilter);
+    }
+    return diffFilters(mirror, desired);
+}
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <apply/filter_applier.h>
+#include <apply/canonical_filter.h>
+#include <apply/weight_allocator.h>
+#include <engine/filter_mirror.h>
+
+namespace wfpk
+{
+// The changes needed to go from the installed filters to the desired ones
+struct FilterDiff
+{
+    // Desired filters that are not installed
+    std::vector<const FWPM_FILTER *> toAdd;
+    // Installed filters that are no longer desired
+    std::vector<FilterId> toDelete;
+    // Desired filters that are already installed
+    size_t unchangedCount{0};
+
+    bool empty() const
+    {
+        return toAdd.empty() && toDelete.empty();
+    }
+};
+
+// Filters are matched by key first - our keys are derived from content, so this
+// is a set of O(1) lookups - and then on weight, which the key leaves out. Whatever
+// is left (e.g filters installed before keys were derived) is matched on canonical
+// content (see canonicalFilterContent()), one-for-one, so surplus installed copies
+// are deleted.
+auto diffFilters(const FilterMirror &installed, std::span<const FWPM_FILTER> desired)
+    -> FilterDiff;
+auto diffFilters(const std::vector<std::shared_ptr<FWPM_FILTER>> &installed,
+                 std::span<const FWPM_FILTER> desired) -> FilterDiff;
+
+// The desired filters, re-weighted to keep the weights they're installed with wherever
+// those still rank them correctly (see WeightAllocator::retain()) - so a diff after
+// inserting a rule adds its filters rather than re-adding every filter ranked below it.
+// The weights are stored in `weights`, which the returned shallow copies point into.
+// The filters are copied as they are if any isn't weighted by a WeightAllocator, or
+// there's no room left to retain weights.
+auto retainInstalledWeights(const FilterMirror &installed, std::span<const FWPM_FILTER> desired,
+                            std::vector<UINT64> &weights) -> std::vector<FWPM_FILTER>;
+
+// Enumerate every PIA filter installed on the given layers
+template <FilterEnumerableEngine EngineT>
+auto installedPiaFilters(EngineT &engine, const std::vector<GUID> &layerKeys)
+    -> std::vector<std::shared_ptr<FWPM_FILTER>>
+{
+    std::vector<std::shared_ptr<FWPM_FILTER>> filters;
+    for(const auto &layerKey : layerKeys)
+    {
+        engine.enumerateFiltersForLayer(layerKey, [&](const auto &pFilter) {
+            if(isPiaFilter(*pFilter))
+            {
+                filters.push_back(pFilter);
+            }
+        });
+    }
+
+    return filters;
+}
+
+// As installedPiaFilters(), but decoded into a mirror as they're enumerated - so each
+// layer's pages are released as soon as it's been read
+template <FilterEnumerableEngine EngineT>
+auto installedPiaMirror(EngineT &engine, const std::vector<GUID> &layerKeys) -> FilterMirror
+{
+    FilterMirror mirror;
+    for(const auto &layerKey : layerKeys)
+    {
+        engine.enumerateFiltersForLayer(
+            layerKey,
+            [&](const auto &pFilter) {
+                if(isPiaFilter(*pFilter))
+                {
+                    mirror.add(*pFilter);
+                }
+            },
+            {.providerKey = PIA_PROVIDER_KEY});
+    }
+
+    return mirror;
+}
+
+struct DiffApplyResult
+{
+    size_t addedCount{0};
+    size_t deletedCount{0};
+    size_t unchangedCount{0};
+    // Ids and keys of the added filters
+    std::vector<FilterId> filterIds;
+    std::vector<GUID> filterKeys;
+    // enumerate, weights, diff, and the begin/delete/add/commit apply phases
+    PhaseTimings timings;
+};
+
+// Brings the installed PIA filters in line with a desired set, touching only
+// the filters that differ - all within a single transaction.
+// Unlike deleting everything and re-adding, unchanged filters stay in place so
+// there's no window without a policy.
+template <typename EngineT>
+    requires FilterEngine<EngineT> && FilterEnumerableEngine<EngineT>
+class DiffApplier
+{
+public:
+    // layerKeys are the layers searched for installed PIA filters
+    DiffApplier(EngineT &engine, std::vector<GUID> layerKeys)
+        : _engine{engine}
+        , _layerKeys{std::move(layerKeys)}
+    {}
+
+public:
+    // The hook runs even when no filters differ, in a transaction of its own
+    void beforeCommit(CommitHook hook)
+    {
+        _beforeCommit = std::move(hook);
+    }
+
+    // Throws a WfpError on failure, the transaction is rolled back before the error propagates
+    auto apply(std::span<const FWPM_FILTER> desired) -> DiffApplyResult
+    {
+        DiffApplyResult result;
+
+        const auto installed = result.timings.measure(
+            "enumerate", [&] { return installedPiaMirror(_engine, _layerKeys); });
+        std::vector<UINT64> weights;
+        const auto weighted = result.timings.measure(
+            "weights", [&] { return retainInstalledWeights(installed, desired, weights); });
+        const auto diff =
+            result.timings.measure("diff", [&] { return diffFilters(installed, weighted); });
+
+        result.unchangedCount = diff.unchangedCount;
+        if(diff.empty() && !_beforeCommit)
+        {
+            return result;
+        }
+
+        std::optional<Transaction<EngineT>> transaction;
+        result.timings.measure("begin", [&] { transaction.emplace(_engine); });
+
+        result.timings.measure("delete", [&] {
+            for(const auto &filterId : diff.toDelete)
+            {
+                DWORD status = _engine.deleteFilterById(filterId);
+                if(status != ERROR_SUCCESS)
+                {
+                    transaction.reset();
+                    throw WfpError{
+                        std::format("Failed to delete filter {}, rolled back:", filterId), status};
+                }
+                ++result.deletedCount;
+            }
+        });
+
+        result.timings.measure("add", [&] {
+            for(const auto *pFilter : diff.toAdd)
+            {
+                FilterId id{};
+                DWORD status = _engine.tryAdd(*pFilter, id);
+                if(status != ERROR_SUCCESS)
+                {
+                    transaction.reset();
+                    throw WfpError{std::format("Failed to add filter {} of {}, rolled back:",
+                                               result.addedCount + 1, diff.toAdd.size()),
+                                   status};
+                }
+                ++result.addedCount;
+                result.filterIds.push_back(id);
+                result.filterKeys.push_back(pFilter->filterKey);
+            }
+        });
+
+        result.timings.measure("commit", [&] {
+            if(_beforeCommit)
+            {
+                _beforeCommit();
+            }
+            transaction->commit();
+        });
+
+        return result;
+    }
+
+private:
+    EngineT &_engine;
+    std::vector<GUID> _layerKeys;
+    CommitHook _beforeCommit;
+};
+}
@@ -0,0 +1,394 @@
+#include <apply/filter_journal.h>
+#include <fstream>
+#include <cstring>
+
+namespace wfpk
+{
+namespace
+{
+constexpr std::string_view kMagic{"WFPKJRNL"};
+constexpr uint32_t kVersion = 1;
+constexpr size_t kHeaderSize = kMagic.size() + sizeof(kVersion);
+// Size and CRC-32 of each record
+constexpr size_t kRecordHeaderSize = 2 * sizeof(uint32_t);
+// Journals smaller than this aren't worth compacting
+constexpr uintmax_t kCompactThreshold = 64 * 1024;
+
+enum class RecordKind : uint8_t
+{
+    Load = 1,
+    Retire = 2
+};
+
+// CRC-32 (IEEE 802.3, as used by zip) - catches a torn or corrupted record
+constexpr auto kCrcTable = [] {
+    std::array<uint32_t, 256> table{};
+    for(uint32_t i = 0; i < table.size(); ++i)
+    {
+        uint32_t crc = i;
+        for(int bit = 0; bit < 8; ++bit)
+        {
+            crc = crc & 1 ? 0xEDB88320 ^ (crc >> 1) : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}();
+
+uint32_t crc32(std::string_view data)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    for(const auto ch : data)
+    {
+        crc = kCrcTable[(crc ^ static_cast<uint8_t>(ch)) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// Fields are written in host byte order - the journal never leaves the machine
+template <typename T> void put(std::string &out, const T &value)
+{
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+// Reads fields back out of a payload, failing on a short read
+class Reader
+{
+public:
+    explicit Reader(std::string_view data)
+        : _data{data}
+    {}
+
+public:
+    template <typename T> bool get(T &value)
+    {
+        if(_data.size() < sizeof(value))
+        {
+            return false;
+        }
+        std::memcpy(&value, _data.data(), sizeof(value));
+        _data.remove_prefix(sizeof(value));
+        return true;
+    }
+
+    bool get(std::string &value, size_t size)
+    {
+        if(_data.size() < size)
+        {
+            return false;
+        }
+        value.assign(_data.substr(0, size));
+        _data.remove_prefix(size);
+        return true;
+    }
+
+    bool done() const
+    {
+        return _data.empty();
+    }
+
+private:
+    std::string_view _data;
+};
+
+std::string loadPayload(const JournalLoad &load)
+{
+    std::string payload;
+    payload.reserve(32 + load.rulesetName.size() +
+                    load.filters.size() * (sizeof(FilterId) + sizeof(GUID)));
+
+    put(payload, RecordKind::Load);
+    put(payload, load.sequence);
+    put(payload, static_cast<int64_t>(std::chrono::duration_cast<std::chrono::seconds>(
+                                          load.time.time_since_epoch())
+                                          .count()));
+    put(payload, static_cast<uint32_t>(load.rulesetName.size()));
+    payload += load.rulesetName;
+    put(payload, static_cast<uint32_t>(load.filters.size()));
+    for(const auto &entry : load.filters)
+    {
+        put(payload, entry.filterId);
+        put(payload, entry.filterKey);
+    }
+
+    return payload;
+}
+
+bool parseLoad(Reader &reader, JournalLoad &load)
+{
+    int64_t seconds{};
+    uint32_t nameSize{};
+    uint32_t filterCount{};
+    if(!reader.get(load.sequence) || !reader.get(seconds) || !reader.get(nameSize) ||
+       !reader.get(load.rulesetName, nameSize) || !reader.get(filterCount))
+    {
+        return false;
+    }
+    load.time = std::chrono::system_clock::time_point{std::chrono::seconds{seconds}};
+
+    load.filters.resize(filterCount);
+    for(auto &entry : load.filters)
+    {
+        if(!reader.get(entry.filterId) || !reader.get(entry.filterKey))
+        {
+            return false;
+        }
+    }
+
+    return reader.done();
+}
+
+std::string record(std::string_view payload)
+{
+    std::string result;
+    result.reserve(kRecordHeaderSize + payload.size());
+    put(result, static_cast<uint32_t>(payload.size()));
+    put(result, crc32(payload));
+    result += payload;
+    return result;
+}
+
+std::string header()
+{
+    std::string result{kMagic};
+    put(result, kVersion);
+    return result;
+}
+}
+
+auto defaultJournalPath() -> std::filesystem::path
+{
+    return wfpkDataDirectory() / "filters.journal";
+}
+
+auto FilterJournal::recordLoad(std::string_view rulesetName, std::span<const FilterId> filterIds,
+                               std::span<const GUID> filterKeys) -> uint64_t
+{
+    assert(filterIds.size() == filterKeys.size());
+
+    const auto contents = read();
+
+    JournalLoad load;
+    load.sequence = contents.lastSequence + 1;
+    load.rulesetName = rulesetName;
+    load.time = std::chrono::system_clock::now();
+    load.filters.reserve(filterIds.size());
+    for(size_t i = 0; i < filterIds.size(); ++i)
+    {
+        load.filters.push_back({filterIds[i], filterKeys[i]});
+    }
+
+    append(contents, loadPayload(load));
+    return load.sequence;
+}
+
+void FilterJournal::retire(std::span<const uint64_t> sequences)
+{
+    if(sequences.empty())
+    {
+        return;
+    }
+
+    auto contents = read();
+
+    std::string payload;
+    put(payload, RecordKind::Retire);
+    put(payload, static_cast<uint32_t>(sequences.size()));
+    for(const auto sequence : sequences)
+    {
+        put(payload, sequence);
+    }
+    append(contents, payload);
+
+    std::erase_if(contents.liveLoads, [&](const auto &load) {
+        return std::ranges::find(sequences, load.sequence) != sequences.end();
+    });
+    contents.intactSize += kRecordHeaderSize + payload.size();
+    contents.liveSize = 0;
+    for(const auto &load : contents.liveLoads)
+    {
+        contents.liveSize += kRecordHeaderSize + loadPayload(load).size();
+    }
+
+    if(contents.intactSize > kCompactThreshold &&
+       contents.intactSize - kHeaderSize > 2 * contents.liveSize)
+    {
+        compact(contents);
+    }
+}
+
+auto FilterJournal::liveLoads() const -> std::vector<JournalLoad>
+{
+    return read().liveLoads;
+}
+
+auto FilterJournal::lastLoad() const -> std::optional<JournalLoad>
+{
+    auto loads = liveLoads();
+    if(loads.empty())
+    {
+        return {};
+    }
+    return std::move(loads.back());
+}
+
+auto FilterJournal::loadsOf(std::string_view rulesetName) const -> std::vector<JournalLoad>
+{
+    auto loads = liveLoads();
+    std::erase_if(loads, [&](const auto &load) { return load.rulesetName != rulesetName; });
+    return loads;
+}
+
+auto FilterJournal::read() const -> Contents
+{
+    Contents contents;
+
+    std::ifstream file{_path, std::ios::binary};
+    if(!file.is_open())
+    {
+        // Nothing recorded yet
+        return contents;
+    }
+
+    const std::string data{std::istreambuf_iterator<char>{file}, {}};
+    if(data.size() < kHeaderSize)
+    {
+        // Empty, or the header was torn as the journal was created
+        return contents;
+    }
+
+    Reader headerReader{data};
+    std::string magic;
+    uint32_t version{};
+    if(!headerReader.get(magic, kMagic.size()) || magic != kMagic ||
+       !headerReader.get(version) || version != kVersion)
+    {
+        throw std::runtime_error{
+            std::format("{} is not a wfpk journal (or is from another version)", _path.string())};
+    }
+
+    // Record sizes by load, to track how much of the journal is live
+    std::unordered_map<uint64_t, size_t> loadSizes;
+    size_t offset = kHeaderSize;
+    while(offset < data.size())
+    {
+        Reader recordReader{std::string_view{data}.substr(offset)};
+        uint32_t payloadSize{};
+        uint32_t crc{};
+        if(!recordReader.get(payloadSize) || !recordReader.get(crc) ||
+           data.size() - offset - kRecordHeaderSize < payloadSize)
+        {
+            break;
+        }
+
+        const auto payload =
+            std::string_view{data}.substr(offset + kRecordHeaderSize, payloadSize);
+        if(crc32(payload) != crc)
+        {
+            break;
+        }
+
+        Reader reader{payload};
+        RecordKind kind{};
+        if(!reader.get(kind))
+        {
+            break;
+        }
+
+        if(kind == RecordKind::Load)
+        {
+            JournalLoad load;
+            if(!parseLoad(reader, load))
+            {
+                break;
+            }
+            contents.lastSequence = (std::max)(contents.lastSequence, load.sequence);
+            loadSizes[load.sequence] = kRecordHeaderSize + payloadSize;
+            contents.liveLoads.push_back(std::move(load));
+        }
+        else if(kind == RecordKind::Retire)
+        {
+            uint32_t count{};
+            if(!reader.get(count))
+            {
+                break;
+            }
+            std::vector<uint64_t> retired(count);
+            if(!std::ranges::all_of(retired, [&](auto &sequence) { return reader.get(sequence); }))
+            {
+                break;
+            }
+            std::erase_if(contents.liveLoads, [&](const auto &load) {
+                return std::ranges::find(retired, load.sequence) != retired.end();
+            });
+        }
+        else
+        {
+            break;
+        }
+
+        offset += kRecordHeaderSize + payloadSize;
+    }
+
+    contents.intactSize = offset;
+    for(const auto &load : contents.liveLoads)
+    {
+        contents.liveSize += loadSizes[load.sequence];
+    }
+
+    return contents;
+}
+
+void FilterJournal::append(const Contents &contents, const std::string &payload)
+{
+    std::error_code error;
+    std::ofstream file;
+    if(contents.intactSize == 0)
+    {
+        std::filesystem::create_directories(_path.parent_path(), error);
+        file.open(_path, std::ios::binary | std::ios::trunc);
+        file << header();
+    }
+    else
+    {
+        if(std::filesystem::file_size(_path, error) > contents.intactSize)
+        {
+            // Drop a record torn by an earlier crash, so this one isn't appended after it
+            std::filesystem::resize_file(_path, contents.intactSize, error);
+        }
+        file.open(_path, std::ios::binary | std::ios::app);
+    }
+
+    file << record(payload);
+    file.flush();
+
+    if(error || !file)
+    {
+        throw std::runtime_error{std::format("Failed to write to journal {}", _path.string())};
+    }
+}
+
+void FilterJournal::compact(const Contents &contents)
+{
+    auto compactPath = _path;
+    compactPath += ".compact";
+
+    {
+        std::ofstream file{compactPath, std::ios::binary | std::ios::trunc};
+        file << header();
+        for(const auto &load : contents.liveLoads)
+        {
+            file << record(loadPayload(load));
+        }
+        file.flush();
+
+        if(!file)
+        {
+            throw std::runtime_error{
+                std::format("Failed to write journal {}", compactPath.string())};
+        }
+    }
+
+    std::filesystem::rename(compactPath, _path);
+}
+}
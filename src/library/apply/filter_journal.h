@@ -0,0 +1,162 @@
+#pragma once
+
+#include <apply/filter_applier.h>
+#include <unordered_set>
+
+namespace wfpk
+{
+// A filter added by a load
+struct JournalEntry
+{
+    FilterId filterId{};
+    // ZeroGuid where the BFE generated the key
+    GUID filterKey{};
+};
+
+// The filters added by one load
+struct JournalLoad
+{
+    // Numbers loads in the order they were recorded
+    uint64_t sequence{0};
+    std::string rulesetName;
+    std::chrono::system_clock::time_point time;
+    std::vector<JournalEntry> filters;
+};
+
+// Where wfpk keeps its journal: %ProgramData%\wfpk\filters.journal
+auto defaultJournalPath() -> std::filesystem::path;
+
+// A local record of the filters each load added, so they can be deleted again
+// exactly, without enumerating every layer to find them.
+//
+// The file is append-only: a header, then records of a size, a CRC-32 and a payload.
+// A payload either records a load, or retires earlier loads once they're deleted.
+// A record torn by a crash fails its checksum, so it (and anything after it) is
+// ignored, and overwritten by the next append.
+//
+// The journal isn't kept in step with the BFE - a load's filters may since have been
+// deleted, by a diff, a swap or anything else. That's reconciled lazily: when a load
+// is deleted, its filters that are already gone are counted rather than treated as
+// errors (see deleteJournaledFilters()).
+class FilterJournal
+{
+public:
+    explicit FilterJournal(std::filesystem::path path)
+        : _path{std::move(path)}
+    {}
+
+public:
+    // Record the filters a load added (filterKeys in step with filterIds), returning
+    // the load's sequence number. These throw a std::runtime_error if the journal
+    // can't be read or written.
+    auto recordLoad(std::string_view rulesetName, std::span<const FilterId> filterIds,
+                    std::span<const GUID> filterKeys) -> uint64_t;
+    // Record loads as deleted. Once retired loads make up most of the journal it's
+    // rewritten without them.
+    void retire(std::span<const uint64_t> sequences);
+
+    // Loads not yet retired, oldest first
+    auto liveLoads() const -> std::vector<JournalLoad>;
+    auto lastLoad() const -> std::optional<JournalLoad>;
+    auto loadsOf(std::string_view rulesetName) const -> std::vector<JournalLoad>;
+
+    const std::filesystem::path &path() const
+    {
+        return _path;
+    }
+
+private:
+    struct Contents
+    {
+        std::vector<JournalLoad> liveLoads;
+        uint64_t lastSequence{0};
+        // Size of the file up to the end of the last intact record
+        uintmax_t intactSize{0};
+        // Bytes taken by live loads' records
+        uintmax_t liveSize{0};
+    };
+
+    auto read() const -> Contents;
+    void append(const Contents &contents, const std::string &payload);
+    // Rewrite the journal with only the live loads - written aside then renamed over
+    // the journal, so a crash leaves one or the other intact
+    void compact(const Contents &contents);
+
+private:
+    std::filesystem::path _path;
+};
+
+struct JournalDeleteResult
+{
+    size_t deletedCount{0};
+    // Journaled filters that were no longer installed
+    size_t missingCount{0};
+    // begin/delete/commit phases
+    PhaseTimings timings;
+};
+
+// Deletes the filters recorded for the given loads in a single transaction - either
+// all of them that are still installed are deleted or, on any failure, none are.
+// Filters are deleted by key, which unlike their id survives a reboot; a filter that's
+// already gone is counted in missingCount. The caller retires the loads once this
+// returns - if that fails, deleting them again only finds their filters missing.
+template <KeyedFilterEngine EngineT>
+auto deleteJournaledFilters(EngineT &engine, std::span<const JournalLoad> loads,
+                            CommitHook beforeCommit = {}) -> JournalDeleteResult
+{
+    JournalDeleteResult result;
+
+    std::optional<Transaction<EngineT>> transaction;
+    result.timings.measure("begin", [&] { transaction.emplace(engine); });
+
+    result.timings.measure("delete", [&] {
+        // A key can be journaled by more than one load (e.g a reload after a delete)
+        std::unordered_set<GUID> deletedKeys;
+        for(const auto &load : loads)
+        {
+            for(const auto &entry : load.filters)
+            {
+                DWORD status{};
+                if(entry.filterKey != ZeroGuid)
+                {
+                    if(!deletedKeys.insert(entry.filterKey).second)
+                    {
+                        continue;
+                    }
+                    status = engine.deleteFilterByKey(entry.filterKey);
+                }
+                else
+                {
+                    status = engine.deleteFilterById(entry.filterId);
+                }
+
+                if(status == FWP_E_FILTER_NOT_FOUND)
+                {
+                    ++result.missingCount;
+                }
+                else if(status != ERROR_SUCCESS)
+                {
+                    transaction.reset();
+                    throw WfpError{std::format("Failed to delete filter {}, rolled back:",
+                                               entry.filterId),
+                                   status};
+                }
+                else
+                {
+                    ++result.deletedCount;
+                }
+            }
+        }
+    });
+
+    result.timings.measure("commit", [&] {
+        if(beforeCommit)
+        {
+            beforeCommit();
+        }
+        transaction->commit();
+    });
+
+    return result;
+}
+}
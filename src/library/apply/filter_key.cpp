@@ -0,0 +1,16 @@
+#include <apply/filter_key.h>
+#include <apply/canonical_filter.h>
+#include <sha1.h>
+
+namespace wfpk
+{
+GUID filterKeyFor(std::string_view rulesetName, const FWPM_FILTER &filter)
+{
+    std::string name{rulesetName};
+    // Separate the ruleset name from the content so the boundary is unambiguous
+    name.push_back('\0');
+    name += canonicalFilterIdentity(filter);
+
+    return nameBasedGuid(WFPK_FILTER_KEY_NAMESPACE, name);
+}
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <wfp_objects.h>
+#include <string_view>
+
+namespace wfpk
+{
+// Namespace for our content-derived filter keys
+inline constexpr GUID WFPK_FILTER_KEY_NAMESPACE = {
+    0x96dc8c25, 0xd957, 0x4a4d, {0xbf, 0xdc, 0x9f, 0x4f, 0xc9, 0x4f, 0xfe, 0xb2}};
+
+// A stable filter key derived from the ruleset name and the filter's canonical
+// identity (see canonicalFilterIdentity()). Applying the same rule from the same
+// ruleset always produces the same key, so installed filters can be found by key
+// and duplicate adds are rejected by the BFE.
+// The weight isn't part of the key: inserting a rule re-weights the rules below it
+// without re-keying them, and a filter repeated further down a ruleset - which the
+// first copy always pre-empts - gets the same key and is added once.
+GUID filterKeyFor(std::string_view rulesetName, const FWPM_FILTER &filter);
+}
@@ -0,0 +1,215 @@
+#include <winsock2.h>
+#include <apply/filter_plan.h>
+#include <apply/filter_builder.h>
+#include <apply/app_id_cache.h>
+#include <parser/parser.h>
+#include <wfp_name_mapper.h>
+#include <array>
+#include <unordered_set>
+#include <bit>
+
+namespace wfpk
+{
+namespace
+{
+// Quote and escape a string for JSON
+std::string jsonString(std::string_view str)
+{
+    std::string result{"\""};
+    for(const char ch : str)
+    {
+        switch(ch)
+        {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\r': result += "\\r"; break;
+            case '\t': result += "\\t"; break;
+            default:
+                if(static_cast<unsigned char>(ch) < 0x20)
+                {
+                    result += std::format("\\u{:04x}", static_cast<int>(ch));
+                }
+                else
+                {
+                    result += ch;
+                }
+        }
+    }
+
+    return result + "\"";
+}
+
+// The distinct apps the ruleset's rules refer to, in order of first use
+auto distinctAppPaths(const RulesetNode &ruleset) -> std::vector<std::string>
+{
+    std::vector<std::string> appPaths;
+    std::unordered_set<std::string> seen;
+    for(const auto &pChild : ruleset.children())
+    {
+        const auto *pFilterNode = dynamic_cast<const FilterNode *>(pChild.get());
+        if(pFilterNode && !pFilterNode->filterConditions().sourceApp.empty() &&
+           seen.insert(pFilterNode->filterConditions().sourceApp).second)
+        {
+            appPaths.push_back(pFilterNode->filterConditions().sourceApp);
+        }
+    }
+
+    return appPaths;
+}
+
+std::string weightJson(const FWP_VALUE &weight)
+{
+    switch(weight.type)
+    {
+        // Weight managed by the BFE
+        case FWP_EMPTY: return "null";
+        case FWP_UINT8: return std::to_string(weight.uint8);
+        case FWP_UINT64: return std::to_string(*weight.uint64);
+        default:
+            return jsonString(std::format("unknown (type: {})", static_cast<INT32>(weight.type)));
+    }
+}
+
+std::string flagsJson(UINT32 flags)
+{
+#define FLAG_NAME(flag) std::pair<UINT32, std::string_view>{flag, #flag}
+    constexpr std::array kFlagNames{
+        FLAG_NAME(FWPM_FILTER_FLAG_PERSISTENT),
+        FLAG_NAME(FWPM_FILTER_FLAG_BOOTTIME),
+        FLAG_NAME(FWPM_FILTER_FLAG_HAS_PROVIDER_CONTEXT),
+        FLAG_NAME(FWPM_FILTER_FLAG_CLEAR_ACTION_RIGHT),
+        FLAG_NAME(FWPM_FILTER_FLAG_PERMIT_IF_CALLOUT_UNREGISTERED),
+        FLAG_NAME(FWPM_FILTER_FLAG_DISABLED),
+        FLAG_NAME(FWPM_FILTER_FLAG_INDEXED)};
+#undef FLAG_NAME
+
+    std::string result;
+    for(const auto &[flag, name] : kFlagNames)
+    {
+        if(flags & flag)
+        {
+            result += (result.empty() ? "" : ",") + jsonString(name);
+            flags &= ~flag;
+        }
+    }
+
+    // Any we don't have a name for
+    if(flags)
+    {
+        result += (result.empty() ? "" : ",") + std::to_string(flags);
+    }
+
+    return "[" + result + "]";
+}
+
+std::string conditionValueJson(const FWPM_FILTER_CONDITION &condition)
+{
+    const FWP_CONDITION_VALUE &value = condition.conditionValue;
+
+    switch(value.type)
+    {
+        case FWP_EMPTY: return "null";
+        case FWP_UINT8: return std::to_string(value.uint8);
+        case FWP_UINT16: return std::to_string(value.uint16);
+        case FWP_UINT32: return std::to_string(value.uint32);
+        case FWP_UINT64: return std::to_string(*value.uint64);
+        case FWP_V4_ADDR_MASK:
+            // Stored in host order, as a mask rather than a prefix length
+            return jsonString(std::format("{}/{}", ipToString(ntohl(value.v4AddrMask->addr)),
+                                          std::popcount(value.v4AddrMask->mask)));
+        case FWP_V6_ADDR_MASK:
+            return jsonString(std::format("{}/{}", ipToString(value.v6AddrMask->addr),
+                                          static_cast<UINT32>(value.v6AddrMask->prefixLength)));
+        case FWP_BYTE_BLOB_TYPE:
+            if(condition.fieldKey == FWPM_CONDITION_ALE_APP_ID)
+            {
+                // App ids are null terminated wide strings
+                return jsonString(blobToString(*value.byteBlob));
+            }
+            else
+            {
+                std::string hex;
+                for(const UINT8 byte : std::span{value.byteBlob->data, value.byteBlob->size})
+                {
+                    hex += std::format("{:02x}", byte);
+                }
+                return jsonString(hex);
+            }
+        default:
+            return jsonString(std::format("unknown (type: {})", static_cast<INT32>(value.type)));
+    }
+}
+}
+
+auto planRuleset(const std::string &source, const FWPM_DISPLAY_DATA &displayData,
+                 std::string rulesetName, AppIdResolver appIdResolver,
+                 WeightPolicy weightPolicy, InterfaceResolver interfaceResolver) -> RulesetPlan
+{
+    PhaseTimings timings;
+    PhaseAllocations allocations;
+    auto measure = [&](const std::string &phase, auto func) {
+        return timings.measure(phase, [&] { return allocations.measure(phase, func); });
+    };
+
+    auto ast = measure("parse", [&] { return Parser{source}.parse(); });
+    if(!ast)
+    {
+        throw std::runtime_error{std::format("Could not parse rules for: {}", rulesetName)};
+    }
+
+    // Each app is resolved once, concurrently, ahead of lowering - resolving an app
+    // can cost far more than lowering its rules
+    if(const auto appPaths = distinctAppPaths(*ast); appIdResolver && !appPaths.empty())
+    {
+        auto appIds = std::make_shared<const std::unordered_map<std::string, std::vector<UINT8>>>(
+            measure("resolve", [&] { return resolveAppIds(appPaths, appIdResolver); }));
+        appIdResolver = [appIds](const std::string &appPath) {
+            const auto it = appIds->find(appPath);
+            return it != appIds->end() ? it->second : std::vector<UINT8>{};
+        };
+    }
+
+    auto batch = measure("lower", [&] {
+        return FilterBuilder{displayData,
+                             std::move(rulesetName),
+                             std::move(appIdResolver),
+                             WeightAllocator{weightPolicy},
+                             std::thread::hardware_concurrency(),
+                             std::move(interfaceResolver)}
+            .build(*ast);
+    });
+
+    return {std::move(batch), std::move(timings), std::move(allocations)};
+}
+
+std::string filterPlanEntry(const FWPM_FILTER &filter)
+{
+    std::string conditions;
+    for(const auto &condition : std::span{filter.filterCondition, filter.numFilterConditions})
+    {
+        conditions += std::format(
+            "{}{{\"field\":{},\"match\":{},\"value\":{}}}", conditions.empty() ? "" : ",",
+            jsonString(WfpNameMapper::getName(condition.fieldKey).rawName),
+            jsonString(WfpNameMapper::getName(condition.matchType).rawName),
+            conditionValueJson(condition));
+    }
+
+    return std::format(
+        "{{\"key\":{},\"layer\":{},\"sublayer\":{},\"action\":{},\"weight\":{},\"flags\":{},"
+        "\"conditions\":[{}]}}",
+        jsonString(guidToString(filter.filterKey)),
+        jsonString(WfpNameMapper::getName(filter.layerKey).rawName),
+        jsonString(guidToString(filter.subLayerKey)),
+        jsonString(WfpNameMapper::getName<WFPK_ACTION_TYPE>(filter.action.type).rawName),
+        weightJson(filter.weight), flagsJson(filter.flags), conditions);
+}
+
+void writeFilterPlan(std::ostream &out, std::span<const FWPM_FILTER> filters)
+{
+    for(const auto &filter : filters)
+    {
+        out << filterPlanEntry(filter) << '\n';
+    }
+}
+}
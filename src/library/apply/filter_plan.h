@@ -0,0 +1,33 @@
+#pragma once
+
+#include <apply/filter_batch.h>
+#include <visitors/wfp_executor.h>
+#include <allocation_stats.h>
+#include <ostream>
+
+namespace wfpk
+{
+// The filters a ruleset lowers to, along with what it cost to produce them
+struct RulesetPlan
+{
+    FilterBatch batch;
+    PhaseTimings timings;
+    PhaseAllocations allocations;
+};
+
+// Run the front end (parse and lower) over a ruleset's source.
+// This never touches the BFE - it's shared by `load` and `load --plan`.
+auto planRuleset(const std::string &source, const FWPM_DISPLAY_DATA &displayData,
+                 std::string rulesetName, AppIdResolver appIdResolver = {},
+                 WeightPolicy weightPolicy = WeightPolicy::RuleOrder,
+                 InterfaceResolver interfaceResolver = {}) -> RulesetPlan;
+
+// Describe a filter as a single line of JSON: its key, layer, sublayer, action,
+// weight, flags and decoded conditions. e.g:
+// {"key":"{...}","layer":"FWPM_LAYER_ALE_AUTH_CONNECT_V4",...,"conditions":[
+//   {"field":"FWPM_CONDITION_IP_REMOTE_ADDRESS","match":"FWP_MATCH_EQUAL","value":"10.0.0.0/8"}]}
+std::string filterPlanEntry(const FWPM_FILTER &filter);
+
+// Write filters as newline delimited JSON (NDJSON), one filter per line
+void writeFilterPlan(std::ostream &out, std::span<const FWPM_FILTER> filters);
+}
@@ -0,0 +1,68 @@
+#include <winsock2.h>
+#include <iphlpapi.h>
+#include <netioapi.h>
+#include <apply/interface_table.h>
+#include <charconv>
+
+namespace wfpk
+{
+auto systemInterfaces() -> std::vector<NetworkInterface>
+{
+    MIB_IF_TABLE2 *pTable{nullptr};
+    DWORD result = GetIfTable2(&pTable);
+    if(result != ERROR_SUCCESS)
+    {
+        throw WfpError{"GetIfTable2 failed:", result};
+    }
+    std::unique_ptr<MIB_IF_TABLE2, decltype(&FreeMibTable)> table{pTable, &FreeMibTable};
+
+    std::vector<NetworkInterface> interfaces;
+    interfaces.reserve(table->NumEntries);
+    for(const auto &row : std::span{table->Table, table->NumEntries})
+    {
+        interfaces.push_back({wideStringToString(row.Alias), wideStringToString(row.Description),
+                              row.InterfaceLuid.Value, row.InterfaceIndex});
+    }
+
+    return interfaces;
+}
+
+auto InterfaceTable::find(const std::string &name) const -> std::optional<NetworkInterface>
+{
+    std::call_once(_enumerated, [this] { enumerate(); });
+
+    const std::string key = toLowercase(name);
+    if(auto it = _byAlias.find(key); it != _byAlias.end())
+    {
+        return it->second;
+    }
+    if(auto it = _byDescription.find(key); it != _byDescription.end())
+    {
+        return it->second;
+    }
+    UINT32 index{};
+    const auto [end, error] = std::from_chars(key.data(), key.data() + key.size(), index);
+    if(error == std::errc{} && end == key.data() + key.size())
+    {
+        if(auto it = _byIndex.find(index); it != _byIndex.end())
+        {
+            return it->second;
+        }
+    }
+
+    return {};
+}
+
+void InterfaceTable::enumerate() const
+{
+    ++_enumerationCount;
+    for(auto &netInterface : _enumerator())
+    {
+        // Interfaces are listed more than once (e.g filter drivers bound to an adapter
+        // share its description) - the first listed wins, which is the adapter itself
+        _byAlias.try_emplace(toLowercase(netInterface.alias), netInterface);
+        _byDescription.try_emplace(toLowercase(netInterface.description), netInterface);
+        _byIndex.try_emplace(netInterface.index, std::move(netInterface));
+    }
+}
+}
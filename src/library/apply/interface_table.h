@@ -0,0 +1,64 @@
+#pragma once
+
+#include <visitors/wfp_executor.h>
+#include <mutex>
+
+namespace wfpk
+{
+struct NetworkInterface
+{
+    // e.g "Wi-Fi" or "Ethernet 2" (as shown by Get-NetAdapter)
+    std::string alias;
+    // e.g "Intel(R) Wi-Fi 6 AX201 160MHz"
+    std::string description;
+    UINT64 luid{0};
+    UINT32 index{0};
+};
+
+// Lists the machine's network interfaces
+using InterfaceEnumerator = std::function<std::vector<NetworkInterface>()>;
+
+// The system's interfaces (see GetIfTable2). Throws a WfpError on failure.
+auto systemInterfaces() -> std::vector<NetworkInterface>;
+
+// Resolves the interface names rules refer to. The interfaces are enumerated once, on
+// the first lookup, into a map - so lowering needs no system call per rule.
+// A name matches an interface's alias, its description or (if it's a number) its index,
+// ignoring case - aliases are tried first. Lookups are thread safe.
+class InterfaceTable
+{
+public:
+    explicit InterfaceTable(InterfaceEnumerator enumerator = systemInterfaces)
+        : _enumerator{std::move(enumerator)}
+    {}
+
+public:
+    auto find(const std::string &name) const -> std::optional<NetworkInterface>;
+    // An InterfaceResolver backed by this table, which must outlive it
+    auto resolver() const -> InterfaceResolver
+    {
+        return [this](const std::string &name) -> std::optional<UINT64> {
+            const auto found = find(name);
+            return found ? std::optional{found->luid} : std::nullopt;
+        };
+    }
+
+    // Whether (and so how many times) the interfaces have been enumerated
+    size_t enumerationCount() const
+    {
+        return _enumerationCount;
+    }
+
+private:
+    void enumerate() const;
+
+private:
+    InterfaceEnumerator _enumerator;
+    mutable std::once_flag _enumerated;
+    mutable size_t _enumerationCount{0};
+    // By lowercased alias, description and index
+    mutable std::unordered_map<std::string, NetworkInterface> _byAlias;
+    mutable std::unordered_map<std::string, NetworkInterface> _byDescription;
+    mutable std::unordered_map<UINT32, NetworkInterface> _byIndex;
+};
+}
@@ -0,0 +1,46 @@
+#include <apply/ruleset_fingerprint.h>
+#include <apply/canonical_filter.h>
+
+namespace wfpk
+{
+FingerprintBuilder::FingerprintBuilder(std::string_view variant)
+{
+    _sha1.update(variant);
+    // Separate the variant from the filters so the boundary is unambiguous
+    _sha1.update("\0", 1);
+}
+
+void FingerprintBuilder::add(std::span<const FWPM_FILTER> filters)
+{
+    for(const auto &filter : filters)
+    {
+        const std::string content = canonicalFilterContent(filter);
+        // Length-prefixed, as canonical content is variable length
+        const UINT64 contentSize = content.size();
+
+        _sha1.update(&filter.filterKey, sizeof(filter.filterKey));
+        _sha1.update(&contentSize, sizeof(contentSize));
+        _sha1.update(content);
+    }
+}
+
+auto rulesetFingerprint(std::span<const FWPM_FILTER> filters, std::string_view variant)
+    -> RulesetFingerprint
+{
+    FingerprintBuilder builder{variant};
+    builder.add(filters);
+    return builder.finish();
+}
+
+std::string fingerprintString(const RulesetFingerprint &fingerprint)
+{
+    std::string result;
+    result.reserve(fingerprint.size() * 2);
+    for(const auto byte : fingerprint)
+    {
+        result += std::format("{:02x}", byte);
+    }
+
+    return result;
+}
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <engine/engine_concepts.h>
+#include <sha1.h>
+#include <span>
+#include <string_view>
+
+namespace wfpk
+{
+// wfpk's own provider, recording the fingerprint of the last ruleset loaded in its
+// providerData. No filters reference it, so it can be replaced at will.
+inline constinit GUID WFPK_FINGERPRINT_PROVIDER_KEY = {
+    0x2b30d030, 0x3575, 0x400d, {0xa6, 0x70, 0xa6, 0x12, 0xa6, 0x39, 0x4b, 0x2e}};
+
+using RulesetFingerprint = Sha1::Digest;
+
+// A hash of a compiled ruleset: the key and canonical content of each of its filters,
+// in order. `variant` covers anything else that decides what applying the filters
+// leaves installed (e.g the apply mode).
+auto rulesetFingerprint(std::span<const FWPM_FILTER> filters, std::string_view variant)
+    -> RulesetFingerprint;
+
+// Builds a rulesetFingerprint() incrementally, a run of filters at a time
+class FingerprintBuilder
+{
+public:
+    explicit FingerprintBuilder(std::string_view variant);
+
+public:
+    void add(std::span<const FWPM_FILTER> filters);
+    // Completes the fingerprint - the builder should not be added to afterwards
+    auto finish() -> RulesetFingerprint
+    {
+        return _sha1.finish();
+    }
+
+private:
+    Sha1 _sha1;
+};
+
+// Lowercase hex, for display
+std::string fingerprintString(const RulesetFingerprint &fingerprint);
+
+// Reads and records the fingerprint of the last ruleset loaded.
+// A match means the filters a load would install already are, unless something
+// other than wfpk changed them since - so the load can be skipped.
+template <ProviderEngine EngineT> class FingerprintStore
+{
+public:
+    explicit FingerprintStore(EngineT &engine)
+        : _engine{engine}
+    {}
+
+public:
+    // The recorded fingerprint, if any - a single round trip
+    auto installed() const -> std::optional<RulesetFingerprint>
+    {
+        const auto data = _engine.providerData(WFPK_FINGERPRINT_PROVIDER_KEY);
+        if(!data || data->size() != RulesetFingerprint{}.size())
+        {
+            return {};
+        }
+
+        RulesetFingerprint fingerprint{};
+        std::ranges::copy(*data, fingerprint.begin());
+        return fingerprint;
+    }
+
+    // Record a ruleset as loaded. Call this from the transaction that applies the
+    // ruleset (see CommitHook) so it's only recorded if the filters are.
+    // Throws a WfpError on failure.
+    void record(const RulesetFingerprint &fingerprint)
+    {
+        // Providers can't be updated, only replaced
+        clear();
+
+        RulesetFingerprint data{fingerprint};
+        FWPM_PROVIDER provider{};
+        provider.providerKey = WFPK_FINGERPRINT_PROVIDER_KEY;
+        provider.displayData.name = const_cast<wchar_t *>(L"wfpk ruleset fingerprint");
+        provider.displayData.description =
+            const_cast<wchar_t *>(L"Fingerprint of the last ruleset loaded by wfpk");
+        // Outlives the session, like the filters it describes
+        provider.flags = FWPM_PROVIDER_FLAG_PERSISTENT;
+        provider.providerData.size = static_cast<UINT32>(data.size());
+        provider.providerData.data = data.data();
+
+        DWORD status = _engine.tryAddProvider(provider);
+        if(status != ERROR_SUCCESS)
+        {
+            throw WfpError{"Failed to record the ruleset fingerprint:", status};
+        }
+    }
+
+    // Forget the recorded fingerprint so the next load does the full work.
+    // Needed whenever wfpk changes installed filters other than by a load.
+    void clear()
+    {
+        DWORD status = _engine.deleteProviderByKey(WFPK_FINGERPRINT_PROVIDER_KEY);
+        if(status != ERROR_SUCCESS && status != FWP_E_PROVIDER_NOT_FOUND)
+        {
+            throw WfpError{"Failed to clear the ruleset fingerprint:", status};
+        }
+    }
+
+private:
+    EngineT &_engine;
+};
+}
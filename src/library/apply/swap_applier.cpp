@@ -0,0 +1,10 @@
+#include <apply/swap_applier.h>
+#include <sha1.h>
+
+namespace wfpk
+{
+GUID swapFilterKey(const GUID &subLayerKey, const GUID &filterKey)
+{
+    return nameBasedGuid(subLayerKey, {reinterpret_cast<const char *>(&filterKey), sizeof(GUID)});
+}
+}
@@ -0,0 +1,262 @@
+#pragma once
+
+#include <apply/filter_applier.h>
+
+namespace wfpk
+{
+// wfpk's two swap sublayers. Each swap installs the ruleset into whichever one
+// isn't active, then retires the other.
+inline constinit GUID WFPK_SWAP_SUBLAYER_KEYS[] = {
+    {0x8ffe879d, 0xcac1, 0x4fa7, {0xb8, 0x4a, 0x38, 0x30, 0x8f, 0xb6, 0x16, 0xd8}},
+    {0xe72dfccc, 0x2cb5, 0x4553, {0xa3, 0xa9, 0x67, 0x91, 0xee, 0x66, 0x30, 0x61}}};
+
+// The key a filter gets in a swap sublayer. Each sublayer gets its own keys, so
+// filters staged in one don't collide with the same filters still in the other.
+GUID swapFilterKey(const GUID &subLayerKey, const GUID &filterKey);
+
+struct SwapRetireResult
+{
+    size_t deletedCount{0};
+    // enumerate, and the begin/delete/commit phases
+    PhaseTimings timings;
+};
+
+struct SwapResult
+{
+    // The sublayer now holding the ruleset
+    GUID activeSubLayerKey{};
+    UINT16 activeWeight{0};
+    // Ids of the filters added to it
+    std::vector<FilterId> filterIds;
+    // and their (sublayer-specific) keys
+    std::vector<GUID> filterKeys;
+    // Filters of the previous policy - the previous swap sublayer's, and any loaded into
+    // the PIA sublayer without a swap - deleted in the same transaction
+    size_t retiredCount{0};
+    // Filters left behind by an earlier, interrupted swap - removed before staging
+    size_t leftoverCount{0};
+    // leftovers, and the enumerate/begin/sublayer/add/retire/commit phases of the swap
+    PhaseTimings timings;
+};
+
+// Replaces a policy without a window of partial enforcement. The ruleset is staged
+// into a new sublayer, and in the same transaction the previous policy is deleted -
+// the previous swap sublayer and its filters, and any PIA filters loaded into the PIA
+// sublayer without a swap. Until the commit only the old policy applies, afterwards
+// only the new one. Nothing is compared filter by filter, as a diff does.
+//
+// The policies can't both be in force even briefly: WFP arbitrates across sublayers,
+// so a block in the old one would override the new one's permits. The old policy's
+// filters are enumerated before the transaction begins, to keep it short.
+template <typename EngineT>
+    requires FilterEngine<EngineT> && FilterEnumerableEngine<EngineT> && SubLayerEngine<EngineT>
+class SwapApplier
+{
+public:
+    // Weight of each swap sublayer
+    static constexpr UINT16 kBaseWeight = 0x8000;
+
+public:
+    // layerKeys are the layers searched for the retired sublayer's filters
+    SwapApplier(EngineT &engine, std::vector<GUID> layerKeys)
+        : _engine{engine}
+        , _layerKeys{std::move(layerKeys)}
+    {}
+
+public:
+    void beforeCommit(CommitHook hook)
+    {
+        _beforeCommit = std::move(hook);
+    }
+
+    // Throws a WfpError on failure, the transaction is rolled back before the error
+    // propagates - leaving the previous policy in force.
+    auto apply(std::span<const FWPM_FILTER> filters) -> SwapResult
+    {
+        SwapResult result;
+
+        std::optional<UINT16> weights[2] = {_engine.subLayerWeight(WFPK_SWAP_SUBLAYER_KEYS[0]),
+                                            _engine.subLayerWeight(WFPK_SWAP_SUBLAYER_KEYS[1])};
+        size_t active = weights[1].value_or(0) > weights[0].value_or(0) ? 1 : 0;
+
+        if(weights[0] && weights[1])
+        {
+            // Left by an interrupted swap from before the old sublayer was deleted in the
+            // swap's own transaction - the higher weighted sublayer was in force
+            auto leftovers = retire(_engine, _layerKeys, WFPK_SWAP_SUBLAYER_KEYS[1 - active]);
+            result.leftoverCount = leftovers.deletedCount;
+            result.timings.merge("leftovers", leftovers.timings);
+            weights[1 - active].reset();
+        }
+
+        const bool hasActive = weights[active].has_value();
+        const size_t shadow = hasActive ? 1 - active : 0;
+        const GUID &shadowKey = WFPK_SWAP_SUBLAYER_KEYS[shadow];
+        const GUID &activeKey = WFPK_SWAP_SUBLAYER_KEYS[active];
+
+        std::vector<FilterId> retiredIds;
+        std::vector<FilterId> unswappedIds;
+        result.timings.measure("enumerate", [&] {
+            if(hasActive)
+            {
+                retiredIds = subLayerFilterIds(_engine, _layerKeys, activeKey);
+            }
+            // Loaded by append, diff or pipelined loads - part of the policy too
+            unswappedIds = subLayerFilterIds(_engine, _layerKeys, PIA_SUBLAYER_KEY);
+        });
+
+        std::optional<Transaction<EngineT>> transaction;
+        result.timings.measure("begin", [&] { transaction.emplace(_engine); });
+
+        result.timings.measure("sublayer", [&] {
+            FWPM_SUBLAYER subLayer{};
+            subLayer.subLayerKey = shadowKey;
+            subLayer.displayData.name = const_cast<wchar_t *>(L"wfpk ruleset");
+            subLayer.displayData.description =
+                const_cast<wchar_t *>(L"Ruleset installed by wfpk load --swap");
+            subLayer.flags = FWPM_SUBLAYER_FLAG_PERSISTENT;
+            subLayer.weight = kBaseWeight;
+
+            DWORD status = _engine.tryAddSubLayer(subLayer);
+            if(status != ERROR_SUCCESS)
+            {
+                transaction.reset();
+                throw WfpError{"Failed to add the swap sublayer, rolled back:", status};
+            }
+        });
+
+        result.filterIds.reserve(filters.size());
+        result.filterKeys.reserve(filters.size());
+        result.timings.measure("add", [&] {
+            for(size_t index = 0; index < filters.size(); ++index)
+            {
+                // Shallow copy, the conditions still belong to the caller
+                FWPM_FILTER filter{filters[index]};
+                filter.subLayerKey = shadowKey;
+                if(filter.filterKey != ZeroGuid)
+                {
+                    filter.filterKey = swapFilterKey(shadowKey, filter.filterKey);
+                }
+
+                FilterId id{};
+                DWORD status = _engine.tryAdd(filter, id);
+                if(status == FWP_E_ALREADY_EXISTS && filter.filterKey != ZeroGuid)
+                {
+                    // The sublayer is new, so this repeats a filter from higher up the
+                    // ruleset - which pre-empts it anyway
+                    continue;
+                }
+                if(status != ERROR_SUCCESS)
+                {
+                    transaction.reset();
+                    throw WfpError{std::format("Failed to add filter {} of {}, rolled back:",
+                                               index + 1, filters.size()),
+                                   status};
+                }
+                result.filterIds.push_back(id);
+                result.filterKeys.push_back(filter.filterKey);
+            }
+        });
+
+        result.timings.measure("retire", [&] {
+            // The PIA sublayer isn't wfpk's alone, so it stays
+            deleteFilters(_engine, transaction, unswappedIds);
+            if(hasActive)
+            {
+                // A filter added to the old sublayer since it was enumerated leaves it in
+                // use, so deleting it fails and the swap is rolled back
+                deleteSubLayer(_engine, transaction, retiredIds, activeKey);
+            }
+        });
+        result.retiredCount = retiredIds.size() + unswappedIds.size();
+
+        result.timings.measure("commit", [&] {
+            if(_beforeCommit)
+            {
+                _beforeCommit();
+            }
+            transaction->commit();
+        });
+
+        result.activeSubLayerKey = shadowKey;
+        result.activeWeight = kBaseWeight;
+        return result;
+    }
+
+private:
+    // The PIA filters in a sublayer
+    static auto subLayerFilterIds(EngineT &engine, const std::vector<GUID> &layerKeys,
+                                  const GUID &subLayerKey) -> std::vector<FilterId>
+    {
+        std::vector<FilterId> ids;
+        for(const auto &layerKey : layerKeys)
+        {
+            engine.enumerateFiltersForLayer(
+                layerKey,
+                [&](const auto &pFilter) {
+                    if(pFilter->subLayerKey == subLayerKey)
+                    {
+                        ids.push_back(pFilter->filterId);
+                    }
+                },
+                {.providerKey = PIA_PROVIDER_KEY});
+        }
+        return ids;
+    }
+
+    // Delete filters in the open transaction, which is rolled back if any delete fails
+    static void deleteFilters(EngineT &engine, std::optional<Transaction<EngineT>> &transaction,
+                              const std::vector<FilterId> &filterIds)
+    {
+        for(const auto &filterId : filterIds)
+        {
+            DWORD status = engine.deleteFilterById(filterId);
+            if(status != ERROR_SUCCESS)
+            {
+                transaction.reset();
+                throw WfpError{std::format("Failed to delete filter {}, rolled back:", filterId),
+                               status};
+            }
+        }
+    }
+
+    // Delete a swap sublayer's filters and then the sublayer, in the open transaction -
+    // which is rolled back if any delete fails
+    static void deleteSubLayer(EngineT &engine, std::optional<Transaction<EngineT>> &transaction,
+                               const std::vector<FilterId> &filterIds, const GUID &subLayerKey)
+    {
+        deleteFilters(engine, transaction, filterIds);
+
+        DWORD status = engine.deleteSubLayerByKey(subLayerKey);
+        if(status != ERROR_SUCCESS)
+        {
+            transaction.reset();
+            throw WfpError{"Failed to delete the retired swap sublayer, rolled back:", status};
+        }
+    }
+
+    // Delete a swap sublayer along with its filters, in a transaction of its own
+    static auto retire(EngineT &engine, const std::vector<GUID> &layerKeys,
+                       const GUID &subLayerKey) -> SwapRetireResult
+    {
+        SwapRetireResult result;
+
+        const auto filterIds = result.timings.measure(
+            "enumerate", [&] { return subLayerFilterIds(engine, layerKeys, subLayerKey); });
+
+        std::optional<Transaction<EngineT>> transaction;
+        result.timings.measure("begin", [&] { transaction.emplace(engine); });
+        result.timings.measure(
+            "delete", [&] { deleteSubLayer(engine, transaction, filterIds, subLayerKey); });
+        result.timings.measure("commit", [&] { transaction->commit(); });
+
+        result.deletedCount = filterIds.size();
+        return result;
+    }
+
+private:
+    EngineT &_engine;
+    std::vector<GUID> _layerKeys;
+    CommitHook _beforeCommit;
+};
+}
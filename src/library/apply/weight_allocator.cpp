@@ -0,0 +1,276 @@
+#include <apply/weight_allocator.h>
+#include <bit>
+#include <numeric>
+
+namespace wfpk
+{
+namespace
+{
+// How narrow an address condition is, on a common 0-32 scale for v4 and v6
+UINT32 addressNarrowness(const FWP_CONDITION_VALUE &value)
+{
+    switch(value.type)
+    {
+        case FWP_V4_ADDR_MASK: return std::popcount(value.v4AddrMask->mask);
+        case FWP_V6_ADDR_MASK: return value.v6AddrMask->prefixLength / 4;
+        // A single address
+        case FWP_UINT32:
+        case FWP_BYTE_ARRAY16_TYPE: return 32;
+        default: return 0;
+    }
+}
+
+bool isAddressField(const GUID &fieldKey)
+{
+    return fieldKey == FWPM_CONDITION_IP_LOCAL_ADDRESS ||
+           fieldKey == FWPM_CONDITION_IP_REMOTE_ADDRESS;
+}
+}
+
+UINT32 conditionSpecificity(std::span<const FWPM_FILTER_CONDITION> conditions)
+{
+    // Each distinct field, and the narrowness of its widest value (for address fields).
+    // Filters have a handful of fields at most, so a linear search beats a map.
+    std::vector<std::pair<GUID, UINT32>> fields;
+
+    for(const auto &condition : conditions)
+    {
+        const UINT32 narrowness =
+            isAddressField(condition.fieldKey) ? addressNarrowness(condition.conditionValue) : 0;
+
+        auto it = std::ranges::find(fields, condition.fieldKey, &std::pair<GUID, UINT32>::first);
+        if(it == fields.end())
+        {
+            fields.emplace_back(condition.fieldKey, narrowness);
+        }
+        else
+        {
+            it->second = (std::min)(it->second, narrowness);
+        }
+    }
+
+    UINT32 addressSpecificity{};
+    for(const auto &[fieldKey, narrowness] : fields)
+    {
+        addressSpecificity += narrowness;
+    }
+
+    const auto fieldCount =
+        (std::min)(static_cast<UINT32>(fields.size()), WeightAllocator::kMaxSpecificFields);
+
+    // Only the local and remote address fields contribute, so at most 64
+    return fieldCount * WeightAllocator::kFieldSpecificity + (std::min)(addressSpecificity, 64U);
+}
+
+WeightAllocator::WeightAllocator(WeightPolicy policy, UINT64 lowest, UINT64 highest)
+    : _policy{policy}
+    , _lowest{lowest}
+{
+    if(highest <= lowest)
+    {
+        throw std::invalid_argument{
+            std::format("Invalid weight range: [{}, {}]", lowest, highest)};
+    }
+
+    // Every (rule, specificity) pair gets a rank, spread evenly across the range
+    const UINT64 rankCount = kMaxRules * (kMaxSpecificity + 1);
+    _stride = (highest - lowest) / (rankCount + 1);
+
+    if(_stride < 2)
+    {
+        throw std::invalid_argument{std::format(
+            "Weight range [{}, {}] is too small to leave gaps between rules", lowest, highest)};
+    }
+}
+
+UINT64 WeightAllocator::weightFor(size_t ruleIndex, UINT32 specificity) const
+{
+    if(ruleIndex >= kMaxRules)
+    {
+        throw std::out_of_range{std::format("Rule {} is beyond the {} rules that can be weighted",
+                                            ruleIndex, kMaxRules)};
+    }
+
+    // Earlier rules rank higher
+    const UINT64 orderRank = kMaxRules - 1 - ruleIndex;
+    specificity = (std::min)(specificity, kMaxSpecificity);
+
+    const UINT64 rank = _policy == WeightPolicy::RuleOrder
+                            ? orderRank * (kMaxSpecificity + 1) + specificity
+                            : UINT64{specificity} * kMaxRules + orderRank;
+
+    return _lowest + (rank + 1) * _stride;
+}
+
+auto WeightAllocator::between(UINT64 lower, UINT64 upper) -> std::optional<UINT64>
+{
+    if(upper <= lower || upper - lower < 2)
+    {
+        return {};
+    }
+
+    return lower + (upper - lower) / 2;
+}
+
+auto WeightAllocator::retain(std::span<const UINT64> weights,
+                             std::span<const std::optional<UINT64>> installed, UINT64 lowest,
+                             UINT64 highest) -> std::optional<std::vector<UINT64>>
+{
+    assert(weights.size() == installed.size());
+    const auto retainable = [&](size_t filter) {
+        return installed[filter] && *installed[filter] >= lowest && *installed[filter] <= highest;
+    };
+
+    // Filters from the highest weight down, grouped by weight - filters in a group aren't
+    // ranked against each other. Within a group, installed weights come highest first.
+    std::vector<size_t> order(weights.size());
+    std::iota(order.begin(), order.end(), size_t{0});
+    std::ranges::sort(order, [&](size_t a, size_t b) {
+        if(weights[a] != weights[b])
+        {
+            return weights[a] > weights[b];
+        }
+        return std::pair{retainable(a), installed[a].value_or(0)} >
+               std::pair{retainable(b), installed[b].value_or(0)};
+    });
+    std::vector<size_t> groupStarts;
+    for(size_t position = 0; position < order.size(); ++position)
+    {
+        if(position == 0 || weights[order[position]] != weights[order[position - 1]])
+        {
+            groupStarts.push_back(position);
+        }
+    }
+    const size_t groupCount = groupStarts.size();
+    groupStarts.push_back(order.size());
+
+    // The installed weights to keep: the longest chain of them that's strictly decreasing
+    // from group to group (and non-increasing within one), i.e the longest non-increasing
+    // run of (weight, group) - found by patience sorting
+    struct Candidate
+    {
+        UINT64 weight;
+        size_t group;
+        size_t filter;
+    };
+    std::vector<Candidate> candidates;
+    for(size_t group = 0; group < groupCount; ++group)
+    {
+        for(size_t position = groupStarts[group]; position < groupStarts[group + 1]; ++position)
+        {
+            if(retainable(order[position]))
+            {
+                candidates.push_back({*installed[order[position]], group, order[position]});
+            }
+        }
+    }
+
+    constexpr size_t NoCandidate = (std::numeric_limits<size_t>::max)();
+    const auto rank = [&](size_t candidate) {
+        return std::pair{candidates[candidate].weight, candidates[candidate].group};
+    };
+    // The candidate ending the best chain of each length, and the one before each candidate
+    std::vector<size_t> tails;
+    std::vector<size_t> previous(candidates.size(), NoCandidate);
+    for(size_t candidate = 0; candidate < candidates.size(); ++candidate)
+    {
+        auto it = std::ranges::upper_bound(tails, rank(candidate), std::greater{}, rank);
+        if(it != tails.begin())
+        {
+            previous[candidate] = *std::prev(it);
+        }
+        if(it == tails.end())
+        {
+            tails.push_back(candidate);
+        }
+        else
+        {
+            *it = candidate;
+        }
+    }
+
+    // The lowest and highest weights kept in each group, if any are
+    std::vector<std::optional<std::pair<UINT64, UINT64>>> keptRanges(groupCount);
+    std::vector<bool> kept(weights.size(), false);
+    for(size_t candidate = tails.empty() ? NoCandidate : tails.back(); candidate != NoCandidate;
+        candidate = previous[candidate])
+    {
+        const auto &[weight, group, filter] = candidates[candidate];
+        // The chain is walked from its lowest weight up
+        if(!keptRanges[group])
+        {
+            keptRanges[group].emplace(weight, weight);
+        }
+        keptRanges[group]->second = weight;
+        kept[filter] = true;
+    }
+
+    std::vector<UINT64> result(weights.size());
+    const auto assign = [&](size_t group, UINT64 weight) {
+        for(size_t position = groupStarts[group]; position < groupStarts[group + 1]; ++position)
+        {
+            const size_t filter = order[position];
+            result[filter] = kept[filter] ? *installed[filter] : weight;
+        }
+    };
+
+    // Each run of groups with nothing kept is slotted in between the groups either side,
+    // exclusive of both - or of the ends of the range
+    UINT64 upper = highest;
+    size_t runStart = 0;
+    for(size_t group = 0; group <= groupCount; ++group)
+    {
+        const bool end = group == groupCount;
+        if(!end && !keptRanges[group])
+        {
+            continue;
+        }
+
+        const UINT64 lower = end ? lowest : keptRanges[group]->second;
+        const size_t runLength = group - runStart;
+        if(runLength > 0)
+        {
+            const UINT64 runHighest = weights[order[groupStarts[runStart]]];
+            const UINT64 runLowest = weights[order[groupStarts[group - 1]]];
+            if(runHighest < upper && runLowest > lower)
+            {
+                // Their own weights fit already
+                for(size_t runGroup = runStart; runGroup < group; ++runGroup)
+                {
+                    assign(runGroup, weights[order[groupStarts[runGroup]]]);
+                }
+            }
+            else if(runLength == 1)
+            {
+                const auto weight = between(lower, upper);
+                if(!weight)
+                {
+                    return {};
+                }
+                assign(runStart, *weight);
+            }
+            else
+            {
+                const UINT64 step = upper > lower ? (upper - lower) / (runLength + 1) : 0;
+                if(step == 0)
+                {
+                    return {};
+                }
+                for(size_t runGroup = runStart; runGroup < group; ++runGroup)
+                {
+                    assign(runGroup, upper - (runGroup - runStart + 1) * step);
+                }
+            }
+        }
+
+        if(!end)
+        {
+            assign(group, keptRanges[group]->first);
+            upper = keptRanges[group]->first;
+        }
+        runStart = group + 1;
+    }
+
+    return result;
+}
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <wfp_objects.h>
+#include <span>
+
+namespace wfpk
+{
+// How filters within the PIA sublayer are ranked against each other.
+// WFP evaluates the highest weight matching filter first, so a higher rank wins.
+enum class WeightPolicy
+{
+    // Earlier rules in the file win (first match), like most rule based firewalls.
+    // Specificity only ranks filters from the same rule.
+    RuleOrder,
+    // More specific filters win (like longest prefix match), earlier rules break ties
+    Specificity
+};
+
+// How specific a filter's conditions are - in [0, kMaxSpecificity].
+// Filters constraining more fields are more specific, then filters whose address
+// conditions cover fewer addresses. Conditions on the same field are ORed, so a field
+// is only as specific as its widest value.
+UINT32 conditionSpecificity(std::span<const FWPM_FILTER_CONDITION> conditions);
+inline UINT32 filterSpecificity(const FWPM_FILTER &filter)
+{
+    return conditionSpecificity({filter.filterCondition, filter.numFilterConditions});
+}
+
+// Assigns 64-bit filter weights from a rule's position in the ruleset and its specificity.
+//
+// Weights are a pure function of (rule index, specificity), so filters can be weighted
+// independently (and in parallel), and appending rules never changes existing weights.
+// Every possible rank is spread evenly across the weight range, leaving large gaps
+// between neighbouring ranks - so a rule can later be slotted in between two existing
+// filters (see between()) without re-weighting everything else.
+class WeightAllocator
+{
+public:
+    // Filters constrain at most this many distinct fields for specificity purposes
+    static constexpr UINT32 kMaxSpecificFields = 8;
+    // Each field is worth more than any amount of address narrowing (2 fields x 32)
+    static constexpr UINT32 kFieldSpecificity = 65;
+    static constexpr UINT32 kMaxSpecificity = kMaxSpecificFields * kFieldSpecificity + 64;
+    // Rules beyond this index can't be weighted
+    static constexpr size_t kMaxRules = size_t{1} << 24;
+
+    // The weight range previously used by every PIA filter: FWP_UINT8 weights are
+    // expanded by the BFE into the top 4 bits of the 64-bit weight, and PIA used 10.
+    // Staying inside it keeps PIA filters ranked the same against everyone else's.
+    static constexpr UINT64 kDefaultLowest = UINT64{10} << 60;
+    static constexpr UINT64 kDefaultHighest = (UINT64{11} << 60) - 1;
+
+public:
+    explicit WeightAllocator(WeightPolicy policy = WeightPolicy::RuleOrder,
+                             UINT64 lowest = kDefaultLowest, UINT64 highest = kDefaultHighest);
+
+public:
+    // The weight for a filter from the given rule (0 is the first rule in the file)
+    UINT64 weightFor(size_t ruleIndex, UINT32 specificity) const;
+    UINT64 weightFor(size_t ruleIndex, const FWPM_FILTER &filter) const
+    {
+        return weightFor(ruleIndex, filterSpecificity(filter));
+    }
+
+    // A weight strictly between two existing weights, for inserting a filter that must
+    // rank between them. Returns nullopt if there's no room left.
+    static auto between(UINT64 lower, UINT64 upper) -> std::optional<UINT64>;
+
+    // Weights for re-applying a ruleset over an earlier version of it that keep as many
+    // installed weights as they can: `weights` are the filters' weights from weightFor(),
+    // `installed` the weights they're installed with, if they are.
+    // An installed weight is kept where it still ranks its filter as `weights` do
+    // against every other kept weight. Filters between two kept ones are slotted in
+    // between them (see between()) - with their own weight where it already fits - so
+    // inserting a rule re-weights its own filters, not every filter ranked below it.
+    // Returns nullopt if there's no room left, to re-weight everything instead.
+    static auto retain(std::span<const UINT64> weights,
+                       std::span<const std::optional<UINT64>> installed,
+                       UINT64 lowest = kDefaultLowest, UINT64 highest = kDefaultHighest)
+        -> std::optional<std::vector<UINT64>>;
+
+    WeightPolicy policy() const
+    {
+        return _policy;
+    }
+    // The distance between neighbouring ranks
+    UINT64 stride() const
+    {
+        return _stride;
+    }
+
+private:
+    WeightPolicy _policy{};
+    UINT64 _lowest{};
+    UINT64 _stride{};
+};
+}
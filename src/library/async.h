@@ -0,0 +1,216 @@
+#pragma once
+
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+namespace wfpk
+{
+namespace detail
+{
+// Where an Async's result is left for whoever awaits it
+template <typename T> class AsyncState
+{
+public:
+    using Stored = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+public:
+    // Keep the result, then resume the coroutine awaiting it (if any) on this thread
+    void settle(std::optional<Stored> value, std::exception_ptr error)
+    {
+        std::coroutine_handle<> continuation;
+        {
+            std::lock_guard lock{_mutex};
+            _value = std::move(value);
+            _error = std::move(error);
+            _settled = true;
+            continuation = std::exchange(_continuation, {});
+        }
+        _settledCv.notify_all();
+        if(continuation)
+        {
+            continuation.resume();
+        }
+    }
+
+    bool isSettled() const
+    {
+        std::lock_guard lock{_mutex};
+        return _settled;
+    }
+
+    // False if the result is already here, so the awaiter needn't suspend
+    bool setContinuation(std::coroutine_handle<> continuation)
+    {
+        std::lock_guard lock{_mutex};
+        if(_settled)
+        {
+            return false;
+        }
+        _continuation = continuation;
+        return true;
+    }
+
+    // Waits for the result. Rethrows the error it settled with.
+    auto take() -> Stored
+    {
+        std::unique_lock lock{_mutex};
+        _settledCv.wait(lock, [&] { return _settled; });
+        if(_error)
+        {
+            std::rethrow_exception(_error);
+        }
+        return std::move(*_value);
+    }
+
+private:
+    mutable std::mutex _mutex;
+    std::condition_variable _settledCv;
+    bool _settled{false};
+    std::optional<Stored> _value;
+    std::exception_ptr _error;
+    std::coroutine_handle<> _continuation;
+};
+
+template <typename T> struct AsyncPromiseBase
+{
+    std::shared_ptr<AsyncState<T>> pState{std::make_shared<AsyncState<T>>()};
+
+    void return_value(T value)
+    {
+        pState->settle(std::move(value), {});
+    }
+};
+
+template <> struct AsyncPromiseBase<void>
+{
+    std::shared_ptr<AsyncState<void>> pState{std::make_shared<AsyncState<void>>()};
+
+    void return_void()
+    {
+        pState->settle(std::monostate{}, {});
+    }
+};
+}
+
+// The result of work that may still be running - a coroutine returning Async<T>, or an
+// operation handed to an Executor (see Executor::submit()). A coroutine co_awaits it,
+// suspending until the result is ready and then resuming on the thread that produced
+// it; other code can block on get().
+//
+// Unlike a Generator, an Async coroutine starts as soon as it's called - so work started
+// before any of it is awaited overlaps:
+//
+//   auto connect = engine.enumerateAsync(FWPM_LAYER_ALE_AUTH_CONNECT_V4);
+//   auto accept = engine.enumerateAsync(FWPM_LAYER_ALE_AUTH_RECV_ACCEPT_V4);
+//   auto connectFilters = co_await connect; // both enumerations are in flight
+//
+// A result is awaited (or got) once. An exception thrown producing it is rethrown there.
+template <typename T> class Async
+{
+    using State = detail::AsyncState<T>;
+
+public:
+    struct promise_type : detail::AsyncPromiseBase<T>
+    {
+        Async get_return_object()
+        {
+            return Async{this->pState};
+        }
+        // Runs straight away, on the caller's thread until it first suspends
+        std::suspend_never initial_suspend() noexcept
+        {
+            return {};
+        }
+        // The result outlives the coroutine, so its frame is freed as it finishes
+        std::suspend_never final_suspend() noexcept
+        {
+            return {};
+        }
+        void unhandled_exception()
+        {
+            this->pState->settle(std::nullopt, std::current_exception());
+        }
+    };
+
+    // Settles an Async from outside a coroutine, e.g on an executor thread
+    class Completion
+    {
+    public:
+        Completion()
+            : _pState{std::make_shared<State>()}
+        {}
+
+    public:
+        auto async() const -> Async
+        {
+            return Async{_pState};
+        }
+        template <typename... ArgsT> void setValue(ArgsT &&...args)
+        {
+            _pState->settle(typename State::Stored(std::forward<ArgsT>(args)...), {});
+        }
+        void setError(std::exception_ptr error)
+        {
+            _pState->settle(std::nullopt, std::move(error));
+        }
+
+    private:
+        std::shared_ptr<State> _pState;
+    };
+
+public:
+    Async(Async &&) noexcept = default;
+    Async &operator=(Async &&) noexcept = default;
+    Async(const Async &) = delete;
+    Async &operator=(const Async &) = delete;
+
+public:
+    bool isReady() const
+    {
+        return _pState->isSettled();
+    }
+
+    // Blocks until the result is ready. Never call it on a thread the work itself needs,
+    // e.g an executor's only thread.
+    T get()
+    {
+        if constexpr(std::is_void_v<T>)
+        {
+            _pState->take();
+        }
+        else
+        {
+            return _pState->take();
+        }
+    }
+
+    // Awaitable
+    bool await_ready() const
+    {
+        return isReady();
+    }
+    bool await_suspend(std::coroutine_handle<> continuation)
+    {
+        return _pState->setContinuation(continuation);
+    }
+    T await_resume()
+    {
+        return get();
+    }
+
+private:
+    explicit Async(std::shared_ptr<State> pState)
+        : _pState{std::move(pState)}
+    {}
+
+private:
+    std::shared_ptr<State> _pState;
+};
+}
@@ -9,6 +9,9 @@ DeleteCommand::DeleteCommand(wfpk::WfpKiller *pWfpKiller)
     addOption("h,help", "Display this help message.");
     addOption("f,filter", "Delete a filter.",
               cxxopts::value<std::vector<std::string>>()->default_value({}));
+    addOption("l,last", "Delete the filters added by the last load.");
+    addOption("r,ruleset", "Delete the filters added by every load of a ruleset.",
+              cxxopts::value<std::string>()->default_value({}));
 }
 
 void DeleteCommand::runCommand(int argc, char **argv)
@@ -45,6 +48,15 @@ void DeleteCommand::runCommand(int argc, char **argv)
         }
         _pWfpKiller->deleteFilters(filterIds);
     }
+    // These delete what the journal recorded, with no enumeration
+    else if(result.count("last"))
+    {
+        _pWfpKiller->deleteLastLoad();
+    }
+    else if(result.count("ruleset"))
+    {
+        _pWfpKiller->deleteRuleset(result["ruleset"].as<std::string>());
+    }
     else
     {
         std::cout << "Options are required.\n";
@@ -1,4 +1,5 @@
 #include <cli/list_command.h>
+#include <thread>
 
 namespace wfpk
 {
@@ -28,10 +29,25 @@ ListCommand::ListCommand(wfpk::WfpKiller *pWfpKiller)
     addOption("f,filters", "Display all filters.");
     addOption("c,callouts", "Display all callouts.");
     addOption("L,layers", "Display layers.");
+    addOption("p,providers", "Display all providers.");
     addOption("pia", "Display PIA filters.");
     addOption("s,search", "Display filters that match the regex.",
               cxxopts::value<std::vector<std::string>>()->default_value({}));
-    addOption("sublayers", "Display sublayers");
+    addOption("layer", "Only enumerate layers whose names match the regex.",
+              cxxopts::value<std::vector<std::string>>()->default_value({}));
+    addOption("a,action", "Display filters taking these actions (block, permit).",
+              cxxopts::value<std::vector<std::string>>()->default_value({}));
+    addOption("sublayers", "Display all sublayers.");
+    addOption("page-size", "Objects fetched per round trip to the BFE.",
+              cxxopts::value<UINT32>()->default_value(
+                  std::to_string(SingleLayerFilterEnum::DefaultPageSize)));
+    addOption("sessions", "Engine sessions used to enumerate layers in parallel.",
+              cxxopts::value<size_t>()->default_value(
+                  std::to_string((std::max)(std::thread::hardware_concurrency(), 1U))));
+    addOption("stream", "Print filters as they're fetched, ungrouped and unsorted.");
+    addOption("limit", "With --stream, stop after this many filters.",
+              cxxopts::value<size_t>()->default_value(
+                  std::to_string((std::numeric_limits<size_t>::max)())));
 }
 
 void ListCommand::runCommand(int argc, char **argv)
@@ -43,31 +59,84 @@ void ListCommand::runCommand(int argc, char **argv)
         std::cout << help();
         return;
     }
-    else if(result.count("search"))
+
+    _pWfpKiller->setPageSize(result["page-size"].as<UINT32>());
+    _pWfpKiller->setMaxSessions(result["sessions"].as<size_t>());
+
+    if(result.count("providers"))
+    {
+        _pWfpKiller->listProviders();
+    }
+    if(result.count("sublayers"))
+    {
+        _pWfpKiller->listSubLayers();
+    }
+    if(result.count("callouts"))
     {
-        const auto &listValues = result["search"].as<std::vector<std::string>>();
-        bool shouldShowAllFilters = std::ranges::find(listValues, "all") != listValues.end();
+        _pWfpKiller->listCallouts();
+    }
+    if(result.count("layers"))
+    {
+        _pWfpKiller->listLayers();
+    }
 
-        std::vector<std::regex> providers, subLayers, layers;
+    const bool isListingObjects = result.count("providers") || result.count("sublayers") ||
+                                  result.count("callouts") || result.count("layers");
+    const bool isListingFilters = result.count("filters") || result.count("search") ||
+                                  result.count("pia") || result.count("layer") ||
+                                  result.count("action");
+    if(!isListingFilters)
+    {
+        if(!isListingObjects)
+        {
+            std::cout << "Options are required.\n";
+            std::cout << help();
+        }
+        return;
+    }
 
-        if(!shouldShowAllFilters)
+    WfpKiller::Options options;
+
+    const auto &listValues = result["search"].as<std::vector<std::string>>();
+    bool shouldShowAllFilters = std::ranges::find(listValues, "all") != listValues.end();
+    if(!shouldShowAllFilters)
+    {
+        // We match the 'names' against both providers and subLayers
+        // so that both fields are searched
+        options.providerMatchers = stringVecToMatchers(listValues);
+        options.subLayerMatchers = options.providerMatchers;
+    }
+    options.layerMatchers = stringVecToMatchers(result["layer"].as<std::vector<std::string>>());
+
+    // These are selected by the BFE, rather than after the filters are transferred
+    if(result.count("pia"))
+    {
+        options.query.providerKey = PIA_PROVIDER_KEY;
+    }
+    for(const auto &action : result["action"].as<std::vector<std::string>>())
+    {
+        if(toLowercase(action) == "block")
         {
-            // We match the 'names' against both providers and subLayers
-            // so that both fields are searched
-            providers = stringVecToMatchers(listValues);
-            subLayers = providers;
-            layers = stringVecToMatchers({result["search"].as<std::vector<std::string>>()});
+            options.query.actionTypes.push_back(FWP_ACTION_BLOCK);
         }
+        else if(toLowercase(action) == "permit")
+        {
+            options.query.actionTypes.push_back(FWP_ACTION_PERMIT);
+        }
+        else
+        {
+            std::cerr << std::format("Unknown action: {}\n", action);
+            return;
+        }
+    }
 
-        _pWfpKiller->listFilters({.providerMatchers = providers,
-                                  .layerMatchers = layers,
-                                  .subLayerMatchers = subLayers});
+    if(result.count("stream"))
+    {
+        _pWfpKiller->streamFilters(options, result["limit"].as<size_t>());
     }
     else
     {
-        std::cout << "Options are required.\n";
-        std::cout << help();
-        return;
+        _pWfpKiller->listFilters(options);
     }
 }
 }
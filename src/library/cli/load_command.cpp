@@ -9,6 +9,28 @@ LoadCommand::LoadCommand(wfpk::WfpKiller *pWfpKiller)
     addOption("h,help", "Display this help message.");
     addOption("f,file", "The file containing WFP rules.",
               cxxopts::value<std::string>()->default_value({}));
+    addOption("d,diff", "Only add and delete the filters that differ from those installed.");
+    addOption("s,swap", "Swap the whole policy at once, via a new sublayer that replaces the "
+                        "previous one - and any filters loaded without --swap - in the same "
+                        "transaction.");
+    addOption("n,name", "Name of the ruleset (defaults to the file name).",
+              cxxopts::value<std::string>()->default_value({}));
+    addOption("w,weights",
+              "How rules are ranked: 'order' (earlier rules win) or 'specificity' (more "
+              "specific filters win).",
+              cxxopts::value<std::string>()->default_value("order"));
+    addOption("pipeline", "Parse, lower and apply the ruleset concurrently, and report each "
+                          "stage's throughput. An unchanged ruleset is only found once it's "
+                          "all been applied, and is then rolled back. Not with --diff, --swap "
+                          "or --plan.");
+    addOption("e,ephemeral", "Install the filters only until wfpk exits, via a dynamic session. "
+                             "Not with --diff, --swap, --pipeline or --plan.");
+    addOption("v,verbose", "Print each rule before loading the ruleset.");
+    addOption("force", "Reload the ruleset even if it's unchanged since it was last loaded.");
+    addOption("p,plan", "Write the filters that would be installed to this file, as NDJSON. "
+                        "Reports each phase's allocations in builds with "
+                        "WFPK_COUNT_ALLOCATIONS.",
+              cxxopts::value<std::string>()->default_value({}));
 }
 
 void LoadCommand::runCommand(int argc, char **argv)
@@ -25,7 +47,51 @@ void LoadCommand::runCommand(int argc, char **argv)
         std::string sourceFile{result["file"].as<std::string>()};
         std::cout << "Got a file param of: " << sourceFile << "\n";
 
-        _pWfpKiller->loadFilters(sourceFile);
+        WfpKiller::LoadOptions options{};
+        options.rulesetName = result["name"].as<std::string>();
+        options.planFile = result["plan"].as<std::string>();
+
+        const auto weights = result["weights"].as<std::string>();
+        if(weights == "specificity")
+        {
+            options.weightPolicy = WeightPolicy::Specificity;
+        }
+        else if(weights != "order")
+        {
+            std::cerr << std::format("Unknown weights option: {}\n", weights);
+            return;
+        }
+        options.force = result.count("force") > 0;
+        options.pipelined = result.count("pipeline") > 0;
+        options.ephemeral = result.count("ephemeral") > 0;
+        options.verbose = result.count("verbose") > 0;
+        if(result.count("diff") && result.count("swap"))
+        {
+            std::cerr << "--diff and --swap can't be used together\n";
+            return;
+        }
+        if(options.pipelined && (result.count("diff") || result.count("swap") ||
+                                 !options.planFile.empty()))
+        {
+            std::cerr << "--pipeline can't be used with --diff, --swap or --plan\n";
+            return;
+        }
+        if(options.ephemeral && (result.count("diff") || result.count("swap") ||
+                                 options.pipelined || !options.planFile.empty()))
+        {
+            std::cerr << "--ephemeral can't be used with --diff, --swap, --pipeline or --plan\n";
+            return;
+        }
+        if(result.count("diff"))
+        {
+            options.applyMode = WfpKiller::ApplyMode::Diff;
+        }
+        else if(result.count("swap"))
+        {
+            options.applyMode = WfpKiller::ApplyMode::Swap;
+        }
+
+        _pWfpKiller->loadFilters(sourceFile, options);
     }
     else
     {
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <engine/engine_concepts.h>
+#include <engine/session_pool.h>
+#include <executor.h>
+
+namespace wfpk
+{
+// The blocking engine calls as awaitables. Each call is run by an executor thread on a
+// session leased from a SessionPool, so independent operations overlap - enumerating
+// one layer while adding to another, or while resolving app ids with runAsync() -
+// rather than each waiting out the others' round trips:
+//
+//   Async<size_t> countBlocks(AsyncEngine<Engine> &engine)
+//   {
+//       auto v4 = engine.enumerateAsync(FWPM_LAYER_ALE_AUTH_CONNECT_V4, blockQuery);
+//       auto v6 = engine.enumerateAsync(FWPM_LAYER_ALE_AUTH_CONNECT_V6, blockQuery);
+//       co_return (co_await v4).size() + (co_await v6).size();
+//   }
+//
+// Operations are independent, so there's no ordering between them beyond what awaiting
+// one before starting the next gives - nor any transaction spanning them.
+//
+// Thread safe. The pool must outlive the AsyncEngine, which finishes the operations
+// already started as it's destroyed.
+template <typename EngineT>
+    requires FilterEnumerableEngine<EngineT> &&
+             requires(EngineT &engine, const FWPM_FILTER &filter, FilterId id) {
+                 { engine.tryAdd(filter, id) } -> std::same_as<DWORD>;
+                 { engine.deleteFilterById(id) } -> std::same_as<DWORD>;
+             }
+class AsyncEngine
+{
+public:
+    using Filters = std::vector<std::shared_ptr<FWPM_FILTER>>;
+
+public:
+    // An executor thread per session the pool can lease, unless threadCount says
+    // otherwise - operations beyond the sessions available wait for one, holding a thread
+    explicit AsyncEngine(SessionPool<EngineT> &sessions, size_t threadCount = 0)
+        : _sessions{sessions}
+        , _executor{threadCount ? threadCount : sessions.maxSessions()}
+    {}
+
+public:
+    // The filter and everything it points to must stay valid until the add completes.
+    // Throws a WfpError if the filter isn't added.
+    auto addAsync(const FWPM_FILTER &filter) -> Async<FilterId>
+    {
+        return onSession([pFilter = &filter](EngineT &engine) {
+            FilterId id{};
+            if(auto result = engine.tryAdd(*pFilter, id); result != ERROR_SUCCESS)
+            {
+                throw WfpError{"FwpmFilterAdd failed:", result};
+            }
+            return id;
+        });
+    }
+
+    // The result of the delete, as deleteFilterById() returns it
+    auto deleteAsync(FilterId filterId) -> Async<DWORD>
+    {
+        return onSession(
+            [filterId](EngineT &engine) { return engine.deleteFilterById(filterId); });
+    }
+
+    // The layer's filters that the BFE selects for the query, in the order they're
+    // enumerated
+    auto enumerateAsync(const GUID &layerKey, FilterQuery query = {}) -> Async<Filters>
+    {
+        return onSession([layerKey, query = std::move(query)](EngineT &engine) {
+            Filters filters;
+            auto keep = [&](std::shared_ptr<FWPM_FILTER> pFilter) {
+                filters.push_back(std::move(pFilter));
+            };
+            engine.enumerateFiltersForLayer(layerKey, keep, query);
+            return filters;
+        });
+    }
+
+    // Other blocking work, run on an executor thread without a session - e.g resolving
+    // app ids while a layer is enumerated
+    template <typename FuncT> auto runAsync(FuncT func) -> Async<std::invoke_result_t<FuncT>>
+    {
+        return _executor.submit(std::move(func));
+    }
+
+private:
+    template <typename FuncT> auto onSession(FuncT func)
+    {
+        return _executor.submit([this, func = std::move(func)] {
+            auto session = _sessions.lease();
+            return func(*session);
+        });
+    }
+
+private:
+    SessionPool<EngineT> &_sessions;
+    Executor _executor;
+};
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <wfp_objects.h>
+#include <concepts>
+
+namespace wfpk
+{
+// Concepts describing the parts of the BFE our higher level logic relies on.
+// Both Engine (the real BFE) and MemoryEngine (an in-memory stand-in) satisfy these,
+// which lets the apply logic be exercised without a live BFE.
+
+// An engine that can group changes into a single atomic unit
+template <typename EngineT>
+concept TransactionalEngine = requires(EngineT &engine) {
+    engine.beginTransaction();
+    engine.commitTransaction();
+    { engine.abortTransaction() } -> std::same_as<DWORD>;
+};
+
+// An engine that filters can be added to and deleted from
+template <typename EngineT>
+concept FilterEngine = TransactionalEngine<EngineT> &&
+                       requires(EngineT &engine, const FWPM_FILTER &filter, FilterId id) {
+                           { engine.tryAdd(filter, id) } -> std::same_as<DWORD>;
+                           { engine.deleteFilterById(id) } -> std::same_as<DWORD>;
+                       };
+
+// An engine whose filters can also be fetched and deleted by key
+template <typename EngineT>
+concept KeyedFilterEngine = FilterEngine<EngineT> && requires(EngineT &engine, const GUID &key) {
+    { engine.filterByKey(key) } -> std::same_as<std::shared_ptr<FWPM_FILTER>>;
+    { engine.deleteFilterByKey(key) } -> std::same_as<DWORD>;
+};
+
+// An engine whose installed filters can be enumerated a layer at a time, optionally
+// only those the BFE selects for a query
+template <typename EngineT>
+concept FilterEnumerableEngine =
+    requires(EngineT &engine, const GUID &layerKey, const FilterQuery &query) {
+        engine.enumerateFiltersForLayer(layerKey, [](std::shared_ptr<FWPM_FILTER>) {});
+        engine.enumerateFiltersForLayer(layerKey, [](std::shared_ptr<FWPM_FILTER>) {}, query);
+    };
+
+// An engine that providers can be added to, deleted from and read back.
+// wfpk uses its own providers' providerData for bookkeeping (see FingerprintStore)
+template <typename EngineT>
+concept ProviderEngine =
+    requires(EngineT &engine, const FWPM_PROVIDER &provider, const GUID &providerKey) {
+        { engine.tryAddProvider(provider) } -> std::same_as<DWORD>;
+        { engine.deleteProviderByKey(providerKey) } -> std::same_as<DWORD>;
+        { engine.providerData(providerKey) } -> std::same_as<std::optional<std::vector<UINT8>>>;
+    };
+
+// An engine that sublayers can be added to and deleted from
+template <typename EngineT>
+concept SubLayerEngine =
+    requires(EngineT &engine, const FWPM_SUBLAYER &subLayer, const GUID &subLayerKey) {
+        { engine.tryAddSubLayer(subLayer) } -> std::same_as<DWORD>;
+        { engine.deleteSubLayerByKey(subLayerKey) } -> std::same_as<DWORD>;
+        { engine.subLayerWeight(subLayerKey) } -> std::same_as<std::optional<UINT16>>;
+    };
+
+// An engine that notifies changes to its objects, and whose filters can be fetched by
+// the id a change carries
+template <typename EngineT>
+concept ChangeNotifyingEngine =
+    requires(EngineT &engine, ChangeCallback callback, FilterId filterId) {
+        { engine.subscribeChanges(std::move(callback)) } -> std::same_as<ChangeSubscription>;
+        { engine.filterById(filterId) } -> std::same_as<std::shared_ptr<FWPM_FILTER>>;
+    };
+}
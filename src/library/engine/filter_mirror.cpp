@@ -0,0 +1,259 @@
+#include <engine/filter_mirror.h>
+#include <stdexcept>
+#include <cstring>
+
+namespace wfpk
+{
+namespace
+{
+template <typename T> size_t capacityBytes(const std::vector<T> &column)
+{
+    return column.capacity() * sizeof(T);
+}
+
+// A SID's revision and sub-authority count, its 6-byte authority, then 4 bytes per
+// sub-authority (as GetLengthSid() works out)
+size_t sidLength(const SID *pSid)
+{
+    const auto subAuthorityCount = reinterpret_cast<const UINT8 *>(pSid)[1];
+    return 8 + 4 * size_t{subAuthorityCount};
+}
+}
+
+auto FilterMirror::KeyTable::intern(const GUID &key) -> KeyIndex
+{
+    auto [it, isNew] = indices.try_emplace(key, static_cast<KeyIndex>(keys.size()));
+    if(isNew)
+    {
+        if(keys.size() >= NoKey)
+        {
+            indices.erase(it);
+            throw std::length_error{"Too many distinct keys to mirror"};
+        }
+        keys.push_back(key);
+    }
+    return it->second;
+}
+
+auto FilterMirror::KeyTable::find(const GUID &key) const -> KeyIndex
+{
+    auto it = indices.find(key);
+    return it != indices.end() ? it->second : NoKey;
+}
+
+size_t FilterMirror::KeyTable::bytesUsed() const
+{
+    // Roughly a node per key, plus the bucket array
+    return capacityBytes(keys) +
+           indices.size() * (sizeof(std::pair<const GUID, KeyIndex>) + 2 * sizeof(void *)) +
+           indices.bucket_count() * sizeof(void *);
+}
+
+void FilterMirror::reserve(size_t filterCount)
+{
+    _ids.reserve(filterCount);
+    _keys.reserve(filterCount);
+    _weights.reserve(filterCount);
+    _weightTypes.reserve(filterCount);
+    _effectiveWeights.reserve(filterCount);
+    _actions.reserve(filterCount);
+    _flags.reserve(filterCount);
+    _layers.reserve(filterCount);
+    _subLayers.reserve(filterCount);
+    _providers.reserve(filterCount);
+    _callouts.reserve(filterCount);
+    _conditionOffsets.reserve(filterCount + 1);
+}
+
+auto FilterMirror::add(const FWPM_FILTER &filter) -> Row
+{
+    // Interned first, so a full table leaves the mirror unchanged
+    const auto layer = _layerTable.intern(filter.layerKey);
+    const auto subLayer = _subLayerTable.intern(filter.subLayerKey);
+    const auto provider =
+        filter.providerKey ? _providerTable.intern(*filter.providerKey) : NoKey;
+    const auto callout = filter.action.type & FWP_ACTION_FLAG_CALLOUT
+                             ? _calloutTable.intern(filter.action.calloutKey)
+                             : NoKey;
+
+    const auto row = static_cast<Row>(_ids.size());
+    _ids.push_back(filter.filterId);
+    _keys.push_back(filter.filterKey);
+    _actions.push_back(filter.action.type);
+    _flags.push_back(filter.flags);
+    _layers.push_back(layer);
+    _subLayers.push_back(subLayer);
+    _providers.push_back(provider);
+    _callouts.push_back(callout);
+
+    _weightTypes.push_back(static_cast<UINT8>(filter.weight.type));
+    switch(filter.weight.type)
+    {
+        case FWP_UINT8: _weights.push_back(filter.weight.uint8); break;
+        case FWP_UINT64:
+            _weights.push_back(filter.weight.uint64 ? *filter.weight.uint64 : 0);
+            break;
+        default: _weights.push_back(0);
+    }
+    _effectiveWeights.push_back(
+        filter.effectiveWeight.type == FWP_UINT64 && filter.effectiveWeight.uint64
+            ? *filter.effectiveWeight.uint64
+            : 0);
+
+    for(UINT32 i = 0; i < filter.numFilterConditions; ++i)
+    {
+        const auto &condition = filter.filterCondition[i];
+        _conditions.push_back(
+            {condition.fieldKey, condition.matchType, copyValue(condition.conditionValue)});
+    }
+    _conditionOffsets.push_back(static_cast<UINT32>(_conditions.size()));
+
+    return row;
+}
+
+auto FilterMirror::select(const FilterQuery &query) const -> std::vector<Row>
+{
+    std::vector<Row> rows;
+
+    KeyIndex provider{NoKey};
+    if(query.providerKey)
+    {
+        provider = _providerTable.find(*query.providerKey);
+        if(provider == NoKey)
+        {
+            // No filter here has the provider
+            return rows;
+        }
+    }
+
+    for(Row row = 0; row < _ids.size(); ++row)
+    {
+        if(query.providerKey && _providers[row] != provider)
+        {
+            continue;
+        }
+        if(!query.actionTypes.empty() &&
+           std::ranges::find(query.actionTypes, _actions[row]) == query.actionTypes.end())
+        {
+            continue;
+        }
+        rows.push_back(row);
+    }
+
+    return rows;
+}
+
+auto FilterMirror::filter(Row row) const -> FWPM_FILTER
+{
+    FWPM_FILTER filter{};
+    filter.filterId = _ids[row];
+    filter.filterKey = _keys[row];
+    filter.flags = _flags[row];
+    filter.layerKey = _layerTable.keys[_layers[row]];
+    filter.subLayerKey = _subLayerTable.keys[_subLayers[row]];
+    if(_providers[row] != NoKey)
+    {
+        filter.providerKey = const_cast<GUID *>(&_providerTable.keys[_providers[row]]);
+    }
+
+    filter.action.type = _actions[row];
+    if(_callouts[row] != NoKey)
+    {
+        filter.action.calloutKey = _calloutTable.keys[_callouts[row]];
+    }
+
+    filter.weight.type = static_cast<FWP_DATA_TYPE>(_weightTypes[row]);
+    if(filter.weight.type == FWP_UINT64)
+    {
+        filter.weight.uint64 = const_cast<UINT64 *>(&_weights[row]);
+    }
+    else if(filter.weight.type == FWP_UINT8)
+    {
+        filter.weight.uint8 = static_cast<UINT8>(_weights[row]);
+    }
+    if(_effectiveWeights[row])
+    {
+        filter.effectiveWeight.type = FWP_UINT64;
+        filter.effectiveWeight.uint64 = const_cast<UINT64 *>(&_effectiveWeights[row]);
+    }
+
+    const auto rowConditions = conditions(row);
+    filter.numFilterConditions = static_cast<UINT32>(rowConditions.size());
+    if(!rowConditions.empty())
+    {
+        filter.filterCondition = const_cast<FWPM_FILTER_CONDITION *>(rowConditions.data());
+    }
+
+    return filter;
+}
+
+size_t FilterMirror::bytesUsed() const
+{
+    return capacityBytes(_ids) + capacityBytes(_keys) + capacityBytes(_weights) +
+           capacityBytes(_weightTypes) + capacityBytes(_effectiveWeights) +
+           capacityBytes(_actions) + capacityBytes(_flags) + capacityBytes(_layers) +
+           capacityBytes(_subLayers) + capacityBytes(_providers) + capacityBytes(_callouts) +
+           capacityBytes(_conditionOffsets) + capacityBytes(_conditions) +
+           _layerTable.bytesUsed() + _subLayerTable.bytesUsed() + _providerTable.bytesUsed() +
+           _calloutTable.bytesUsed() + _arena.bytesUsed();
+}
+
+auto FilterMirror::copyValue(const FWP_CONDITION_VALUE &value) -> FWP_CONDITION_VALUE
+{
+    FWP_CONDITION_VALUE copy{value};
+    switch(value.type)
+    {
+        case FWP_V4_ADDR_MASK: copy.v4AddrMask = _arena.copy(*value.v4AddrMask); break;
+        case FWP_V6_ADDR_MASK: copy.v6AddrMask = _arena.copy(*value.v6AddrMask); break;
+        case FWP_RANGE_TYPE:
+            copy.rangeValue = _arena.copy(FWP_RANGE{copyValue(value.rangeValue->valueLow),
+                                                    copyValue(value.rangeValue->valueHigh)});
+            break;
+        default: {
+            // The remaining types are laid out as in FWP_VALUE
+            FWP_VALUE single{};
+            std::memcpy(&single, &value, sizeof(single));
+            single = copyValue(single);
+            std::memcpy(&copy, &single, sizeof(single));
+        }
+    }
+    return copy;
+}
+
+auto FilterMirror::copyValue(const FWP_VALUE &value) -> FWP_VALUE
+{
+    FWP_VALUE copy{value};
+    auto copyBlob = [&](const FWP_BYTE_BLOB *pBlob) {
+        return _arena.copy(FWP_BYTE_BLOB{
+            pBlob->size, _arena.copyArray(std::span<const UINT8>{pBlob->data, pBlob->size})});
+    };
+
+    switch(value.type)
+    {
+        case FWP_UINT64: copy.uint64 = _arena.copy(*value.uint64); break;
+        case FWP_INT64: copy.int64 = _arena.copy(*value.int64); break;
+        case FWP_DOUBLE: copy.double64 = _arena.copy(*value.double64); break;
+        case FWP_BYTE_ARRAY16_TYPE: copy.byteArray16 = _arena.copy(*value.byteArray16); break;
+        case FWP_BYTE_ARRAY6_TYPE: copy.byteArray6 = _arena.copy(*value.byteArray6); break;
+        case FWP_BYTE_BLOB_TYPE: copy.byteBlob = copyBlob(value.byteBlob); break;
+        case FWP_SECURITY_DESCRIPTOR_TYPE: copy.sd = copyBlob(value.sd); break;
+        case FWP_SID: {
+            // Sub-authorities are DWORDs, so keep the copy DWORD aligned
+            const size_t length = sidLength(value.sid);
+            auto *pSid = _arena.allocate<UINT32>((length + 3) / 4);
+            std::memcpy(pSid, value.sid, length);
+            copy.sid = reinterpret_cast<SID *>(pSid);
+            break;
+        }
+        case FWP_UNICODE_STRING_TYPE: {
+            const std::wstring_view str{value.unicodeString};
+            // Include the null terminator
+            copy.unicodeString = _arena.copyArray(std::span{str.data(), str.size() + 1});
+            break;
+        }
+        // Held inline
+        default: break;
+    }
+    return copy;
+}
+}
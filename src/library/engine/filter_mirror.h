@@ -0,0 +1,157 @@
+#pragma once
+
+#include <wfp_objects.h>
+#include <apply/arena.h>
+#include <span>
+
+namespace wfpk
+{
+// A compact copy of a set of enumerated filters, decoded into a column per field - so
+// the enumerated pages can be released, and listing, searching, diffing and deleting
+// scan a few dense arrays instead of chasing pointers through BFE allocations.
+//
+// Layers, sublayers, providers and callouts are interned: each filter holds a 16-bit
+// index into a table of distinct keys, so a question about a provider (e.g whether its
+// name matches) is answered once per provider rather than once per filter. Conditions
+// are packed end to end in one pool, their payloads in an arena.
+//
+// A filter takes 61 bytes of columns plus 40 per condition and its payload - against
+// an enumerated filter's 232 byte FWPM_FILTER, its display strings, provider data and
+// the page pointer and shared_ptr held for it (see filter_mirror_benchmark).
+// Display and provider data aren't mirrored.
+class FilterMirror
+{
+public:
+    // A filter's position in the mirror, in the order filters were added
+    using Row = UINT32;
+    // An index into one of the key tables
+    using KeyIndex = UINT16;
+    // The provider (or callout) index of a filter without one
+    static constexpr KeyIndex NoKey = 0xFFFF;
+
+public:
+    FilterMirror() = default;
+    FilterMirror(FilterMirror &&) = default;
+    FilterMirror &operator=(FilterMirror &&) = default;
+    FilterMirror(const FilterMirror &) = delete;
+    FilterMirror &operator=(const FilterMirror &) = delete;
+
+public:
+    void reserve(size_t filterCount);
+    // Decode a filter into a new row, copying everything it points to.
+    // Throws a std::length_error if a key table is full.
+    auto add(const FWPM_FILTER &filter) -> Row;
+
+    size_t size() const
+    {
+        return _ids.size();
+    }
+    bool empty() const
+    {
+        return _ids.empty();
+    }
+
+    // Columns, indexed by row
+    auto ids() const -> std::span<const FilterId>
+    {
+        return _ids;
+    }
+    auto keys() const -> std::span<const GUID>
+    {
+        return _keys;
+    }
+    // The weight as requested - a uint8 weight is widened - and its FWP_DATA_TYPE
+    auto weights() const -> std::span<const UINT64>
+    {
+        return _weights;
+    }
+    auto weightTypes() const -> std::span<const UINT8>
+    {
+        return _weightTypes;
+    }
+    auto actions() const -> std::span<const FWP_ACTION_TYPE>
+    {
+        return _actions;
+    }
+    auto layerIndices() const -> std::span<const KeyIndex>
+    {
+        return _layers;
+    }
+    auto subLayerIndices() const -> std::span<const KeyIndex>
+    {
+        return _subLayers;
+    }
+    auto providerIndices() const -> std::span<const KeyIndex>
+    {
+        return _providers;
+    }
+    auto conditions(Row row) const -> std::span<const FWPM_FILTER_CONDITION>
+    {
+        return std::span{_conditions}.subspan(
+            _conditionOffsets[row], _conditionOffsets[row + 1] - _conditionOffsets[row]);
+    }
+
+    // The distinct keys, indexed by the index columns
+    auto layerKeys() const -> std::span<const GUID>
+    {
+        return _layerTable.keys;
+    }
+    auto subLayerKeys() const -> std::span<const GUID>
+    {
+        return _subLayerTable.keys;
+    }
+    auto providerKeys() const -> std::span<const GUID>
+    {
+        return _providerTable.keys;
+    }
+
+    // The rows matching a query exactly (see FilterQuery::matches()), in row order
+    auto select(const FilterQuery &query) const -> std::vector<Row>;
+
+    // A row's filter, rebuilt with its pointers into the mirror - valid until the
+    // mirror is next changed
+    auto filter(Row row) const -> FWPM_FILTER;
+
+    // Heap bytes held: every column's capacity, the key tables and the arena
+    size_t bytesUsed() const;
+
+private:
+    struct KeyTable
+    {
+        std::vector<GUID> keys;
+        std::unordered_map<GUID, KeyIndex> indices;
+
+        KeyIndex intern(const GUID &key);
+        // NoKey if the table doesn't hold the key
+        KeyIndex find(const GUID &key) const;
+        size_t bytesUsed() const;
+    };
+
+    auto copyValue(const FWP_CONDITION_VALUE &value) -> FWP_CONDITION_VALUE;
+    auto copyValue(const FWP_VALUE &value) -> FWP_VALUE;
+
+private:
+    std::vector<FilterId> _ids;
+    std::vector<GUID> _keys;
+    // The weight as requested - a uint8 weight is widened - and its type
+    std::vector<UINT64> _weights;
+    std::vector<UINT8> _weightTypes;
+    // The weight the BFE assigned, 0 if the filter wasn't enumerated from the BFE
+    std::vector<UINT64> _effectiveWeights;
+    std::vector<FWP_ACTION_TYPE> _actions;
+    std::vector<UINT32> _flags;
+    std::vector<KeyIndex> _layers;
+    std::vector<KeyIndex> _subLayers;
+    std::vector<KeyIndex> _providers;
+    std::vector<KeyIndex> _callouts;
+    // Row i's conditions are _conditions[_conditionOffsets[i], _conditionOffsets[i + 1])
+    std::vector<UINT32> _conditionOffsets{0};
+    std::vector<FWPM_FILTER_CONDITION> _conditions;
+    KeyTable _layerTable;
+    KeyTable _subLayerTable;
+    KeyTable _providerTable;
+    KeyTable _calloutTable;
+    // Condition payloads
+    Arena _arena;
+};
+}
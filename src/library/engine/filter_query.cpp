@@ -0,0 +1,58 @@
+#include <engine/filter_query.h>
+
+namespace wfpk
+{
+namespace
+{
+// The bits that tell an action type apart (the rest are flags shared between types)
+constexpr UINT32 kActionTypeBits = 0xFFF;
+// Passes every action type
+constexpr UINT32 kAllActions = 0xFFFFFFFF;
+}
+
+auto FilterQuery::enumTemplate(const GUID &layerKey) const -> FWPM_FILTER_ENUM_TEMPLATE
+{
+    FWPM_FILTER_ENUM_TEMPLATE enumTemplate{};
+    // Every filter in the layer, not just those overlapping some conditions
+    enumTemplate.enumType = FWP_FILTER_ENUM_OVERLAPPING;
+    enumTemplate.layerKey = layerKey;
+    enumTemplate.providerKey = providerKey ? const_cast<GUID *>(&*providerKey) : nullptr;
+
+    // An action type passes if it shares a bit with the mask, so pass only each wanted
+    // type's distinguishing bits - the flag bits are shared by (almost) every type
+    enumTemplate.actionMask = actionTypes.empty() ? kAllActions : 0;
+    for(const auto actionType : actionTypes)
+    {
+        enumTemplate.actionMask |= actionType & kActionTypeBits;
+    }
+
+    return enumTemplate;
+}
+
+bool FilterQuery::matches(const FWPM_FILTER &filter) const
+{
+    if(providerKey && !(filter.providerKey && *filter.providerKey == *providerKey))
+    {
+        return false;
+    }
+
+    return actionTypes.empty() ||
+           std::ranges::find(actionTypes, filter.action.type) != actionTypes.end();
+}
+
+bool enumTemplateMatches(const FWPM_FILTER_ENUM_TEMPLATE &enumTemplate,
+                         const FWPM_FILTER &filter)
+{
+    if(filter.layerKey != enumTemplate.layerKey)
+    {
+        return false;
+    }
+    if(enumTemplate.providerKey &&
+       !(filter.providerKey && *filter.providerKey == *enumTemplate.providerKey))
+    {
+        return false;
+    }
+
+    return (filter.action.type & enumTemplate.actionMask) != 0;
+}
+}
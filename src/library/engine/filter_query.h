@@ -0,0 +1,37 @@
+#pragma once
+
+#include <utils.h>
+
+namespace wfpk
+{
+// Selects the filters of a layer, by what the BFE can select them by itself - so that
+// filters that can't match aren't transferred at all.
+//
+// The BFE's selection is coarser than the query: a template's actionMask passes any
+// action sharing a bit with it, so the BFE's matches are a superset. Callers check
+// what's transferred against matches() for the exact result.
+struct FilterQuery
+{
+    // Only filters added by this provider
+    std::optional<GUID> providerKey;
+    // Only filters taking one of these actions (e.g FWP_ACTION_BLOCK) - empty for any
+    std::vector<FWP_ACTION_TYPE> actionTypes;
+
+    // The enumeration template selecting layerKey's filters, with as much of the query
+    // pushed into it as it can express. It refers to this query, which must outlive it.
+    auto enumTemplate(const GUID &layerKey) const -> FWPM_FILTER_ENUM_TEMPLATE;
+    // Whether a filter matches the query exactly
+    bool matches(const FWPM_FILTER &filter) const;
+
+    bool isEmpty() const
+    {
+        return !providerKey && actionTypes.empty();
+    }
+};
+
+// Whether the BFE would enumerate a filter with the given template - for stand-ins
+// that model the BFE (see MemoryEngine). Only the layer, provider and action mask are
+// modeled.
+bool enumTemplateMatches(const FWPM_FILTER_ENUM_TEMPLATE &enumTemplate,
+                         const FWPM_FILTER &filter);
+}
@@ -0,0 +1,44 @@
+#include <engine/live_filter_mirror.h>
+
+namespace wfpk
+{
+void ChangeQueue::push(const ObjectChange &change)
+{
+    std::lock_guard lock{_mutex};
+    if(_changes.size() >= _capacity)
+    {
+        // Everything's reloaded anyway, so there's no use keeping what's queued
+        _changes.clear();
+        _missedChanges = true;
+    }
+    if(!_missedChanges)
+    {
+        _changes.push_back(change);
+    }
+}
+
+auto ChangeQueue::take() -> std::optional<std::vector<ObjectChange>>
+{
+    std::lock_guard lock{_mutex};
+    if(std::exchange(_missedChanges, false))
+    {
+        _changes.clear();
+        return {};
+    }
+    return std::exchange(_changes, {});
+}
+
+void ChangeQueue::clear()
+{
+    std::lock_guard lock{_mutex};
+    _changes.clear();
+    _missedChanges = false;
+}
+
+void ChangeQueue::markMissed()
+{
+    std::lock_guard lock{_mutex};
+    _changes.clear();
+    _missedChanges = true;
+}
+}
@@ -0,0 +1,293 @@
+#pragma once
+
+#include <engine/engine_concepts.h>
+#include <engine/filter_mirror.h>
+#include <mutex>
+
+namespace wfpk
+{
+// Changes notified on the BFE's threads, waiting to be applied on the mirror's own.
+// It holds at most `capacity` changes - once full, further changes are discarded and
+// the next take() reports that some were missed.
+class ChangeQueue
+{
+public:
+    explicit ChangeQueue(size_t capacity)
+        : _capacity{capacity}
+    {}
+
+public:
+    // Thread-safe, called from change callbacks
+    void push(const ObjectChange &change);
+    // The changes queued since the last take(), in the order they were notified - or
+    // nullopt if any were discarded
+    auto take() -> std::optional<std::vector<ObjectChange>>;
+    // Discard everything queued so far (the changes are reloaded instead)
+    void clear();
+    // Report changes as missed on the next take()
+    void markMissed();
+
+private:
+    std::mutex _mutex;
+    std::vector<ObjectChange> _changes;
+    size_t _capacity;
+    bool _missedChanges{false};
+};
+
+// The filters of a set of layers, loaded into a FilterMirror once and then kept current
+// by the engine's change notifications - so a long-lived wfpk (e.g monitor) answers
+// questions about installed filters from memory instead of re-enumerating them.
+//
+// Notifications only say which object changed, so they're queued as they arrive and
+// applied by sync(): a deleted filter's row is dropped, an added filter is fetched by
+// id (and kept if it's in one of the layers). Subscribing before loading means changes
+// racing the load are applied after it, and applying one twice is harmless.
+//
+// Changes can still be missed - the queue can overflow, or the BFE drop notifications
+// - so sync() reloads everything when the queue reports it, and resync() does so on
+// demand. Each time the mirrored filters change their epoch does too: rows, and the
+// filters read from them, are only valid for the epoch they were read in.
+//
+// Only the queue is thread-safe - sync() and reads must not run concurrently.
+template <typename EngineT>
+    requires FilterEnumerableEngine<EngineT> && ChangeNotifyingEngine<EngineT>
+class LiveFilterMirror
+{
+public:
+    using Row = FilterMirror::Row;
+
+    enum : size_t
+    {
+        DefaultQueueCapacity = 64 * 1024
+    };
+
+public:
+    // Subscribes to the engine's changes, then loads the layers' filters.
+    // Throws if either fails.
+    LiveFilterMirror(EngineT &engine, std::vector<GUID> layerKeys,
+                     size_t queueCapacity = DefaultQueueCapacity)
+        : _engine{engine}
+        , _layerKeys{std::move(layerKeys)}
+        , _queue{queueCapacity}
+        , _subscription{_engine.subscribeChanges(
+              [this](const ObjectChange &change) { _queue.push(change); })}
+    {
+        _contents = load();
+    }
+    LiveFilterMirror(LiveFilterMirror &&) = delete;
+    LiveFilterMirror(const LiveFilterMirror &) = delete;
+    LiveFilterMirror &operator=(const LiveFilterMirror &) = delete;
+    LiveFilterMirror &operator=(LiveFilterMirror &&) = delete;
+
+public:
+    // Apply the changes notified since the last sync, or reload everything if any were
+    // missed. Returns the filter epoch after applying them.
+    // Throws if an added filter can't be fetched, or a reload fails - the changes not
+    // yet applied are then reloaded by the next sync().
+    auto sync() -> UINT64
+    {
+        auto changes = _queue.take();
+        if(!changes)
+        {
+            resync();
+            return _filterEpoch;
+        }
+
+        bool filtersChanged{false};
+        try
+        {
+            for(const auto &change : *changes)
+            {
+                switch(change.kind)
+                {
+                    case ObjectKind::Filter: filtersChanged |= apply(change); break;
+                    case ObjectKind::Provider: ++_providerEpoch; break;
+                    case ObjectKind::SubLayer: ++_subLayerEpoch; break;
+                }
+            }
+        }
+        catch(...)
+        {
+            // The rest of the changes were taken, so reload rather than lose them
+            _queue.markMissed();
+            ++_filterEpoch;
+            throw;
+        }
+
+        if(filtersChanged)
+        {
+            compactIfSparse();
+            ++_filterEpoch;
+        }
+        return _filterEpoch;
+    }
+
+    // Reload every filter, discarding the changes queued so far
+    void resync()
+    {
+        _queue.clear();
+        try
+        {
+            _contents = load();
+        }
+        catch(...)
+        {
+            // Changes made since the clear were queued, but not the ones before it
+            _queue.markMissed();
+            throw;
+        }
+
+        ++_filterEpoch;
+        ++_providerEpoch;
+        ++_subLayerEpoch;
+        ++_resyncCount;
+    }
+
+    // Changes each time the mirrored filters do (see sync()), invalidating their rows
+    UINT64 filterEpoch() const
+    {
+        return _filterEpoch;
+    }
+    // Change each time a provider or sublayer is added or deleted - anything known about
+    // them (e.g their names) may be out of date
+    UINT64 providerEpoch() const
+    {
+        return _providerEpoch;
+    }
+    UINT64 subLayerEpoch() const
+    {
+        return _subLayerEpoch;
+    }
+    // Reloads, including those sync() made after missing changes
+    size_t resyncCount() const
+    {
+        return _resyncCount;
+    }
+
+    // The number of filters mirrored
+    size_t size() const
+    {
+        return _contents.rowsById.size();
+    }
+    bool contains(FilterId filterId) const
+    {
+        return _contents.rowsById.contains(filterId);
+    }
+
+    // A filter by id, or nullopt if it isn't mirrored - it points into the mirror, so
+    // is only valid until the next sync()
+    auto find(FilterId filterId) const -> std::optional<FWPM_FILTER>
+    {
+        auto it = _contents.rowsById.find(filterId);
+        if(it == _contents.rowsById.end())
+        {
+            return {};
+        }
+        return _contents.mirror.filter(it->second);
+    }
+
+    // The rows of the filters matching a query exactly, in row order
+    auto select(const FilterQuery &query) const -> std::vector<Row>
+    {
+        auto rows = _contents.mirror.select(query);
+        std::erase_if(rows, [&](Row row) { return !_contents.isLive[row]; });
+        return rows;
+    }
+    auto filter(Row row) const -> FWPM_FILTER
+    {
+        assert(_contents.isLive[row]); // pre-condition
+        return _contents.mirror.filter(row);
+    }
+
+private:
+    // The mirror, and which of its rows are filters still installed
+    struct Contents
+    {
+        FilterMirror mirror;
+        std::unordered_map<FilterId, Row> rowsById;
+        std::vector<bool> isLive;
+
+        void insert(const FWPM_FILTER &filter)
+        {
+            rowsById.emplace(filter.filterId, mirror.add(filter));
+            isLive.push_back(true);
+        }
+    };
+
+    auto load() const -> Contents
+    {
+        Contents contents;
+        for(const auto &layerKey : _layerKeys)
+        {
+            _engine.enumerateFiltersForLayer(
+                layerKey, [&](std::shared_ptr<FWPM_FILTER> pFilter) { contents.insert(*pFilter); });
+        }
+        return contents;
+    }
+
+    // Returns whether the mirrored filters changed
+    bool apply(const ObjectChange &change)
+    {
+        if(change.type == FWPM_CHANGE_DELETE)
+        {
+            auto it = _contents.rowsById.find(change.filterId);
+            // Not in our layers, or deleted before it was loaded
+            if(it == _contents.rowsById.end())
+            {
+                return false;
+            }
+            _contents.isLive[it->second] = false;
+            _contents.rowsById.erase(it);
+            return true;
+        }
+
+        // Loaded already - it was added while the layers were being enumerated
+        if(_contents.rowsById.contains(change.filterId))
+        {
+            return false;
+        }
+        auto pFilter = _engine.filterById(change.filterId);
+        // Deleted since - and its delete is queued too
+        if(!pFilter || std::ranges::find(_layerKeys, pFilter->layerKey) == _layerKeys.end())
+        {
+            return false;
+        }
+        _contents.insert(*pFilter);
+        return true;
+    }
+
+    // Deleted rows are only skipped, so the mirror is rebuilt from the live ones once
+    // they're outnumbered
+    void compactIfSparse()
+    {
+        const size_t liveRows = _contents.rowsById.size();
+        if(_contents.isLive.size() - liveRows <= liveRows)
+        {
+            return;
+        }
+
+        Contents compacted;
+        compacted.mirror.reserve(liveRows);
+        for(Row row = 0; row < _contents.isLive.size(); ++row)
+        {
+            if(_contents.isLive[row])
+            {
+                compacted.insert(_contents.mirror.filter(row));
+            }
+        }
+        _contents = std::move(compacted);
+    }
+
+private:
+    EngineT &_engine;
+    std::vector<GUID> _layerKeys;
+    ChangeQueue _queue;
+    Contents _contents;
+    UINT64 _filterEpoch{1};
+    UINT64 _providerEpoch{1};
+    UINT64 _subLayerEpoch{1};
+    size_t _resyncCount{0};
+    // Last, so it's destroyed - and changes stop - before the queue is
+    ChangeSubscription _subscription;
+};
+}
@@ -0,0 +1,393 @@
+#include <winsock2.h>
+#include <engine/memory_engine.h>
+
+namespace wfpk
+{
+namespace
+{
+using Payloads = std::vector<std::shared_ptr<void>>;
+
+template <typename T> T *keep(Payloads &payloads, const T &value)
+{
+    auto pValue = std::make_shared<T>(value);
+    payloads.push_back(pValue);
+    return pValue.get();
+}
+
+FWP_BYTE_BLOB *keepBlob(Payloads &payloads, const FWP_BYTE_BLOB &blob)
+{
+    auto pData = std::shared_ptr<UINT8[]>{new UINT8[blob.size]};
+    std::copy_n(blob.data, blob.size, pData.get());
+    payloads.push_back(pData);
+
+    return keep(payloads, FWP_BYTE_BLOB{blob.size, pData.get()});
+}
+
+// Deep copy the pointed-to data of a value so it no longer refers to caller storage.
+// FWP_VALUE and FWP_CONDITION_VALUE share the same layout for the types below.
+template <typename ValueT> void copyValue(Payloads &payloads, ValueT &value)
+{
+    switch(value.type)
+    {
+        case FWP_UINT64: value.uint64 = keep(payloads, *value.uint64); break;
+        case FWP_INT64: value.int64 = keep(payloads, *value.int64); break;
+        case FWP_DOUBLE: value.double64 = keep(payloads, *value.double64); break;
+        case FWP_BYTE_ARRAY16_TYPE: value.byteArray16 = keep(payloads, *value.byteArray16); break;
+        case FWP_BYTE_ARRAY6_TYPE: value.byteArray6 = keep(payloads, *value.byteArray6); break;
+        case FWP_BYTE_BLOB_TYPE: value.byteBlob = keepBlob(payloads, *value.byteBlob); break;
+        case FWP_SECURITY_DESCRIPTOR_TYPE: value.sd = keepBlob(payloads, *value.sd); break;
+        case FWP_UNICODE_STRING_TYPE: {
+            auto pString = std::make_shared<std::wstring>(value.unicodeString);
+            payloads.push_back(pString);
+            value.unicodeString = pString->data();
+            break;
+        }
+        default: break;
+    }
+}
+}
+
+auto MemoryEngine::copyFilter(const FWPM_FILTER &filter) -> std::shared_ptr<StoredFilter>
+{
+    auto pStored = std::make_shared<StoredFilter>();
+    auto &copy = pStored->filter;
+    auto &payloads = pStored->payloads;
+
+    copy = filter;
+
+    if(filter.displayData.name)
+    {
+        pStored->name = filter.displayData.name;
+    }
+    if(filter.displayData.description)
+    {
+        pStored->description = filter.displayData.description;
+    }
+    copy.displayData.name = pStored->name.data();
+    copy.displayData.description = pStored->description.data();
+
+    if(filter.providerKey)
+    {
+        pStored->providerKey = *filter.providerKey;
+        copy.providerKey = &pStored->providerKey;
+    }
+
+    if(filter.providerData.size > 0)
+    {
+        copy.providerData = *keepBlob(payloads, filter.providerData);
+    }
+
+    copyValue(payloads, copy.weight);
+    copy.effectiveWeight = copy.weight;
+
+    pStored->conditions.assign(filter.filterCondition,
+                               filter.filterCondition + filter.numFilterConditions);
+    for(auto &condition : pStored->conditions)
+    {
+        auto &value = condition.conditionValue;
+        switch(value.type)
+        {
+            case FWP_V4_ADDR_MASK: value.v4AddrMask = keep(payloads, *value.v4AddrMask); break;
+            case FWP_V6_ADDR_MASK: value.v6AddrMask = keep(payloads, *value.v6AddrMask); break;
+            case FWP_RANGE_TYPE: {
+                auto pRange = keep(payloads, *value.rangeValue);
+                copyValue(payloads, pRange->valueLow);
+                copyValue(payloads, pRange->valueHigh);
+                value.rangeValue = pRange;
+                break;
+            }
+            default: copyValue(payloads, value);
+        }
+    }
+    copy.filterCondition = pStored->conditions.empty() ? nullptr : pStored->conditions.data();
+
+    return pStored;
+}
+
+DWORD MemoryEngine::tryAdd(const FWPM_FILTER &filter, FilterId &id)
+{
+    ++_roundTrips;
+
+    if(_addsUntilFailure)
+    {
+        if(*_addsUntilFailure == 0)
+        {
+            _addsUntilFailure.reset();
+            return _injectedError;
+        }
+        --*_addsUntilFailure;
+    }
+
+    if(filter.numFilterConditions > 0 && !filter.filterCondition)
+    {
+        return ERROR_INVALID_PARAMETER;
+    }
+
+    auto pStored = copyFilter(filter);
+    auto &copy = pStored->filter;
+
+    // The BFE generates a key when none is given
+    if(copy.filterKey == ZeroGuid)
+    {
+        copy.filterKey.Data1 = static_cast<unsigned long>(_nextFilterId);
+        copy.filterKey.Data2 = 0xfeed;
+    }
+
+    if(_state.idsByKey.contains(copy.filterKey))
+    {
+        return FWP_E_ALREADY_EXISTS;
+    }
+
+    copy.filterId = _nextFilterId++;
+    _state.idsByKey.emplace(copy.filterKey, copy.filterId);
+    _state.filters.emplace(copy.filterId, std::move(pStored));
+
+    id = copy.filterId;
+    notify({ObjectKind::Filter, FWPM_CHANGE_ADD, copy.filterKey, id});
+
+    return ERROR_SUCCESS;
+}
+
+DWORD MemoryEngine::deleteFilterById(FilterId filterId)
+{
+    ++_roundTrips;
+
+    auto it = _state.filters.find(filterId);
+    if(it == _state.filters.end())
+    {
+        return FWP_E_FILTER_NOT_FOUND;
+    }
+
+    const GUID filterKey = it->second->filter.filterKey;
+    _state.idsByKey.erase(filterKey);
+    _state.filters.erase(it);
+    notify({ObjectKind::Filter, FWPM_CHANGE_DELETE, filterKey, filterId});
+
+    return ERROR_SUCCESS;
+}
+
+DWORD MemoryEngine::deleteFilterByKey(const GUID &filterKey)
+{
+    ++_roundTrips;
+
+    auto it = _state.idsByKey.find(filterKey);
+    if(it == _state.idsByKey.end())
+    {
+        return FWP_E_FILTER_NOT_FOUND;
+    }
+
+    const FilterId filterId = it->second;
+    _state.filters.erase(filterId);
+    _state.idsByKey.erase(it);
+    notify({ObjectKind::Filter, FWPM_CHANGE_DELETE, filterKey, filterId});
+
+    return ERROR_SUCCESS;
+}
+
+DWORD MemoryEngine::tryAddProvider(const FWPM_PROVIDER &provider)
+{
+    ++_roundTrips;
+
+    const auto &data = provider.providerData;
+    const bool added =
+        _state.providers.try_emplace(provider.providerKey, data.data, data.data + data.size)
+            .second;
+    if(!added)
+    {
+        return FWP_E_ALREADY_EXISTS;
+    }
+
+    notify({ObjectKind::Provider, FWPM_CHANGE_ADD, provider.providerKey});
+    return ERROR_SUCCESS;
+}
+
+DWORD MemoryEngine::deleteProviderByKey(const GUID &providerKey)
+{
+    ++_roundTrips;
+
+    if(_state.providers.erase(providerKey) == 0)
+    {
+        return FWP_E_PROVIDER_NOT_FOUND;
+    }
+
+    notify({ObjectKind::Provider, FWPM_CHANGE_DELETE, providerKey});
+    return ERROR_SUCCESS;
+}
+
+auto MemoryEngine::providerData(const GUID &providerKey) -> std::optional<std::vector<UINT8>>
+{
+    ++_roundTrips;
+
+    auto it = _state.providers.find(providerKey);
+    if(it == _state.providers.end())
+    {
+        return {};
+    }
+
+    return it->second;
+}
+
+DWORD MemoryEngine::tryAddSubLayer(const FWPM_SUBLAYER &subLayer)
+{
+    ++_roundTrips;
+
+    const bool added = _state.subLayers.try_emplace(subLayer.subLayerKey, subLayer.weight).second;
+    if(!added)
+    {
+        return FWP_E_ALREADY_EXISTS;
+    }
+
+    notify({ObjectKind::SubLayer, FWPM_CHANGE_ADD, subLayer.subLayerKey});
+    return ERROR_SUCCESS;
+}
+
+DWORD MemoryEngine::deleteSubLayerByKey(const GUID &subLayerKey)
+{
+    ++_roundTrips;
+
+    if(!_state.subLayers.contains(subLayerKey))
+    {
+        return FWP_E_SUBLAYER_NOT_FOUND;
+    }
+
+    const bool inUse = std::ranges::any_of(_state.filters, [&](const auto &entry) {
+        return entry.second->filter.subLayerKey == subLayerKey;
+    });
+    if(inUse)
+    {
+        return FWP_E_IN_USE;
+    }
+
+    _state.subLayers.erase(subLayerKey);
+    notify({ObjectKind::SubLayer, FWPM_CHANGE_DELETE, subLayerKey});
+    return ERROR_SUCCESS;
+}
+
+auto MemoryEngine::subLayerWeight(const GUID &subLayerKey) -> std::optional<UINT16>
+{
+    ++_roundTrips;
+
+    auto it = _state.subLayers.find(subLayerKey);
+    if(it == _state.subLayers.end())
+    {
+        return {};
+    }
+
+    return it->second;
+}
+
+void MemoryEngine::beginTransaction()
+{
+    ++_roundTrips;
+
+    if(_snapshot)
+    {
+        throw WfpError{"FwpmTransactionBegin failed:", FWP_E_TXN_IN_PROGRESS};
+    }
+
+    // Stored filters are never modified once added, so a shallow copy is enough
+    _snapshot = _state;
+}
+
+void MemoryEngine::commitTransaction()
+{
+    ++_roundTrips;
+
+    if(!_snapshot)
+    {
+        throw WfpError{"FwpmTransactionCommit failed:", FWP_E_NO_TXN_IN_PROGRESS};
+    }
+
+    _snapshot.reset();
+
+    for(const auto &change : std::exchange(_pendingChanges, {}))
+    {
+        deliver(change);
+    }
+}
+
+DWORD MemoryEngine::abortTransaction()
+{
+    ++_roundTrips;
+
+    if(!_snapshot)
+    {
+        return FWP_E_NO_TXN_IN_PROGRESS;
+    }
+
+    _state = std::move(*_snapshot);
+    _snapshot.reset();
+    // Nothing changed after all
+    _pendingChanges.clear();
+
+    return ERROR_SUCCESS;
+}
+
+const FWPM_FILTER *MemoryEngine::findFilter(FilterId filterId) const
+{
+    auto it = _state.filters.find(filterId);
+    return it != _state.filters.end() ? &it->second->filter : nullptr;
+}
+
+auto MemoryEngine::filterById(FilterId filterId) -> std::shared_ptr<FWPM_FILTER>
+{
+    ++_roundTrips;
+
+    auto it = _state.filters.find(filterId);
+    if(it == _state.filters.end())
+    {
+        return {};
+    }
+
+    // Aliasing constructor - shares ownership of the stored copy
+    return {it->second, &it->second->filter};
+}
+
+auto MemoryEngine::filterByKey(const GUID &filterKey) -> std::shared_ptr<FWPM_FILTER>
+{
+    ++_roundTrips;
+
+    auto it = _state.idsByKey.find(filterKey);
+    if(it == _state.idsByKey.end())
+    {
+        return {};
+    }
+
+    const auto &pStored = _state.filters.at(it->second);
+    return {pStored, &pStored->filter};
+}
+
+auto MemoryEngine::subscribeChanges(ChangeCallback callback) -> ChangeSubscription
+{
+    const size_t id = _nextSubscriberId++;
+    _subscribers.emplace(id, std::move(callback));
+
+    return ChangeSubscription{[this, id] { _subscribers.erase(id); }};
+}
+
+void MemoryEngine::notify(const ObjectChange &change)
+{
+    if(_snapshot)
+    {
+        _pendingChanges.push_back(change);
+    }
+    else
+    {
+        deliver(change);
+    }
+}
+
+void MemoryEngine::deliver(const ObjectChange &change)
+{
+    if(_changesToDrop > 0)
+    {
+        --_changesToDrop;
+        return;
+    }
+
+    for(const auto &[id, callback] : _subscribers)
+    {
+        callback(change);
+    }
+}
+}
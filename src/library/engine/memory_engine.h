@@ -0,0 +1,160 @@
+#pragma once
+
+#include <wfp_objects.h>
+#include <map>
+#include <deque>
+#include <optional>
+
+namespace wfpk
+{
+// An in-memory stand-in for Engine.
+// Models the parts of the BFE our apply logic relies on (filter add/delete and
+// transactions with rollback) and counts every call as a round trip, so batching
+// and rollback behaviour can be tested without a live BFE or admin rights.
+class MemoryEngine
+{
+public:
+    MemoryEngine() = default;
+    MemoryEngine(MemoryEngine &&) = delete;
+    MemoryEngine(const MemoryEngine &) = delete;
+    MemoryEngine &operator=(const MemoryEngine &) = delete;
+    MemoryEngine &operator=(MemoryEngine &&) = delete;
+
+public:
+    // The filter is deep-copied, so the caller's storage need not outlive the engine
+    DWORD tryAdd(const FWPM_FILTER &filter, FilterId &id);
+    DWORD deleteFilterById(FilterId filterId);
+    DWORD deleteFilterByKey(const GUID &filterKey);
+
+    // Only the provider's key and providerData are kept
+    DWORD tryAddProvider(const FWPM_PROVIDER &provider);
+    DWORD deleteProviderByKey(const GUID &providerKey);
+    auto providerData(const GUID &providerKey) -> std::optional<std::vector<UINT8>>;
+
+    // Only the sublayer's key and weight are kept. As with the BFE, a sublayer
+    // can't be deleted while filters refer to it.
+    DWORD tryAddSubLayer(const FWPM_SUBLAYER &subLayer);
+    DWORD deleteSubLayerByKey(const GUID &subLayerKey);
+    auto subLayerWeight(const GUID &subLayerKey) -> std::optional<UINT16>;
+
+    void beginTransaction();
+    void commitTransaction();
+    DWORD abortTransaction();
+
+    // A filter by id, or nullptr if there's no such filter
+    auto filterById(FilterId filterId) -> std::shared_ptr<FWPM_FILTER>;
+    // A filter by key, or nullptr if there's no such filter
+    auto filterByKey(const GUID &filterKey) -> std::shared_ptr<FWPM_FILTER>;
+
+    // As Engine::subscribeChanges(), but the callback is called synchronously - as each
+    // change is made, or as the transaction making it commits. It mustn't subscribe or
+    // unsubscribe, and the subscription mustn't outlive the engine.
+    auto subscribeChanges(ChangeCallback callback) -> ChangeSubscription;
+
+    // Iterate over the filters for one layer (in filter id order) that the BFE would
+    // select for the query
+    template <typename IterFuncT>
+        requires std::invocable<IterFuncT, std::shared_ptr<FWPM_FILTER>>
+    void enumerateFiltersForLayer(const GUID &layerKey, IterFuncT func,
+                                  const FilterQuery &query = {})
+    {
+        ++_roundTrips;
+        const auto enumTemplate = query.enumTemplate(layerKey);
+        for(const auto &[id, pStored] : _state.filters)
+        {
+            if(enumTemplateMatches(enumTemplate, pStored->filter))
+            {
+                // Aliasing constructor - shares ownership of the stored copy
+                func(std::shared_ptr<FWPM_FILTER>{pStored, &pStored->filter});
+            }
+        }
+    }
+
+    // Fault injection: the add that happens after `count` further successful adds
+    // fails with the given error.
+    void failAddAfter(size_t count, DWORD error = ERROR_INVALID_PARAMETER)
+    {
+        _addsUntilFailure = count;
+        _injectedError = error;
+    }
+
+    // Fault injection: the next `count` changes aren't notified, as if the notifications
+    // were lost
+    void dropChanges(size_t count)
+    {
+        _changesToDrop = count;
+    }
+
+    // Returns nullptr if no filter with the given id exists
+    const FWPM_FILTER *findFilter(FilterId filterId) const;
+
+    size_t filterCount() const
+    {
+        return _state.filters.size();
+    }
+    size_t providerCount() const
+    {
+        return _state.providers.size();
+    }
+    size_t subLayerCount() const
+    {
+        return _state.subLayers.size();
+    }
+    // Number of calls made against the engine - each one would be an RPC to the BFE
+    size_t roundTrips() const
+    {
+        return _roundTrips;
+    }
+    void resetRoundTrips()
+    {
+        _roundTrips = 0;
+    }
+    bool inTransaction() const
+    {
+        return _snapshot.has_value();
+    }
+
+private:
+    // A deep copy of a filter along with the storage its pointers refer to
+    struct StoredFilter
+    {
+        FWPM_FILTER filter{};
+        GUID providerKey{};
+        std::wstring name;
+        std::wstring description;
+        std::vector<FWPM_FILTER_CONDITION> conditions;
+        // Type-erased storage for pointed-to values (addresses, blobs, 64 bit values..)
+        std::vector<std::shared_ptr<void>> payloads;
+    };
+
+    static auto copyFilter(const FWPM_FILTER &filter) -> std::shared_ptr<StoredFilter>;
+    // Notify subscribers of a change - once the current transaction commits, if any
+    void notify(const ObjectChange &change);
+    void deliver(const ObjectChange &change);
+
+private:
+    struct State
+    {
+        std::map<FilterId, std::shared_ptr<StoredFilter>> filters;
+        // Filter keys are unique across the engine, as with the BFE
+        std::unordered_map<GUID, FilterId> idsByKey;
+        // providerData by provider key
+        std::unordered_map<GUID, std::vector<UINT8>> providers;
+        // Weight by sublayer key
+        std::unordered_map<GUID, UINT16> subLayers;
+    };
+
+    State _state;
+    // State of the engine at the start of the current transaction
+    std::optional<State> _snapshot;
+    FilterId _nextFilterId{1};
+    size_t _roundTrips{0};
+    std::optional<size_t> _addsUntilFailure;
+    DWORD _injectedError{ERROR_SUCCESS};
+    std::map<size_t, ChangeCallback> _subscribers;
+    size_t _nextSubscriberId{0};
+    // Changes made in the current transaction, notified when it commits
+    std::vector<ObjectChange> _pendingChanges;
+    size_t _changesToDrop{0};
+};
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <utils.h>
+#include <functional>
+#include <utility>
+
+namespace wfpk
+{
+// The kinds of object whose changes the BFE notifies
+enum class ObjectKind
+{
+    Filter,
+    Provider,
+    SubLayer
+};
+
+// An object added to or deleted from the BFE - all a change notification carries
+struct ObjectChange
+{
+    ObjectKind kind{ObjectKind::Filter};
+    // FWPM_CHANGE_ADD or FWPM_CHANGE_DELETE
+    FWPM_CHANGE_TYPE type{FWPM_CHANGE_ADD};
+    // The filter, provider or sublayer key
+    GUID key{};
+    // Filters only
+    UINT64 filterId{0};
+};
+
+// Called with each change - by the BFE, on one of its thread pool threads
+using ChangeCallback = std::function<void(const ObjectChange &)>;
+
+// A subscription to an engine's changes (see Engine::subscribeChanges()), which
+// unsubscribes when destroyed
+class ChangeSubscription
+{
+public:
+    ChangeSubscription() = default;
+    explicit ChangeSubscription(std::function<void()> unsubscribe)
+        : _unsubscribe{std::move(unsubscribe)}
+    {}
+    ChangeSubscription(ChangeSubscription &&other) noexcept
+        : _unsubscribe{std::exchange(other._unsubscribe, {})}
+    {}
+    ChangeSubscription &operator=(ChangeSubscription &&other) noexcept
+    {
+        if(this != &other)
+        {
+            reset();
+            _unsubscribe = std::exchange(other._unsubscribe, {});
+        }
+        return *this;
+    }
+    ChangeSubscription(const ChangeSubscription &) = delete;
+    ChangeSubscription &operator=(const ChangeSubscription &) = delete;
+    ~ChangeSubscription()
+    {
+        reset();
+    }
+
+public:
+    // Unsubscribe now, if still subscribed
+    void reset()
+    {
+        if(_unsubscribe)
+        {
+            std::exchange(_unsubscribe, {})();
+        }
+    }
+
+    explicit operator bool() const
+    {
+        return static_cast<bool>(_unsubscribe);
+    }
+
+private:
+    std::function<void()> _unsubscribe;
+};
+}
@@ -0,0 +1,44 @@
+#include <engine/object_name_cache.h>
+
+namespace wfpk
+{
+std::string ObjectNameCacheStats::toString() const
+{
+    return std::format("{} hits, {} misses ({} absent)", hits, misses, absent);
+}
+
+auto ObjectNameCache::find(const GUID &key) -> const Names *
+{
+    if(auto it = _names.find(key); it != _names.end())
+    {
+        ++_stats.hits;
+        return it->second ? &*it->second : nullptr;
+    }
+
+    ++_stats.misses;
+    auto name = _fetch(key);
+    if(!name)
+    {
+        ++_stats.absent;
+        if(_absentKeys == AbsentKeys::Cached)
+        {
+            _names.emplace(key, std::nullopt);
+        }
+        return nullptr;
+    }
+
+    std::string lowercaseName = toLowercase(*name);
+    auto it = _names.emplace(key, Names{std::move(*name), std::move(lowercaseName)}).first;
+    return &*it->second;
+}
+
+void ObjectNameCache::clear()
+{
+    _names.clear();
+}
+
+auto ObjectNameCache::stats() const -> ObjectNameCacheStats
+{
+    return _stats;
+}
+}
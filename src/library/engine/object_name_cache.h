@@ -0,0 +1,77 @@
+#pragma once
+
+#include <utils.h>
+#include <functional>
+
+namespace wfpk
+{
+struct ObjectNameCacheStats
+{
+    size_t hits{0};
+    size_t misses{0};
+    // Misses for keys with no such object
+    size_t absent{0};
+
+    // e.g: 4980 hits, 20 misses (1 absent)
+    std::string toString() const;
+};
+
+// The display names of one kind of object (providers or sublayers) by key. A name is
+// fetched the first time its key is asked for, then kept decoded and lowercased - so
+// matching thousands of filters against name patterns costs a fetch per distinct
+// provider or sublayer rather than two RPCs and conversions per filter.
+//
+// Keys with no such object can be remembered too (negative caching), so a filter
+// naming a deleted sublayer costs one fetch however often it's seen. Names are never
+// invalidated - clear() the cache once they may have changed (e.g when a
+// LiveFilterMirror's providerEpoch() does).
+//
+// Not thread safe.
+class ObjectNameCache
+{
+public:
+    // An object's display name, or nullopt if there's no object with the key.
+    // Throws on any other failure.
+    using FetchFunc = std::function<std::optional<std::string>(const GUID &)>;
+
+    // Whether a key with no object is remembered, or fetched again each time
+    enum class AbsentKeys
+    {
+        Cached,
+        Refetched
+    };
+
+    struct Names
+    {
+        std::string displayName;
+        // For case-insensitive matching
+        std::string lowercaseName;
+    };
+
+public:
+    explicit ObjectNameCache(FetchFunc fetch, AbsentKeys absentKeys = AbsentKeys::Cached)
+        : _fetch{std::move(fetch)}
+        , _absentKeys{absentKeys}
+    {}
+
+public:
+    // An object's names, or nullptr if there's no object with the key - valid until the
+    // cache is cleared. Throws whatever the fetch does.
+    auto find(const GUID &key) -> const Names *;
+    void clear();
+
+    auto stats() const -> ObjectNameCacheStats;
+    // Keys cached, including absent ones
+    size_t size() const
+    {
+        return _names.size();
+    }
+
+private:
+    FetchFunc _fetch;
+    AbsentKeys _absentKeys;
+    // nullopt for a key with no object
+    std::unordered_map<GUID, std::optional<Names>> _names;
+    ObjectNameCacheStats _stats;
+};
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <engine/engine_concepts.h>
+#include <engine/session_pool.h>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace wfpk
+{
+// Enumerates the filters of several layers at once, fanning the layers out across a
+// pool of workers. Each worker has an engine session of its own (opened for it, or
+// leased from a SessionPool), as a session's RPCs are served one at a time - so the
+// layers' round trips overlap rather than queue.
+//
+// A layer's pages are still fetched in turn by one worker (an enumeration handle is a
+// cursor), so the layer is the unit of work. Results are merged in layer order, with
+// each layer's filters in the order the engine enumerated them, however the workers
+// were scheduled.
+template <FilterEnumerableEngine EngineT> class ParallelFilterEnum
+{
+public:
+    // Opens (or leases) a session for a worker. Throws if it can't.
+    using SessionFactory = std::function<SessionLease<EngineT>()>;
+    using LayerFilters = std::vector<std::shared_ptr<FWPM_FILTER>>;
+
+public:
+    // Only the filters the BFE selects for the query are enumerated - see FilterQuery
+    ParallelFilterEnum(std::vector<GUID> layers, SessionFactory openSession,
+                       size_t maxWorkers = std::thread::hardware_concurrency(),
+                       FilterQuery query = {})
+        : _layers{std::move(layers)}
+        , _openSession{std::move(openSession)}
+        , _maxWorkers{maxWorkers}
+        , _query{std::move(query)}
+    {}
+    // A worker per session the pool can lease
+    ParallelFilterEnum(std::vector<GUID> layers, SessionPool<EngineT> &sessions,
+                       FilterQuery query = {})
+        : ParallelFilterEnum{std::move(layers), [&sessions] { return sessions.lease(); },
+                             sessions.maxSessions(), std::move(query)}
+    {}
+
+public:
+    // The filters of each layer, in the order the layers were given.
+    // Throws the first error (in layer order) raised enumerating a layer, or opening
+    // a session if no worker could enumerate it.
+    auto enumerate() const -> std::vector<LayerFilters>
+    {
+        std::vector<LayerFilters> filters(_layers.size());
+        std::vector<std::exception_ptr> errors(_layers.size());
+        std::vector<char> enumerated(_layers.size());
+        std::exception_ptr sessionError;
+        std::mutex sessionErrorMutex;
+        std::atomic<size_t> next{0};
+
+        // Each worker takes the next layer not yet taken - layers differ widely in size
+        auto work = [&] {
+            SessionLease<EngineT> session;
+            try
+            {
+                session = _openSession();
+            }
+            catch(...)
+            {
+                // The other workers pick up this one's share
+                std::lock_guard lock{sessionErrorMutex};
+                sessionError = std::current_exception();
+                return;
+            }
+
+            for(size_t i = next++; i < _layers.size(); i = next++)
+            {
+                try
+                {
+                    session->enumerateFiltersForLayer(
+                        _layers[i], [&](auto pFilter) { filters[i].push_back(std::move(pFilter)); },
+                        _query);
+                }
+                catch(...)
+                {
+                    errors[i] = std::current_exception();
+                }
+                enumerated[i] = true;
+            }
+        };
+
+        {
+            const size_t workerCount =
+                std::max<size_t>((std::min)(_layers.size(), _maxWorkers), 1);
+            std::vector<std::jthread> workers;
+            for(size_t i = 0; i < workerCount; ++i)
+            {
+                workers.emplace_back(work);
+            }
+        }
+
+        for(size_t i = 0; i < _layers.size(); ++i)
+        {
+            if(errors[i])
+            {
+                std::rethrow_exception(errors[i]);
+            }
+            if(!enumerated[i])
+            {
+                std::rethrow_exception(sessionError);
+            }
+        }
+
+        return filters;
+    }
+
+    // Iterate over the filters of every layer, in layer order
+    template <typename IterFuncT>
+        requires std::invocable<IterFuncT, std::shared_ptr<FWPM_FILTER>>
+    void forEach(IterFuncT func) const
+    {
+        for(const auto &layerFilters : enumerate())
+        {
+            for(const auto &pFilter : layerFilters)
+            {
+                func(pFilter);
+            }
+        }
+    }
+
+private:
+    std::vector<GUID> _layers;
+    SessionFactory _openSession;
+    size_t _maxWorkers;
+    FilterQuery _query;
+};
+}
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <utils.h>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+
+namespace wfpk
+{
+template <typename EngineT> class SessionPool;
+
+// Exclusive use of an engine session until the lease is destroyed, when the session
+// goes back to its pool to be leased again - or is closed, if it wasn't leased from a
+// pool or has been discarded.
+//
+// A session's RPCs are served one at a time, so a lease is used by one thread at a
+// time. It must not be released with a transaction still open.
+template <typename EngineT> class SessionLease
+{
+public:
+    SessionLease() = default;
+    // A session of its own, closed when the lease is released
+    SessionLease(std::unique_ptr<EngineT> pSession)
+        : _pSession{std::move(pSession)}
+    {}
+    SessionLease(SessionLease &&other) noexcept
+        : _pPool{std::exchange(other._pPool, nullptr)}
+        , _pSession{std::move(other._pSession)}
+    {}
+    SessionLease &operator=(SessionLease &&other) noexcept
+    {
+        if(this != &other)
+        {
+            release();
+            _pPool = std::exchange(other._pPool, nullptr);
+            _pSession = std::move(other._pSession);
+        }
+        return *this;
+    }
+    SessionLease(const SessionLease &) = delete;
+    SessionLease &operator=(const SessionLease &) = delete;
+    ~SessionLease()
+    {
+        release();
+    }
+
+public:
+    EngineT *get() const
+    {
+        return _pSession.get();
+    }
+    EngineT *operator->() const
+    {
+        return _pSession.get();
+    }
+    EngineT &operator*() const
+    {
+        return *_pSession;
+    }
+    explicit operator bool() const
+    {
+        return static_cast<bool>(_pSession);
+    }
+
+    // Close the session rather than return it to the pool - e.g once an RPC on it has
+    // failed in a way that may have left it unusable
+    void discard()
+    {
+        if(_pPool)
+        {
+            _pPool->discard();
+            _pPool = nullptr;
+        }
+        _pSession.reset();
+    }
+
+private:
+    friend class SessionPool<EngineT>;
+
+    SessionLease(SessionPool<EngineT> &pool, std::unique_ptr<EngineT> pSession)
+        : _pPool{&pool}
+        , _pSession{std::move(pSession)}
+    {}
+
+    void release()
+    {
+        if(_pPool && _pSession)
+        {
+            std::exchange(_pPool, nullptr)->release(std::move(_pSession));
+        }
+        _pSession.reset();
+    }
+
+private:
+    SessionPool<EngineT> *_pPool{nullptr};
+    std::unique_ptr<EngineT> _pSession;
+};
+
+// Engine sessions shared by worker threads, so concurrent BFE work runs on sessions of
+// its own without opening (and authenticating) a session per task. Sessions are opened
+// as they're first needed, up to maxSessions, and then reused - a lease waits for a
+// session to be released once that many are leased.
+//
+// Thread safe. The pool must outlive its leases.
+template <typename EngineT> class SessionPool
+{
+public:
+    // Opens a new session. Throws if it can't.
+    using SessionFactory = std::function<std::unique_ptr<EngineT>()>;
+
+public:
+    SessionPool(SessionFactory openSession, size_t maxSessions)
+        : _openSession{std::move(openSession)}
+        , _maxSessions{std::max<size_t>(maxSessions, 1)}
+    {}
+    SessionPool(SessionPool &&) = delete;
+    SessionPool(const SessionPool &) = delete;
+    SessionPool &operator=(const SessionPool &) = delete;
+    SessionPool &operator=(SessionPool &&) = delete;
+    ~SessionPool()
+    {
+        assert(_openCount == _idle.size()); // pre-condition, no leases outstanding
+    }
+
+public:
+    // An idle session, or a newly opened one if fewer than maxSessions are open - or else
+    // the next session released. Throws whatever opening a session throws.
+    auto lease() -> SessionLease<EngineT>
+    {
+        std::unique_lock lock{_mutex};
+        _released.wait(lock, [&] { return !_idle.empty() || _openCount < _maxSessions; });
+        return takeSession(lock);
+    }
+
+    // As lease(), but an empty lease rather than waiting when every session is leased
+    auto tryLease() -> SessionLease<EngineT>
+    {
+        std::unique_lock lock{_mutex};
+        if(_idle.empty() && _openCount >= _maxSessions)
+        {
+            return {};
+        }
+        return takeSession(lock);
+    }
+
+    // Idle sessions beyond a smaller limit are closed now, leased ones as they're released
+    void setMaxSessions(size_t maxSessions)
+    {
+        std::vector<std::unique_ptr<EngineT>> closing;
+        {
+            std::lock_guard lock{_mutex};
+            _maxSessions = std::max<size_t>(maxSessions, 1);
+            while(_openCount > _maxSessions && !_idle.empty())
+            {
+                closing.push_back(std::move(_idle.back()));
+                _idle.pop_back();
+                --_openCount;
+            }
+        }
+        // More sessions may be opened now
+        _released.notify_all();
+    }
+
+    size_t maxSessions() const
+    {
+        std::lock_guard lock{_mutex};
+        return _maxSessions;
+    }
+    // Sessions open, leased or idle
+    size_t openCount() const
+    {
+        std::lock_guard lock{_mutex};
+        return _openCount;
+    }
+    size_t idleCount() const
+    {
+        std::lock_guard lock{_mutex};
+        return _idle.size();
+    }
+
+private:
+    friend class SessionLease<EngineT>;
+
+    // Called with the lock held, and a session free to take or open
+    auto takeSession(std::unique_lock<std::mutex> &lock) -> SessionLease<EngineT>
+    {
+        if(!_idle.empty())
+        {
+            auto pSession = std::move(_idle.back());
+            _idle.pop_back();
+            return {*this, std::move(pSession)};
+        }
+
+        // Opened outside the lock - it's a round trip. The slot is held meanwhile.
+        ++_openCount;
+        lock.unlock();
+        try
+        {
+            return {*this, _openSession()};
+        }
+        catch(...)
+        {
+            discard();
+            throw;
+        }
+    }
+
+    void release(std::unique_ptr<EngineT> pSession)
+    {
+        {
+            std::lock_guard lock{_mutex};
+            if(_openCount > _maxSessions)
+            {
+                --_openCount;
+            }
+            else
+            {
+                _idle.push_back(std::move(pSession));
+            }
+        }
+        _released.notify_one();
+        // A session over the limit is closed here, outside the lock
+    }
+
+    // A leased session is gone, freeing its slot
+    void discard()
+    {
+        {
+            std::lock_guard lock{_mutex};
+            --_openCount;
+        }
+        _released.notify_one();
+    }
+
+private:
+    SessionFactory _openSession;
+    mutable std::mutex _mutex;
+    std::condition_variable _released;
+    size_t _maxSessions;
+    size_t _openCount{0};
+    std::vector<std::unique_ptr<EngineT>> _idle;
+};
+}
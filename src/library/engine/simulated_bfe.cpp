@@ -0,0 +1,34 @@
+#include <engine/simulated_bfe.h>
+
+namespace wfpk
+{
+DWORD SimulatedBfe::Session::tryAdd(const FWPM_FILTER &filter, FilterId &id)
+{
+    return _bfe.call([&](MemoryEngine &engine) { return engine.tryAdd(filter, id); });
+}
+
+DWORD SimulatedBfe::Session::deleteFilterById(FilterId filterId)
+{
+    return _bfe.call([&](MemoryEngine &engine) { return engine.deleteFilterById(filterId); });
+}
+
+auto SimulatedBfe::openSession() -> std::unique_ptr<Session>
+{
+    waitLatency();
+    return std::make_unique<Session>(*this);
+}
+
+void SimulatedBfe::waitLatency()
+{
+    ++_roundTrips;
+    const size_t concurrentCalls = ++_concurrentCalls;
+    size_t peak = _peakConcurrentCalls;
+    while(concurrentCalls > peak &&
+          !_peakConcurrentCalls.compare_exchange_weak(peak, concurrentCalls))
+    {
+    }
+
+    std::this_thread::sleep_for(_latency.load());
+    --_concurrentCalls;
+}
+}
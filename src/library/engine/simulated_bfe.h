@@ -0,0 +1,118 @@
+#pragma once
+
+#include <engine/memory_engine.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+namespace wfpk
+{
+// An in-memory BFE that several sessions use at once from different threads - for
+// exercising concurrent engine code (SessionPool, AsyncEngine) and measuring what it
+// overlaps, on any platform. Its objects are kept in a MemoryEngine.
+//
+// Every call on a session first waits out an injectable latency, standing in for the
+// RPC round trip, and then takes effect atomically. Calls on different sessions wait
+// out their latency at the same time, as they would on the real BFE, while calls on
+// one session are served one at a time.
+//
+// Thread safe. Each session is used by one thread at a time, as an Engine is.
+class SimulatedBfe
+{
+public:
+    class Session
+    {
+    public:
+        explicit Session(SimulatedBfe &bfe)
+            : _bfe{bfe}
+        {}
+
+    public:
+        DWORD tryAdd(const FWPM_FILTER &filter, FilterId &id);
+        DWORD deleteFilterById(FilterId filterId);
+
+        // The layer's filters are fetched in one round trip, then passed to func
+        template <typename IterFuncT>
+            requires std::invocable<IterFuncT, std::shared_ptr<FWPM_FILTER>>
+        void enumerateFiltersForLayer(const GUID &layerKey, IterFuncT func,
+                                      const FilterQuery &query = {})
+        {
+            std::vector<std::shared_ptr<FWPM_FILTER>> filters;
+            _bfe.call([&](MemoryEngine &engine) {
+                engine.enumerateFiltersForLayer(
+                    layerKey,
+                    [&](std::shared_ptr<FWPM_FILTER> pFilter) {
+                        filters.push_back(std::move(pFilter));
+                    },
+                    query);
+            });
+            for(auto &pFilter : filters)
+            {
+                func(std::move(pFilter));
+            }
+        }
+
+    private:
+        SimulatedBfe &_bfe;
+    };
+
+public:
+    explicit SimulatedBfe(std::chrono::microseconds latency = {})
+        : _latency{latency}
+    {}
+    SimulatedBfe(SimulatedBfe &&) = delete;
+    SimulatedBfe(const SimulatedBfe &) = delete;
+    SimulatedBfe &operator=(const SimulatedBfe &) = delete;
+    SimulatedBfe &operator=(SimulatedBfe &&) = delete;
+
+public:
+    // Opening a session is a round trip too
+    auto openSession() -> std::unique_ptr<Session>;
+
+    void setLatency(std::chrono::microseconds latency)
+    {
+        _latency = latency;
+    }
+    auto latency() const -> std::chrono::microseconds
+    {
+        return _latency;
+    }
+
+    // Calls made on all sessions, and sessions opened
+    size_t roundTrips() const
+    {
+        return _roundTrips;
+    }
+    // The most calls that have been waiting out their latency at the same time
+    size_t peakConcurrentCalls() const
+    {
+        return _peakConcurrentCalls;
+    }
+
+    // For adding filters beforehand and inspecting them after, without latency - not
+    // while any session is in use
+    auto engine() -> MemoryEngine &
+    {
+        return _engine;
+    }
+
+private:
+    // Wait out the latency, then run func on the engine with no other call running
+    template <typename FuncT> auto call(FuncT func)
+    {
+        waitLatency();
+        std::lock_guard lock{_mutex};
+        return func(_engine);
+    }
+    void waitLatency();
+
+private:
+    std::atomic<std::chrono::microseconds> _latency;
+    std::atomic<size_t> _roundTrips{0};
+    std::atomic<size_t> _concurrentCalls{0};
+    std::atomic<size_t> _peakConcurrentCalls{0};
+    std::mutex _mutex;
+    MemoryEngine _engine;
+};
+}
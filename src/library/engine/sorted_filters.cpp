@@ -0,0 +1,33 @@
+#include <engine/sorted_filters.h>
+
+namespace wfpk
+{
+UINT64 filterWeight(const FWPM_FILTER &filter)
+{
+    if(filter.effectiveWeight.type == FWP_UINT64 && filter.effectiveWeight.uint64)
+    {
+        return *filter.effectiveWeight.uint64;
+    }
+
+    // See here (weight section) for explanation of types
+    // https://learn.microsoft.com/en-us/windows/win32/api/fwpmtypes/ns-fwpmtypes-fwpm_filter0
+    switch(filter.weight.type)
+    {
+        case FWP_UINT64: return filter.weight.uint64 ? *filter.weight.uint64 : 0;
+        case FWP_UINT8: return static_cast<UINT64>(filter.weight.uint8 & 0xF) << 60;
+        case FWP_EMPTY:
+        default: return 0;
+    }
+}
+
+void SortedFilters::sort()
+{
+    if(_isSorted)
+    {
+        return;
+    }
+
+    std::ranges::stable_sort(_entries, std::ranges::greater{}, &Entry::weight);
+    _isSorted = true;
+}
+}
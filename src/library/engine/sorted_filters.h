@@ -0,0 +1,74 @@
+#pragma once
+
+#include <utils.h>
+#include <span>
+
+namespace wfpk
+{
+// A filter's weight as the BFE ranks filters within a sublayer.
+// Enumerated filters carry the weight the BFE assigned (effectiveWeight); otherwise it's
+// decoded from the requested weight:
+// - FWP_UINT64: the weight itself
+// - FWP_UINT8: a 4-bit weight w, which the BFE places in [w << 60, (w + 1) << 60)
+// - FWP_EMPTY: left for the BFE to assign, so it ranks lowest here
+UINT64 filterWeight(const FWPM_FILTER &filter);
+
+// Filters in the order the BFE evaluates them within a sublayer - heaviest first, and
+// filters of equal weight in the order they were added.
+//
+// A flat vector of (weight, filter) handles, decoded once as each filter is added and
+// sorted once by sort() - rather than a tree node and a reference count per filter.
+// It doesn't own the filters, which must outlive it.
+class SortedFilters
+{
+public:
+    struct Entry
+    {
+        UINT64 weight{0};
+        const FWPM_FILTER *pFilter{nullptr};
+    };
+
+public:
+    void reserve(size_t count)
+    {
+        _entries.reserve(count);
+    }
+
+    // Added filters are out of order until sort() is called
+    void add(const FWPM_FILTER &filter)
+    {
+        _entries.push_back({filterWeight(filter), &filter});
+        _isSorted = false;
+    }
+
+    void sort();
+
+    // Only valid once sorted
+    auto entries() const -> std::span<const Entry>
+    {
+        assert(_isSorted);
+        return _entries;
+    }
+    auto begin() const
+    {
+        return entries().begin();
+    }
+    auto end() const
+    {
+        return entries().end();
+    }
+
+    size_t size() const
+    {
+        return _entries.size();
+    }
+    bool empty() const
+    {
+        return _entries.empty();
+    }
+
+private:
+    std::vector<Entry> _entries;
+    bool _isSorted{true};
+};
+}
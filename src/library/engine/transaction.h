@@ -0,0 +1,52 @@
+#pragma once
+
+#include <engine/engine_concepts.h>
+
+namespace wfpk
+{
+// RAII wrapper around an engine transaction.
+// Unless commit() is called the transaction is aborted on destruction,
+// rolling back every change made since it began.
+template <TransactionalEngine EngineT> class Transaction
+{
+public:
+    // Throws a WfpError if the transaction cannot be started
+    explicit Transaction(EngineT &engine)
+        : _engine{engine}
+    {
+        _engine.beginTransaction();
+    }
+
+    Transaction(Transaction &&) = delete;
+    Transaction(const Transaction &) = delete;
+    Transaction &operator=(const Transaction &) = delete;
+    Transaction &operator=(Transaction &&) = delete;
+
+    ~Transaction()
+    {
+        if(_committed)
+        {
+            return;
+        }
+
+        DWORD result = _engine.abortTransaction();
+        if(result != ERROR_SUCCESS)
+        {
+            // Cannot throw in a destructor
+            std::cerr << "FwpmTransactionAbort failed: " << getErrorString(result) << std::endl;
+        }
+    }
+
+public:
+    // Throws a WfpError on failure, in which case the transaction is aborted on destruction
+    void commit()
+    {
+        _engine.commitTransaction();
+        _committed = true;
+    }
+
+private:
+    EngineT &_engine;
+    bool _committed{false};
+};
+}
@@ -0,0 +1,53 @@
+#include <executor.h>
+
+namespace wfpk
+{
+Executor::Executor(size_t threadCount)
+{
+    threadCount = std::max<size_t>(threadCount, 1);
+    _threads.reserve(threadCount);
+    for(size_t i = 0; i < threadCount; ++i)
+    {
+        _threads.emplace_back([this] { run(); });
+    }
+}
+
+Executor::~Executor()
+{
+    {
+        std::lock_guard lock{_mutex};
+        _stopping = true;
+    }
+    _posted.notify_all();
+    // The jthreads join as they're destroyed, once the queue has drained
+    _threads.clear();
+}
+
+void Executor::post(std::function<void()> work)
+{
+    {
+        std::lock_guard lock{_mutex};
+        _work.push_back(std::move(work));
+    }
+    _posted.notify_one();
+}
+
+void Executor::run()
+{
+    while(true)
+    {
+        std::function<void()> work;
+        {
+            std::unique_lock lock{_mutex};
+            _posted.wait(lock, [&] { return _stopping || !_work.empty(); });
+            if(_work.empty())
+            {
+                return;
+            }
+            work = std::move(_work.front());
+            _work.pop_front();
+        }
+        work();
+    }
+}
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <async.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace wfpk
+{
+// A fixed set of worker threads running work in the order it's posted - somewhere for
+// blocking calls (BFE round trips, app id resolution) to wait without holding up the
+// thread that wants their results. submit() hands back the result as an Async, so
+// coroutines can await blocking work.
+//
+// Thread safe. Work still queued when the executor is destroyed is run first.
+class Executor
+{
+public:
+    explicit Executor(size_t threadCount = std::thread::hardware_concurrency());
+    Executor(Executor &&) = delete;
+    Executor(const Executor &) = delete;
+    Executor &operator=(const Executor &) = delete;
+    Executor &operator=(Executor &&) = delete;
+    ~Executor();
+
+public:
+    // Work must not throw - use submit() for work that may
+    void post(std::function<void()> work);
+
+    // Run func on a worker thread. A coroutine awaiting the result resumes on that
+    // thread; whatever func throws is rethrown there.
+    template <typename FuncT> auto submit(FuncT func) -> Async<std::invoke_result_t<FuncT>>
+    {
+        using ResultT = std::invoke_result_t<FuncT>;
+        typename Async<ResultT>::Completion completion;
+        auto result = completion.async();
+        post([completion = std::move(completion), func = std::move(func)]() mutable {
+            // Settled outside the try - settling resumes the coroutine awaiting the
+            // result, which mustn't run inside func's error handling
+            std::exception_ptr error;
+            if constexpr(std::is_void_v<ResultT>)
+            {
+                try
+                {
+                    func();
+                }
+                catch(...)
+                {
+                    error = std::current_exception();
+                }
+                if(error)
+                {
+                    completion.setError(error);
+                }
+                else
+                {
+                    completion.setValue();
+                }
+            }
+            else
+            {
+                std::optional<ResultT> value;
+                try
+                {
+                    value.emplace(func());
+                }
+                catch(...)
+                {
+                    error = std::current_exception();
+                }
+                if(error)
+                {
+                    completion.setError(error);
+                }
+                else
+                {
+                    completion.setValue(std::move(*value));
+                }
+            }
+        });
+        return result;
+    }
+
+    size_t threadCount() const
+    {
+        return _threads.size();
+    }
+
+private:
+    void run();
+
+private:
+    std::mutex _mutex;
+    std::condition_variable _posted;
+    std::deque<std::function<void()>> _work;
+    bool _stopping{false};
+    std::vector<std::jthread> _threads;
+};
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <optional>
+#include <utility>
+
+namespace wfpk
+{
+// A lazily evaluated sequence produced by a coroutine, in the manner of C++23's
+// std::generator - each value is produced as the caller advances to it, and
+// destroying the generator part way through ends the coroutine, releasing whatever
+// it holds. It's an input range, so it works with range-for and std::views.
+//
+// e.g:
+//   Generator<int> count(int n) { for(int i = 0; i < n; ++i) co_yield i; }
+template <typename T> class Generator
+{
+public:
+    struct promise_type
+    {
+        std::optional<T> value;
+        std::exception_ptr error;
+
+        Generator get_return_object()
+        {
+            return Generator{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        // Nothing runs until the first value is asked for
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+        std::suspend_always final_suspend() noexcept
+        {
+            return {};
+        }
+        std::suspend_always yield_value(T yielded)
+        {
+            value = std::move(yielded);
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception()
+        {
+            error = std::current_exception();
+        }
+    };
+
+    class iterator
+    {
+    public:
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+
+        iterator() = default;
+        explicit iterator(std::coroutine_handle<promise_type> handle)
+            : _handle{handle}
+        {}
+
+        T &operator*() const
+        {
+            return *_handle.promise().value;
+        }
+        T *operator->() const
+        {
+            return &*_handle.promise().value;
+        }
+        iterator &operator++()
+        {
+            resume(_handle);
+            return *this;
+        }
+        void operator++(int)
+        {
+            ++*this;
+        }
+        bool operator==(std::default_sentinel_t) const
+        {
+            return !_handle || _handle.done();
+        }
+
+    private:
+        std::coroutine_handle<promise_type> _handle;
+    };
+
+public:
+    Generator(Generator &&other) noexcept
+        : _handle{std::exchange(other._handle, {})}
+    {}
+    Generator &operator=(Generator &&other) noexcept
+    {
+        std::swap(_handle, other._handle);
+        return *this;
+    }
+    Generator(const Generator &) = delete;
+    Generator &operator=(const Generator &) = delete;
+    ~Generator()
+    {
+        if(_handle)
+        {
+            _handle.destroy();
+        }
+    }
+
+public:
+    // Runs the coroutine up to its first value - a generator can be iterated once
+    iterator begin()
+    {
+        resume(_handle);
+        return iterator{_handle};
+    }
+    std::default_sentinel_t end() const
+    {
+        return {};
+    }
+
+private:
+    explicit Generator(std::coroutine_handle<promise_type> handle)
+        : _handle{handle}
+    {}
+
+    // Run to the next value, rethrowing anything the coroutine threw
+    static void resume(std::coroutine_handle<promise_type> handle)
+    {
+        if(!handle || handle.done())
+        {
+            return;
+        }
+        handle.resume();
+        if(auto error = std::exchange(handle.promise().error, {}))
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    std::coroutine_handle<promise_type> _handle;
+};
+}
@@ -38,6 +38,7 @@ const std::vector<Keyword> keywords = {
     {.tokenType = TokenType::Inet4, .lexeme = "inet"},
     {.tokenType = TokenType::InDir, .lexeme = "in"},
     {.tokenType = TokenType::OutDir, .lexeme = "out"},
+    {.tokenType = TokenType::On, .lexeme = "on"},
     {.tokenType = TokenType::Port, .lexeme = "port"},
     {.tokenType = TokenType::Proto, .lexeme = "proto"},
     {.tokenType = TokenType::From, .lexeme = "from"},
@@ -39,7 +39,8 @@ enum class TokenType : uint32_t
 
     Inet4,
     Inet6,
-    Comma
+    Comma,
+    On
 };
 
 struct SourceLocation
@@ -97,6 +98,14 @@ public:
         , _sourceLocation{1, 1}
     {}
 
+    // Lex a fragment of a larger source, which starts at the given location
+    // (so tokens and errors refer to the larger source)
+    Lexer(std::string input, SourceLocation start)
+        : _input{std::move(input)}
+        , _currentIndex{0}
+        , _sourceLocation{start}
+    {}
+
     Lexer(const Lexer &) = default;
     Lexer(Lexer &&) = default;
     Lexer &operator=(const Lexer &) = default;
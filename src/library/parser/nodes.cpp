@@ -22,6 +22,11 @@ std::string FilterNode::toString() const
 
     auto conditions = filterConditions();
 
+    if(!conditions.interfaceName.empty())
+    {
+        output += std::format("on \"{}\" ", conditions.interfaceName);
+    }
+
     if(conditions == NoFilterConditions)
     {
         output += "all ";
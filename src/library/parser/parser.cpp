@@ -300,7 +300,22 @@ std::unique_ptr<Node> Parser::filter()
         unexpectedTokenError("expected a direction - such as out or in.");
     }
 
+    // Interface names (e.g "Wi-Fi", "Ethernet 2") often have spaces, so are strings
+    std::string interfaceName;
+    if(match(TokenType::On))
+    {
+        if(auto tok = match(TokenType::String))
+        {
+            interfaceName = std::move(tok->text);
+        }
+        else
+        {
+            unexpectedTokenError("expected an interface name - such as \"Wi-Fi\".");
+        }
+    }
+
     FilterConditions filterConditions = conditions();
+    filterConditions.interfaceName = std::move(interfaceName);
 
     return std::make_unique<FilterNode>(action, direction, std::move(filterConditions));
 }
@@ -0,0 +1,104 @@
+#include <pipeline/load_pipeline.h>
+
+namespace wfpk
+{
+size_t lastRuleBoundary(std::string_view text)
+{
+    size_t boundary{0};
+    bool inString{false};
+    bool atLineStart{true};
+
+    for(size_t i = 0; i < text.size(); ++i)
+    {
+        const char ch = text[i];
+        if(atLineStart && !inString && ch != ' ' && ch != '\t')
+        {
+            atLineStart = false;
+            // The lexer matches keywords by prefix, as we do here
+            const auto rest = text.substr(i);
+            if(i > 0 && (rest.starts_with("block") || rest.starts_with("permit")))
+            {
+                // Cut at the start of the line
+                boundary = text.rfind('\n', i) + 1;
+            }
+        }
+
+        if(ch == '"')
+        {
+            inString = !inString;
+        }
+        else if(ch == '\n')
+        {
+            atLineStart = true;
+        }
+    }
+
+    return boundary;
+}
+
+auto RuleSegmenter::next() -> std::optional<RuleSegment>
+{
+    while(true)
+    {
+        if(_pending.size() >= _chunkSize)
+        {
+            // Whatever follows the boundary may be a partial rule, so it waits for more
+            if(const size_t boundary = lastRuleBoundary(_pending); boundary > 0)
+            {
+                return take(boundary);
+            }
+        }
+
+        if(!_source)
+        {
+            if(std::ranges::all_of(_pending, [](char ch) { return std::isspace(ch); }))
+            {
+                return {};
+            }
+            return take(_pending.size());
+        }
+
+        const size_t size = _pending.size();
+        _pending.resize(size + _chunkSize);
+        _source.read(_pending.data() + size, static_cast<std::streamsize>(_chunkSize));
+        _pending.resize(size + static_cast<size_t>(_source.gcount()));
+        _bytesRead += static_cast<size_t>(_source.gcount());
+    }
+}
+
+auto RuleSegmenter::take(size_t length) -> RuleSegment
+{
+    RuleSegment segment{_pending.substr(0, length), _pendingStart};
+    _pending.erase(0, length);
+
+    // Segments are cut at the start of a line
+    _pendingStart.line += static_cast<uint32_t>(std::ranges::count(segment.text, '\n'));
+    _pendingStart.column = 1;
+
+    return segment;
+}
+
+std::string PipelineStats::toString() const
+{
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+    const double elapsedMs = Milliseconds{elapsed}.count();
+
+    std::string result;
+    for(const auto &stage : stages)
+    {
+        const double busyMs = Milliseconds{stage.busy}.count();
+        result += std::format("{}: {} {}, {:.1f}ms busy ({:.0f}/s, {:.0f}% of {:.1f}ms)\n",
+                              stage.name, stage.count, stage.unit, busyMs, stage.perSecond(),
+                              elapsedMs > 0 ? 100 * busyMs / elapsedMs : 0.0, elapsedMs);
+    }
+    for(const auto &queue : queues)
+    {
+        result += std::format(
+            "{} queue: capacity {}, occupancy {:.1f} avg {} max, {} full and {} empty waits\n",
+            queue.name, queue.capacity, queue.averageOccupancy(), queue.maxOccupancy,
+            queue.fullWaits, queue.emptyWaits);
+    }
+
+    return result;
+}
+}
@@ -0,0 +1,393 @@
+#pragma once
+
+#include <pipeline/spsc_queue.h>
+#include <apply/filter_applier.h>
+#include <apply/ruleset_fingerprint.h>
+#include <visitors/wfp_executor.h>
+#include <parser/parser.h>
+#include <istream>
+#include <thread>
+
+namespace wfpk
+{
+// A run of whole rules cut from a ruleset's source, small enough to parse on its own
+struct RuleSegment
+{
+    std::string text;
+    // Where the segment starts in the source, so parse errors point at the right line
+    SourceLocation start;
+};
+
+// The offset of the last rule boundary in text - the start of the last line that begins
+// with a rule's action (outside a string), as rules may span lines. 0 if there's none.
+size_t lastRuleBoundary(std::string_view text);
+
+// Reads a ruleset's source a chunk at a time, cutting it into RuleSegments at rule
+// boundaries
+class RuleSegmenter
+{
+public:
+    explicit RuleSegmenter(std::istream &source, size_t chunkSize)
+        : _source{source}
+        , _chunkSize{std::max<size_t>(chunkSize, 1)}
+    {}
+
+public:
+    // The next segment, or nullopt at the end of the source
+    auto next() -> std::optional<RuleSegment>;
+    size_t bytesRead() const
+    {
+        return _bytesRead;
+    }
+
+private:
+    auto take(size_t length) -> RuleSegment;
+
+private:
+    std::istream &_source;
+    size_t _chunkSize{};
+    // Read but not yet cut into a segment
+    std::string _pending;
+    SourceLocation _pendingStart{};
+    size_t _bytesRead{0};
+};
+
+// What one stage of the pipeline got through
+struct StageStats
+{
+    std::string name;
+    // What the stage counts (bytes, rules, filters..)
+    std::string unit;
+    size_t count{0};
+    // Time spent working, rather than waiting on a queue
+    std::chrono::nanoseconds busy{};
+
+    double perSecond() const
+    {
+        return busy.count() ? count / std::chrono::duration<double>(busy).count() : 0.0;
+    }
+};
+
+struct PipelineStats
+{
+    std::vector<StageStats> stages;
+    std::vector<QueueStats> queues;
+    std::chrono::nanoseconds elapsed{};
+
+    // One line per stage then per queue, e.g:
+    // lower: 20000 filters, 15.2ms busy (1315789/s, 61% of 24.9ms)
+    // parsed queue: capacity 4, occupancy 1.3 avg 4 max, 12 full and 3 empty waits
+    std::string toString() const;
+};
+
+struct PipelineResult
+{
+    // Ids of the filters added by the load
+    std::vector<FilterId> filterIds;
+    // and their keys (ZeroGuid where the BFE generated the key)
+    std::vector<GUID> filterKeys;
+    // Filters skipped as they're already installed (see FilterApplier)
+    size_t alreadyInstalledCount{0};
+    // False if the fingerprint hook rolled the load back - nothing was added
+    bool committed{true};
+    PipelineStats stats;
+};
+
+// Loads a ruleset with its stages overlapping rather than one after another:
+//
+//   read -> [segments] -> parse -> [parsed] -> lower -> [lowered] -> submit
+//
+// The source is cut into segments of whole rules, each parsed and lowered into its
+// own FilterBatch while earlier batches are being added to the engine. The queues
+// are bounded, so a slow stage holds back the ones before it rather than letting
+// them run ahead and buffer the whole ruleset.
+//
+// As with FilterApplier, every filter is added in a single transaction, which only
+// commits once all of them are - any failure (including a parse error) rolls back
+// the lot. Submitting runs on the calling thread, so the engine is only used from it;
+// the AppIdResolver and InterfaceResolver are called from the lowering thread.
+template <KeyedFilterEngine EngineT> class LoadPipeline
+{
+public:
+    struct Tuning
+    {
+        // Source read (and parsed) at a time
+        size_t segmentSize{64 * 1024};
+        // Capacity of each queue, in segments
+        size_t queueCapacity{4};
+    };
+
+    // Called as a CommitHook, with the fingerprint of everything loaded. Returns whether
+    // to commit - the fingerprint is only known once every filter has been added, so a
+    // load that isn't wanted after all (e.g the ruleset is unchanged) is rolled back.
+    using FingerprintHook = std::function<bool(const RulesetFingerprint &)>;
+
+public:
+    LoadPipeline(EngineT &engine, const FWPM_DISPLAY_DATA &displayData, std::string rulesetName,
+                 AppIdResolver appIdResolver = {}, WeightAllocator weights = WeightAllocator{},
+                 Tuning tuning = Tuning{}, InterfaceResolver interfaceResolver = {})
+        : _engine{engine}
+        , _displayData{displayData}
+        , _rulesetName{std::move(rulesetName)}
+        , _appIdResolver{std::move(appIdResolver)}
+        , _interfaceResolver{std::move(interfaceResolver)}
+        , _weights{weights}
+        , _tuning{tuning}
+    {}
+
+public:
+    // The fingerprint is built as filters are lowered (see rulesetFingerprint())
+    void beforeCommit(std::string_view fingerprintVariant, FingerprintHook hook)
+    {
+        _fingerprintVariant = fingerprintVariant;
+        _beforeCommit = std::move(hook);
+    }
+
+    // Throws the first error raised by any stage, in pipeline order
+    auto run(std::istream &source) -> PipelineResult
+    {
+        enum Stage
+        {
+            Read,
+            Parse,
+            Lower,
+            Submit,
+            StageCount
+        };
+
+        SpscQueue<RuleSegment> segments{"segments", _tuning.queueCapacity};
+        SpscQueue<ParsedSegment> parsed{"parsed", _tuning.queueCapacity};
+        SpscQueue<FilterBatch> lowered{"lowered", _tuning.queueCapacity};
+
+        PipelineResult result;
+        auto &stages = result.stats.stages;
+        stages = {
+            {"read", "bytes"}, {"parse", "rules"}, {"lower", "filters"}, {"submit", "filters"}};
+        std::exception_ptr errors[StageCount];
+
+        // A failing stage cancels every queue, so the others stop too
+        auto runStage = [&](Stage stage, auto func) {
+            return [&, stage, func] {
+                try
+                {
+                    func(stages[stage]);
+                }
+                catch(...)
+                {
+                    errors[stage] = std::current_exception();
+                    segments.cancel();
+                    parsed.cancel();
+                    lowered.cancel();
+                }
+            };
+        };
+
+        const auto start = std::chrono::steady_clock::now();
+        {
+            std::jthread reader{
+                runStage(Read, [&](auto &stats) { read(source, segments, stats); })};
+            std::jthread parser{
+                runStage(Parse, [&](auto &stats) { parse(segments, parsed, stats); })};
+            std::jthread lowerer{
+                runStage(Lower, [&](auto &stats) { lower(parsed, lowered, stats); })};
+
+            runStage(Submit, [&](auto &stats) { submit(lowered, result, stats); })();
+        }
+        result.stats.elapsed = std::chrono::steady_clock::now() - start;
+        result.stats.queues = {segments.stats(), parsed.stats(), lowered.stats()};
+
+        for(const auto &error : errors)
+        {
+            if(error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+
+        return result;
+    }
+
+private:
+    struct ParsedSegment
+    {
+        std::unique_ptr<RulesetNode> ruleset;
+        // Index of the segment's first rule in the whole ruleset, for weighting
+        size_t firstRuleIndex{0};
+    };
+
+    // Measures the work a stage does, excluding time spent waiting on queues
+    template <typename FuncT> static auto busy(StageStats &stats, FuncT func)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        struct Stop
+        {
+            StageStats &stats;
+            std::chrono::steady_clock::time_point start;
+            ~Stop()
+            {
+                stats.busy += std::chrono::steady_clock::now() - start;
+            }
+        } stop{stats, start};
+
+        return func();
+    }
+
+    void read(std::istream &source, SpscQueue<RuleSegment> &segments, StageStats &stats)
+    {
+        RuleSegmenter segmenter{source, _tuning.segmentSize};
+        while(auto segment = busy(stats, [&] { return segmenter.next(); }))
+        {
+            stats.count = segmenter.bytesRead();
+            if(!segments.push(std::move(*segment)))
+            {
+                return;
+            }
+        }
+        stats.count = segmenter.bytesRead();
+        segments.close();
+    }
+
+    void parse(SpscQueue<RuleSegment> &segments, SpscQueue<ParsedSegment> &parsed,
+               StageStats &stats)
+    {
+        size_t ruleCount{0};
+        while(auto segment = segments.pop())
+        {
+            auto ruleset = busy(stats, [&] {
+                return Parser{Lexer{std::move(segment->text), segment->start}}.parse();
+            });
+            if(!ruleset)
+            {
+                throw std::runtime_error{
+                    std::format("Could not parse rules for: {}", _rulesetName)};
+            }
+
+            const size_t firstRuleIndex = ruleCount;
+            ruleCount += ruleset->children().size();
+            stats.count = ruleCount;
+            if(!parsed.push({std::move(ruleset), firstRuleIndex}))
+            {
+                return;
+            }
+        }
+        parsed.close();
+    }
+
+    void lower(SpscQueue<ParsedSegment> &parsed, SpscQueue<FilterBatch> &lowered,
+               StageStats &stats)
+    {
+        std::optional<FingerprintBuilder> fingerprint;
+        if(_beforeCommit)
+        {
+            fingerprint.emplace(_fingerprintVariant);
+        }
+
+        while(auto segment = parsed.pop())
+        {
+            auto batch = busy(stats, [&] {
+                FilterBatch batch{_displayData, _rulesetName};
+                segment->ruleset->accept(
+                    WfpExecutor{batch, _appIdResolver, _weights, segment->firstRuleIndex,
+                                _interfaceResolver});
+                if(fingerprint)
+                {
+                    fingerprint->add(batch.filters());
+                }
+                return batch;
+            });
+
+            stats.count += batch.size();
+            if(!lowered.push(std::move(batch)))
+            {
+                return;
+            }
+        }
+
+        if(parsed.cancelled())
+        {
+            return;
+        }
+        if(fingerprint)
+        {
+            // Read by the submitter once the queue is closed
+            _fingerprint = fingerprint->finish();
+        }
+        lowered.close();
+    }
+
+    void submit(SpscQueue<FilterBatch> &lowered, PipelineResult &result, StageStats &stats)
+    {
+        // Only begun once there's something to add, so the BFE isn't held up while the
+        // first segment is parsed
+        std::optional<Transaction<EngineT>> transaction;
+        std::unordered_set<GUID> addedKeys;
+
+        while(auto batch = lowered.pop())
+        {
+            busy(stats, [&] {
+                if(!transaction)
+                {
+                    transaction.emplace(_engine);
+                }
+
+                for(const auto &filter : batch->filters())
+                {
+                    FilterId id{};
+                    DWORD status = addOrReweight(_engine, filter, id, addedKeys);
+                    if(status == FWP_E_ALREADY_EXISTS && filter.filterKey != ZeroGuid)
+                    {
+                        ++result.alreadyInstalledCount;
+                    }
+                    else if(status != ERROR_SUCCESS)
+                    {
+                        // Destroying the transaction rolls back every filter added so far
+                        throw WfpError{std::format("Failed to add filter {}, rolled back:",
+                                                   stats.count + 1),
+                                       status};
+                    }
+                    else
+                    {
+                        result.filterIds.push_back(id);
+                        result.filterKeys.push_back(filter.filterKey);
+                    }
+                    ++stats.count;
+                }
+            });
+        }
+
+        // An earlier stage failed - the transaction is rolled back on destruction
+        if(lowered.cancelled())
+        {
+            return;
+        }
+
+        busy(stats, [&] {
+            if(!transaction)
+            {
+                transaction.emplace(_engine);
+            }
+            if(_beforeCommit && !_beforeCommit(_fingerprint))
+            {
+                // Rolled back as the transaction is destroyed
+                result.committed = false;
+                result.filterIds.clear();
+                result.filterKeys.clear();
+                return;
+            }
+            transaction->commit();
+        });
+    }
+
+private:
+    EngineT &_engine;
+    FWPM_DISPLAY_DATA _displayData{};
+    std::string _rulesetName;
+    AppIdResolver _appIdResolver;
+    InterfaceResolver _interfaceResolver;
+    WeightAllocator _weights;
+    Tuning _tuning;
+    std::string _fingerprintVariant;
+    FingerprintHook _beforeCommit;
+    RulesetFingerprint _fingerprint{};
+};
+}
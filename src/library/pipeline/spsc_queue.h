@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <optional>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace wfpk
+{
+// How full a queue ran and how often either end had to wait on the other
+struct QueueStats
+{
+    std::string name;
+    size_t capacity{0};
+    size_t pushCount{0};
+    // Summed over every push, for the average occupancy
+    size_t occupancySum{0};
+    size_t maxOccupancy{0};
+    // Times the producer found the queue full (backpressure)
+    size_t fullWaits{0};
+    // Times the consumer found the queue empty (starved)
+    size_t emptyWaits{0};
+
+    double averageOccupancy() const
+    {
+        return pushCount ? static_cast<double>(occupancySum) / pushCount : 0.0;
+    }
+};
+
+// A bounded, lock-free queue between exactly one producer and one consumer thread.
+// The two ends only share a pair of monotonic indices; a full queue blocks push()
+// and an empty one blocks pop(), waiting on an atomic rather than a lock.
+template <typename T> class SpscQueue
+{
+public:
+    SpscQueue(std::string name, size_t capacity)
+        : _slots(std::max<size_t>(capacity, 1))
+    {
+        _stats.name = std::move(name);
+        _stats.capacity = _slots.size();
+    }
+
+    SpscQueue(SpscQueue &&) = delete;
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+    SpscQueue &operator=(SpscQueue &&) = delete;
+
+public:
+    // Producer only. Blocks while the queue is full.
+    // Returns false (dropping the value) if the queue was cancelled.
+    bool push(T value)
+    {
+        const size_t tail = _tail.load(std::memory_order_relaxed);
+        bool waited{false};
+        while(true)
+        {
+            const auto signal = _signal.load(std::memory_order_acquire);
+            if(_cancelled.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+            if(tail - _head.load(std::memory_order_acquire) < _slots.size())
+            {
+                break;
+            }
+
+            if(!waited)
+            {
+                ++_stats.fullWaits;
+                waited = true;
+            }
+            _signal.wait(signal, std::memory_order_acquire);
+        }
+
+        _slots[tail % _slots.size()] = std::move(value);
+        _tail.store(tail + 1, std::memory_order_release);
+        wake();
+
+        const size_t occupancy = tail + 1 - _head.load(std::memory_order_acquire);
+        ++_stats.pushCount;
+        _stats.occupancySum += occupancy;
+        _stats.maxOccupancy = (std::max)(_stats.maxOccupancy, occupancy);
+
+        return true;
+    }
+
+    // Consumer only. Blocks while the queue is empty.
+    // Returns nullopt once the queue is closed and drained, or cancelled.
+    auto pop() -> std::optional<T>
+    {
+        const size_t head = _head.load(std::memory_order_relaxed);
+        bool waited{false};
+        while(true)
+        {
+            const auto signal = _signal.load(std::memory_order_acquire);
+            if(_cancelled.load(std::memory_order_acquire))
+            {
+                return {};
+            }
+            if(_tail.load(std::memory_order_acquire) != head)
+            {
+                break;
+            }
+            if(_closed.load(std::memory_order_acquire))
+            {
+                return {};
+            }
+
+            if(!waited)
+            {
+                ++_stats.emptyWaits;
+                waited = true;
+            }
+            _signal.wait(signal, std::memory_order_acquire);
+        }
+
+        auto &slot = _slots[head % _slots.size()];
+        std::optional<T> value{std::move(slot)};
+        slot.reset();
+        _head.store(head + 1, std::memory_order_release);
+        wake();
+
+        return value;
+    }
+
+    // Producer only - no more values will be pushed
+    void close()
+    {
+        _closed.store(true, std::memory_order_release);
+        wake();
+    }
+
+    // Either end (or anyone else) - abandon the queue, waking both ends
+    void cancel()
+    {
+        _cancelled.store(true, std::memory_order_release);
+        wake();
+    }
+
+    bool cancelled() const
+    {
+        return _cancelled.load(std::memory_order_acquire);
+    }
+
+    // Only meaningful once both ends are done
+    const QueueStats &stats() const
+    {
+        return _stats;
+    }
+
+private:
+    void wake()
+    {
+        _signal.fetch_add(1, std::memory_order_release);
+        _signal.notify_all();
+    }
+
+private:
+    std::vector<std::optional<T>> _slots;
+    // Counts of values popped and pushed, the difference is the occupancy
+    std::atomic<size_t> _head{0};
+    std::atomic<size_t> _tail{0};
+    // Bumped on every change either end may be waiting for
+    std::atomic<uint32_t> _signal{0};
+    std::atomic<bool> _closed{false};
+    std::atomic<bool> _cancelled{false};
+    // Push stats belong to the producer, emptyWaits to the consumer
+    QueueStats _stats;
+};
+}
@@ -0,0 +1,150 @@
+#include <sha1.h>
+#include <bit>
+#include <cstring>
+
+namespace wfpk
+{
+Sha1::Sha1()
+    : _state{0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0}
+{}
+
+void Sha1::update(const void *data, size_t size)
+{
+    auto pBytes = static_cast<const uint8_t *>(data);
+    _totalSize += size;
+
+    while(size > 0)
+    {
+        const size_t count = (std::min)(size, _buffer.size() - _bufferSize);
+        std::memcpy(_buffer.data() + _bufferSize, pBytes, count);
+        _bufferSize += count;
+        pBytes += count;
+        size -= count;
+
+        if(_bufferSize == _buffer.size())
+        {
+            processBlock(_buffer.data());
+            _bufferSize = 0;
+        }
+    }
+}
+
+auto Sha1::finish() -> Digest
+{
+    const uint64_t totalBits = _totalSize * 8;
+
+    // Pad with 0x80 then zeros, leaving 8 bytes for the big-endian message length
+    const uint8_t padStart = 0x80;
+    update(&padStart, 1);
+    const uint8_t zero = 0;
+    while(_bufferSize != 56)
+    {
+        update(&zero, 1);
+    }
+
+    uint8_t length[8];
+    for(int i = 0; i < 8; ++i)
+    {
+        length[i] = static_cast<uint8_t>(totalBits >> (56 - 8 * i));
+    }
+    update(length, sizeof(length));
+
+    Digest digest{};
+    for(size_t i = 0; i < _state.size(); ++i)
+    {
+        for(size_t j = 0; j < 4; ++j)
+        {
+            digest[i * 4 + j] = static_cast<uint8_t>(_state[i] >> (24 - 8 * j));
+        }
+    }
+
+    return digest;
+}
+
+void Sha1::processBlock(const uint8_t *block)
+{
+    uint32_t w[80];
+    for(int i = 0; i < 16; ++i)
+    {
+        w[i] = (uint32_t{block[i * 4]} << 24) | (uint32_t{block[i * 4 + 1]} << 16) |
+               (uint32_t{block[i * 4 + 2]} << 8) | uint32_t{block[i * 4 + 3]};
+    }
+    for(int i = 16; i < 80; ++i)
+    {
+        w[i] = std::rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    auto [a, b, c, d, e] = _state;
+
+    for(int i = 0; i < 80; ++i)
+    {
+        uint32_t f{}, k{};
+        if(i < 20)
+        {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        }
+        else if(i < 40)
+        {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        }
+        else if(i < 60)
+        {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        }
+        else
+        {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+
+        const uint32_t temp = std::rotl(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = std::rotl(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    _state[0] += a;
+    _state[1] += b;
+    _state[2] += c;
+    _state[3] += d;
+    _state[4] += e;
+}
+
+GUID nameBasedGuid(const GUID &namespaceKey, std::string_view name)
+{
+    // RFC 4122 hashes the namespace in network byte order
+    uint8_t namespaceBytes[16];
+    for(int i = 0; i < 4; ++i)
+    {
+        namespaceBytes[i] = static_cast<uint8_t>(namespaceKey.Data1 >> (24 - 8 * i));
+    }
+    namespaceBytes[4] = static_cast<uint8_t>(namespaceKey.Data2 >> 8);
+    namespaceBytes[5] = static_cast<uint8_t>(namespaceKey.Data2);
+    namespaceBytes[6] = static_cast<uint8_t>(namespaceKey.Data3 >> 8);
+    namespaceBytes[7] = static_cast<uint8_t>(namespaceKey.Data3);
+    std::memcpy(namespaceBytes + 8, namespaceKey.Data4, 8);
+
+    Sha1 sha1;
+    sha1.update(namespaceBytes, sizeof(namespaceBytes));
+    sha1.update(name);
+    auto digest = sha1.finish();
+
+    // Version 5 and the RFC 4122 variant
+    digest[6] = static_cast<uint8_t>((digest[6] & 0x0F) | 0x50);
+    digest[8] = static_cast<uint8_t>((digest[8] & 0x3F) | 0x80);
+
+    GUID guid{};
+    guid.Data1 = (uint32_t{digest[0]} << 24) | (uint32_t{digest[1]} << 16) |
+                 (uint32_t{digest[2]} << 8) | uint32_t{digest[3]};
+    guid.Data2 = static_cast<unsigned short>((digest[4] << 8) | digest[5]);
+    guid.Data3 = static_cast<unsigned short>((digest[6] << 8) | digest[7]);
+    std::memcpy(guid.Data4, digest.data() + 8, 8);
+
+    return guid;
+}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <guiddef.h>
+#include <array>
+#include <string_view>
+#include <cstdint>
+
+namespace wfpk
+{
+// Incremental SHA-1 (FIPS 180-4).
+// Used for content-derived identifiers, not for anything security sensitive.
+class Sha1
+{
+public:
+    using Digest = std::array<uint8_t, 20>;
+
+public:
+    Sha1();
+
+public:
+    void update(const void *data, size_t size);
+    void update(std::string_view data)
+    {
+        update(data.data(), data.size());
+    }
+    // Completes the hash - the object should not be updated afterwards
+    auto finish() -> Digest;
+
+    static auto hash(std::string_view data) -> Digest
+    {
+        Sha1 sha1;
+        sha1.update(data);
+        return sha1.finish();
+    }
+
+private:
+    void processBlock(const uint8_t *block);
+
+private:
+    std::array<uint32_t, 5> _state{};
+    std::array<uint8_t, 64> _buffer{};
+    size_t _bufferSize{0};
+    uint64_t _totalSize{0};
+};
+
+// A name-based (version 5) GUID as defined by RFC 4122: the same namespace and
+// name always produce the same GUID.
+GUID nameBasedGuid(const GUID &namespaceKey, std::string_view name);
+}
@@ -99,6 +99,21 @@ std::string wideStringToString(const std::wstring &wstr)
     return str;
 }
 
+std::wstring stringToWideString(const std::string &str)
+{
+    if(str.empty())
+    {
+        return {};
+    }
+
+    const int size =
+        MultiByteToWideChar(CP_UTF8, 0, str.data(), static_cast<int>(str.size()), nullptr, 0);
+    std::wstring wstr(size, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, str.data(), static_cast<int>(str.size()), wstr.data(), size);
+
+    return wstr;
+}
+
 std::string toLowercase(const std::string &str)
 {
     std::string ret;
@@ -111,6 +126,12 @@ std::string toLowercase(const std::string &str)
     return ret;
 }
 
+auto wfpkDataDirectory() -> std::filesystem::path
+{
+    const char *programData = std::getenv("ProgramData");
+    return std::filesystem::path{programData ? programData : "."} / "wfpk";
+}
+
 std::string getErrorString(DWORD errorCode)
 {
     LPSTR errMsg = nullptr;
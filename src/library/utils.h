@@ -17,6 +17,7 @@
 #include <concepts>
 #include <assert.h>
 #include <filesystem>
+#include <chrono>
 #include <magic_enum.h>
 
 // Allow GUID to be used as a key in a hash
@@ -31,18 +32,24 @@ template <> struct std::hash<GUID>
 
 namespace wfpk
 {
-// CRTP singleton mixin
-template <class Derived> class Singleton
+// CRTP mixin making the first instance of a class (while it lives) reachable via
+// instance(). Further instances can exist alongside it but aren't reachable.
+template <class Derived> class PrimaryInstance
 {
 public:
-    Singleton()
+    PrimaryInstance()
     {
-        assert(_instance == nullptr);
-        _instance = this;
+        if(!_instance)
+        {
+            _instance = this;
+        }
     }
-    ~Singleton()
+    ~PrimaryInstance()
     {
-        _instance = nullptr;
+        if(_instance == this)
+        {
+            _instance = nullptr;
+        }
     }
     static Derived *instance()
     {
@@ -50,7 +57,7 @@ public:
     }
 
 private:
-    inline static Singleton *_instance = nullptr;
+    inline static PrimaryInstance *_instance = nullptr;
 };
 
 template <class Derived> struct OStreamTraceable
@@ -87,6 +94,8 @@ struct in6_addr stringToIp6(const std::string &addressStr);
 std::string blobToString(const FWP_BYTE_BLOB &blob);
 // Convert a std::wstring to a std::string
 std::string wideStringToString(const std::wstring &wstr);
+// Convert a UTF-8 std::string (e.g a path from a ruleset) to a std::wstring
+std::wstring stringToWideString(const std::string &str);
 // Convert a GUID to a std::string
 std::string guidToString(const GUID &guid);
 // Lowercase a string
@@ -94,6 +103,9 @@ std::string toLowercase(const std::string &input);
 
 std::string getErrorString(DWORD errorCode);
 
+// Where wfpk keeps its local state: %ProgramData%\wfpk
+auto wfpkDataDirectory() -> std::filesystem::path;
+
 // Validate a string contains an ipv4 address
 bool isIpv4(const std::string &ipAddress);
 // Validate a string contains an ipv6 address
@@ -117,6 +129,93 @@ template <typename T> std::string joinVec(const std::vector<T> &ports)
     return oss.str();
 }
 
+// Records the wall-clock duration of named phases (in the order they ran)
+// so long running operations can report where their time went.
+class PhaseTimings
+{
+public:
+    using Duration = std::chrono::microseconds;
+
+    // Run func() and record how long it took under the given phase name
+    template <typename FuncT>
+        requires std::invocable<FuncT>
+    auto measure(const std::string &phase, FuncT func) -> std::invoke_result_t<FuncT>
+    {
+        const auto start = std::chrono::steady_clock::now();
+        auto record = [&] {
+            _phases.emplace_back(phase, std::chrono::duration_cast<Duration>(
+                                            std::chrono::steady_clock::now() - start));
+        };
+
+        if constexpr(std::is_void_v<std::invoke_result_t<FuncT>>)
+        {
+            func();
+            record();
+        }
+        else
+        {
+            auto result = func();
+            record();
+            return result;
+        }
+    }
+
+    void add(const std::string &phase, Duration duration)
+    {
+        _phases.emplace_back(phase, duration);
+    }
+
+    // Add all phases of another set of timings, with their names prefixed, e.g "apply.commit"
+    void merge(const std::string &prefix, const PhaseTimings &other)
+    {
+        for(const auto &[phase, duration] : other._phases)
+        {
+            _phases.emplace_back(std::format("{}.{}", prefix, phase), duration);
+        }
+    }
+
+    // Add all phases of another set of timings as they are
+    void append(const PhaseTimings &other)
+    {
+        _phases.insert(_phases.end(), other._phases.begin(), other._phases.end());
+    }
+
+    auto phases() const -> const std::vector<std::pair<std::string, Duration>> &
+    {
+        return _phases;
+    }
+
+    Duration total() const
+    {
+        Duration sum{};
+        for(const auto &[phase, duration] : _phases)
+        {
+            sum += duration;
+        }
+
+        return sum;
+    }
+
+    // e.g "parse: 1.20ms, lower: 0.30ms, apply: 12.00ms"
+    std::string toString() const
+    {
+        std::string result;
+        for(const auto &[phase, duration] : _phases)
+        {
+            if(!result.empty())
+            {
+                result += ", ";
+            }
+            result += std::format("{}: {:.2f}ms", phase, duration.count() / 1000.0);
+        }
+
+        return result;
+    }
+
+private:
+    std::vector<std::pair<std::string, Duration>> _phases;
+};
+
 template <typename T>
 auto concatVec(const std::vector<T> &vec1, const std::vector<T> &vec2) -> std::vector<T>
 {
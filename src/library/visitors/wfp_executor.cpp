@@ -1,15 +1,187 @@
 #include <visitors/wfp_executor.h>
 #include <utils.h>
+#include <cstring>
 
 namespace wfpk
 {
+namespace
+{
+using Direction = FilterNode::Direction;
+using IpVersion = FilterConditions::IpVersion;
+
+// Filters are emitted per address family, as WFP layers are
+enum class AddressFamily
+{
+    V4,
+    V6
+};
+
+const GUID &layerFor(Direction direction, AddressFamily family)
+{
+    if(direction == Direction::Out)
+    {
+        return family == AddressFamily::V4 ? FWPM_LAYER_ALE_AUTH_CONNECT_V4
+                                           : FWPM_LAYER_ALE_AUTH_CONNECT_V6;
+    }
+    else
+    {
+        return family == AddressFamily::V4 ? FWPM_LAYER_ALE_AUTH_RECV_ACCEPT_V4
+                                           : FWPM_LAYER_ALE_AUTH_RECV_ACCEPT_V6;
+    }
+}
+
+auto addressesFor(const IpAddresses &addresses, AddressFamily family)
+    -> const std::vector<std::string> &
+{
+    return family == AddressFamily::V4 ? addresses.v4 : addresses.v6;
+}
+
+// A rule only applies to a family if it allows that ip version and every address
+// constraint it has (source and dest) can be met by an address of that family.
+bool appliesToFamily(const FilterConditions &conditions, AddressFamily family)
+{
+    if((family == AddressFamily::V4 && conditions.ipVersion == IpVersion::Inet6) ||
+       (family == AddressFamily::V6 && conditions.ipVersion == IpVersion::Inet4))
+    {
+        return false;
+    }
+
+    auto canMatch = [&](const IpAddresses &addresses) {
+        return addresses.empty() || !addressesFor(addresses, family).empty();
+    };
+
+    return canMatch(conditions.sourceIps) && canMatch(conditions.destIps);
+}
+
+// Splits "address/prefix" - the prefix defaults to the full address length
+auto splitSubnet(const std::string &addressStr, uint32_t maxPrefix)
+    -> std::pair<std::string, uint32_t>
+{
+    if(std::ranges::find(addressStr, '/') == addressStr.end())
+    {
+        return {addressStr, maxPrefix};
+    }
+
+    auto parts = splitString(addressStr, '/');
+    uint32_t prefix = std::min<uint32_t>(atoi(parts.back().c_str()), maxPrefix);
 
-struct BasicFilter : public FWPM_FILTER
+    return {parts.front(), prefix};
+}
+
+FWP_V4_ADDR_AND_MASK v4AddressWithMask(const std::string &addressStr)
+{
+    const auto &[address, prefix] = splitSubnet(addressStr, 32);
+
+    FWP_V4_ADDR_AND_MASK addressWithMask{};
+    addressWithMask.addr = stringToIp4(address);
+    // A /32 subnet contains all 1s (and avoid shifting by 32 for /0)
+    addressWithMask.mask = prefix == 0 ? 0 : ~0U << (32 - prefix);
+
+    return addressWithMask;
+}
+
+FWP_V6_ADDR_AND_MASK v6AddressWithMask(const std::string &addressStr)
 {
-    BasicFilter(uint8_t weight)
-        : FWPM_FILTER{}
+    const auto &[address, prefix] = splitSubnet(addressStr, 128);
+
+    FWP_V6_ADDR_AND_MASK addressWithMask{};
+    const struct in6_addr ip6 = stringToIp6(address);
+    static_assert(sizeof(ip6) == sizeof(addressWithMask.addr));
+    std::memcpy(addressWithMask.addr, &ip6, sizeof(addressWithMask.addr));
+    addressWithMask.prefixLength = static_cast<UINT8>(prefix);
+
+    return addressWithMask;
+}
+
+// Builds up the conditions for a single filter
+class ConditionList
+{
+public:
+    explicit ConditionList(FilterBatch &batch)
+        : _batch{batch}
     {}
+
+public:
+    void addAddresses(const GUID &fieldKey, const IpAddresses &addresses, AddressFamily family)
+    {
+        for(const auto &addressStr : addressesFor(addresses, family))
+        {
+            FWPM_FILTER_CONDITION &condition = add(fieldKey);
+            if(family == AddressFamily::V4)
+            {
+                condition.conditionValue.type = FWP_V4_ADDR_MASK;
+                condition.conditionValue.v4AddrMask = _batch.store(v4AddressWithMask(addressStr));
+            }
+            else
+            {
+                condition.conditionValue.type = FWP_V6_ADDR_MASK;
+                condition.conditionValue.v6AddrMask = _batch.store(v6AddressWithMask(addressStr));
+            }
+        }
+    }
+
+    void addPorts(const GUID &fieldKey, const std::vector<uint16_t> &ports)
+    {
+        for(const auto &port : ports)
+        {
+            FWPM_FILTER_CONDITION &condition = add(fieldKey);
+            condition.conditionValue.type = FWP_UINT16;
+            condition.conditionValue.uint16 = port;
+        }
+    }
+
+    void addProtocol(FilterConditions::TransportProtocol transportProtocol)
+    {
+        using TransportProtocol = FilterConditions::TransportProtocol;
+
+        // No condition needed to match all transports
+        if(transportProtocol == TransportProtocol::AllTransports)
+        {
+            return;
+        }
+
+        FWPM_FILTER_CONDITION &condition = add(FWPM_CONDITION_IP_PROTOCOL);
+        condition.conditionValue.type = FWP_UINT8;
+        condition.conditionValue.uint8 =
+            transportProtocol == TransportProtocol::Tcp ? IPPROTO_TCP : IPPROTO_UDP;
+    }
+
+    void addAppId(const std::vector<UINT8> &appId)
+    {
+        // The batch stores its own copy of the data
+        FWP_BYTE_BLOB blob{static_cast<UINT32>(appId.size()), const_cast<UINT8 *>(appId.data())};
+
+        FWPM_FILTER_CONDITION &condition = add(FWPM_CONDITION_ALE_APP_ID);
+        condition.conditionValue.type = FWP_BYTE_BLOB_TYPE;
+        condition.conditionValue.byteBlob = _batch.store(blob);
+    }
+
+    void addInterface(UINT64 interfaceLuid)
+    {
+        FWPM_FILTER_CONDITION &condition = add(FWPM_CONDITION_IP_LOCAL_INTERFACE);
+        condition.conditionValue.type = FWP_UINT64;
+        condition.conditionValue.uint64 = _batch.store(interfaceLuid);
+    }
+
+    auto conditions() const -> std::span<const FWPM_FILTER_CONDITION>
+    {
+        return _conditions;
+    }
+
+private:
+    FWPM_FILTER_CONDITION &add(const GUID &fieldKey)
+    {
+        FWPM_FILTER_CONDITION &condition = _conditions.emplace_back();
+        condition.fieldKey = fieldKey;
+        condition.matchType = FWP_MATCH_EQUAL;
+        return condition;
+    }
+
+private:
+    FilterBatch &_batch;
+    std::vector<FWPM_FILTER_CONDITION> _conditions;
 };
+}
 
 void WfpExecutor::visit(const RulesetNode &ruleset) const
 {
@@ -22,84 +194,97 @@ void WfpExecutor::visit(const RulesetNode &ruleset) const
 void WfpExecutor::visit(const FilterNode &filterNode) const
 {
     using Action = FilterNode::Action;
-    using Direction = FilterNode::Direction;
-
-    std::cout << "Adding rule: " << filterNode << std::endl;
 
     FWPM_FILTER filter{};
-    std::unique_ptr<FWPM_PROVIDER, WfpDeleter> pProvider{
-        _engine.getProviderByKey(PIA_PROVIDER_KEY)};
 
-    // Basic filter setup
+    // Basic filter setup - display data is supplied by the batch
     filter.providerKey = &PIA_PROVIDER_KEY;
     filter.subLayerKey = PIA_SUBLAYER_KEY;
     filter.flags = FWPM_FILTER_FLAG_PERSISTENT | FWPM_FILTER_FLAG_INDEXED;
-    filter.weight.type = FWP_UINT8;
-    filter.weight.uint8 = 10;
-    filter.displayData = pProvider->displayData;
-
-    if(filterNode.direction() == Direction::Out)
-    {
-        filter.layerKey = FWPM_LAYER_ALE_AUTH_CONNECT_V4;
-    }
-    else if(filterNode.direction() == Direction::In)
-    {
-        filter.layerKey = FWPM_LAYER_ALE_AUTH_RECV_ACCEPT_V4;
-    }
+    filter.weight.type = FWP_UINT64;
 
-    if(filterNode.action() == FilterNode::Action::Permit)
+    if(filterNode.action() == Action::Permit)
     {
         filter.action.type = FWP_ACTION_PERMIT;
     }
-    else if(filterNode.action() == FilterNode::Action::Block)
+    else if(filterNode.action() == Action::Block)
     {
         filter.action.type = FWP_ACTION_BLOCK;
     }
 
-    const auto filterConditions = filterNode.filterConditions();
+    const auto &conditions = filterNode.filterConditions();
+
+    // Source and dest map to local/remote depending on the direction of traffic
+    const bool isOutbound = filterNode.direction() == Direction::Out;
+    const GUID &sourceAddressField =
+        isOutbound ? FWPM_CONDITION_IP_LOCAL_ADDRESS : FWPM_CONDITION_IP_REMOTE_ADDRESS;
+    const GUID &destAddressField =
+        isOutbound ? FWPM_CONDITION_IP_REMOTE_ADDRESS : FWPM_CONDITION_IP_LOCAL_ADDRESS;
+    const GUID &sourcePortField =
+        isOutbound ? FWPM_CONDITION_IP_LOCAL_PORT : FWPM_CONDITION_IP_REMOTE_PORT;
+    const GUID &destPortField =
+        isOutbound ? FWPM_CONDITION_IP_REMOTE_PORT : FWPM_CONDITION_IP_LOCAL_PORT;
 
-    if(filterConditions == wfpk::NoFilterConditions)
+    const size_t ruleIndex = _ruleIndex++;
+
+    std::vector<UINT8> appId;
+    if(!conditions.sourceApp.empty())
     {
-        filter.filterCondition = nullptr;
-        filter.numFilterConditions = 0;
+        if(_appIdResolver)
+        {
+            appId = _appIdResolver(conditions.sourceApp);
+        }
 
-        //_engine.add(filter);
+        if(appId.empty())
+        {
+            throw std::runtime_error{
+                std::format("Could not resolve app id for: {}", conditions.sourceApp)};
+        }
     }
-    else
+
+    std::optional<UINT64> interfaceLuid;
+    if(!conditions.interfaceName.empty())
     {
-        for(const auto &addressStr : filterConditions.destIps.v4)
+        if(_interfaceResolver)
         {
-            // Add a condition for an application id constraint
-            FWPM_FILTER_CONDITION condition{};
-            FWP_V4_ADDR_AND_MASK addressWithMask;
-
-            if(std::ranges::find(addressStr, '/') != addressStr.end())
-            {
-                auto parts = splitString(addressStr, '/');
-                uint32_t address = stringToIp4(parts.front());
-                uint32_t prefix = atoi(parts.back().c_str());
+            interfaceLuid = _interfaceResolver(conditions.interfaceName);
+        }
 
-                addressWithMask.addr = address;
-                addressWithMask.mask = ~0UL << (32 - prefix);
-            }
-            else
-            {
-                uint32_t address = stringToIp4(addressStr);
-                addressWithMask.addr = address;
-                // /32 subnet contains all 1s
-                addressWithMask.mask = ~0UL;
-            }
+        if(!interfaceLuid)
+        {
+            throw std::runtime_error{
+                std::format("Could not resolve interface: {}", conditions.interfaceName)};
+        }
+    }
 
-            condition.fieldKey = FWPM_CONDITION_IP_REMOTE_ADDRESS;
-            condition.matchType = FWP_MATCH_EQUAL;
-            condition.conditionValue.type = FWP_V4_ADDR_MASK;
-            condition.conditionValue.v4AddrMask = &addressWithMask;
+    for(const auto family : {AddressFamily::V4, AddressFamily::V6})
+    {
+        if(!appliesToFamily(conditions, family))
+        {
+            continue;
+        }
 
-            filter.filterCondition = &condition;
-            filter.numFilterConditions = 1;
+        filter.layerKey = layerFor(filterNode.direction(), family);
 
-            //_engine.add(filter);
+        ConditionList conditionList{_batch};
+        conditionList.addAddresses(sourceAddressField, conditions.sourceIps, family);
+        conditionList.addAddresses(destAddressField, conditions.destIps, family);
+        conditionList.addPorts(sourcePortField, conditions.sourcePorts);
+        conditionList.addPorts(destPortField, conditions.destPorts);
+        conditionList.addProtocol(conditions.transportProtocol);
+        if(!appId.empty())
+        {
+            conditionList.addAppId(appId);
+        }
+        if(interfaceLuid)
+        {
+            conditionList.addInterface(*interfaceLuid);
         }
+
+        filter.weight.uint64 = _batch.store(
+            _weights.weightFor(ruleIndex, conditionSpecificity(conditionList.conditions())));
+
+        _batch.add(filter, conditionList.conditions());
     }
 }
 }
@@ -1,15 +1,43 @@
 #pragma once
 
 #include <parser/nodes.h>
-#include <wfp_objects.h>
+#include <apply/filter_batch.h>
+#include <apply/weight_allocator.h>
+#include <functional>
 
 namespace wfpk
 {
+// Resolves an application path to its WFP app id (see FwpmGetAppIdFromFileName).
+// Returns an empty vector if the app id cannot be resolved.
+using AppIdResolver = std::function<std::vector<UINT8>(const std::string &appPath)>;
+
+// Resolves a network interface's name to its LUID (see InterfaceTable).
+// Returns nullopt if there's no interface with that name.
+using InterfaceResolver = std::function<std::optional<UINT64>(const std::string &interfaceName)>;
+
+// Lowers a ruleset into WFP filters.
+// Filters are collected into a FilterBatch rather than added to the engine directly,
+// so the whole ruleset can be applied as a single transaction.
+//
+// Each rule produces at most one filter per address family. WFP ORs conditions that
+// share a field key (and ANDs different fields), so all of a rule's addresses, ports
+// etc. become conditions on the same filter rather than a filter each.
+//
+// Filters are weighted by the WeightAllocator from their rule's index in the ruleset.
+// Rules are numbered in the order they're visited, starting from firstRuleIndex.
 class WfpExecutor
 {
 public:
-    explicit WfpExecutor(Engine &engine)
-        : _engine{engine}
+    // The appIdResolver is only needed for rules that constrain a source app, and the
+    // interfaceResolver for rules on an interface
+    explicit WfpExecutor(FilterBatch &batch, AppIdResolver appIdResolver = {},
+                         WeightAllocator weights = WeightAllocator{}, size_t firstRuleIndex = 0,
+                         InterfaceResolver interfaceResolver = {})
+        : _batch{batch}
+        , _appIdResolver{std::move(appIdResolver)}
+        , _interfaceResolver{std::move(interfaceResolver)}
+        , _weights{weights}
+        , _ruleIndex{firstRuleIndex}
     {}
 
 public:
@@ -17,6 +45,11 @@ public:
     void visit(const FilterNode &filterNode) const;
 
 private:
-    Engine &_engine;
+    FilterBatch &_batch;
+    AppIdResolver _appIdResolver;
+    InterfaceResolver _interfaceResolver;
+    WeightAllocator _weights;
+    // Nodes accept a const visitor, so the rule counter has to be mutable
+    mutable size_t _ruleIndex{};
 };
 }
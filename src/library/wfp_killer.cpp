@@ -10,7 +10,18 @@
 #include <wfp_ostream_helpers.h>
 #include <wfp_name_mapper.h>
 #include <parser/parser.h>
-#include <visitors/wfp_executor.h>
+#include <apply/filter_plan.h>
+#include <apply/filter_applier.h>
+#include <apply/filter_diff.h>
+#include <apply/ruleset_fingerprint.h>
+#include <apply/swap_applier.h>
+#include <apply/ephemeral_filters.h>
+#include <apply/app_id_cache.h>
+#include <apply/interface_table.h>
+#include <pipeline/load_pipeline.h>
+#include <engine/parallel_filter_enum.h>
+#include <engine/live_filter_mirror.h>
+#include <mutex>
 
 // We only need a minimal windows.h
 #define WIN32_LEAN_AND_MEAN
@@ -31,9 +42,104 @@ const std::vector kLayers = {FWPM_LAYER_OUTBOUND_TRANSPORT_V4,   FWPM_LAYER_OUTB
                              FWPM_LAYER_OUTBOUND_IPPACKET_V4};
 
 using Options = WfpKiller::Options;
+
+// Filters in a plan are never installed, so they don't need the provider's display data
+FWPM_DISPLAY_DATA kPlanDisplayData{const_cast<wchar_t *>(L"wfpk plan"), nullptr};
+
+// What monitor()'s event callback is given
+struct MonitorContext
+{
+    const Engine &engine;
+    LiveFilterMirror<Engine> &filters;
+    // Events can be delivered on several threads at once
+    std::mutex mutex;
+};
+
+// The filter that allowed or dropped a classify event, 0 for any other event
+UINT64 appliedFilterId(const FWPM_NET_EVENT &event)
+{
+    switch(event.type)
+    {
+        case FWPM_NET_EVENT_TYPE_CLASSIFY_DROP: return event.classifyDrop->filterId;
+        case FWPM_NET_EVENT_TYPE_CLASSIFY_ALLOW: return event.classifyAllow->filterId;
+        default: return 0;
+    }
+}
+
+void printAppliedFilter(MonitorContext &context, UINT64 filterId)
+{
+    try
+    {
+        context.filters.sync();
+        if(const auto filter = context.filters.find(filterId))
+        {
+            std::cout << "\n    - (Filter applied: " << *filter << ")";
+            return;
+        }
+    }
+    // Not just WfpErrors - this runs in the BFE's callback, which nothing may escape
+    // (e.g the mirror's std::length_error when a key table is full, or a bad_alloc)
+    catch(const std::exception &ex)
+    {
+        std::cerr << ex.what() << "\n";
+    }
+
+    // Not in one of kLayers, so it's fetched instead
+    std::unique_ptr<FWPM_FILTER, WfpDeleter> pFilter{context.engine.getFilterById(filterId)};
+    if(pFilter)
+    {
+        std::cout << "\n    - (Filter applied: " << *pFilter << ")";
+    }
 }
 
-void WfpKiller::loadFilters(const std::string &sourceFile)
+// Print each rule of a ruleset. It's parsed again for this, as a load lowers its rules on
+// worker threads - where a line per rule would interleave, and cost the load its speed.
+void printRules(const std::string &source)
+{
+    if(const auto ast = Parser{source}.parse())
+    {
+        for(const auto &pRule : ast->children())
+        {
+            std::cout << std::format("Adding rule: {}\n", pRule->toString());
+        }
+    }
+}
+
+// A layer's filters mirrored heaviest first - see SortedFilters
+FilterMirror mirrorByWeight(const std::vector<std::shared_ptr<FWPM_FILTER>> &filters)
+{
+    SortedFilters sorted;
+    sorted.reserve(filters.size());
+    for(const auto &pFilter : filters)
+    {
+        sorted.add(*pFilter);
+    }
+    sorted.sort();
+
+    FilterMirror mirror;
+    mirror.reserve(filters.size());
+    for(const auto &entry : sorted)
+    {
+        mirror.add(*entry.pFilter);
+    }
+    return mirror;
+}
+
+// Print each object as it's enumerated, using its operator<<
+template <typename ObjectT> void printObjects(const Engine &engine, std::string_view kind)
+{
+    size_t count{0};
+    for(const auto &pObject : engine.objects<ObjectT>())
+    {
+        std::cout << *pObject << "\n";
+        ++count;
+    }
+
+    std::cout << std::format("\nTotal number of {}: {}\n", kind, count);
+}
+}
+
+void WfpKiller::loadFilters(const std::string &sourceFile, const LoadOptions &options)
 {
     std::ifstream file{sourceFile};
 
@@ -42,13 +148,221 @@ void WfpKiller::loadFilters(const std::string &sourceFile)
         throw std::runtime_error{std::format("Could not open file: {}", sourceFile)};
     }
 
+    const std::string rulesetName = options.rulesetName.empty()
+                                        ? std::filesystem::path{sourceFile}.stem().string()
+                                        : options.rulesetName;
+
+    // Called from planRuleset's workers (or LoadPipeline's lowering thread) on a cache
+    // miss - FwpmGetAppIdFromFileName needs no engine session
+    auto lookupAppId = [&](const std::string &appPath) {
+        std::unique_ptr<FWP_BYTE_BLOB, WfpDeleter> pBlob{
+            _engine.getAppIdFromFileName(stringToWideString(appPath))};
+
+        return pBlob ? std::vector<UINT8>(pBlob->data, pBlob->data + pBlob->size)
+                     : std::vector<UINT8>{};
+    };
+    AppIdCache appIds{lookupAppId, defaultAppIdCachePath()};
+    const auto resolveAppId = appIds.resolver();
+
+    // The cache only saves time, so failing to save it doesn't fail the load
+    auto saveAppIds = [&] {
+        const auto stats = appIds.stats();
+        if(stats.hits + stats.misses > 0)
+        {
+            std::cout << std::format("App ids: {}\n", stats.toString());
+        }
+
+        try
+        {
+            appIds.save();
+        }
+        catch(const std::exception &ex)
+        {
+            std::cerr << std::format("Warning: {}\n", ex.what());
+        }
+    };
+
+    // Rules naming an interface ("on \"Wi-Fi\"") are resolved against the adapters
+    // enumerated once, on the first such rule
+    const InterfaceTable interfaces;
+
+    if(options.pipelined)
+    {
+        if(options.verbose)
+        {
+            std::stringstream source;
+            source << file.rdbuf();
+            printRules(source.str());
+            file.clear();
+            file.seekg(0);
+        }
+
+        const auto pProvider = piaProvider();
+
+        LoadPipeline pipeline{_engine, pProvider->displayData, rulesetName, resolveAppId,
+                              WeightAllocator{options.weightPolicy}, {}, interfaces.resolver()};
+        // The fingerprint is only known once every filter has been lowered and added - too
+        // late to skip the load, so an unchanged ruleset is rolled back instead
+        FingerprintStore fingerprints{_engine};
+        RulesetFingerprint loaded{};
+        pipeline.beforeCommit(enumName(options.applyMode), [&](const auto &fingerprint) {
+            loaded = fingerprint;
+            if(!options.force && fingerprints.installed() == fingerprint)
+            {
+                return false;
+            }
+            fingerprints.record(fingerprint);
+            return true;
+        });
+
+        auto result = pipeline.run(file);
+        saveAppIds();
+        if(!result.committed)
+        {
+            std::cout << std::format(
+                "{} is already loaded (fingerprint {}), use --force to reload\n", sourceFile,
+                fingerprintString(loaded));
+            std::cout << result.stats.toString();
+            return;
+        }
+        journalLoad(rulesetName, result.filterIds, result.filterKeys);
+
+        std::cout << std::format("Loaded {} filters ({} already installed) from {}\n",
+                                 result.filterIds.size(), result.alreadyInstalledCount,
+                                 sourceFile);
+        std::cout << result.stats.toString();
+        return;
+    }
+
+    PhaseTimings timings;
+
     std::stringstream buffer;
-    buffer << file.rdbuf();
+    timings.measure("read", [&] { buffer << file.rdbuf(); });
+    if(options.verbose)
+    {
+        printRules(buffer.str());
+    }
+
+    if(!options.planFile.empty())
+    {
+        // A dry run - nothing is read from or written to the BFE.
+        // Display data isn't part of the plan, so the provider's isn't needed.
+        auto plan = planRuleset(buffer.str(), kPlanDisplayData, rulesetName, resolveAppId,
+                                options.weightPolicy, interfaces.resolver());
+        timings.append(plan.timings);
+        saveAppIds();
+
+        std::ofstream planFile{options.planFile};
+        if(!planFile.is_open())
+        {
+            throw std::runtime_error{std::format("Could not open plan file: {}", options.planFile)};
+        }
+
+        timings.measure("write", [&] {
+            plan.allocations.measure("write",
+                                     [&] { writeFilterPlan(planFile, plan.batch.filters()); });
+        });
+
+        std::cout << std::format("Planned {} filters from {} into {}\n", plan.batch.size(),
+                                 sourceFile, options.planFile);
+        std::cout << std::format("Timings: {}\n", timings.toString());
+        if(allocationsCounted())
+        {
+            std::cout << std::format("Allocations: {}\n", plan.allocations.toString());
+        }
+        return;
+    }
+
+    const auto pProvider = piaProvider();
 
-    auto ast = Parser{buffer.str()}.parse();
-    WfpExecutor wfpExecutor{_engine};
+    // The batch (and the arena holding its conditions) lives until the apply has committed
+    auto plan = planRuleset(buffer.str(), pProvider->displayData, rulesetName, resolveAppId,
+                            options.weightPolicy, interfaces.resolver());
+    timings.append(plan.timings);
+    saveAppIds();
+    const FilterBatch &batch = plan.batch;
+
+    if(options.ephemeral)
+    {
+        // Nothing persists, so there's nothing to fingerprint or journal - and nothing
+        // to clean up, the BFE deletes the lot when the session closes
+        const auto filters = ephemeralFilters(batch.filters(), rulesetName);
+        Engine session{SessionKind::Dynamic};
+        auto result = FilterApplier{session}.apply(filters);
+        timings.merge("apply", result.timings);
+
+        std::cout << std::format("Loaded {} ephemeral filters ({} already installed) from {}\n",
+                                 result.filterIds.size(), result.alreadyInstalledCount,
+                                 sourceFile);
+        std::cout << std::format("Timings: {}\n", timings.toString());
+        std::cout << "The filters are removed when wfpk exits - press enter or Ctrl+C to exit.\n";
+        std::cin.get();
+        return;
+    }
+
+    // Agents reload on a timer, usually with nothing changed - skip the BFE work if the
+    // last ruleset loaded was this one
+    const auto fingerprint = timings.measure("fingerprint", [&] {
+        return rulesetFingerprint(batch.filters(), enumName(options.applyMode));
+    });
+    FingerprintStore fingerprints{_engine};
+    if(!options.force && fingerprints.installed() == fingerprint)
+    {
+        std::cout << std::format("{} is already loaded (fingerprint {}), use --force to reload\n",
+                                 sourceFile, fingerprintString(fingerprint));
+        std::cout << std::format("Timings: {}\n", timings.toString());
+        return;
+    }
 
-    ast->accept(wfpExecutor);
+    // Recorded in the same transaction as the filters
+    auto recordFingerprint = [&] { fingerprints.record(fingerprint); };
+
+    if(options.applyMode == ApplyMode::Diff)
+    {
+        // Only touch what changed, in one transaction
+        DiffApplier applier{_engine, kLayers};
+        applier.beforeCommit(recordFingerprint);
+        auto result = applier.apply(batch.filters());
+        timings.merge("apply", result.timings);
+        journalLoad(rulesetName, result.filterIds, result.filterKeys);
+
+        std::cout << std::format("Added {}, deleted {} and kept {} filters from {}\n",
+                                 result.addedCount, result.deletedCount, result.unchangedCount,
+                                 sourceFile);
+    }
+    else if(options.applyMode == ApplyMode::Swap)
+    {
+        SwapApplier applier{_engine, kLayers};
+        applier.beforeCommit(recordFingerprint);
+        auto result = applier.apply(batch.filters());
+        timings.merge("swap", result.timings);
+        journalLoad(rulesetName, result.filterIds, result.filterKeys);
+
+        std::cout << std::format("Swapped in {} filters from {}, replacing {}\n",
+                                 result.filterIds.size(), sourceFile, result.retiredCount);
+        if(result.leftoverCount > 0)
+        {
+            std::cout << std::format("Deleted {} filters left by an interrupted swap\n",
+                                     result.leftoverCount);
+        }
+    }
+    else
+    {
+        // Apply the entire ruleset in one transaction - a failure leaves nothing installed
+        FilterApplier applier{_engine, [](size_t done, size_t total) {
+                                  std::cout << std::format("Applied {}/{} filters\n", done, total);
+                              }};
+        applier.beforeCommit(recordFingerprint);
+        auto result = applier.apply(batch.filters());
+        timings.merge("apply", result.timings);
+        journalLoad(rulesetName, result.filterIds, result.filterKeys);
+
+        std::cout << std::format("Loaded {} filters ({} already installed) from {}\n",
+                                 result.filterIds.size(), result.alreadyInstalledCount,
+                                 sourceFile);
+    }
+
+    std::cout << std::format("Timings: {}\n", timings.toString());
 }
 
 // creates a dummy conditional filter that filters on the chrome app
@@ -98,121 +412,229 @@ void WfpKiller::createFilter()
 void WfpKiller::listFilters(const Options &options) const
 {
     size_t filterCount{0};
+    size_t transferredCount{0};
 
-    for(const auto &layerKey : kLayers)
+    const auto layers = selectedLayers(options);
+    auto layerFilters = enumerateLayers(layers, options.query);
+    for(size_t i = 0; i < layers.size(); ++i)
     {
-        const auto &filters = _engine.filtersForLayer(layerKey);
+        const auto &layerKey = layers[i];
+        transferredCount += layerFilters[i].size();
 
-        std::unordered_map<GUID, FilterSet> filtersBySubLayer;
-        FilterSet filtersWithoutSubLayer;
+        // Rows are heaviest first, so each sublayer's rows are too. The layer's pages
+        // aren't needed once it's mirrored.
+        const auto mirror = mirrorByWeight(layerFilters[i]);
+        layerFilters[i] = {};
 
-        for(const auto &pFilter : filters)
+        const auto subLayerKeys = mirror.subLayerKeys();
+        std::vector<std::vector<FilterMirror::Row>> rowsBySubLayer(subLayerKeys.size());
+        for(const auto row : listedRows(options, mirror))
         {
-            if(!options.isEmpty() && !isFilterNameMatched(options.providerMatchers, pFilter))
-            {
-                continue;
-            }
-
-            // Non-existent sublayers are represented as ZeroGuid
-            if(pFilter->subLayerKey != ZeroGuid)
-            {
-                auto &set = filtersBySubLayer[pFilter->subLayerKey];
-                set.insert(pFilter);
-            }
-            else
-            {
-                filtersWithoutSubLayer.insert(pFilter);
-            }
+            rowsBySubLayer[mirror.subLayerIndices()[row]].push_back(row);
         }
 
-        if(filtersBySubLayer.empty() && filtersWithoutSubLayer.empty())
+        if(std::ranges::all_of(rowsBySubLayer, [](const auto &rows) { return rows.empty(); }))
         {
             continue;
         }
 
         std::cout << std::format("\nLayer: {}\n", WfpNameMapper::getName(layerKey).rawName);
 
-        for(const auto &[subLayerKey, filterSet] : filtersBySubLayer)
+        // Non-existent sublayers are represented as ZeroGuid, and listed last
+        std::optional<size_t> noSubLayer;
+        for(size_t subLayer = 0; subLayer < subLayerKeys.size(); ++subLayer)
         {
-            std::unique_ptr<FWPM_SUBLAYER, WfpDeleter> pSubLayer{
-                _engine.getSubLayerByKey(subLayerKey)};
+            const auto &rows = rowsBySubLayer[subLayer];
+            if(rows.empty())
+            {
+                continue;
+            }
+            if(subLayerKeys[subLayer] == ZeroGuid)
+            {
+                noSubLayer = subLayer;
+                continue;
+            }
 
-            if(pSubLayer)
+            if(const auto *pNames = _engine.subLayerNames().find(subLayerKeys[subLayer]))
             {
-                std::string subLayerName =
-                    toLowercase(wideStringToString(pSubLayer->displayData.name));
-                std::cout << std::format("SubLayer: {}\n\n",
-                                         wideStringToString(pSubLayer->displayData.name));
+                std::cout << std::format("SubLayer: {}\n\n", pNames->displayName);
             }
             else
             {
                 std::cerr << std::format("Got an invalid subLayer GUID: {}\n",
-                                         WfpNameMapper::getName(subLayerKey).rawName);
+                                         WfpNameMapper::getName(subLayerKeys[subLayer]).rawName);
             }
 
-            for(const auto &pFilter : filterSet)
+            for(const auto row : rows)
             {
-                std::cout << *pFilter << "\n";
+                std::cout << mirror.filter(row) << "\n";
                 ++filterCount;
             }
+            std::cout << "\n";
+        }
 
-            if(!filterSet.empty())
+        if(noSubLayer)
+        {
+            std::cout << "No SubLayer\n\n";
+            for(const auto row : rowsBySubLayer[*noSubLayer])
             {
-                std::cout << "\n";
+                std::cout << mirror.filter(row) << "\n";
+                ++filterCount;
             }
         }
+    }
+
+    std::cout << std::format("\nTotal number of filters: {} ({} transferred from the BFE)\n",
+                             filterCount, transferredCount);
+    printNameStats();
+}
 
-        if(!filtersWithoutSubLayer.empty())
+void WfpKiller::streamFilters(const Options &options, size_t limit) const
+{
+    size_t transferredCount{0};
+    auto isMatched = [&](const std::shared_ptr<FWPM_FILTER> &pFilter) {
+        ++transferredCount;
+        return isListed(options, pFilter);
+    };
+
+    size_t filterCount{0};
+    for(const auto &layerKey : selectedLayers(options))
+    {
+        const auto remaining = static_cast<std::ptrdiff_t>(
+            std::min<size_t>(limit - filterCount, (std::numeric_limits<std::ptrdiff_t>::max)()));
+        bool isFirst{true};
+        for(const auto &pFilter : _engine.filters(layerKey, options.query) |
+                                      std::views::filter(isMatched) | std::views::take(remaining))
         {
-            std::cout << "No SubLayer\n\n";
-            for(const auto &pFilter : filtersWithoutSubLayer)
+            if(isFirst)
             {
-                std::cout << *pFilter << "\n";
+                std::cout << std::format("\nLayer: {}\n", WfpNameMapper::getName(layerKey).rawName);
+                isFirst = false;
             }
+            std::cout << *pFilter << "\n";
+            ++filterCount;
+        }
+
+        if(filterCount == limit)
+        {
+            break;
         }
     }
 
-    std::cout << std::format("\nTotal number of filters: {}\n", filterCount);
+    std::cout << std::format("\nTotal number of filters: {} ({} transferred from the BFE)\n",
+                             filterCount, transferredCount);
+    printNameStats();
 }
 
-// TODO: make this more efficient - it's currently loading (sublayers and providers) objects every
-// time
-bool WfpKiller::isFilterNameMatched(const std::vector<std::regex> &matchers,
-                                    const std::shared_ptr<FWPM_FILTER> &pFilter) const
+void WfpKiller::listProviders() const
 {
-    std::unique_ptr<FWPM_SUBLAYER, WfpDeleter> pSubLayer;
-    std::unique_ptr<FWPM_PROVIDER, WfpDeleter> pProvider;
+    printObjects<FWPM_PROVIDER>(_engine, "providers");
+}
+
+void WfpKiller::listSubLayers() const
+{
+    printObjects<FWPM_SUBLAYER>(_engine, "sublayers");
+}
 
-    if(pFilter->subLayerKey != ZeroGuid)
+void WfpKiller::listCallouts() const
+{
+    printObjects<FWPM_CALLOUT>(_engine, "callouts");
+}
+
+void WfpKiller::listLayers() const
+{
+    printObjects<FWPM_LAYER>(_engine, "layers");
+}
+
+auto WfpKiller::selectedLayers(const Options &options) const -> std::vector<GUID>
+{
+    if(options.layerMatchers.empty())
     {
-        pSubLayer.reset(_engine.getSubLayerByKey(pFilter->subLayerKey));
+        return kLayers;
     }
-    if(pFilter->providerKey)
+
+    std::vector<GUID> layers;
+    std::ranges::copy_if(kLayers, std::back_inserter(layers), [&](const GUID &layerKey) {
+        const auto name = WfpNameMapper::getName(layerKey);
+        return isNameMatched(options.layerMatchers, toLowercase(name.rawName)) ||
+               isNameMatched(options.layerMatchers, toLowercase(name.friendlyName));
+    });
+    return layers;
+}
+
+bool WfpKiller::isListed(const Options &options, const std::shared_ptr<FWPM_FILTER> &pFilter) const
+{
+    // The BFE only selects a superset of the query's filters
+    if(!options.query.matches(*pFilter))
     {
-        pProvider.reset(_engine.getProviderByKey(*pFilter->providerKey));
+        return false;
     }
 
-    if(pSubLayer)
+    return options.providerMatchers.empty() ||
+           isFilterNameMatched(options.providerMatchers, pFilter);
+}
+
+auto WfpKiller::listedRows(const Options &options, const FilterMirror &mirror) const
+    -> std::vector<FilterMirror::Row>
+{
+    // The BFE only selects a superset of the query's filters
+    auto rows = mirror.select(options.query);
+    if(options.providerMatchers.empty())
     {
-        std::string subLayerName = toLowercase(wideStringToString(pSubLayer->displayData.name));
-        if(isNameMatched(matchers, subLayerName))
-        {
-            return true;
-        }
+        return rows;
     }
-    if(pProvider)
-    {
-        std::string providerName = toLowercase(wideStringToString(pProvider->displayData.name));
-        if(isNameMatched(matchers, providerName))
+
+    // Names are matched once per sublayer and provider, not per filter
+    auto matchKeys = [&](std::span<const GUID> keys, ObjectNameCache &names) {
+        std::vector<char> isMatched(keys.size());
+        for(size_t i = 0; i < keys.size(); ++i)
         {
-            return true;
+            isMatched[i] = isNameMatched(options.providerMatchers, names.find(keys[i]));
         }
+        return isMatched;
+    };
+    const auto isSubLayerMatched = matchKeys(mirror.subLayerKeys(), _engine.subLayerNames());
+    const auto isProviderMatched = matchKeys(mirror.providerKeys(), _engine.providerNames());
+
+    std::erase_if(rows, [&](FilterMirror::Row row) {
+        const auto provider = mirror.providerIndices()[row];
+        return !isSubLayerMatched[mirror.subLayerIndices()[row]] &&
+               !(provider != FilterMirror::NoKey && isProviderMatched[provider]);
+    });
+    return rows;
+}
+
+auto WfpKiller::enumerateLayers(const std::vector<GUID> &layers, const FilterQuery &query) const
+    -> std::vector<std::vector<std::shared_ptr<FWPM_FILTER>>>
+{
+    return ParallelFilterEnum<Engine>{layers, _sessions, query}.enumerate();
+}
+
+bool WfpKiller::isFilterNameMatched(const std::vector<std::regex> &matchers,
+                                    const std::shared_ptr<FWPM_FILTER> &pFilter) const
+{
+    // The engine caches names, so this only fetches each sublayer and provider once
+    if(isNameMatched(matchers, _engine.subLayerNames().find(pFilter->subLayerKey)))
+    {
+        return true;
     }
 
-    return false;
+    return pFilter->providerKey &&
+           isNameMatched(matchers, _engine.providerNames().find(*pFilter->providerKey));
+}
+
+void WfpKiller::printNameStats() const
+{
+    const auto subLayerStats = _engine.subLayerNames().stats();
+    const auto providerStats = _engine.providerNames().stats();
+    if(subLayerStats.hits + subLayerStats.misses + providerStats.hits + providerStats.misses > 0)
+    {
+        std::cout << std::format("Sublayer names: {}\nProvider names: {}\n",
+                                 subLayerStats.toString(), providerStats.toString());
+    }
 }
 
-void WfpKiller::deleteFilters(const std::vector<FilterId> &filterIds) const
+void WfpKiller::deleteFilters(const std::vector<FilterId> &filterIds)
 {
     uint32_t deleteCount{0};
 
@@ -237,14 +659,19 @@ void WfpKiller::deleteFilters(const std::vector<FilterId> &filterIds) const
     // Delete ALL PIA filters
     else
     {
-        // Get all PIA filters
-        std::vector<std::shared_ptr<FWPM_FILTER>> piaFilters;
-        _engine.enumerateFiltersForLayers(kLayers, [&](const auto &pFilter) {
-            if(isPiaProvider(pFilter->providerKey))
+        // Get all PIA filters - only PIA's are transferred, and only their ids are kept
+        FilterMirror piaFilters;
+        for(auto &filters : enumerateLayers(kLayers, {.providerKey = PIA_PROVIDER_KEY}))
+        {
+            for(const auto &pFilter : filters)
             {
-                piaFilters.push_back(pFilter);
+                if(isPiaProvider(pFilter->providerKey))
+                {
+                    piaFilters.add(*pFilter);
+                }
             }
-        });
+            filters = {};
+        }
 
         std::cout << std::format("This action will delete ALL PIA filters\nAre you sure? (y/n) "
                                  "(will delete {} filters)\n",
@@ -254,26 +681,139 @@ void WfpKiller::deleteFilters(const std::vector<FilterId> &filterIds) const
         if(userDecision == 'y')
         {
             // Delete all PIA filters.
-            for(const auto &pFilter : piaFilters)
+            for(const auto filterId : piaFilters.ids())
             {
-                if(deleteSingleFilter(pFilter->filterId))
+                if(deleteSingleFilter(filterId))
                 {
                     ++deleteCount;
                 }
             }
+
+            // Whatever was journaled is gone with them
+            std::vector<uint64_t> sequences;
+            for(const auto &load : _journal.liveLoads())
+            {
+                sequences.push_back(load.sequence);
+            }
+            _journal.retire(sequences);
         }
     }
 
+    if(deleteCount > 0)
+    {
+        // The last ruleset loaded is no longer (entirely) installed
+        FingerprintStore{_engine}.clear();
+    }
+
     std::cout << std::format("Deleted {} filters.\n", deleteCount);
 }
 
+void WfpKiller::deleteLastLoad()
+{
+    auto load = _journal.lastLoad();
+    if(!load)
+    {
+        std::cout << std::format("No loads are recorded in {}\n", _journal.path().string());
+        return;
+    }
+
+    deleteJournaled({std::move(*load)});
+}
+
+void WfpKiller::deleteRuleset(const std::string &rulesetName)
+{
+    auto loads = _journal.loadsOf(rulesetName);
+    if(loads.empty())
+    {
+        std::cout << std::format("No loads of {} are recorded in {}\n", rulesetName,
+                                 _journal.path().string());
+        return;
+    }
+
+    deleteJournaled(loads);
+}
+
+void WfpKiller::deleteJournaled(const std::vector<JournalLoad> &loads)
+{
+    for(const auto &load : loads)
+    {
+        std::cout << std::format("Deleting load {} of {} ({} filters, {:%Y-%m-%d %H:%M:%S})\n",
+                                 load.sequence, load.rulesetName, load.filters.size(),
+                                 std::chrono::floor<std::chrono::seconds>(load.time));
+    }
+
+    // The last ruleset loaded is no longer (entirely) installed
+    auto result =
+        deleteJournaledFilters(_engine, loads, [&] { FingerprintStore{_engine}.clear(); });
+
+    std::vector<uint64_t> sequences;
+    for(const auto &load : loads)
+    {
+        sequences.push_back(load.sequence);
+    }
+    _journal.retire(sequences);
+
+    std::cout << std::format("Deleted {} filters ({} were already gone).\n", result.deletedCount,
+                             result.missingCount);
+    std::cout << std::format("Timings: {}\n", result.timings.toString());
+}
+
+void WfpKiller::journalLoad(const std::string &rulesetName, std::span<const FilterId> filterIds,
+                            std::span<const GUID> filterKeys)
+{
+    if(filterIds.empty())
+    {
+        return;
+    }
+
+    try
+    {
+        _journal.recordLoad(rulesetName, filterIds, filterKeys);
+    }
+    catch(const std::exception &ex)
+    {
+        std::cerr << std::format("Warning: the load was not journaled, so can't be deleted "
+                                 "with delete --last or --ruleset: {}\n",
+                                 ex.what());
+    }
+}
+
 void WfpKiller::monitor()
 {
+    // Events only carry the id of the filter applied - it's looked up in a mirror kept
+    // current by change notifications, rather than fetched from the BFE for every event
+    LiveFilterMirror<Engine> filters{_engine, kLayers};
+    MonitorContext context{_engine, filters};
+
     std::cout << "Monitoring network events - press enter or Ctrl+C to stop.\n";
     _engine.monitorEvents(
-        [](void *context, const FWPM_NET_EVENT *event) { std::cout << *event << "\n"; });
+        [](void *pContext, const FWPM_NET_EVENT *event) {
+            auto &context = *static_cast<MonitorContext *>(pContext);
+            std::lock_guard lock{context.mutex};
+            std::cout << *event;
+            if(const auto filterId = appliedFilterId(*event))
+            {
+                printAppliedFilter(context, filterId);
+            }
+            std::cout << "\n";
+        },
+        &context);
 
     std::cin.get();
+    // The context is about to go
+    _engine.stopMonitoringEvents();
+}
+
+auto WfpKiller::piaProvider() const -> std::unique_ptr<FWPM_PROVIDER, WfpDeleter>
+{
+    std::unique_ptr<FWPM_PROVIDER, WfpDeleter> pProvider{
+        _engine.getProviderByKey(PIA_PROVIDER_KEY)};
+    if(!pProvider)
+    {
+        throw std::runtime_error{"The PIA provider is not installed"};
+    }
+
+    return pProvider;
 }
 
 bool WfpKiller::deleteSingleFilter(FilterId filterId) const
@@ -301,4 +841,10 @@ bool WfpKiller::isNameMatched(const std::vector<std::regex> &matchers,
 
     return matched;
 }
+
+bool WfpKiller::isNameMatched(const std::vector<std::regex> &matchers,
+                              const ObjectNameCache::Names *pNames) const
+{
+    return pNames && isNameMatched(matchers, pNames->lowercaseName);
+}
 }
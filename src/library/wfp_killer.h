@@ -1,9 +1,14 @@
 #pragma once
 
 #include "wfp_objects.h"
+#include <engine/filter_mirror.h>
+#include <engine/session_pool.h>
+#include <apply/weight_allocator.h>
+#include <apply/filter_journal.h>
 #include <string>
 #include <vector>
 #include <regex>
+#include <thread>
 
 namespace wfpk
 {
@@ -14,13 +19,43 @@ public:
     struct Options
     {
         std::vector<std::regex> providerMatchers;
+        // Layers whose names match none of these aren't enumerated at all
         std::vector<std::regex> layerMatchers;
         std::vector<std::regex> subLayerMatchers;
+        // Selects filters in the BFE, so those it excludes are never transferred
+        FilterQuery query;
+    };
+
+    enum class ApplyMode
+    {
+        // Add the ruleset's filters alongside whatever is installed
+        Append,
+        // Only add and delete the filters that differ from the installed PIA filters
+        Diff,
+        // Install into a new sublayer, deleting the previous swap's sublayer and its
+        // filters in the same transaction
+        Swap
+    };
 
-        bool isEmpty() const
-        {
-            return providerMatchers.empty() && layerMatchers.empty() && subLayerMatchers.empty();
-        }
+    struct LoadOptions
+    {
+        ApplyMode applyMode{ApplyMode::Append};
+        // Filter keys are derived from this, defaults to the source file's name
+        std::string rulesetName;
+        // How rules are ranked against each other
+        WeightPolicy weightPolicy{WeightPolicy::RuleOrder};
+        // If set, write the filters that would be installed to this file (as NDJSON)
+        // instead of installing them
+        std::string planFile;
+        // Apply even if the ruleset's fingerprint shows it's already loaded
+        bool force{false};
+        // Read, parse, lower and apply concurrently (see LoadPipeline) - Append mode only
+        bool pipelined{false};
+        // Add the filters from a dynamic session held open until wfpk exits, which
+        // removes them all at once - Append mode only
+        bool ephemeral{false};
+        // Print each rule before loading the ruleset
+        bool verbose{false};
     };
 
 public:
@@ -29,19 +64,75 @@ public:
     WfpKiller &operator=(const WfpKiller &) = delete;
 
 public:
+    // Objects fetched per round trip when enumerating
+    void setPageSize(UINT32 pageSize)
+    {
+        _engine.setPageSize(pageSize);
+    }
+    // Sessions opened for work spread across threads (e.g enumerating layers)
+    void setMaxSessions(size_t maxSessions)
+    {
+        _sessions.setMaxSessions(maxSessions);
+    }
+
     void createFilter();
     void listFilters(const Options &options) const;
-    void deleteFilters(const std::vector<FilterId> &filterIds) const;
+    // As listFilters, but each filter is printed as it's fetched - in the order the BFE
+    // enumerates them rather than grouped by sublayer and weight. Stops fetching after
+    // `limit` filters.
+    void streamFilters(const Options &options, size_t limit) const;
+    // Print every installed object of a kind, as the BFE enumerates them
+    void listProviders() const;
+    void listSubLayers() const;
+    void listCallouts() const;
+    void listLayers() const;
+    void deleteFilters(const std::vector<FilterId> &filterIds);
+    // Delete the filters added by the last load, or by every load of a ruleset, as
+    // recorded in the journal
+    void deleteLastLoad();
+    void deleteRuleset(const std::string &rulesetName);
     void monitor();
-    void loadFilters(const std::string &sourceFile);
+    void loadFilters(const std::string &sourceFile, const LoadOptions &options);
 
 private:
+    // Throws if PIA isn't installed
+    auto piaProvider() const -> std::unique_ptr<FWPM_PROVIDER, WfpDeleter>;
     bool deleteSingleFilter(FilterId filterId) const;
+    // The layers of kLayers matching the options' layerMatchers
+    auto selectedLayers(const Options &options) const -> std::vector<GUID>;
+    // Whether a filter the BFE selected for options.query matches the options exactly
+    bool isListed(const Options &options, const std::shared_ptr<FWPM_FILTER> &pFilter) const;
+    // As isListed(), for every row of a mirror - in row order
+    auto listedRows(const Options &options, const FilterMirror &mirror) const
+        -> std::vector<FilterMirror::Row>;
+    // The filters the BFE selects for the query from each layer, enumerated in parallel -
+    // a worker per pooled session
+    auto enumerateLayers(const std::vector<GUID> &layers, const FilterQuery &query = {}) const
+        -> std::vector<std::vector<std::shared_ptr<FWPM_FILTER>>>;
+    void deleteJournaled(const std::vector<JournalLoad> &loads);
+    // Failing to journal a load doesn't fail it, its filters are already committed
+    void journalLoad(const std::string &rulesetName, std::span<const FilterId> filterIds,
+                     std::span<const GUID> filterKeys);
     bool isNameMatched(const std::vector<std::regex> &matchers, const std::string &name) const;
+    // Matches the lowercased name - a missing object (nullptr) matches nothing
+    bool isNameMatched(const std::vector<std::regex> &matchers,
+                       const ObjectNameCache::Names *pNames) const;
     bool isFilterNameMatched(const std::vector<std::regex> &matchers,
                              const std::shared_ptr<FWPM_FILTER> &pFilter) const;
+    // How the engine's name caches fared, if they were used
+    void printNameStats() const;
 
 private:
     Engine _engine;
+    // Workers can't share _engine - its RPCs are served one at a time. A pool, so
+    // sessions are opened once however many times work is spread out.
+    mutable SessionPool<Engine> _sessions{
+        [this] {
+            auto pSession = std::make_unique<Engine>();
+            pSession->setPageSize(_engine.pageSize());
+            return pSession;
+        },
+        std::thread::hardware_concurrency()};
+    FilterJournal _journal{defaultJournalPath()};
 };
 }
@@ -36,10 +36,10 @@ public:
 
     // Primary template (not implemented)
     template <WFPK_TYPES type, typename T> static WfpName getName(T value);
+};
 
-    // Full specializations of above
-    template <> static WfpName getName<WFPK_ACTION_TYPE, UINT32>(UINT32 value);
+// Full specializations of above - these must be declared at namespace scope
+template <> WfpName WfpNameMapper::getName<WFPK_ACTION_TYPE, UINT32>(UINT32 value);
 
-    template <> static WfpName getName<WFPK_IPPROTO_TYPE, UINT8>(UINT8 value);
-};
+template <> WfpName WfpNameMapper::getName<WFPK_IPPROTO_TYPE, UINT8>(UINT8 value);
 }
@@ -12,11 +12,57 @@
 
 namespace wfpk
 {
+namespace
+{
+// What the BFE's change callbacks are given as their context
+struct ChangeSink
+{
+    HANDLE engineHandle{};
+    ChangeCallback callback;
+    HANDLE filterChanges{};
+    HANDLE providerChanges{};
+    HANDLE subLayerChanges{};
+};
+
+void onFilterChange(void *pContext, const FWPM_FILTER_CHANGE0 *pChange)
+{
+    static_cast<ChangeSink *>(pContext)->callback(
+        {ObjectKind::Filter, pChange->changeType, pChange->filterKey, pChange->filterId});
+}
 
-Engine::Engine()
+void onProviderChange(void *pContext, const FWPM_PROVIDER_CHANGE0 *pChange)
+{
+    static_cast<ChangeSink *>(pContext)->callback(
+        {ObjectKind::Provider, pChange->changeType, pChange->providerKey});
+}
+
+void onSubLayerChange(void *pContext, const FWPM_SUBLAYER_CHANGE0 *pChange)
+{
+    static_cast<ChangeSink *>(pContext)->callback(
+        {ObjectKind::SubLayer, pChange->changeType, pChange->subLayerKey});
+}
+
+void unsubscribe(DWORD result, std::string_view name)
+{
+    if(result != ERROR_SUCCESS)
+    {
+        // Just showing the error - nothing more can be done about it
+        std::cerr << std::format("{} failed: {}\n", name, getErrorString(result));
+    }
+}
+}
+
+Engine::Engine(SessionKind kind)
     : _handle{}
 {
-    DWORD result = FwpmEngineOpen(NULL, RPC_C_AUTHN_WINNT, NULL, NULL, &_handle);
+    FWPM_SESSION session{};
+    session.displayData.name = const_cast<wchar_t *>(L"wfpk");
+    if(kind == SessionKind::Dynamic)
+    {
+        session.flags = FWPM_SESSION_FLAG_DYNAMIC;
+    }
+
+    DWORD result = FwpmEngineOpen(NULL, RPC_C_AUTHN_WINNT, NULL, &session, &_handle);
     if(result != ERROR_SUCCESS)
     {
         throw WfpError{"FwpmEngineOpen failed, code:", result};
@@ -39,81 +85,258 @@ FilterId Engine::add(const FWPM_FILTER &filter)
     return id;
 }
 
-DWORD Engine::deleteFilterById(FilterId filterId) const
+DWORD Engine::tryAdd(const FWPM_FILTER &filter, FilterId &id) const
 {
-    return FwpmFilterDeleteById(_handle, filterId);
+    return FwpmFilterAdd(_handle, &filter, NULL, &id);
 }
 
-Engine::~Engine()
+void Engine::beginTransaction() const
 {
-    DWORD result{ERROR_SUCCESS};
-    result = FwpmEngineClose(_handle);
+    DWORD result = FwpmTransactionBegin(_handle, 0);
     if(result != ERROR_SUCCESS)
     {
-        // Cannot throw in a destructor
-        std::cerr << "FwpmEngineClose failed: " << getErrorString(result);
+        throw WfpError{"FwpmTransactionBegin failed:", result};
     }
 }
 
-auto SingleLayerFilterEnum::createEnumTemplate(const GUID &layerKey) const
-    -> FWPM_FILTER_ENUM_TEMPLATE
+void Engine::commitTransaction() const
 {
-    FWPM_FILTER_ENUM_TEMPLATE enumTemplate{};
-    enumTemplate.enumType = FWP_FILTER_ENUM_OVERLAPPING;
-    enumTemplate.layerKey = layerKey;
-    enumTemplate.providerKey = NULL; // const_cast<GUID*>(&PIA_PROVIDER_KEY);
-    enumTemplate.actionMask = 0xFFFFFFFF;
+    DWORD result = FwpmTransactionCommit(_handle);
+    if(result != ERROR_SUCCESS)
+    {
+        throw WfpError{"FwpmTransactionCommit failed:", result};
+    }
+}
 
-    return enumTemplate;
+DWORD Engine::abortTransaction() const
+{
+    return FwpmTransactionAbort(_handle);
 }
 
-SingleLayerFilterEnum::SingleLayerFilterEnum(const GUID &layerKey, HANDLE engineHandle)
-    : _engineHandle{engineHandle}
+auto Engine::filterById(FilterId filterId) const -> std::shared_ptr<FWPM_FILTER>
 {
-    DWORD result{ERROR_SUCCESS};
+    FWPM_FILTER *pFilter{nullptr};
+    DWORD result = FwpmFilterGetById(_handle, filterId, &pFilter);
+    if(result == FWP_E_FILTER_NOT_FOUND)
+    {
+        return {};
+    }
+    else if(result != ERROR_SUCCESS)
+    {
+        throw WfpError{"FwpmFilterGetById failed:", result};
+    }
+
+    return {pFilter, WfpDeleter{}};
+}
+
+auto Engine::filterByKey(const GUID &filterKey) const -> std::shared_ptr<FWPM_FILTER>
+{
+    FWPM_FILTER *pFilter{nullptr};
+    DWORD result = FwpmFilterGetByKey(_handle, &filterKey, &pFilter);
+    if(result == FWP_E_FILTER_NOT_FOUND)
+    {
+        return {};
+    }
+    else if(result != ERROR_SUCCESS)
+    {
+        throw WfpError{"FwpmFilterGetByKey failed:", result};
+    }
+
+    return {pFilter, WfpDeleter{}};
+}
+
+auto Engine::subscribeChanges(ChangeCallback callback) const -> ChangeSubscription
+{
+    auto pSink = std::make_shared<ChangeSink>(_handle, std::move(callback));
+    // Unsubscribes whatever was subscribed to, should a later subscription fail
+    ChangeSubscription subscription{[pSink] {
+        if(pSink->filterChanges)
+        {
+            unsubscribe(FwpmFilterUnsubscribeChanges0(pSink->engineHandle, pSink->filterChanges),
+                        "FwpmFilterUnsubscribeChanges0");
+        }
+        if(pSink->providerChanges)
+        {
+            unsubscribe(
+                FwpmProviderUnsubscribeChanges0(pSink->engineHandle, pSink->providerChanges),
+                "FwpmProviderUnsubscribeChanges0");
+        }
+        if(pSink->subLayerChanges)
+        {
+            unsubscribe(
+                FwpmSubLayerUnsubscribeChanges0(pSink->engineHandle, pSink->subLayerChanges),
+                "FwpmSubLayerUnsubscribeChanges0");
+        }
+    }};
 
-    FWPM_FILTER_ENUM_TEMPLATE enumTemplate{createEnumTemplate(layerKey)};
+    // No template - every object of the kind
+    constexpr UINT32 flags =
+        FWPM_SUBSCRIPTION_FLAG_NOTIFY_ON_ADD | FWPM_SUBSCRIPTION_FLAG_NOTIFY_ON_DELETE;
 
-    HANDLE enumHandle{};
-    result = FwpmFilterCreateEnumHandle(_engineHandle, &enumTemplate, &enumHandle);
+    FWPM_FILTER_SUBSCRIPTION0 filterSubscription{};
+    filterSubscription.flags = flags;
+    DWORD result = FwpmFilterSubscribeChanges0(_handle, &filterSubscription, onFilterChange,
+                                               pSink.get(), &pSink->filterChanges);
     if(result != ERROR_SUCCESS)
     {
-        throw WfpError{"FwpmFilterCreateEnumHandle failed:", result};
+        throw WfpError{"FwpmFilterSubscribeChanges0 failed:", result};
     }
 
-    FWPM_FILTER **pFilters{nullptr};
+    FWPM_PROVIDER_SUBSCRIPTION0 providerSubscription{};
+    providerSubscription.flags = flags;
+    result = FwpmProviderSubscribeChanges0(_handle, &providerSubscription, onProviderChange,
+                                           pSink.get(), &pSink->providerChanges);
+    if(result != ERROR_SUCCESS)
+    {
+        throw WfpError{"FwpmProviderSubscribeChanges0 failed:", result};
+    }
 
-    UINT32 numEntries{0};
-    result = FwpmFilterEnum(_engineHandle, enumHandle, MaxFilterCount, &pFilters, &numEntries);
+    FWPM_SUBLAYER_SUBSCRIPTION0 subLayerSubscription{};
+    subLayerSubscription.flags = flags;
+    result = FwpmSubLayerSubscribeChanges0(_handle, &subLayerSubscription, onSubLayerChange,
+                                           pSink.get(), &pSink->subLayerChanges);
     if(result != ERROR_SUCCESS)
     {
-        throw WfpError{"FwpmFilterEnum failed:", result};
+        throw WfpError{"FwpmSubLayerSubscribeChanges0 failed:", result};
     }
 
-    for(size_t i = 0; i < numEntries; ++i)
+    return subscription;
+}
+
+DWORD Engine::deleteFilterById(FilterId filterId) const
+{
+    return FwpmFilterDeleteById(_handle, filterId);
+}
+
+DWORD Engine::deleteFilterByKey(const GUID &filterKey) const
+{
+    return FwpmFilterDeleteByKey(_handle, &filterKey);
+}
+
+DWORD Engine::tryAddProvider(const FWPM_PROVIDER &provider) const
+{
+    return FwpmProviderAdd(_handle, &provider, NULL);
+}
+
+DWORD Engine::deleteProviderByKey(const GUID &providerKey) const
+{
+    return FwpmProviderDeleteByKey(_handle, &providerKey);
+}
+
+auto Engine::providerData(const GUID &providerKey) const -> std::optional<std::vector<UINT8>>
+{
+    FWPM_PROVIDER *pProvider{nullptr};
+    DWORD result = FwpmProviderGetByKey(_handle, &providerKey, &pProvider);
+    if(result == FWP_E_PROVIDER_NOT_FOUND)
+    {
+        return {};
+    }
+    else if(result != ERROR_SUCCESS)
     {
-        FWPM_FILTER *pFilter{nullptr};
+        throw WfpError{"FwpmProviderGetByKey failed:", result};
+    }
 
-        // Grab a new filter so that we can carefully manage its lifetime
-        DWORD result = FwpmFilterGetById(_engineHandle, pFilters[i]->filterId, &pFilter);
-        if(result == ERROR_SUCCESS)
-        {
-            _pFilters.insert(std::shared_ptr<FWPM_FILTER>{pFilter, WfpDeleter{}});
-        }
-        else
-        {
-            std::cerr << "FwpmFilterGetById failed: " << getErrorString(result) << std::endl;
-        }
+    std::unique_ptr<FWPM_PROVIDER, WfpDeleter> pOwned{pProvider};
+    const auto &data = pOwned->providerData;
+
+    return std::vector<UINT8>(data.data, data.data + data.size);
+}
+
+DWORD Engine::tryAddSubLayer(const FWPM_SUBLAYER &subLayer) const
+{
+    return FwpmSubLayerAdd(_handle, &subLayer, NULL);
+}
+
+DWORD Engine::deleteSubLayerByKey(const GUID &subLayerKey) const
+{
+    return FwpmSubLayerDeleteByKey(_handle, &subLayerKey);
+}
+
+auto Engine::subLayerWeight(const GUID &subLayerKey) const -> std::optional<UINT16>
+{
+    FWPM_SUBLAYER *pSubLayer{nullptr};
+    DWORD result = FwpmSubLayerGetByKey(_handle, &subLayerKey, &pSubLayer);
+    if(result == FWP_E_SUBLAYER_NOT_FOUND)
+    {
+        return {};
+    }
+    else if(result != ERROR_SUCCESS)
+    {
+        throw WfpError{"FwpmSubLayerGetByKey failed:", result};
+    }
+
+    std::unique_ptr<FWPM_SUBLAYER, WfpDeleter> pOwned{pSubLayer};
+    return pOwned->weight;
+}
+
+auto Engine::fetchProviderName(const GUID &providerKey) const -> std::optional<std::string>
+{
+    FWPM_PROVIDER *pProvider{nullptr};
+    DWORD result = FwpmProviderGetByKey(_handle, &providerKey, &pProvider);
+    if(result == FWP_E_PROVIDER_NOT_FOUND)
+    {
+        return {};
+    }
+    else if(result != ERROR_SUCCESS)
+    {
+        throw WfpError{"FwpmProviderGetByKey failed:", result};
+    }
+
+    std::unique_ptr<FWPM_PROVIDER, WfpDeleter> pOwned{pProvider};
+    const wchar_t *pName = pOwned->displayData.name;
+    return pName ? wideStringToString(pName) : std::string{};
+}
+
+auto Engine::fetchSubLayerName(const GUID &subLayerKey) const -> std::optional<std::string>
+{
+    FWPM_SUBLAYER *pSubLayer{nullptr};
+    DWORD result = FwpmSubLayerGetByKey(_handle, &subLayerKey, &pSubLayer);
+    if(result == FWP_E_SUBLAYER_NOT_FOUND)
+    {
+        return {};
+    }
+    else if(result != ERROR_SUCCESS)
+    {
+        throw WfpError{"FwpmSubLayerGetByKey failed:", result};
     }
 
-    // Free the enum filters since we have shared_ptrs to new ones now anyway
-    FwpmFreeMemory(reinterpret_cast<void **>(&pFilters));
-    // Close the enumeration handle
-    result = FwpmFilterDestroyEnumHandle(_engineHandle, enumHandle);
+    std::unique_ptr<FWPM_SUBLAYER, WfpDeleter> pOwned{pSubLayer};
+    const wchar_t *pName = pOwned->displayData.name;
+    return pName ? wideStringToString(pName) : std::string{};
+}
+
+Engine::~Engine()
+{
+    DWORD result{ERROR_SUCCESS};
+    result = FwpmEngineClose(_handle);
     if(result != ERROR_SUCCESS)
     {
-        // Just showing the error - we have the filters already, so let's give it a chance
-        std::cerr << "FwpmFilterDestroyEnumHandle failed: " + getErrorString(result) << std::endl;
+        // Cannot throw in a destructor
+        std::cerr << "FwpmEngineClose failed: " << getErrorString(result);
+    }
+}
+
+SingleLayerFilterEnum::SingleLayerFilterEnum(const GUID &layerKey, HANDLE engineHandle,
+                                             UINT32 pageSize, const FilterQuery &query)
+{
+    const auto enumTemplate = query.enumTemplate(layerKey);
+    FilterEnumHandle enumHandle{engineHandle, &enumTemplate};
+
+    _pageCount = forEachPagedEntry<FWPM_FILTER>(
+        pageSize, enumHandle.fetchName(),
+        [&](UINT32 count, FWPM_FILTER ***pppFilters, UINT32 *pNumEntries) {
+            return enumHandle.fetch(count, pppFilters, pNumEntries);
+        },
+        [&](std::shared_ptr<FWPM_FILTER> pFilter) { _pFilters.push_back(std::move(pFilter)); });
+}
+
+auto Engine::filters(GUID layerKey, FilterQuery query) const
+    -> Generator<std::shared_ptr<FWPM_FILTER>>
+{
+    // The query outlives the enumeration, as its template points into it
+    for(auto &pFilter : enumObjects<FWPM_FILTER>(_handle, _pageSize, query.enumTemplate(layerKey)))
+    {
+        co_yield std::move(pFilter);
     }
 }
 }
@@ -1,14 +1,20 @@
 #pragma once
 
 #include <utils.h>
+#include <generator.h>
+#include <engine/filter_query.h>
+#include <engine/sorted_filters.h>
+#include <engine/object_change.h>
+#include <engine/object_name_cache.h>
 #include <stdexcept>
 #include <iostream>
 #include <vector>
-#include <set>
 #include <memory>
 #include <optional>
 #include <concepts>
 #include <source_location>
+#include <span>
+#include <cassert>
 
 namespace wfpk
 {
@@ -24,6 +30,12 @@ inline constinit GUID PIA_PROVIDER_KEY = {
 inline constinit GUID PIA_SUBLAYER_KEY = {
     0xf31e288d, 0xde5a, 0x4522, {0x94, 0x58, 0xde, 0x14, 0xeb, 0xd0, 0xa3, 0xf8}};
 
+// Whether a filter was installed by the PIA provider
+inline bool isPiaFilter(const FWPM_FILTER &filter)
+{
+    return filter.providerKey && IsEqualGUID(*filter.providerKey, PIA_PROVIDER_KEY);
+}
+
 // Base error
 class WfpError : public std::runtime_error
 {
@@ -54,55 +66,232 @@ struct WfpDeleter
     }
 };
 
-// Ensure filters are sorted by weight
-struct FilterCompare
+// One page of an FWPM enumeration - an array of entries in a single allocation
+template <typename EntryT> struct EnumPage
+{
+    std::shared_ptr<EntryT *> pEntries;
+    UINT32 size{0};
+
+    // A view of the i'th entry, sharing ownership of the page
+    auto entry(UINT32 i) const -> std::shared_ptr<EntryT>
+    {
+        // Aliasing constructor - points at the entry, owns the page
+        return {pEntries, pEntries.get()[i]};
+    }
+};
+
+// Pages through an FWPM enumeration on demand - fetchPage(pageSize, &ppEntries,
+// &numEntries) (e.g FwpmFilterEnum) is called as each page is asked for, until a short
+// page shows it's exhausted. A page is freed (with a single FwpmFreeMemory) once it and
+// the last view of its entries are released.
+// Throws a WfpError if a fetch fails.
+template <typename EntryT, typename PageDeleterT = WfpDeleter, typename FetchFuncT>
+auto enumPages(UINT32 pageSize, std::string fetchName, FetchFuncT fetchPage)
+    -> Generator<EnumPage<EntryT>>
+{
+    assert(pageSize > 0);
+
+    for(;;)
+    {
+        EntryT **ppEntries{nullptr};
+        UINT32 numEntries{0};
+        DWORD result = fetchPage(pageSize, &ppEntries, &numEntries);
+        if(result != ERROR_SUCCESS)
+        {
+            throw WfpError{fetchName + " failed:", result};
+        }
+
+        EnumPage<EntryT> page{std::shared_ptr<EntryT *>{ppEntries, PageDeleterT{}}, numEntries};
+        co_yield std::move(page);
+
+        if(numEntries < pageSize)
+        {
+            co_return;
+        }
+    }
+}
+
+// As enumPages(), but yields each entry in turn as a view sharing ownership of its page
+template <typename EntryT, typename PageDeleterT = WfpDeleter, typename FetchFuncT>
+auto enumEntries(UINT32 pageSize, std::string fetchName, FetchFuncT fetchPage)
+    -> Generator<std::shared_ptr<EntryT>>
+{
+    for(const auto &page : enumPages<EntryT, PageDeleterT>(pageSize, std::move(fetchName),
+                                                           std::move(fetchPage)))
+    {
+        for(UINT32 i = 0; i < page.size; ++i)
+        {
+            co_yield page.entry(i);
+        }
+    }
+}
+
+// As enumPages(), but hands every entry to func.
+// Returns the number of pages fetched.
+template <typename EntryT, typename PageDeleterT = WfpDeleter, typename FetchFuncT,
+          typename IterFuncT>
+    requires std::invocable<IterFuncT, std::shared_ptr<EntryT>>
+size_t forEachPagedEntry(UINT32 pageSize, std::string fetchName, FetchFuncT fetchPage,
+                         IterFuncT func)
+{
+    size_t pageCount{0};
+    for(const auto &page : enumPages<EntryT, PageDeleterT>(pageSize, std::move(fetchName),
+                                                           std::move(fetchPage)))
+    {
+        ++pageCount;
+        for(UINT32 i = 0; i < page.size; ++i)
+        {
+            func(page.entry(i));
+        }
+    }
+    return pageCount;
+}
+
+// The Fwpm*CreateEnumHandle, Fwpm*Enum and Fwpm*DestroyEnumHandle functions that
+// enumerate one kind of WFP object, specialized below for each kind
+template <typename ObjectT> struct FwpmEnumApi;
+
+template <> struct FwpmEnumApi<FWPM_FILTER>
+{
+    using TemplateT = FWPM_FILTER_ENUM_TEMPLATE;
+    static constexpr std::string_view name{"FwpmFilter"};
+    static constexpr auto createHandle = &FwpmFilterCreateEnumHandle;
+    static constexpr auto enumerate = &FwpmFilterEnum;
+    static constexpr auto destroyHandle = &FwpmFilterDestroyEnumHandle;
+};
+
+template <> struct FwpmEnumApi<FWPM_PROVIDER>
 {
-    // Make this a PtrT so it can work with raw pointers
-    // as well as smart ptrs
-    template <typename PtrT> bool operator()(const PtrT &lhs, const PtrT &rhs) const
+    using TemplateT = FWPM_PROVIDER_ENUM_TEMPLATE;
+    static constexpr std::string_view name{"FwpmProvider"};
+    static constexpr auto createHandle = &FwpmProviderCreateEnumHandle;
+    static constexpr auto enumerate = &FwpmProviderEnum;
+    static constexpr auto destroyHandle = &FwpmProviderDestroyEnumHandle;
+};
+
+template <> struct FwpmEnumApi<FWPM_SUBLAYER>
+{
+    using TemplateT = FWPM_SUBLAYER_ENUM_TEMPLATE;
+    static constexpr std::string_view name{"FwpmSubLayer"};
+    static constexpr auto createHandle = &FwpmSubLayerCreateEnumHandle;
+    static constexpr auto enumerate = &FwpmSubLayerEnum;
+    static constexpr auto destroyHandle = &FwpmSubLayerDestroyEnumHandle;
+};
+
+template <> struct FwpmEnumApi<FWPM_CALLOUT>
+{
+    using TemplateT = FWPM_CALLOUT_ENUM_TEMPLATE;
+    static constexpr std::string_view name{"FwpmCallout"};
+    static constexpr auto createHandle = &FwpmCalloutCreateEnumHandle;
+    static constexpr auto enumerate = &FwpmCalloutEnum;
+    static constexpr auto destroyHandle = &FwpmCalloutDestroyEnumHandle;
+};
+
+template <> struct FwpmEnumApi<FWPM_LAYER>
+{
+    using TemplateT = FWPM_LAYER_ENUM_TEMPLATE;
+    static constexpr std::string_view name{"FwpmLayer"};
+    static constexpr auto createHandle = &FwpmLayerCreateEnumHandle;
+    static constexpr auto enumerate = &FwpmLayerEnum;
+    static constexpr auto destroyHandle = &FwpmLayerDestroyEnumHandle;
+};
+
+// RAII wrapper around an enumeration handle for one kind of WFP object.
+// ApiT is FwpmEnumApi<ObjectT>, or a stand-in with the same members.
+template <typename ObjectT, typename ApiT = FwpmEnumApi<ObjectT>> class EnumHandle
+{
+public:
+    using TemplateT = typename ApiT::TemplateT;
+
+public:
+    // A null template enumerates every object of the kind.
+    // Throws a WfpError if the handle can't be created
+    EnumHandle(HANDLE engineHandle, const TemplateT *pEnumTemplate = nullptr)
+        : _engineHandle{engineHandle}
+    {
+        DWORD result = ApiT::createHandle(_engineHandle, pEnumTemplate, &_enumHandle);
+        if(result != ERROR_SUCCESS)
+        {
+            throw WfpError{std::format("{}CreateEnumHandle failed:", ApiT::name), result};
+        }
+    }
+    EnumHandle(EnumHandle &&) = delete;
+    EnumHandle(const EnumHandle &) = delete;
+    EnumHandle &operator=(const EnumHandle &) = delete;
+    EnumHandle &operator=(EnumHandle &&) = delete;
+    ~EnumHandle()
     {
-        // See here (weight section) for explanation of types
-        // https://learn.microsoft.com/en-us/windows/win32/api/fwpmtypes/ns-fwpmtypes-fwpm_filter0
-        switch(lhs->weight.type)
+        DWORD result = ApiT::destroyHandle(_engineHandle, _enumHandle);
+        if(result != ERROR_SUCCESS)
         {
-            // we don't check for this as the deref causes crashes sometimes - use u8 instead
-            case FWP_UINT64:
-                // if(lhs->weight.uint64 && rhs->weight.uint64)
-                //     return *(lhs->weight.uint64) > *(rhs->weight.uint64);
-                // else
-                // {
-                //     std::cerr << "invalid weight got null uint64!" << std::endl;
-                //     return true;
-                // }
-            case FWP_EMPTY: // Weight determined by BFE
-            case FWP_UINT8:
-            default: return lhs->weight.uint8 > rhs->weight.uint8;
+            // Just showing the error - we have the objects already, so let's give it a chance
+            std::cerr << std::format("{}DestroyEnumHandle failed: {}\n", ApiT::name,
+                                     getErrorString(result));
         }
     }
+
+public:
+    // Fetch the next page of objects - see enumPages()
+    DWORD fetch(UINT32 pageSize, ObjectT ***pppEntries, UINT32 *pNumEntries) const
+    {
+        return ApiT::enumerate(_engineHandle, _enumHandle, pageSize, pppEntries, pNumEntries);
+    }
+
+    // The name of the fetch function, for errors - e.g FwpmFilterEnum
+    static std::string fetchName()
+    {
+        return std::format("{}Enum", ApiT::name);
+    }
+
+private:
+    HANDLE _engineHandle{};
+    HANDLE _enumHandle{};
 };
 
-// Use a multiset so we can have multiple filters of the same weight
-using FilterSet = std::multiset<std::shared_ptr<FWPM_FILTER>, FilterCompare>;
+using FilterEnumHandle = EnumHandle<FWPM_FILTER>;
 
-// RAII Wrapper around FWPM_FILTER enumeration classes
+// Stream the objects of one kind the template selects (every one, with no template) a
+// page at a time - see enumPages(). The enumeration stays open until the generator is
+// destroyed, and only the pages still referenced are held.
+template <typename ObjectT, typename ApiT = FwpmEnumApi<ObjectT>,
+          typename PageDeleterT = WfpDeleter>
+auto enumObjects(HANDLE engineHandle, UINT32 pageSize,
+                 std::optional<typename ApiT::TemplateT> enumTemplate = {})
+    -> Generator<std::shared_ptr<ObjectT>>
+{
+    EnumHandle<ObjectT, ApiT> enumHandle{engineHandle, enumTemplate ? &*enumTemplate : nullptr};
+
+    auto fetchPage = [&](UINT32 count, ObjectT ***pppEntries, UINT32 *pNumEntries) {
+        return enumHandle.fetch(count, pppEntries, pNumEntries);
+    };
+    for(auto &pObject : enumEntries<ObjectT, PageDeleterT>(pageSize, enumHandle.fetchName(),
+                                                          fetchPage))
+    {
+        co_yield std::move(pObject);
+    }
+}
+
+// RAII Wrapper around FWPM_FILTER enumeration classes.
+// Filters are enumerated a page at a time until the layer is exhausted - each is a
+// view into its page, so a layer of any size takes a handful of round trips. They're
+// kept in the order the BFE enumerated them - see SortedFilters to rank them by weight.
 class SingleLayerFilterEnum
 {
-    enum
+public:
+    enum : UINT32
     {
-        MaxFilterCount = 5000
+        DefaultPageSize = 5000
     };
 
 public:
-    SingleLayerFilterEnum(const GUID &layerKey, HANDLE engineHandle);
+    // Only the filters the BFE selects for the query are enumerated - see FilterQuery
+    SingleLayerFilterEnum(const GUID &layerKey, HANDLE engineHandle,
+                          UINT32 pageSize = DefaultPageSize, const FilterQuery &query = {});
     SingleLayerFilterEnum(SingleLayerFilterEnum &&) = delete;
     SingleLayerFilterEnum(const SingleLayerFilterEnum &) = delete;
     SingleLayerFilterEnum &operator=(const SingleLayerFilterEnum &) = delete;
     SingleLayerFilterEnum &operator=(SingleLayerFilterEnum &&) = delete;
 
-private:
-    // Build the enumeration template
-    auto createEnumTemplate(const GUID &layerKey) const -> FWPM_FILTER_ENUM_TEMPLATE;
-
 public:
     template <typename IterFuncT>
         requires std::invocable<IterFuncT, std::shared_ptr<FWPM_FILTER>>
@@ -114,14 +303,20 @@ public:
         }
     }
 
-    const FilterSet &filters() const
+    auto filters() const -> const std::vector<std::shared_ptr<FWPM_FILTER>> &
     {
         return _pFilters;
     }
 
+    // FwpmFilterEnum calls made
+    size_t pageCount() const
+    {
+        return _pageCount;
+    }
+
 private:
-    HANDLE _engineHandle{};
-    FilterSet _pFilters;
+    std::vector<std::shared_ptr<FWPM_FILTER>> _pFilters;
+    size_t _pageCount{0};
 };
 
 // Wraps SingleLayerFilterEnum to allow iteration over
@@ -129,9 +324,11 @@ private:
 class FilterEnum
 {
 public:
-    FilterEnum(const std::vector<GUID> &layers, HANDLE engineHandle)
+    FilterEnum(const std::vector<GUID> &layers, HANDLE engineHandle,
+               UINT32 pageSize = SingleLayerFilterEnum::DefaultPageSize)
         : _engineHandle{engineHandle}
         , _layers{layers}
+        , _pageSize{pageSize}
     {}
 
 public:
@@ -141,7 +338,7 @@ public:
     {
         for(const auto &layer : _layers)
         {
-            SingleLayerFilterEnum{layer, _engineHandle}.forEach(
+            SingleLayerFilterEnum{layer, _engineHandle, _pageSize}.forEach(
                 [&](const auto &pFilter) { func(pFilter); });
         }
     }
@@ -149,6 +346,7 @@ public:
 private:
     HANDLE _engineHandle{};
     std::vector<GUID> _layers;
+    UINT32 _pageSize{SingleLayerFilterEnum::DefaultPageSize};
 };
 
 // Monitor live WFP events
@@ -162,9 +360,10 @@ public:
         assert(_engineHandle); // pre-condition
     }
 
+    // The callback is given pContext with each event
     template <typename FuncT>
         requires std::invocable<FuncT, void *, const FWPM_NET_EVENT *>
-    void start(FuncT callbackFunc)
+    void start(FuncT callbackFunc, void *pContext = nullptr)
     {
         // Template that determines the events we're interested in
         FWPM_NET_EVENT_ENUM_TEMPLATE eventEnumTemplate{};
@@ -184,8 +383,7 @@ public:
         subscription.enumTemplate = &eventEnumTemplate;
 
         DWORD result = FwpmNetEventSubscribe(_engineHandle, &subscription, callbackFunc,
-                                             NULL, // Context for the callback; can be NULL
-                                             &_eventSubscriptionHandle);
+                                             pContext, &_eventSubscriptionHandle);
 
         if(result != ERROR_SUCCESS)
         {
@@ -213,12 +411,21 @@ private:
     HANDLE _eventSubscriptionHandle{};
 };
 
-// RAII wrapper around FWPEngine - also a singleton that can be
-// accessed via Engine::instance()
-class Engine : public Singleton<Engine>
+// How an engine session is opened
+enum class SessionKind
+{
+    Standard,
+    // Everything added in the session is deleted when it closes, and it can't add
+    // persistent objects
+    Dynamic
+};
+
+// RAII wrapper around FWPEngine - the first one opened (the application's own) can
+// be accessed via Engine::instance()
+class Engine : public PrimaryInstance<Engine>
 {
 public:
-    Engine();
+    explicit Engine(SessionKind kind = SessionKind::Standard);
     Engine(Engine &&) = delete;
     Engine(const Engine &) = delete;
     Engine &operator=(const Engine &) = delete;
@@ -227,6 +434,16 @@ public:
 
 public:
     FilterId add(const FWPM_FILTER &filter);
+    // Add a filter without any tracing, the new filter id is written to id.
+    // Intended for bulk adds where the caller handles errors.
+    DWORD tryAdd(const FWPM_FILTER &filter, FilterId &id) const;
+
+    // Group BFE changes into a single atomic unit
+    // begin and commit throw a WfpError on failure
+    void beginTransaction() const;
+    void commitTransaction() const;
+    // Discards all changes since beginTransaction()
+    DWORD abortTransaction() const;
     // template <typename WfpObjectType, typename LookupType>
     // WfpObjectType *getWfpObject(const LookupType &lookup)
     // {
@@ -250,6 +467,12 @@ public:
         return pFilter;
     }
 
+    // A filter by id, or nullptr if it isn't installed (e.g it's been deleted since its
+    // id was seen). Throws a WfpError on any other failure.
+    auto filterById(FilterId filterId) const -> std::shared_ptr<FWPM_FILTER>;
+    // As filterById(), by key
+    auto filterByKey(const GUID &filterKey) const -> std::shared_ptr<FWPM_FILTER>;
+
     FWP_BYTE_BLOB *getAppIdFromFileName(const std::wstring &appPath)
     {
         FWP_BYTE_BLOB *pBlob{nullptr};
@@ -281,6 +504,17 @@ public:
         return pSublayer;
     }
 
+    // Provider and sublayer display names, each fetched once per session - see
+    // ObjectNameCache. A cache, so it can be used through a const engine.
+    auto providerNames() const -> ObjectNameCache &
+    {
+        return _providerNames;
+    }
+    auto subLayerNames() const -> ObjectNameCache &
+    {
+        return _subLayerNames;
+    }
+
     FWPM_PROVIDER *getProviderByKey(const GUID &providerKey) const
     {
         FWPM_PROVIDER *pProvider{nullptr};
@@ -295,37 +529,93 @@ public:
         return pProvider;
     }
 
+    // Objects fetched per Fwpm*Enum call when enumerating - larger pages take fewer
+    // round trips, but more memory is held at once
+    void setPageSize(UINT32 pageSize)
+    {
+        _pageSize = std::max<UINT32>(pageSize, 1);
+    }
+    UINT32 pageSize() const
+    {
+        return _pageSize;
+    }
+
     // Iterate over all filters for all given layers
     template <typename IterFuncT>
         requires std::invocable<IterFuncT, std::shared_ptr<FWPM_FILTER>>
     void enumerateFiltersForLayers(const std::vector<GUID> &layerKeys, IterFuncT func) const
     {
-        FilterEnum{layerKeys, _handle}.forEach(func);
+        FilterEnum{layerKeys, _handle, _pageSize}.forEach(func);
     }
 
-    // Iterate over filters for just one layer
+    // Iterate over filters for just one layer - those the BFE selects for the query
     template <typename IterFuncT>
         requires std::invocable<IterFuncT, std::shared_ptr<FWPM_FILTER>>
-    void enumerateFiltersForLayer(const GUID &layerKey, IterFuncT func) const
+    void enumerateFiltersForLayer(const GUID &layerKey, IterFuncT func,
+                                  const FilterQuery &query = {}) const
     {
-        SingleLayerFilterEnum{layerKey, _handle}.forEach(func);
+        SingleLayerFilterEnum{layerKey, _handle, _pageSize, query}.forEach(func);
     }
 
-    auto filtersForLayer(const GUID &layerKey) const -> FilterSet
+    auto filtersForLayer(const GUID &layerKey) const
+        -> std::vector<std::shared_ptr<FWPM_FILTER>>
     {
-        return SingleLayerFilterEnum{layerKey, _handle}.filters();
+        return SingleLayerFilterEnum{layerKey, _handle, _pageSize}.filters();
+    }
+
+    // Stream the filters of one layer, in the order the BFE enumerates them. Pages are
+    // fetched as they're reached, so only the page being read is held - stopping early
+    // (destroying the generator) fetches no more and closes the enumeration.
+    // e.g: for(const auto &pFilter : engine.filters(layerKey) | std::views::take(10))
+    auto filters(GUID layerKey, FilterQuery query = {}) const
+        -> Generator<std::shared_ptr<FWPM_FILTER>>;
+
+    // Stream every installed object of one kind - FWPM_PROVIDER, FWPM_SUBLAYER,
+    // FWPM_CALLOUT, FWPM_LAYER or FWPM_FILTER (across all layers). As filters(), pages
+    // are fetched as they're reached.
+    template <typename ObjectT> auto objects() const -> Generator<std::shared_ptr<ObjectT>>
+    {
+        return enumObjects<ObjectT>(_handle, _pageSize);
     }
 
     template <typename CallbackFuncT>
         requires std::invocable<CallbackFuncT, void *, const FWPM_NET_EVENT *>
-    void monitorEvents(CallbackFuncT callbackFunc)
+    void monitorEvents(CallbackFuncT callbackFunc, void *pContext = nullptr)
     {
         _pMonitor = std::make_unique<EventMonitor>(_handle);
-        _pMonitor->start(callbackFunc);
+        _pMonitor->start(callbackFunc, pContext);
+    }
+    // No more events are delivered once this returns
+    void stopMonitoringEvents()
+    {
+        _pMonitor.reset();
     }
 
+    // Subscribe to every filter, provider and sublayer added or deleted, by any session.
+    // The callback is called on one of the BFE's threads, and only with the object's key
+    // (and a filter's id) - see ObjectChange. Changes stop when the subscription is
+    // destroyed, which must happen before the engine is.
+    // Throws a WfpError if any of the subscriptions fail.
+    auto subscribeChanges(ChangeCallback callback) const -> ChangeSubscription;
+
     // Delete a filter by Id
     DWORD deleteFilterById(FilterId filerId) const;
+    // Delete a filter by key - keys outlive a reboot, unlike ids
+    DWORD deleteFilterByKey(const GUID &filterKey) const;
+
+    // Add or delete a provider without any tracing - for wfpk's own bookkeeping providers
+    DWORD tryAddProvider(const FWPM_PROVIDER &provider) const;
+    DWORD deleteProviderByKey(const GUID &providerKey) const;
+    // A copy of a provider's providerData, or nullopt if the provider isn't installed.
+    // Throws a WfpError on any other failure.
+    auto providerData(const GUID &providerKey) const -> std::optional<std::vector<UINT8>>;
+
+    // As above, for wfpk's own sublayers
+    DWORD tryAddSubLayer(const FWPM_SUBLAYER &subLayer) const;
+    DWORD deleteSubLayerByKey(const GUID &subLayerKey) const;
+    // A sublayer's weight, or nullopt if the sublayer isn't installed.
+    // Throws a WfpError on any other failure.
+    auto subLayerWeight(const GUID &subLayerKey) const -> std::optional<UINT16>;
 
     auto handle() -> HANDLE
     {
@@ -336,8 +626,19 @@ public:
         return handle();
     }
 
+private:
+    // Display names for the name caches, nullopt if there's no such object.
+    // Throw a WfpError on any other failure.
+    auto fetchProviderName(const GUID &providerKey) const -> std::optional<std::string>;
+    auto fetchSubLayerName(const GUID &subLayerKey) const -> std::optional<std::string>;
+
 private:
     HANDLE _handle{};
+    UINT32 _pageSize{SingleLayerFilterEnum::DefaultPageSize};
     std::unique_ptr<EventMonitor> _pMonitor;
+    mutable ObjectNameCache _providerNames{
+        [this](const GUID &key) { return fetchProviderName(key); }};
+    mutable ObjectNameCache _subLayerNames{
+        [this](const GUID &key) { return fetchSubLayerName(key); }};
 };
 }
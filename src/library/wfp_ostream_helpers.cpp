@@ -14,6 +14,19 @@
 
 namespace wfpk
 {
+namespace
+{
+// Display names are optional, and description almost always is
+std::string displayName(const FWPM_DISPLAY_DATA &displayData)
+{
+    std::string name = displayData.name ? wideStringToString(displayData.name) : "<unnamed>";
+    if(displayData.description && *displayData.description)
+    {
+        name += " - " + wideStringToString(displayData.description);
+    }
+    return name;
+}
+}
 
 std::ostream &operator<<(std::ostream &os, const FWPM_NET_EVENT &event)
 {
@@ -60,15 +73,6 @@ std::ostream &operator<<(std::ostream &os, const FWPM_NET_EVENT &event)
                       eventType, fileName, localAddress, header.localPort, remoteAddress,
                       header.remotePort);
 
-    // pre-condition, an engine must exist
-    assert(Engine::instance());
-    // Grab a pointer to the applied filter
-    std::unique_ptr<FWPM_FILTER, WfpDeleter> pFilter{Engine::instance()->getFilterById(filterId)};
-    if(pFilter)
-    {
-        os << "\n    - (Filter applied: " << *pFilter << ")";
-    }
-
     return os;
 }
 
@@ -162,4 +166,42 @@ std::ostream &operator<<(std::ostream &os, const FWPM_FILTER_CONDITION &conditio
 
     return os;
 }
+
+std::ostream &operator<<(std::ostream &os, const FWPM_PROVIDER &provider)
+{
+    os << std::format("[Key: {}] {}", guidToString(provider.providerKey),
+                      displayName(provider.displayData));
+    return os;
+}
+
+std::ostream &operator<<(std::ostream &os, const FWPM_SUBLAYER &subLayer)
+{
+    os << std::format("[Key: {}] [Weight: {:5}] {}", guidToString(subLayer.subLayerKey),
+                      subLayer.weight, displayName(subLayer.displayData));
+    if(subLayer.providerKey)
+    {
+        os << std::format(" (provider: {})", guidToString(*subLayer.providerKey));
+    }
+    return os;
+}
+
+std::ostream &operator<<(std::ostream &os, const FWPM_CALLOUT &callout)
+{
+    os << std::format("[Id: {}] {} {}", callout.calloutId,
+                      WfpNameMapper::getName(callout.applicableLayer).friendlyName,
+                      displayName(callout.displayData));
+    if(callout.providerKey)
+    {
+        os << std::format(" (provider: {})", guidToString(*callout.providerKey));
+    }
+    return os;
+}
+
+std::ostream &operator<<(std::ostream &os, const FWPM_LAYER &layer)
+{
+    os << std::format("[Id: {}] {} ({} fields) {}", layer.layerId,
+                      WfpNameMapper::getName(layer.layerKey).rawName, layer.numFields,
+                      displayName(layer.displayData));
+    return os;
+}
 }
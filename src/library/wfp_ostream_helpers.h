@@ -8,4 +8,8 @@ namespace wfpk
 std::ostream &operator<<(std::ostream &os, const FWPM_FILTER &filter);
 std::ostream &operator<<(std::ostream &os, const FWPM_FILTER_CONDITION &condition);
 std::ostream &operator<<(std::ostream &os, const FWPM_NET_EVENT &event);
+std::ostream &operator<<(std::ostream &os, const FWPM_PROVIDER &provider);
+std::ostream &operator<<(std::ostream &os, const FWPM_SUBLAYER &subLayer);
+std::ostream &operator<<(std::ostream &os, const FWPM_CALLOUT &callout);
+std::ostream &operator<<(std::ostream &os, const FWPM_LAYER &layer);
 }
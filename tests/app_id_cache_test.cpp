@@ -0,0 +1,172 @@
+#include <apply/app_id_cache.h>
+#include <apply/filter_plan.h>
+#include "test_rules.h"
+#include <gtest/gtest.h>
+#include <fstream>
+#include <mutex>
+
+using namespace wfpk;
+
+namespace
+{
+// Apps in a fresh temporary directory, removed afterwards
+class AppIdCacheTests : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        const auto *pTest = ::testing::UnitTest::GetInstance()->current_test_info();
+        _dir = std::filesystem::temp_directory_path() / std::format("wfpk_{}", pTest->name());
+        std::filesystem::remove_all(_dir);
+        std::filesystem::create_directories(_dir);
+    }
+    void TearDown() override
+    {
+        std::filesystem::remove_all(_dir);
+    }
+
+    std::string makeApp(const std::string &name, const std::string &content = "app")
+    {
+        const auto path = _dir / name;
+        std::ofstream{path} << content;
+        return path.string();
+    }
+
+    auto cachePath() const -> std::filesystem::path
+    {
+        return _dir / "appids.cache";
+    }
+
+    // Counts its calls, resolving a path to its own bytes
+    AppIdResolver countingResolver()
+    {
+        return [this](const std::string &appPath) {
+            std::scoped_lock lock{_mutex};
+            ++_resolved[appPath];
+            return std::vector<UINT8>(appPath.begin(), appPath.end());
+        };
+    }
+
+    size_t resolvedCount(const std::string &appPath)
+    {
+        std::scoped_lock lock{_mutex};
+        return _resolved[appPath];
+    }
+
+private:
+    std::filesystem::path _dir;
+    std::mutex _mutex;
+    std::unordered_map<std::string, size_t> _resolved;
+};
+}
+
+TEST_F(AppIdCacheTests, TestResolvesEachFileOnce)
+{
+    const auto app = makeApp("app.exe");
+    AppIdCache cache{countingResolver()};
+
+    const auto appId = cache.resolve(app);
+    ASSERT_EQ(cache.resolve(app), appId);
+    ASSERT_EQ(cache.resolve(app), appId);
+
+    ASSERT_EQ(resolvedCount(app), 1);
+    ASSERT_EQ(cache.stats().hits, 2);
+    ASSERT_EQ(cache.stats().misses, 1);
+}
+
+TEST_F(AppIdCacheTests, TestChangedFileIsResolvedAgain)
+{
+    const auto app = makeApp("app.exe");
+    AppIdCache cache{countingResolver()};
+    cache.resolve(app);
+
+    // An update that changes the file's size
+    makeApp("app.exe", "a newer app");
+    cache.resolve(app);
+    cache.resolve(app);
+
+    ASSERT_EQ(resolvedCount(app), 2);
+    ASSERT_EQ(cache.stats().stale, 1);
+    ASSERT_EQ(cache.stats().hits, 1);
+}
+
+TEST_F(AppIdCacheTests, TestMissingFilesAndFailuresAreNotCached)
+{
+    const auto app = makeApp("app.exe");
+    const auto missing = (std::filesystem::path{app}.parent_path() / "missing.exe").string();
+    AppIdCache cache{[](const std::string &appPath) {
+        return appPath.ends_with("missing.exe") ? std::vector<UINT8>{} : std::vector<UINT8>{1};
+    }};
+
+    ASSERT_TRUE(cache.resolve(missing).empty());
+    ASSERT_TRUE(cache.resolve(missing).empty());
+    ASSERT_EQ(cache.stats().failures, 2);
+    ASSERT_EQ(cache.size(), 0);
+}
+
+TEST_F(AppIdCacheTests, TestPersistsAcrossLoads)
+{
+    const auto app = makeApp("app.exe");
+    {
+        AppIdCache cache{countingResolver(), cachePath()};
+        cache.resolve(app);
+        cache.save();
+    }
+
+    AppIdCache reloaded{countingResolver(), cachePath()};
+    ASSERT_EQ(reloaded.size(), 1);
+    reloaded.resolve(app);
+
+    ASSERT_EQ(resolvedCount(app), 1);
+    ASSERT_EQ(reloaded.stats().hits, 1);
+}
+
+TEST_F(AppIdCacheTests, TestNormalizesPaths)
+{
+    ASSERT_EQ(normalizeAppPath("C:/Apps/./Tools/../App.EXE"), normalizeAppPath("c:/apps/app.exe"));
+    ASSERT_NE(normalizeAppPath("c:/apps/app.exe"), normalizeAppPath("c:/apps/app2.exe"));
+}
+
+TEST_F(AppIdCacheTests, TestDamagedCacheIsIgnored)
+{
+    std::ofstream{cachePath()} << "WFPKAPID garbage";
+    AppIdCache cache{countingResolver(), cachePath()};
+
+    ASSERT_EQ(cache.size(), 0);
+    ASSERT_EQ(cache.resolve(makeApp("app.exe")).empty(), false);
+}
+
+TEST_F(AppIdCacheTests, TestResolvesDistinctAppsInParallel)
+{
+    std::vector<std::string> apps;
+    for(size_t i = 0; i < 64; ++i)
+    {
+        apps.push_back(makeApp(std::format("app{}.exe", i)));
+    }
+    AppIdCache cache{countingResolver()};
+
+    const auto appIds = resolveAppIds(apps, cache.resolver(), 8);
+
+    ASSERT_EQ(appIds.size(), apps.size());
+    for(const auto &app : apps)
+    {
+        ASSERT_EQ(appIds.at(app), std::vector<UINT8>(app.begin(), app.end()));
+        ASSERT_EQ(resolvedCount(app), 1);
+    }
+    ASSERT_EQ(cache.stats().misses, apps.size());
+}
+
+TEST_F(AppIdCacheTests, TestPlanResolvesEachAppOnce)
+{
+    const auto app = makeApp("app.exe");
+    std::string rules;
+    for(size_t i = 0; i < 1000; ++i)
+    {
+        rules += std::format("permit out from \"{}\" to 10.0.{}.{}\n", app, i / 256, i % 256);
+    }
+
+    const auto plan = planRuleset(rules, testDisplayData, "test", countingResolver());
+
+    ASSERT_EQ(plan.batch.size(), 1000);
+    ASSERT_EQ(resolvedCount(app), 1);
+}
@@ -0,0 +1,149 @@
+#include <engine/async_engine.h>
+#include <engine/simulated_bfe.h>
+#include <gtest/gtest.h>
+#include <chrono>
+
+using namespace wfpk;
+using namespace std::chrono_literals;
+
+namespace
+{
+FWPM_FILTER blockFilter(const GUID &layerKey)
+{
+    FWPM_FILTER filter{};
+    filter.layerKey = layerKey;
+    filter.subLayerKey = PIA_SUBLAYER_KEY;
+    filter.providerKey = &PIA_PROVIDER_KEY;
+    filter.action.type = FWP_ACTION_BLOCK;
+    return filter;
+}
+
+auto bfeSessions(SimulatedBfe &bfe, size_t maxSessions) -> SessionPool<SimulatedBfe::Session>
+{
+    return {[&bfe] { return bfe.openSession(); }, maxSessions};
+}
+
+Async<int> twice(Async<int> value)
+{
+    co_return 2 * co_await value;
+}
+
+Async<void> failAfter(Async<int> value)
+{
+    co_await value;
+    throw std::runtime_error{"failed"};
+}
+
+// Adds a filter to each layer, then enumerates them all - the layers at once
+Async<size_t> addThenCount(AsyncEngine<SimulatedBfe::Session> &engine,
+                           const std::vector<FWPM_FILTER> &filters)
+{
+    std::vector<Async<FilterId>> adds;
+    for(const auto &filter : filters)
+    {
+        adds.push_back(engine.addAsync(filter));
+    }
+    for(auto &add : adds)
+    {
+        co_await add;
+    }
+
+    std::vector<Async<AsyncEngine<SimulatedBfe::Session>::Filters>> enums;
+    for(const auto &filter : filters)
+    {
+        enums.push_back(engine.enumerateAsync(filter.layerKey));
+    }
+    size_t count{0};
+    for(auto &layerFilters : enums)
+    {
+        count += (co_await layerFilters).size();
+    }
+    co_return count;
+}
+}
+
+TEST(AsyncEngineTests, TestResultsAndErrorsPassThroughAwaits)
+{
+    Executor executor{2};
+
+    ASSERT_EQ(twice(executor.submit([] { return 21; })).get(), 42);
+
+    // Already settled when awaited, so the coroutine doesn't suspend
+    Async<int>::Completion settled;
+    settled.setValue(1);
+    ASSERT_EQ(twice(settled.async()).get(), 2);
+
+    auto thrown = executor.submit([]() -> int { throw std::runtime_error{"failed"}; });
+    ASSERT_THROW(twice(std::move(thrown)).get(), std::runtime_error);
+    ASSERT_THROW(failAfter(executor.submit([] { return 1; })).get(), std::runtime_error);
+}
+
+TEST(AsyncEngineTests, TestAddsEnumeratesAndDeletes)
+{
+    SimulatedBfe bfe;
+    auto sessions = bfeSessions(bfe, 2);
+    AsyncEngine engine{sessions};
+
+    const auto filter = blockFilter(FWPM_LAYER_ALE_AUTH_CONNECT_V4);
+    const auto id = engine.addAsync(filter).get();
+    ASSERT_EQ(bfe.engine().filterCount(), 1);
+
+    const auto filters = engine.enumerateAsync(FWPM_LAYER_ALE_AUTH_CONNECT_V4).get();
+    ASSERT_EQ(filters.size(), 1);
+    ASSERT_EQ(filters.front()->filterId, id);
+    ASSERT_TRUE(engine.enumerateAsync(FWPM_LAYER_ALE_AUTH_RECV_ACCEPT_V4).get().empty());
+
+    ASSERT_EQ(engine.deleteAsync(id).get(), ERROR_SUCCESS);
+    ASSERT_EQ(engine.deleteAsync(id).get(), FWP_E_FILTER_NOT_FOUND);
+    ASSERT_EQ(bfe.engine().filterCount(), 0);
+}
+
+TEST(AsyncEngineTests, TestFailedAddsThrow)
+{
+    SimulatedBfe bfe;
+    auto sessions = bfeSessions(bfe, 1);
+    AsyncEngine engine{sessions};
+
+    bfe.engine().failAddAfter(0);
+    const auto filter = blockFilter(FWPM_LAYER_ALE_AUTH_CONNECT_V4);
+    ASSERT_THROW(engine.addAsync(filter).get(), WfpError);
+    ASSERT_EQ(sessions.idleCount(), sessions.openCount());
+}
+
+TEST(AsyncEngineTests, TestIndependentOperationsOverlap)
+{
+    constexpr auto kLatency = 20ms;
+    SimulatedBfe bfe{kLatency};
+    auto sessions = bfeSessions(bfe, 4);
+    AsyncEngine engine{sessions};
+
+    std::vector<FWPM_FILTER> filters;
+    for(unsigned long i = 0; i < 8; ++i)
+    {
+        filters.push_back(blockFilter(GUID{i + 1}));
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ(addThenCount(engine, filters).get(), filters.size());
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    // The sessions opened, then 8 adds and 8 enumerations - up to 4 at once
+    ASSERT_EQ(bfe.roundTrips(), sessions.openCount() + 16);
+    ASSERT_GT(bfe.peakConcurrentCalls(), 1);
+    ASSERT_LE(bfe.peakConcurrentCalls(), 4);
+    ASSERT_LT(elapsed, kLatency * bfe.roundTrips());
+}
+
+TEST(AsyncEngineTests, TestOtherWorkOverlapsWithRoundTrips)
+{
+    SimulatedBfe bfe{50ms};
+    auto sessions = bfeSessions(bfe, 1);
+    AsyncEngine engine{sessions, 2};
+
+    auto filters = engine.enumerateAsync(FWPM_LAYER_ALE_AUTH_CONNECT_V4);
+    auto appId = engine.runAsync([] { return std::vector<UINT8>{1, 2, 3}; });
+    ASSERT_EQ(appId.get().size(), 3);
+    // Resolved while the enumeration still waits on the BFE
+    ASSERT_FALSE(filters.isReady());
+    ASSERT_TRUE(filters.get().empty());
+}
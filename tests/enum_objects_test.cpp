@@ -0,0 +1,229 @@
+#include <wfp_objects.h>
+#include <gtest/gtest.h>
+
+using namespace wfpk;
+
+namespace
+{
+size_t livePages{0};
+
+// Stands in for the BFE's enumeration functions for one kind of object - an in-memory
+// table handed out a page at a time, each page an array of pointers into the table
+template <typename ObjectT> struct FakeEnumApi
+{
+    using TemplateT = typename FwpmEnumApi<ObjectT>::TemplateT;
+    static constexpr std::string_view name{"FwpmFake"};
+
+    static DWORD createHandle(HANDLE, const TemplateT *pEnumTemplate, HANDLE *pEnumHandle)
+    {
+        if(createResult != ERROR_SUCCESS)
+        {
+            return createResult;
+        }
+        ++openHandles;
+        hadTemplate = pEnumTemplate != nullptr;
+        cursor = 0;
+        *pEnumHandle = reinterpret_cast<HANDLE>(&cursor);
+        return ERROR_SUCCESS;
+    }
+
+    static DWORD enumerate(HANDLE, HANDLE enumHandle, UINT32 pageSize, ObjectT ***pppEntries,
+                           UINT32 *pNumEntries)
+    {
+        EXPECT_EQ(enumHandle, reinterpret_cast<HANDLE>(&cursor));
+        ++fetchCount;
+        if(fetchCount == failingFetch)
+        {
+            return ERROR_ACCESS_DENIED;
+        }
+
+        const size_t count = std::min<size_t>(pageSize, objects.size() - cursor);
+        auto **ppPage = new ObjectT *[count];
+        for(size_t i = 0; i < count; ++i)
+        {
+            ppPage[i] = &objects[cursor++];
+        }
+        ++livePages;
+
+        *pppEntries = ppPage;
+        *pNumEntries = static_cast<UINT32>(count);
+        return ERROR_SUCCESS;
+    }
+
+    static DWORD destroyHandle(HANDLE, HANDLE)
+    {
+        --openHandles;
+        return ERROR_SUCCESS;
+    }
+
+    // Fills the table with count objects, told apart by their flags
+    static void reset(size_t count)
+    {
+        objects.assign(count, ObjectT{});
+        for(size_t i = 0; i < count; ++i)
+        {
+            objects[i].flags = static_cast<UINT32>(i);
+        }
+        createResult = ERROR_SUCCESS;
+        failingFetch = 0;
+        fetchCount = 0;
+        openHandles = 0;
+        hadTemplate = false;
+    }
+
+    static inline std::vector<ObjectT> objects;
+    static inline size_t cursor{0};
+    static inline DWORD createResult{ERROR_SUCCESS};
+    // The fetch (counting from 1) that fails, 0 for none
+    static inline size_t failingFetch{0};
+    static inline size_t fetchCount{0};
+    static inline int openHandles{0};
+    static inline bool hadTemplate{false};
+};
+
+// Frees a page as FwpmFreeMemory would
+struct FakePageDeleter
+{
+    template <typename ObjectT> void operator()(ObjectT **ppPage) const
+    {
+        if(ppPage)
+        {
+            delete[] ppPage;
+            --livePages;
+        }
+    }
+};
+
+template <typename ObjectT>
+auto fakeObjects(UINT32 pageSize,
+                 std::optional<typename FakeEnumApi<ObjectT>::TemplateT> enumTemplate = {})
+{
+    return enumObjects<ObjectT, FakeEnumApi<ObjectT>, FakePageDeleter>(nullptr, pageSize,
+                                                                       enumTemplate);
+}
+
+template <typename ObjectT> auto flagsOf(Generator<std::shared_ptr<ObjectT>> objects)
+{
+    std::vector<UINT32> flags;
+    for(const auto &pObject : objects)
+    {
+        flags.push_back(pObject->flags);
+    }
+    return flags;
+}
+
+template <typename ObjectT> class EnumObjectsTests : public testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        livePages = 0;
+    }
+};
+
+using ObjectKinds = testing::Types<FWPM_PROVIDER, FWPM_SUBLAYER, FWPM_CALLOUT, FWPM_LAYER,
+                                   FWPM_FILTER>;
+TYPED_TEST_SUITE(EnumObjectsTests, ObjectKinds);
+}
+
+TYPED_TEST(EnumObjectsTests, TestEnumeratesEveryObjectAPageAtATime)
+{
+    using Api = FakeEnumApi<TypeParam>;
+    Api::reset(7);
+
+    const auto flags = flagsOf(fakeObjects<TypeParam>(3));
+
+    EXPECT_EQ(flags, (std::vector<UINT32>{0, 1, 2, 3, 4, 5, 6}));
+    EXPECT_EQ(Api::fetchCount, 3);
+    EXPECT_FALSE(Api::hadTemplate);
+    EXPECT_EQ(Api::openHandles, 0);
+    EXPECT_EQ(livePages, 0);
+}
+
+TYPED_TEST(EnumObjectsTests, TestFullLastPageTakesOneMoreFetch)
+{
+    using Api = FakeEnumApi<TypeParam>;
+    Api::reset(6);
+
+    EXPECT_EQ(flagsOf(fakeObjects<TypeParam>(3)).size(), 6);
+    // Only a short page shows the enumeration is exhausted
+    EXPECT_EQ(Api::fetchCount, 3);
+    EXPECT_EQ(Api::openHandles, 0);
+}
+
+TYPED_TEST(EnumObjectsTests, TestStoppingEarlyClosesTheHandle)
+{
+    using Api = FakeEnumApi<TypeParam>;
+    Api::reset(20);
+
+    {
+        auto objects = fakeObjects<TypeParam>(5);
+        auto it = objects.begin();
+        auto pFirst = *it;
+        ++it;
+
+        EXPECT_EQ(Api::openHandles, 1);
+        EXPECT_EQ(Api::fetchCount, 1);
+        EXPECT_EQ(pFirst->flags, 0);
+    }
+
+    EXPECT_EQ(Api::fetchCount, 1);
+    EXPECT_EQ(Api::openHandles, 0);
+    EXPECT_EQ(livePages, 0);
+}
+
+TYPED_TEST(EnumObjectsTests, TestObjectsKeepTheirPageAlive)
+{
+    using Api = FakeEnumApi<TypeParam>;
+    Api::reset(4);
+
+    std::shared_ptr<TypeParam> pKept;
+    for(const auto &pObject : fakeObjects<TypeParam>(2))
+    {
+        if(pObject->flags == 1)
+        {
+            pKept = pObject;
+        }
+    }
+
+    EXPECT_EQ(Api::openHandles, 0);
+    EXPECT_EQ(livePages, 1);
+    EXPECT_EQ(pKept->flags, 1);
+
+    pKept.reset();
+    EXPECT_EQ(livePages, 0);
+}
+
+TYPED_TEST(EnumObjectsTests, TestFailedFetchThrowsAndClosesTheHandle)
+{
+    using Api = FakeEnumApi<TypeParam>;
+    Api::reset(10);
+    Api::failingFetch = 2;
+
+    EXPECT_THROW(flagsOf(fakeObjects<TypeParam>(4)), WfpError);
+    EXPECT_EQ(Api::openHandles, 0);
+    EXPECT_EQ(livePages, 0);
+}
+
+TYPED_TEST(EnumObjectsTests, TestFailedCreateThrows)
+{
+    using Api = FakeEnumApi<TypeParam>;
+    Api::reset(10);
+    Api::createResult = ERROR_ACCESS_DENIED;
+
+    EXPECT_THROW(flagsOf(fakeObjects<TypeParam>(4)), WfpError);
+    EXPECT_EQ(Api::fetchCount, 0);
+    EXPECT_EQ(Api::openHandles, 0);
+}
+
+TEST(EnumObjectsTests, TestTemplateIsPassedToTheHandle)
+{
+    using Api = FakeEnumApi<FWPM_SUBLAYER>;
+    Api::reset(3);
+
+    GUID providerKey{0x1234};
+    EXPECT_EQ(flagsOf(fakeObjects<FWPM_SUBLAYER>(10, FWPM_SUBLAYER_ENUM_TEMPLATE{&providerKey}))
+                  .size(),
+              3);
+    EXPECT_TRUE(Api::hadTemplate);
+}
@@ -0,0 +1,40 @@
+#include <apply/ephemeral_filters.h>
+#include <apply/filter_applier.h>
+#include <apply/filter_plan.h>
+#include <engine/memory_engine.h>
+#include "test_rules.h"
+#include <gtest/gtest.h>
+
+using namespace wfpk;
+
+TEST(EphemeralFiltersTests, TestFiltersAreNotPersistent)
+{
+    const auto plan = planRuleset("block out to 10.0.0.1\npermit in from 10.0.0.2\n",
+                                  testDisplayData, "test");
+    const auto persistent = plan.batch.filters();
+    const auto ephemeral = ephemeralFilters(persistent, "test");
+
+    ASSERT_EQ(ephemeral.size(), persistent.size());
+    for(size_t i = 0; i < ephemeral.size(); ++i)
+    {
+        ASSERT_TRUE(persistent[i].flags & FWPM_FILTER_FLAG_PERSISTENT);
+        ASSERT_FALSE(ephemeral[i].flags & FWPM_FILTER_FLAG_PERSISTENT);
+        ASSERT_TRUE(ephemeral[i].flags & FWPM_FILTER_FLAG_INDEXED);
+        // Still content-derived, so reloading is idempotent
+        ASSERT_NE(ephemeral[i].filterKey, persistent[i].filterKey);
+        ASSERT_EQ(ephemeral[i].filterKey, ephemeralFilters(persistent, "test")[i].filterKey);
+        ASSERT_EQ(ephemeral[i].filterCondition, persistent[i].filterCondition);
+    }
+}
+
+TEST(EphemeralFiltersTests, TestCoexistsWithPersistentFilters)
+{
+    const auto plan = planRuleset("block out to 10.0.0.1\n", testDisplayData, "test");
+
+    MemoryEngine engine;
+    FilterApplier{engine}.apply(plan.batch.filters());
+    const auto result = FilterApplier{engine}.apply(ephemeralFilters(plan.batch.filters(), "test"));
+
+    ASSERT_EQ(result.alreadyInstalledCount, 0);
+    ASSERT_EQ(engine.filterCount(), 2 * plan.batch.size());
+}
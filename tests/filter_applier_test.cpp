@@ -0,0 +1,135 @@
+#include <apply/filter_applier.h>
+#include <engine/memory_engine.h>
+#include "test_rules.h"
+#include <gtest/gtest.h>
+
+using namespace wfpk;
+
+TEST(FilterApplierTests, TestAppliesAllFiltersInOneTransaction)
+{
+    MemoryEngine engine;
+    FilterBatch batch{testDisplayData, "test"};
+    lower(R"(block out to {1.1.1.1, 2.2.2.2, 10.0.0.0/8}
+             permit in all)",
+          batch);
+    // One v4 filter for the first rule, a v4 and v6 filter for the second
+    ASSERT_EQ(batch.size(), 3);
+
+    auto result = FilterApplier{engine}.apply(batch.filters());
+
+    ASSERT_EQ(result.filterIds.size(), 3);
+    ASSERT_EQ(engine.filterCount(), 3);
+    ASSERT_FALSE(engine.inTransaction());
+    // One round trip per filter plus a single begin and commit
+    ASSERT_EQ(engine.roundTrips(), 3 + 2);
+
+    const auto phaseNames = result.timings.phases() | std::views::keys;
+    ASSERT_TRUE(std::ranges::equal(phaseNames, std::vector<std::string>{"begin", "add", "commit"}));
+}
+
+TEST(FilterApplierTests, TestFiltersOutliveTheBatch)
+{
+    MemoryEngine engine;
+    std::vector<FilterId> ids;
+    {
+        FilterBatch batch{testDisplayData, "test"};
+        lower("block out to 192.168.1.0/24", batch);
+        ids = FilterApplier{engine}.apply(batch.filters()).filterIds;
+    }
+
+    const FWPM_FILTER *pFilter = engine.findFilter(ids.front());
+    ASSERT_NE(pFilter, nullptr);
+    ASSERT_EQ(pFilter->numFilterConditions, 1);
+    ASSERT_EQ(pFilter->filterCondition[0].conditionValue.type, FWP_V4_ADDR_MASK);
+    ASSERT_EQ(pFilter->filterCondition[0].conditionValue.v4AddrMask->mask, 0xFFFFFF00);
+    ASSERT_EQ(std::wstring{pFilter->displayData.name}, L"test");
+}
+
+TEST(FilterApplierTests, TestRollsBackOnFailure)
+{
+    MemoryEngine engine;
+
+    // A filter that was installed before the apply
+    FilterBatch existing{testDisplayData, "test"};
+    lower("permit out all", existing);
+    FilterApplier{engine}.apply(existing.filters());
+
+    FilterBatch batch{testDisplayData, "test"};
+    lower(R"(block out to 1.1.1.1
+             block out to 2.2.2.2
+             block out to 3.3.3.3
+             block out to 4.4.4.4)",
+          batch);
+
+    // Fail half way through
+    engine.failAddAfter(2);
+    ASSERT_THROW(FilterApplier{engine}.apply(batch.filters()), WfpError);
+
+    // Nothing from the failed apply remains, and existing filters are untouched
+    ASSERT_EQ(engine.filterCount(), existing.size());
+    ASSERT_FALSE(engine.inTransaction());
+}
+
+TEST(FilterApplierTests, TestReportsProgress)
+{
+    MemoryEngine engine;
+    FilterBatch batch{testDisplayData, "test"};
+    lower(R"(block out to 1.1.1.1
+             block out to 2.2.2.2
+             block out to 3.3.3.3
+             block out to 4.4.4.4
+             block out to 5.5.5.5)",
+          batch);
+
+    std::vector<size_t> progress;
+    FilterApplier applier{
+        engine, [&](size_t done, size_t total) { progress.push_back(done); }, 2};
+    applier.apply(batch.filters());
+
+    // Every 2 filters and always on completion
+    ASSERT_EQ(progress, (std::vector<size_t>{2, 4, 5}));
+}
+
+TEST(FilterApplierTests, TestReweightedFiltersAreReplaced)
+{
+    MemoryEngine engine;
+    FilterBatch before{testDisplayData, "test"};
+    lower("permit out to 10.0.0.1\nblock out to 10.0.0.0/8", before);
+    FilterApplier{engine}.apply(before.filters());
+
+    // Inserting a rule at the top moves the others down a rank - same keys, new weights
+    FilterBatch after{testDisplayData, "test"};
+    lower("block out to 10.0.0.1\npermit out to 10.0.0.1\nblock out to 10.0.0.0/8", after);
+    auto result = FilterApplier{engine}.apply(after.filters());
+
+    ASSERT_EQ(result.filterIds.size(), 3);
+    ASSERT_EQ(result.alreadyInstalledCount, 0);
+    ASSERT_EQ(engine.filterCount(), 3);
+    for(const auto &filter : after.filters())
+    {
+        const auto pInstalled = engine.filterByKey(filter.filterKey);
+        ASSERT_NE(pInstalled, nullptr);
+        ASSERT_EQ(*pInstalled->weight.uint64, *filter.weight.uint64);
+    }
+
+    // Unchanged, nothing is replaced
+    result = FilterApplier{engine}.apply(after.filters());
+    ASSERT_TRUE(result.filterIds.empty());
+    ASSERT_EQ(result.alreadyInstalledCount, 3);
+}
+
+TEST(FilterApplierTests, TestRepeatedFiltersKeepTheFirstWeight)
+{
+    MemoryEngine engine;
+    FilterBatch batch{testDisplayData, "test"};
+    lower("block out to 1.1.1.1\npermit out to 2.2.2.2\nblock out to 1.1.1.1", batch);
+    ASSERT_EQ(batch.filters()[0].filterKey, batch.filters()[2].filterKey);
+
+    auto result = FilterApplier{engine}.apply(batch.filters());
+
+    // The repeat is pre-empted by the first copy, so isn't added over it
+    ASSERT_EQ(result.filterIds.size(), 2);
+    ASSERT_EQ(result.alreadyInstalledCount, 1);
+    ASSERT_EQ(*engine.filterByKey(batch.filters()[0].filterKey)->weight.uint64,
+              *batch.filters()[0].weight.uint64);
+}
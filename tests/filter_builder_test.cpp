@@ -0,0 +1,93 @@
+#include <apply/filter_builder.h>
+#include <parser/parser.h>
+#include "test_rules.h"
+#include <gtest/gtest.h>
+
+using namespace wfpk;
+
+namespace
+{
+// Enough distinct rules to keep several workers busy
+std::string manyRules(size_t count)
+{
+    std::string rules;
+    for(size_t i = 0; i < count; ++i)
+    {
+        rules += std::format("block out to 10.{}.{}.0/24 port {}\n", i / 256, i % 256, i % 1000);
+    }
+    return rules;
+}
+}
+
+TEST(FilterBuilderTests, TestArenaPointersAreStable)
+{
+    Arena arena{64};
+
+    UINT64 *pFirst = arena.copy(UINT64{42});
+    // Larger than a block
+    std::vector<UINT32> values(100, 7);
+    UINT32 *pValues = arena.copyArray(std::span<const UINT32>{values});
+    UINT8 *pByte = arena.copy(UINT8{1});
+    UINT64 *pAligned = arena.copy(UINT64{43});
+
+    Arena other{std::move(arena)};
+    Arena adopter;
+    adopter.adopt(std::move(other));
+
+    ASSERT_EQ(*pFirst, 42);
+    ASSERT_TRUE(std::ranges::equal(std::span{pValues, values.size()}, values));
+    ASSERT_EQ(*pByte, 1);
+    ASSERT_EQ(*pAligned, 43);
+    ASSERT_EQ(reinterpret_cast<uintptr_t>(pAligned) % alignof(UINT64), 0);
+    ASSERT_EQ(adopter.blockCount(), 3);
+    ASSERT_EQ(other.blockCount(), 0);
+}
+
+TEST(FilterBuilderTests, TestParallelBuildMatchesSerialLowering)
+{
+    const auto ast = Parser{manyRules(4 * FilterBuilder::kMinRulesPerWorker + 10)}.parse();
+
+    FilterBatch serial{testDisplayData, "test"};
+    ast->accept(WfpExecutor{serial});
+
+    FilterBuilder builder{testDisplayData, "test", {}, WeightAllocator{}, 4};
+    ASSERT_EQ(builder.workerCount(ast->children().size()), 4);
+    const FilterBatch parallel = builder.build(*ast);
+
+    ASSERT_EQ(parallel.size(), serial.size());
+    for(size_t i = 0; i < serial.size(); ++i)
+    {
+        const FWPM_FILTER &expected = serial.filters()[i];
+        const FWPM_FILTER &actual = parallel.filters()[i];
+
+        // Same content in the same order, so the same keys
+        ASSERT_EQ(actual.filterKey, expected.filterKey);
+        ASSERT_EQ(*actual.weight.uint64, *expected.weight.uint64);
+        ASSERT_EQ(actual.numFilterConditions, expected.numFilterConditions);
+        ASSERT_EQ(actual.filterCondition[0].conditionValue.v4AddrMask->addr,
+                  expected.filterCondition[0].conditionValue.v4AddrMask->addr);
+        ASSERT_EQ(std::wstring{actual.displayData.name}, L"test");
+    }
+}
+
+TEST(FilterBuilderTests, TestSmallRulesetsUseOneWorker)
+{
+    FilterBuilder builder{testDisplayData, "test", {}, WeightAllocator{}, 8};
+
+    ASSERT_EQ(builder.workerCount(0), 1);
+    ASSERT_EQ(builder.workerCount(FilterBuilder::kMinRulesPerWorker - 1), 1);
+    ASSERT_EQ(builder.workerCount(100 * FilterBuilder::kMinRulesPerWorker), 8);
+
+    const auto ast = Parser{"block out to 1.1.1.1"}.parse();
+    ASSERT_EQ(builder.build(*ast).size(), 1);
+}
+
+TEST(FilterBuilderTests, TestWorkerErrorsAreRethrown)
+{
+    std::string rules = manyRules(2 * FilterBuilder::kMinRulesPerWorker);
+    rules += "block out from \"C:\\missing.exe\"\n";
+    const auto ast = Parser{rules}.parse();
+
+    FilterBuilder builder{testDisplayData, "test", {}, WeightAllocator{}, 2};
+    ASSERT_THROW(builder.build(*ast), std::runtime_error);
+}
@@ -0,0 +1,194 @@
+#include <apply/filter_diff.h>
+#include <engine/memory_engine.h>
+#include "test_rules.h"
+#include <gtest/gtest.h>
+
+using namespace wfpk;
+
+namespace
+{
+const std::vector<GUID> testLayers = {FWPM_LAYER_ALE_AUTH_CONNECT_V4,
+                                      FWPM_LAYER_ALE_AUTH_RECV_ACCEPT_V4};
+
+// Install rules directly (no diffing)
+void install(MemoryEngine &engine, const std::string &rules)
+{
+    FilterBatch batch{testDisplayData, "test"};
+    lower(rules, batch);
+    FilterApplier{engine}.apply(batch.filters());
+}
+}
+
+TEST(FilterDiffTests, TestCanonicalContentIgnoresIdentityAndConditionOrder)
+{
+    FWP_V4_ADDR_AND_MASK address{0x01010101, ~0U};
+    FWP_V4_ADDR_AND_MASK localAddress{0x0a000001, ~0U};
+
+    FWPM_FILTER_CONDITION conditions[2]{};
+    conditions[0].fieldKey = FWPM_CONDITION_IP_REMOTE_ADDRESS;
+    conditions[0].conditionValue.type = FWP_V4_ADDR_MASK;
+    conditions[0].conditionValue.v4AddrMask = &address;
+    conditions[1].fieldKey = FWPM_CONDITION_IP_LOCAL_ADDRESS;
+    conditions[1].conditionValue.type = FWP_V4_ADDR_MASK;
+    conditions[1].conditionValue.v4AddrMask = &localAddress;
+
+    FWPM_FILTER first{};
+    first.layerKey = FWPM_LAYER_ALE_AUTH_CONNECT_V4;
+    first.action.type = FWP_ACTION_BLOCK;
+    first.filterCondition = conditions;
+    first.numFilterConditions = 2;
+
+    FWPM_FILTER_CONDITION reversed[2]{conditions[1], conditions[0]};
+    FWPM_FILTER second{first};
+    second.filterId = 1234;
+    second.filterKey.Data1 = 42;
+    second.filterCondition = reversed;
+
+    ASSERT_EQ(canonicalFilterContent(first), canonicalFilterContent(second));
+
+    second.action.type = FWP_ACTION_PERMIT;
+    ASSERT_NE(canonicalFilterContent(first), canonicalFilterContent(second));
+}
+
+TEST(FilterDiffTests, TestDiffOnlyTouchesChangedFilters)
+{
+    MemoryEngine engine;
+    install(engine, "block out to 1.1.1.1\nblock out to 2.2.2.2\nblock out to 3.3.3.3");
+    ASSERT_EQ(engine.filterCount(), 3);
+
+    FilterBatch desired{testDisplayData, "test"};
+    lower("block out to 1.1.1.1\nblock out to 2.2.2.2\nblock out to 4.4.4.4", desired);
+
+    const auto diff = diffFilters(installedPiaFilters(engine, testLayers), desired.filters());
+    ASSERT_EQ(diff.unchangedCount, 2);
+    ASSERT_EQ(diff.toAdd.size(), 1);
+    ASSERT_EQ(diff.toDelete.size(), 1);
+
+    engine.resetRoundTrips();
+    auto result = DiffApplier{engine, testLayers}.apply(desired.filters());
+
+    ASSERT_EQ(result.addedCount, 1);
+    ASSERT_EQ(result.deletedCount, 1);
+    ASSERT_EQ(result.unchangedCount, 2);
+    ASSERT_EQ(engine.filterCount(), 3);
+    // One enumeration per layer, begin, delete, add, commit
+    ASSERT_EQ(engine.roundTrips(), testLayers.size() + 4);
+}
+
+TEST(FilterDiffTests, TestNoChangesMeansNoTransaction)
+{
+    MemoryEngine engine;
+    install(engine, "block out to {1.1.1.1, 2.2.2.2}\npermit in from 10.0.0.0/8");
+
+    FilterBatch desired{testDisplayData, "test"};
+    // Address order within a rule doesn't matter (rule order does, it sets the weights)
+    lower("block out to {2.2.2.2, 1.1.1.1}\npermit in from 10.0.0.0/8", desired);
+
+    engine.resetRoundTrips();
+    auto result = DiffApplier{engine, testLayers}.apply(desired.filters());
+
+    ASSERT_EQ(result.unchangedCount, 2);
+    ASSERT_EQ(engine.roundTrips(), testLayers.size());
+}
+
+TEST(FilterDiffTests, TestUnkeyedFiltersAreMatchedOnContent)
+{
+    MemoryEngine engine;
+
+    // Filters installed without our content-derived keys (BFE generated keys),
+    // including surplus duplicates
+    FilterBatch legacy{testDisplayData, "test"};
+    lower("block out to 1.1.1.1\nblock out to 2.2.2.2", legacy);
+    std::vector<FWPM_FILTER> unkeyed{legacy.filters().begin(), legacy.filters().end()};
+    unkeyed.insert(unkeyed.end(), 2, legacy.filters().front());
+    for(auto &filter : unkeyed)
+    {
+        filter.filterKey = ZeroGuid;
+    }
+    FilterApplier{engine}.apply(unkeyed);
+    ASSERT_EQ(engine.filterCount(), 4);
+
+    FilterBatch desired{testDisplayData, "test"};
+    lower("block out to 1.1.1.1\nblock out to 2.2.2.2", desired);
+
+    auto result = DiffApplier{engine, testLayers}.apply(desired.filters());
+
+    ASSERT_EQ(result.unchangedCount, 2);
+    ASSERT_EQ(result.deletedCount, 2);
+    ASSERT_EQ(result.addedCount, 0);
+    ASSERT_EQ(engine.filterCount(), 2);
+}
+
+TEST(FilterDiffTests, TestFailedDiffLeavesInstalledPolicy)
+{
+    MemoryEngine engine;
+    install(engine, "block out to 1.1.1.1\nblock out to 2.2.2.2");
+
+    FilterBatch desired{testDisplayData, "test"};
+    lower("block out to 3.3.3.3\nblock out to 4.4.4.4", desired);
+
+    engine.failAddAfter(1);
+    ASSERT_THROW(DiffApplier(engine, testLayers).apply(desired.filters()), WfpError);
+
+    // The deletes were rolled back along with the partial adds
+    const auto installed = installedPiaFilters(engine, testLayers);
+    ASSERT_EQ(installed.size(), 2);
+    ASSERT_EQ(installed[0]->filterCondition[0].conditionValue.v4AddrMask->addr, 0x01010101);
+}
+
+TEST(FilterDiffTests, TestInsertingARuleOnlyAddsItsFilters)
+{
+    MemoryEngine engine;
+    install(engine, "block out to 1.1.1.1\nblock out to 2.2.2.2\nblock out to 3.3.3.3");
+
+    FilterBatch desired{testDisplayData, "test"};
+    lower("block out to 1.1.1.1\npermit out to 2.2.2.2\nblock out to 2.2.2.2\n"
+          "block out to 3.3.3.3\npermit in from 10.0.0.0/8",
+          desired);
+
+    auto result = DiffApplier{engine, testLayers}.apply(desired.filters());
+
+    ASSERT_EQ(result.unchangedCount, 3);
+    ASSERT_EQ(result.addedCount, 2);
+    ASSERT_EQ(result.deletedCount, 0);
+
+    // The inserted permit is slotted in between the blocks either side of it
+    const auto installed = installedPiaFilters(engine, testLayers);
+    ASSERT_EQ(installed.size(), 5);
+    auto weightOf = [&](FWP_ACTION_TYPE action, UINT32 address) {
+        for(const auto &pFilter : installed)
+        {
+            if(pFilter->action.type == action && pFilter->numFilterConditions == 1 &&
+               pFilter->filterCondition[0].conditionValue.v4AddrMask->addr == address)
+            {
+                return *pFilter->weight.uint64;
+            }
+        }
+        ADD_FAILURE() << "No such filter";
+        return UINT64{0};
+    };
+    ASSERT_GT(weightOf(FWP_ACTION_BLOCK, 0x01010101), weightOf(FWP_ACTION_PERMIT, 0x02020202));
+    ASSERT_GT(weightOf(FWP_ACTION_PERMIT, 0x02020202), weightOf(FWP_ACTION_BLOCK, 0x02020202));
+}
+
+TEST(FilterDiffTests, TestReweightedFiltersAreReplaced)
+{
+    MemoryEngine engine;
+    install(engine, "block out to 1.1.1.1\nblock out to 2.2.2.2");
+
+    // Same rules, opposite ranks - the keys match but the weights don't
+    FilterBatch desired{testDisplayData, "test"};
+    lower("block out to 2.2.2.2\nblock out to 1.1.1.1", desired);
+    const auto installed = installedPiaMirror(engine, testLayers);
+    const auto diff = diffFilters(installed, desired.filters());
+    ASSERT_EQ(diff.unchangedCount, 0);
+    ASSERT_EQ(diff.toAdd.size(), 2);
+    ASSERT_EQ(diff.toDelete.size(), 2);
+
+    // Applied, one of them keeps its weight and the other is re-weighted around it
+    auto result = DiffApplier{engine, testLayers}.apply(desired.filters());
+    ASSERT_EQ(result.unchangedCount, 1);
+    ASSERT_EQ(result.addedCount, 1);
+    ASSERT_EQ(result.deletedCount, 1);
+    ASSERT_EQ(engine.filterCount(), 2);
+}
@@ -0,0 +1,164 @@
+#include <wfp_objects.h>
+#include <gtest/gtest.h>
+
+using namespace wfpk;
+
+namespace
+{
+// Stands in for the BFE's side of an enumeration - FwpmFilterEnum hands out each page
+// as an array of pointers into one allocation
+class FakeFilterSource
+{
+public:
+    explicit FakeFilterSource(size_t filterCount)
+        : _filters(filterCount)
+    {
+        for(size_t i = 0; i < filterCount; ++i)
+        {
+            _filters[i].filterId = i + 1;
+        }
+    }
+
+public:
+    DWORD fetch(UINT32 pageSize, FWPM_FILTER ***pppFilters, UINT32 *pNumEntries)
+    {
+        ++fetchCount;
+        const size_t count = std::min<size_t>(pageSize, _filters.size() - _next);
+        auto **ppPage = new FWPM_FILTER *[count];
+        for(size_t i = 0; i < count; ++i)
+        {
+            ppPage[i] = &_filters[_next++];
+        }
+        ++livePages;
+
+        *pppFilters = ppPage;
+        *pNumEntries = static_cast<UINT32>(count);
+        return ERROR_SUCCESS;
+    }
+
+    static inline size_t livePages{0};
+    size_t fetchCount{0};
+
+private:
+    std::vector<FWPM_FILTER> _filters;
+    size_t _next{0};
+};
+
+// Frees a page as FwpmFreeMemory would
+struct FakePageDeleter
+{
+    void operator()(FWPM_FILTER **ppPage) const
+    {
+        if(ppPage)
+        {
+            delete[] ppPage;
+            --FakeFilterSource::livePages;
+        }
+    }
+};
+
+auto enumerate(FakeFilterSource &source, UINT32 pageSize,
+               std::vector<std::shared_ptr<FWPM_FILTER>> &filters) -> size_t
+{
+    return forEachPagedEntry<FWPM_FILTER, FakePageDeleter>(
+        pageSize, "FakeFilterEnum",
+        [&](UINT32 count, FWPM_FILTER ***pppFilters, UINT32 *pNumEntries) {
+            return source.fetch(count, pppFilters, pNumEntries);
+        },
+        [&](std::shared_ptr<FWPM_FILTER> pFilter) { filters.push_back(std::move(pFilter)); });
+}
+}
+
+TEST(FilterEnumTests, TestPagesUntilExhausted)
+{
+    // More than the 5000 a single FwpmFilterEnum call used to be limited to
+    FakeFilterSource source{20500};
+    std::vector<std::shared_ptr<FWPM_FILTER>> filters;
+
+    const size_t pageCount = enumerate(source, 5000, filters);
+
+    // 4 full pages, then a short one - not a round trip per filter
+    ASSERT_EQ(pageCount, 5);
+    ASSERT_EQ(source.fetchCount, 5);
+    ASSERT_EQ(filters.size(), 20500);
+    for(size_t i = 0; i < filters.size(); ++i)
+    {
+        ASSERT_EQ(filters[i]->filterId, i + 1);
+    }
+}
+
+TEST(FilterEnumTests, TestFullLastPageTakesAnEmptyFetch)
+{
+    FakeFilterSource source{10000};
+    std::vector<std::shared_ptr<FWPM_FILTER>> filters;
+
+    // Only a short page shows the enumeration is done
+    ASSERT_EQ(enumerate(source, 5000, filters), 3);
+    ASSERT_EQ(filters.size(), 10000);
+    ASSERT_EQ(FakeFilterSource::livePages, 2);
+}
+
+TEST(FilterEnumTests, TestPagesLiveUntilTheirLastView)
+{
+    FakeFilterSource source{100};
+    std::vector<std::shared_ptr<FWPM_FILTER>> filters;
+
+    enumerate(source, 10, filters);
+    // The empty trailing page isn't kept by any view
+    ASSERT_EQ(FakeFilterSource::livePages, 10);
+
+    // Releasing all but one view of a page keeps it
+    filters.erase(filters.begin(), filters.begin() + 9);
+    ASSERT_EQ(FakeFilterSource::livePages, 10);
+    ASSERT_EQ(filters.front()->filterId, 10);
+
+    // Each page is freed once, with its last view
+    filters.erase(filters.begin());
+    ASSERT_EQ(FakeFilterSource::livePages, 9);
+    filters.clear();
+    ASSERT_EQ(FakeFilterSource::livePages, 0);
+}
+
+TEST(FilterEnumTests, TestFailedFetchThrows)
+{
+    size_t fetchCount{0};
+    auto fetch = [&](UINT32, FWPM_FILTER ***, UINT32 *) -> DWORD {
+        ++fetchCount;
+        return ERROR_ACCESS_DENIED;
+    };
+
+    ASSERT_THROW((forEachPagedEntry<FWPM_FILTER, FakePageDeleter>(
+                     100, "FakeFilterEnum", fetch, [](std::shared_ptr<FWPM_FILTER>) {})),
+                 WfpError);
+    ASSERT_EQ(fetchCount, 1);
+}
+
+TEST(FilterEnumTests, TestStreamsPagesOnDemand)
+{
+    FakeFilterSource source{20500};
+    auto fetch = [&](UINT32 count, FWPM_FILTER ***pppFilters, UINT32 *pNumEntries) {
+        return source.fetch(count, pppFilters, pNumEntries);
+    };
+
+    {
+        auto filters = enumEntries<FWPM_FILTER, FakePageDeleter>(5000, "FakeFilterEnum", fetch);
+        ASSERT_EQ(source.fetchCount, 0);
+
+        size_t seen{0};
+        for(const auto &pFilter : filters)
+        {
+            ASSERT_EQ(pFilter->filterId, seen + 1);
+            // Only the page being read has been fetched, and only it is held
+            ASSERT_EQ(source.fetchCount, seen / 5000 + 1);
+            ASSERT_EQ(FakeFilterSource::livePages, 1);
+            if(++seen == 7500)
+            {
+                break;
+            }
+        }
+    }
+
+    // Stopping early fetched nothing more, and released the page
+    ASSERT_EQ(source.fetchCount, 2);
+    ASSERT_EQ(FakeFilterSource::livePages, 0);
+}
@@ -0,0 +1,192 @@
+#include <apply/filter_journal.h>
+#include <apply/filter_plan.h>
+#include <engine/memory_engine.h>
+#include "test_rules.h"
+#include <sha1.h>
+#include <gtest/gtest.h>
+#include <fstream>
+
+using namespace wfpk;
+
+namespace
+{
+// A journal in a fresh temporary directory, removed afterwards
+class FilterJournalTests : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        const auto *pTest = ::testing::UnitTest::GetInstance()->current_test_info();
+        _dir = std::filesystem::temp_directory_path() / std::format("wfpk_{}", pTest->name());
+        std::filesystem::remove_all(_dir);
+    }
+    void TearDown() override
+    {
+        std::filesystem::remove_all(_dir);
+    }
+
+    auto journalPath() const -> std::filesystem::path
+    {
+        return _dir / "filters.journal";
+    }
+
+    // Record a load of made up filters
+    static uint64_t record(FilterJournal &journal, std::string_view rulesetName, size_t count)
+    {
+        std::vector<FilterId> ids;
+        std::vector<GUID> keys;
+        for(size_t i = 0; i < count; ++i)
+        {
+            ids.push_back(i + 1);
+            keys.push_back(nameBasedGuid(ZeroGuid, std::format("{}{}", rulesetName, i)));
+        }
+        return journal.recordLoad(rulesetName, ids, keys);
+    }
+
+private:
+    std::filesystem::path _dir;
+};
+}
+
+TEST_F(FilterJournalTests, TestRecordsLoads)
+{
+    FilterJournal journal{journalPath()};
+    ASSERT_FALSE(journal.lastLoad());
+
+    ASSERT_EQ(record(journal, "a", 3), 1);
+    ASSERT_EQ(record(journal, "b", 2), 2);
+    ASSERT_EQ(record(journal, "a", 1), 3);
+
+    // Read back by a new instance, as by the next wfpk run
+    FilterJournal reopened{journalPath()};
+    const auto last = reopened.lastLoad();
+    ASSERT_TRUE(last);
+    ASSERT_EQ(last->sequence, 3);
+    ASSERT_EQ(last->rulesetName, "a");
+    ASSERT_EQ(last->filters.size(), 1);
+    ASSERT_EQ(last->filters[0].filterKey, nameBasedGuid(ZeroGuid, "a0"));
+
+    const auto loads = reopened.loadsOf("a");
+    ASSERT_EQ(loads.size(), 2);
+    ASSERT_EQ(loads[0].sequence, 1);
+    ASSERT_EQ(loads[0].filters.size(), 3);
+    ASSERT_EQ(loads[1].sequence, 3);
+}
+
+TEST_F(FilterJournalTests, TestRetiredLoadsAreHidden)
+{
+    FilterJournal journal{journalPath()};
+    record(journal, "a", 1);
+    record(journal, "b", 1);
+
+    const uint64_t retired[] = {2};
+    journal.retire(retired);
+
+    ASSERT_EQ(journal.lastLoad()->rulesetName, "a");
+    ASSERT_TRUE(journal.loadsOf("b").empty());
+    // Sequences carry on from the retired load
+    ASSERT_EQ(record(journal, "c", 1), 3);
+}
+
+TEST_F(FilterJournalTests, TestTornRecordIsIgnored)
+{
+    FilterJournal journal{journalPath()};
+    record(journal, "a", 2);
+    record(journal, "b", 2);
+    const auto intactSize = std::filesystem::file_size(journalPath());
+    record(journal, "c", 2);
+
+    // A crash part way through writing the last record
+    std::filesystem::resize_file(journalPath(), intactSize + 10);
+    ASSERT_EQ(journal.lastLoad()->rulesetName, "b");
+
+    // Appending replaces the torn record
+    ASSERT_EQ(record(journal, "d", 2), 3);
+    ASSERT_EQ(journal.liveLoads().size(), 3);
+    ASSERT_EQ(journal.lastLoad()->rulesetName, "d");
+}
+
+TEST_F(FilterJournalTests, TestCorruptRecordIsIgnored)
+{
+    FilterJournal journal{journalPath()};
+    record(journal, "a", 2);
+    record(journal, "b", 2);
+
+    {
+        // Flip a bit in the last record's last filter key
+        std::fstream file{journalPath(), std::ios::binary | std::ios::in | std::ios::out};
+        file.seekg(-1, std::ios::end);
+        const char last = static_cast<char>(file.get());
+        file.seekp(-1, std::ios::end);
+        file.put(static_cast<char>(last ^ 1));
+    }
+
+    const auto loads = journal.liveLoads();
+    ASSERT_EQ(loads.size(), 1);
+    ASSERT_EQ(loads[0].rulesetName, "a");
+}
+
+TEST_F(FilterJournalTests, TestRejectsOtherFiles)
+{
+    std::filesystem::create_directories(journalPath().parent_path());
+    std::ofstream{journalPath()} << "not a journal at all";
+
+    FilterJournal journal{journalPath()};
+    ASSERT_THROW(journal.liveLoads(), std::runtime_error);
+}
+
+TEST_F(FilterJournalTests, TestCompactsRetiredLoads)
+{
+    FilterJournal journal{journalPath()};
+    record(journal, "keep", 10);
+    std::vector<uint64_t> retired;
+    for(size_t i = 0; i < 20; ++i)
+    {
+        retired.push_back(record(journal, "reload", 500));
+    }
+    const auto fullSize = std::filesystem::file_size(journalPath());
+
+    journal.retire(retired);
+
+    ASSERT_LT(std::filesystem::file_size(journalPath()), fullSize / 100);
+    const auto loads = journal.liveLoads();
+    ASSERT_EQ(loads.size(), 1);
+    ASSERT_EQ(loads[0].rulesetName, "keep");
+    ASSERT_EQ(loads[0].filters.size(), 10);
+}
+
+TEST_F(FilterJournalTests, TestDeletesJournaledFiltersWithoutEnumerating)
+{
+    MemoryEngine engine;
+    FilterJournal journal{journalPath()};
+
+    auto first = planRuleset("block out to 10.0.0.1\nblock out to 10.0.0.2\n", testDisplayData,
+                             "first");
+    auto second = planRuleset("permit out to 10.0.0.3\n", testDisplayData, "second");
+    for(const auto *pPlan : {&first, &second})
+    {
+        auto result = FilterApplier{engine}.apply(pPlan->batch.filters());
+        journal.recordLoad(pPlan->batch.rulesetName(), result.filterIds, result.filterKeys);
+    }
+    const size_t firstCount = first.batch.size();
+    const size_t totalCount = engine.filterCount();
+
+    // Something else already deleted one of the first load's filters
+    ASSERT_EQ(engine.deleteFilterByKey(first.batch.filters()[0].filterKey), ERROR_SUCCESS);
+
+    engine.resetRoundTrips();
+    bool hookCalled{false};
+    const auto loads = journal.loadsOf("first");
+    const auto result = deleteJournaledFilters(engine, std::span{loads}, [&] {
+        ASSERT_TRUE(engine.inTransaction());
+        hookCalled = true;
+    });
+
+    ASSERT_TRUE(hookCalled);
+    ASSERT_EQ(result.deletedCount, firstCount - 1);
+    ASSERT_EQ(result.missingCount, 1);
+    ASSERT_EQ(engine.filterCount(), totalCount - firstCount);
+    // begin, a delete per journaled filter and commit - no enumeration
+    ASSERT_EQ(engine.roundTrips(), firstCount + 2);
+    ASSERT_FALSE(engine.inTransaction());
+}
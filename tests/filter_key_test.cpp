@@ -0,0 +1,95 @@
+#include <apply/filter_applier.h>
+#include <apply/filter_batch.h>
+#include <apply/filter_key.h>
+#include <engine/memory_engine.h>
+#include "test_rules.h"
+#include <sha1.h>
+#include <gtest/gtest.h>
+#include <unordered_set>
+
+using namespace wfpk;
+
+namespace
+{
+auto keysOf(const FilterBatch &batch) -> std::vector<GUID>
+{
+    std::vector<GUID> keys;
+    for(const auto &filter : batch.filters())
+    {
+        keys.push_back(filter.filterKey);
+    }
+
+    return keys;
+}
+}
+
+TEST(FilterKeyTests, TestSha1)
+{
+    // FIPS 180 test vectors
+    const Sha1::Digest abc = {0xa9, 0x99, 0x3e, 0x36, 0x47, 0x06, 0x81, 0x6a, 0xba, 0x3e,
+                              0x25, 0x71, 0x78, 0x50, 0xc2, 0x6c, 0x9c, 0xd0, 0xd8, 0x9d};
+    ASSERT_EQ(Sha1::hash("abc"), abc);
+
+    const Sha1::Digest million = {0x34, 0xaa, 0x97, 0x3c, 0xd4, 0xc4, 0xda, 0xa4, 0xf6, 0x1e,
+                                  0xeb, 0x2b, 0xdb, 0xad, 0x27, 0x31, 0x65, 0x34, 0x01, 0x6f};
+    ASSERT_EQ(Sha1::hash(std::string(1'000'000, 'a')), million);
+}
+
+TEST(FilterKeyTests, TestNameBasedGuid)
+{
+    // RFC 4122 DNS namespace, uuid5(NAMESPACE_DNS, "python.org")
+    const GUID dnsNamespace = {
+        0x6ba7b810, 0x9dad, 0x11d1, {0x80, 0xb4, 0x00, 0xc0, 0x4f, 0xd4, 0x30, 0xc8}};
+    const GUID expected = {
+        0x886313e1, 0x3b8a, 0x5372, {0x9b, 0x90, 0x0c, 0x9a, 0xee, 0x19, 0x9e, 0x5d}};
+
+    ASSERT_EQ(nameBasedGuid(dnsNamespace, "python.org"), expected);
+}
+
+TEST(FilterKeyTests, TestKeysAreDeterministic)
+{
+    FilterBatch first{testDisplayData, "blocklist"};
+    lower("block out to {1.1.1.1, 2.2.2.2}\npermit in all", first);
+    FilterBatch second{testDisplayData, "blocklist"};
+    lower("block out to {1.1.1.1, 2.2.2.2}\npermit in all", second);
+
+    const auto keys = keysOf(first);
+    ASSERT_EQ(keys, keysOf(second));
+    ASSERT_TRUE(std::ranges::none_of(keys, [](const auto &key) { return key == ZeroGuid; }));
+    // Every filter has its own key
+    ASSERT_EQ(std::unordered_set<GUID>(keys.begin(), keys.end()).size(), keys.size());
+
+    // The same rules in another ruleset get different keys
+    FilterBatch other{testDisplayData, "allowlist"};
+    lower("block out to {1.1.1.1, 2.2.2.2}\npermit in all", other);
+    ASSERT_NE(keysOf(other)[0], keys[0]);
+}
+
+TEST(FilterKeyTests, TestReapplyIsIdempotent)
+{
+    MemoryEngine engine;
+    FilterBatch batch{testDisplayData, "blocklist"};
+    lower("block out to {1.1.1.1, 2.2.2.2}\npermit in all", batch);
+
+    auto first = FilterApplier{engine}.apply(batch.filters());
+    ASSERT_EQ(first.filterIds.size(), 3);
+
+    // Duplicate adds are detected rather than piling up
+    auto second = FilterApplier{engine}.apply(batch.filters());
+    ASSERT_EQ(second.filterIds.size(), 0);
+    ASSERT_EQ(second.alreadyInstalledCount, 3);
+    ASSERT_EQ(engine.filterCount(), 3);
+}
+
+TEST(FilterKeyTests, TestKeysIgnoreWeight)
+{
+    FilterBatch first{testDisplayData, "blocklist"};
+    lower("block out to 1.1.1.1\npermit in all", first);
+    // Inserting a rule re-weights the rules below it, but doesn't re-key them
+    FilterBatch second{testDisplayData, "blocklist"};
+    lower("block out to 3.3.3.3\nblock out to 1.1.1.1\npermit in all", second);
+
+    ASSERT_NE(*first.filters()[0].weight.uint64, *second.filters()[1].weight.uint64);
+    const auto keys = keysOf(second);
+    ASSERT_EQ(keysOf(first), std::vector<GUID>(keys.begin() + 1, keys.end()));
+}
@@ -0,0 +1,177 @@
+#include <engine/filter_mirror.h>
+#include <apply/canonical_filter.h>
+#include <gtest/gtest.h>
+
+using namespace wfpk;
+
+namespace
+{
+const GUID kOtherProvider{0x1111, 0x2222, 0x3333, {1, 2, 3, 4, 5, 6, 7, 8}};
+const GUID kOtherSubLayer{0x4444, 0x5555, 0x6666, {1, 2, 3, 4, 5, 6, 7, 8}};
+
+// Enumerated-looking filters, each with its own storage - freed by the fixture
+class FilterMirrorTests : public testing::Test
+{
+protected:
+    struct Storage
+    {
+        FWPM_FILTER filter{};
+        GUID providerKey{};
+        UINT64 weight{};
+        FWP_V4_ADDR_AND_MASK addrMask{};
+        FWP_RANGE portRange{};
+        std::vector<UINT8> appId;
+        FWP_BYTE_BLOB blob{};
+        std::vector<FWPM_FILTER_CONDITION> conditions;
+    };
+
+    FWPM_FILTER &addFilter(FilterId id, const GUID *pProvider, const GUID &subLayer,
+                           FWP_ACTION_TYPE action)
+    {
+        auto &storage = *_storage.emplace_back(std::make_unique<Storage>());
+        auto &filter = storage.filter;
+        filter.filterId = id;
+        filter.filterKey = GUID{static_cast<unsigned long>(id), 0x77, 0x88, {9}};
+        filter.layerKey = FWPM_LAYER_ALE_AUTH_CONNECT_V4;
+        filter.subLayerKey = subLayer;
+        filter.action.type = action;
+        filter.flags = FWPM_FILTER_FLAG_PERSISTENT;
+        if(pProvider)
+        {
+            storage.providerKey = *pProvider;
+            filter.providerKey = &storage.providerKey;
+        }
+        storage.weight = 1000 + id;
+        filter.weight.type = FWP_UINT64;
+        filter.weight.uint64 = &storage.weight;
+
+        // An address, a port range and an app id
+        storage.addrMask = {0x0A000000 + static_cast<UINT32>(id), 0xFFFFFF00};
+        storage.portRange.valueLow.type = FWP_UINT16;
+        storage.portRange.valueLow.uint16 = 1000;
+        storage.portRange.valueHigh.type = FWP_UINT16;
+        storage.portRange.valueHigh.uint16 = static_cast<UINT16>(2000 + id);
+        storage.appId = {'a', 0, 'p', 0, 'p', 0, 0, 0};
+        storage.blob = {static_cast<UINT32>(storage.appId.size()), storage.appId.data()};
+
+        storage.conditions.resize(3);
+        storage.conditions[0].fieldKey = FWPM_CONDITION_IP_REMOTE_ADDRESS;
+        storage.conditions[0].conditionValue.type = FWP_V4_ADDR_MASK;
+        storage.conditions[0].conditionValue.v4AddrMask = &storage.addrMask;
+        storage.conditions[1].fieldKey = FWPM_CONDITION_IP_REMOTE_PORT;
+        storage.conditions[1].matchType = FWP_MATCH_RANGE;
+        storage.conditions[1].conditionValue.type = FWP_RANGE_TYPE;
+        storage.conditions[1].conditionValue.rangeValue = &storage.portRange;
+        storage.conditions[2].fieldKey = FWPM_CONDITION_ALE_APP_ID;
+        storage.conditions[2].conditionValue.type = FWP_BYTE_BLOB_TYPE;
+        storage.conditions[2].conditionValue.byteBlob = &storage.blob;
+        filter.numFilterConditions = static_cast<UINT32>(storage.conditions.size());
+        filter.filterCondition = storage.conditions.data();
+
+        return filter;
+    }
+
+    // A mix of PIA's filters and another provider's, across two sublayers
+    FilterMirror mirrorOf(size_t count)
+    {
+        FilterMirror mirror;
+        for(size_t i = 0; i < count; ++i)
+        {
+            const bool isPia = i % 3 != 0;
+            mirror.add(addFilter(i + 1, isPia ? &PIA_PROVIDER_KEY : &kOtherProvider,
+                                 i % 2 ? PIA_SUBLAYER_KEY : kOtherSubLayer,
+                                 i % 4 ? FWP_ACTION_BLOCK : FWP_ACTION_PERMIT));
+        }
+        return mirror;
+    }
+
+    const FWPM_FILTER &source(size_t i) const
+    {
+        return _storage[i]->filter;
+    }
+
+    std::vector<std::unique_ptr<Storage>> _storage;
+};
+}
+
+TEST_F(FilterMirrorTests, TestRebuiltFiltersMatchTheirSource)
+{
+    const auto mirror = mirrorOf(50);
+    ASSERT_EQ(mirror.size(), 50);
+
+    for(FilterMirror::Row row = 0; row < mirror.size(); ++row)
+    {
+        const auto filter = mirror.filter(row);
+        ASSERT_EQ(filter.filterId, source(row).filterId);
+        ASSERT_EQ(filter.filterKey, source(row).filterKey);
+        ASSERT_EQ(*filter.providerKey, *source(row).providerKey);
+        ASSERT_EQ(canonicalFilterContent(filter), canonicalFilterContent(source(row)));
+    }
+}
+
+TEST_F(FilterMirrorTests, TestCopiesEverythingFiltersPointTo)
+{
+    const auto mirror = mirrorOf(2);
+    const auto before = canonicalFilterContent(mirror.filter(1));
+
+    // As if the enumerated page had been freed and reused
+    _storage.clear();
+    mirrorOf(2);
+
+    ASSERT_EQ(canonicalFilterContent(mirror.filter(1)), before);
+    ASSERT_EQ(mirror.conditions(1).size(), 3);
+    ASSERT_EQ(mirror.conditions(1)[1].conditionValue.rangeValue->valueHigh.uint16, 2002);
+}
+
+TEST_F(FilterMirrorTests, TestInternsKeys)
+{
+    const auto mirror = mirrorOf(1000);
+
+    ASSERT_EQ(mirror.layerKeys().size(), 1);
+    ASSERT_EQ(mirror.subLayerKeys().size(), 2);
+    ASSERT_EQ(mirror.providerKeys().size(), 2);
+    for(FilterMirror::Row row = 0; row < mirror.size(); ++row)
+    {
+        ASSERT_EQ(mirror.subLayerKeys()[mirror.subLayerIndices()[row]], source(row).subLayerKey);
+        ASSERT_EQ(mirror.providerKeys()[mirror.providerIndices()[row]], *source(row).providerKey);
+    }
+
+    FilterMirror unowned;
+    auto &filter = addFilter(1, nullptr, ZeroGuid, FWP_ACTION_BLOCK);
+    unowned.add(filter);
+    ASSERT_EQ(unowned.providerIndices()[0], FilterMirror::NoKey);
+    ASSERT_EQ(unowned.filter(0).providerKey, nullptr);
+}
+
+TEST_F(FilterMirrorTests, TestSelectMatchesTheQuery)
+{
+    const auto mirror = mirrorOf(200);
+
+    const std::vector<FilterQuery> queries = {
+        {},
+        {.providerKey = PIA_PROVIDER_KEY},
+        {.actionTypes = {FWP_ACTION_PERMIT}},
+        {.providerKey = kOtherProvider, .actionTypes = {FWP_ACTION_BLOCK}},
+        {.providerKey = GUID{0xDEAD}}};
+    for(const auto &query : queries)
+    {
+        std::vector<FilterMirror::Row> expected;
+        for(FilterMirror::Row row = 0; row < mirror.size(); ++row)
+        {
+            if(query.matches(source(row)))
+            {
+                expected.push_back(row);
+            }
+        }
+        ASSERT_EQ(mirror.select(query), expected);
+    }
+}
+
+TEST_F(FilterMirrorTests, TestIsSmallerThanTheFiltersItMirrors)
+{
+    const auto mirror = mirrorOf(10000);
+
+    // Against the FWPM_FILTER and conditions of an enumerated filter, before any payloads
+    ASSERT_LT(mirror.bytesUsed() / mirror.size(),
+              sizeof(FWPM_FILTER) + 3 * sizeof(FWPM_FILTER_CONDITION));
+}
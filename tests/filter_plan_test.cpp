@@ -0,0 +1,114 @@
+#include <apply/filter_plan.h>
+#include "test_rules.h"
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace wfpk;
+
+namespace
+{
+std::vector<std::string> planLines(const RulesetPlan &plan)
+{
+    std::ostringstream out;
+    writeFilterPlan(out, plan.batch.filters());
+
+    std::vector<std::string> lines;
+    std::istringstream in{out.str()};
+    for(std::string line; std::getline(in, line);)
+    {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+bool contains(const std::string &str, const std::string &substr)
+{
+    return str.find(substr) != std::string::npos;
+}
+
+// The plan entry for an equality condition, the value is already JSON encoded
+std::string conditionEntry(const std::string &field, const std::string &value)
+{
+    return std::format(R"({{"field":"{}","match":"FWP_MATCH_EQUAL","value":{}}})", field, value);
+}
+}
+
+TEST(FilterPlanTests, TestOneLinePerFilter)
+{
+    const auto plan = planRuleset("block out to {1.1.1.1, 10.0.0.0/8}\npermit in all",
+                                  testDisplayData, "test");
+    const auto lines = planLines(plan);
+
+    ASSERT_EQ(lines.size(), plan.batch.size());
+    ASSERT_EQ(lines.size(), 3);
+    for(const auto &line : lines)
+    {
+        ASSERT_TRUE(line.starts_with("{\"key\":"));
+        ASSERT_TRUE(line.ends_with("]}"));
+    }
+}
+
+TEST(FilterPlanTests, TestDecodesFilters)
+{
+    const auto plan = planRuleset(R"(block out proto tcp to {1.1.1.1, 10.0.0.0/8} port 443
+                                     block out to 123::1/64)",
+                                  testDisplayData, "test");
+    const auto lines = planLines(plan);
+    ASSERT_EQ(lines.size(), 2);
+
+    const auto &v4 = lines[0];
+    ASSERT_TRUE(contains(v4, R"("layer":"FWPM_LAYER_ALE_AUTH_CONNECT_V4")"));
+    ASSERT_TRUE(contains(v4, R"("action":"FWP_ACTION_BLOCK")"));
+    ASSERT_TRUE(
+        contains(v4, std::format(R"("weight":{})", *plan.batch.filters()[0].weight.uint64)));
+    ASSERT_TRUE(contains(
+        v4, R"("flags":["FWPM_FILTER_FLAG_PERSISTENT","FWPM_FILTER_FLAG_INDEXED"])"));
+    ASSERT_TRUE(
+        contains(v4, conditionEntry("FWPM_CONDITION_IP_REMOTE_ADDRESS", R"("1.1.1.1/32")")));
+    ASSERT_TRUE(
+        contains(v4, conditionEntry("FWPM_CONDITION_IP_REMOTE_ADDRESS", R"("10.0.0.0/8")")));
+    ASSERT_TRUE(contains(v4, conditionEntry("FWPM_CONDITION_IP_REMOTE_PORT", "443")));
+    ASSERT_TRUE(contains(v4, conditionEntry("FWPM_CONDITION_IP_PROTOCOL", "6")));
+
+    const auto &v6 = lines[1];
+    ASSERT_TRUE(contains(v6, R"("layer":"FWPM_LAYER_ALE_AUTH_CONNECT_V6")"));
+    ASSERT_TRUE(contains(v6, R"("value":"123::1/64")"));
+}
+
+TEST(FilterPlanTests, TestEscapesAppPaths)
+{
+    // App ids are null terminated wide strings
+    auto resolver = [](const std::string &appPath) {
+        std::vector<UINT8> appId(sizeof(wchar_t) * (appPath.size() + 1));
+        std::ranges::copy(std::wstring{appPath.begin(), appPath.end()},
+                          reinterpret_cast<wchar_t *>(appId.data()));
+        return appId;
+    };
+
+    const auto plan =
+        planRuleset("block out from \"C:\\app.exe\"", testDisplayData, "test", resolver);
+    const auto lines = planLines(plan);
+
+    ASSERT_FALSE(lines.empty());
+    ASSERT_TRUE(
+        contains(lines[0], conditionEntry("FWPM_CONDITION_ALE_APP_ID", R"("C:\\app.exe")")));
+}
+
+TEST(FilterPlanTests, TestReportsStages)
+{
+    const auto plan = planRuleset("block out to {1.1.1.1, 2.2.2.2}", testDisplayData, "test");
+
+    const auto timedPhases = plan.timings.phases() | std::views::keys;
+    ASSERT_TRUE(std::ranges::equal(timedPhases, std::vector<std::string>{"parse", "lower"}));
+
+    const auto &allocations = plan.allocations.phases();
+    ASSERT_EQ(allocations.size(), 2);
+    // Both the parser and the builder allocate
+    ASSERT_GT(allocations[0].second.count, 0);
+    ASSERT_GT(allocations[1].second.count, 0);
+}
+
+TEST(FilterPlanTests, TestParseErrorsThrow)
+{
+    ASSERT_THROW(planRuleset("block sideways", testDisplayData, "test"), std::runtime_error);
+}
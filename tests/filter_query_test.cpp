@@ -0,0 +1,133 @@
+#include <engine/filter_query.h>
+#include <engine/memory_engine.h>
+#include <sha1.h>
+#include <gtest/gtest.h>
+
+using namespace wfpk;
+
+namespace
+{
+const GUID otherProviderKey = nameBasedGuid(ZeroGuid, "other provider");
+
+void install(MemoryEngine &engine, const GUID &layerKey, const GUID *pProviderKey,
+             FWP_ACTION_TYPE actionType)
+{
+    FWPM_FILTER filter{};
+    filter.layerKey = layerKey;
+    filter.providerKey = const_cast<GUID *>(pProviderKey);
+    filter.action.type = actionType;
+    FilterId id{};
+    ASSERT_EQ(engine.tryAdd(filter, id), ERROR_SUCCESS);
+}
+
+// Every action type, from PIA, another provider and no provider, in two layers
+void installMix(MemoryEngine &engine)
+{
+    for(const auto &layerKey : {FWPM_LAYER_ALE_AUTH_CONNECT_V4, FWPM_LAYER_ALE_AUTH_CONNECT_V6})
+    {
+        for(const GUID *pProviderKey :
+            std::initializer_list<const GUID *>{&PIA_PROVIDER_KEY, &otherProviderKey, nullptr})
+        {
+            for(const auto actionType :
+                {FWP_ACTION_BLOCK, FWP_ACTION_PERMIT, FWP_ACTION_CALLOUT_TERMINATING,
+                 FWP_ACTION_CALLOUT_INSPECTION, FWP_ACTION_CALLOUT_UNKNOWN})
+            {
+                install(engine, layerKey, pProviderKey, actionType);
+            }
+        }
+    }
+}
+
+// The filters transferred by the engine, and those of them the query matches
+auto enumerate(MemoryEngine &engine, const FilterQuery &query)
+    -> std::pair<std::vector<FWPM_FILTER>, std::vector<FWPM_FILTER>>
+{
+    std::vector<FWPM_FILTER> transferred;
+    std::vector<FWPM_FILTER> returned;
+    engine.enumerateFiltersForLayer(
+        FWPM_LAYER_ALE_AUTH_CONNECT_V4,
+        [&](const auto &pFilter) {
+            transferred.push_back(*pFilter);
+            if(query.matches(*pFilter))
+            {
+                returned.push_back(*pFilter);
+            }
+        },
+        query);
+    return {transferred, returned};
+}
+}
+
+TEST(FilterQueryTests, TestEmptyQuerySelectsTheWholeLayer)
+{
+    const auto enumTemplate = FilterQuery{}.enumTemplate(FWPM_LAYER_ALE_AUTH_CONNECT_V4);
+    ASSERT_EQ(enumTemplate.layerKey, FWPM_LAYER_ALE_AUTH_CONNECT_V4);
+    ASSERT_EQ(enumTemplate.providerKey, nullptr);
+    ASSERT_EQ(enumTemplate.actionMask, 0xFFFFFFFF);
+
+    MemoryEngine engine;
+    installMix(engine);
+    const auto [transferred, returned] = enumerate(engine, {});
+    ASSERT_EQ(transferred.size(), 15);
+    ASSERT_EQ(returned.size(), 15);
+}
+
+TEST(FilterQueryTests, TestProviderIsSelectedByTheBfe)
+{
+    MemoryEngine engine;
+    installMix(engine);
+
+    const FilterQuery piaQuery{.providerKey = PIA_PROVIDER_KEY};
+    ASSERT_EQ(*piaQuery.enumTemplate(FWPM_LAYER_ALE_AUTH_CONNECT_V4).providerKey,
+              PIA_PROVIDER_KEY);
+
+    // Exactly - nothing else is transferred
+    const auto [transferred, returned] = enumerate(engine, piaQuery);
+    ASSERT_EQ(transferred.size(), 5);
+    ASSERT_EQ(returned.size(), 5);
+    for(const auto &filter : transferred)
+    {
+        ASSERT_EQ(*filter.providerKey, PIA_PROVIDER_KEY);
+    }
+}
+
+TEST(FilterQueryTests, TestActionsAreNarrowedByTheBfe)
+{
+    MemoryEngine engine;
+    installMix(engine);
+
+    const FilterQuery blockQuery{.actionTypes = {FWP_ACTION_BLOCK}};
+    const auto [transferred, returned] = enumerate(engine, blockQuery);
+
+    // The mask can't tell block from the callout actions sharing its bits, but it
+    // keeps permit (and inspection) filters from being transferred
+    ASSERT_EQ(transferred.size(), 9);
+    for(const auto &filter : transferred)
+    {
+        ASSERT_NE(filter.action.type, FWP_ACTION_PERMIT);
+        ASSERT_NE(filter.action.type, FWP_ACTION_CALLOUT_INSPECTION);
+    }
+    ASSERT_EQ(returned.size(), 3);
+    for(const auto &filter : returned)
+    {
+        ASSERT_EQ(filter.action.type, FWP_ACTION_BLOCK);
+    }
+}
+
+TEST(FilterQueryTests, TestCombinedQuery)
+{
+    MemoryEngine engine;
+    installMix(engine);
+
+    const FilterQuery query{.providerKey = otherProviderKey,
+                            .actionTypes = {FWP_ACTION_BLOCK, FWP_ACTION_PERMIT}};
+    const auto [transferred, returned] = enumerate(engine, query);
+
+    // Every other-provider filter but inspection's shares a bit with block or permit
+    ASSERT_EQ(transferred.size(), 4);
+    ASSERT_EQ(returned.size(), 2);
+    for(const auto &filter : returned)
+    {
+        ASSERT_EQ(*filter.providerKey, otherProviderKey);
+    }
+}
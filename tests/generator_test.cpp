@@ -0,0 +1,111 @@
+#include <generator.h>
+#include <gtest/gtest.h>
+#include <ranges>
+#include <stdexcept>
+#include <vector>
+
+using namespace wfpk;
+
+namespace
+{
+// Counts the values it has produced, and whether it's still running
+auto counter(int count, int &produced, bool &running) -> Generator<int>
+{
+    running = true;
+    struct Finally
+    {
+        bool &running;
+        ~Finally()
+        {
+            running = false;
+        }
+    } finally{running};
+
+    for(int i = 0; i < count; ++i)
+    {
+        ++produced;
+        co_yield i;
+    }
+}
+}
+
+TEST(GeneratorTests, TestProducesValuesOnDemand)
+{
+    int produced{0};
+    bool running{false};
+    auto values = counter(5, produced, running);
+    // Nothing runs until iterated
+    ASSERT_EQ(produced, 0);
+    ASSERT_FALSE(running);
+
+    std::vector<int> seen;
+    for(int value : values)
+    {
+        seen.push_back(value);
+        ASSERT_EQ(produced, value + 1);
+    }
+
+    ASSERT_EQ(seen, (std::vector{0, 1, 2, 3, 4}));
+    ASSERT_FALSE(running);
+}
+
+TEST(GeneratorTests, TestStoppingEarlyEndsTheCoroutine)
+{
+    int produced{0};
+    bool running{false};
+    {
+        auto values = counter(1000, produced, running);
+        for(int value : values)
+        {
+            if(value == 2)
+            {
+                break;
+            }
+        }
+        ASSERT_TRUE(running);
+    }
+
+    // Destroying the generator unwound the coroutine, releasing what it held
+    ASSERT_EQ(produced, 3);
+    ASSERT_FALSE(running);
+}
+
+TEST(GeneratorTests, TestWorksWithViews)
+{
+    static_assert(std::ranges::input_range<Generator<int>>);
+
+    int produced{0};
+    bool running{false};
+    std::vector<int> seen;
+    for(int value : counter(1000, produced, running) |
+                        std::views::filter([](int i) { return i % 2 == 0; }) |
+                        std::views::take(3))
+    {
+        seen.push_back(value);
+    }
+
+    ASSERT_EQ(seen, (std::vector{0, 2, 4}));
+    // take() steps past the last value it takes (to 6, the next even value) - but no further
+    ASSERT_EQ(produced, 7);
+    ASSERT_FALSE(running);
+}
+
+TEST(GeneratorTests, TestErrorsReachTheCaller)
+{
+    auto failing = []() -> Generator<int> {
+        co_yield 1;
+        throw std::runtime_error{"failed"};
+    };
+
+    std::vector<int> seen;
+    auto values = failing();
+    ASSERT_THROW(
+        {
+            for(int value : values)
+            {
+                seen.push_back(value);
+            }
+        },
+        std::runtime_error);
+    ASSERT_EQ(seen, (std::vector{1}));
+}
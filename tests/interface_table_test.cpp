@@ -0,0 +1,94 @@
+#include <apply/interface_table.h>
+#include "test_rules.h"
+#include <gtest/gtest.h>
+
+using namespace wfpk;
+
+namespace
+{
+// Stands in for GetIfTable2, counting how often it's called
+auto fakeInterfaces(size_t &callCount) -> InterfaceEnumerator
+{
+    return [&callCount] {
+        ++callCount;
+        return std::vector<NetworkInterface>{
+            {"Wi-Fi", "Intel(R) Wi-Fi 6 AX201 160MHz", 0x47000001000000, 12},
+            {"Ethernet 2", "Realtek USB GbE Family Controller", 0x6000001000000, 7},
+            // A filter driver bound to the Wi-Fi adapter, listed with its description
+            {"Wi-Fi-WFP Native MAC Layer LightWeight Filter-0000",
+             "Intel(R) Wi-Fi 6 AX201 160MHz", 0x47000002000000, 13},
+        };
+    };
+}
+}
+
+TEST(InterfaceTableTests, TestEnumeratesOnceOnFirstLookup)
+{
+    size_t callCount{0};
+    InterfaceTable table{fakeInterfaces(callCount)};
+    ASSERT_EQ(callCount, 0);
+
+    for(int i = 0; i < 100; ++i)
+    {
+        ASSERT_TRUE(table.find("Wi-Fi"));
+        ASSERT_FALSE(table.find("Bluetooth"));
+    }
+
+    ASSERT_EQ(callCount, 1);
+    ASSERT_EQ(table.enumerationCount(), 1);
+}
+
+TEST(InterfaceTableTests, TestMatchesAliasDescriptionOrIndex)
+{
+    size_t callCount{0};
+    InterfaceTable table{fakeInterfaces(callCount)};
+
+    // Case doesn't matter, as in Windows
+    ASSERT_EQ(table.find("wi-fi")->luid, 0x47000001000000);
+    ASSERT_EQ(table.find("ETHERNET 2")->index, 7);
+    // The adapter, not the filter driver that shares its description
+    ASSERT_EQ(table.find("Intel(R) Wi-Fi 6 AX201 160MHz")->luid, 0x47000001000000);
+    ASSERT_EQ(table.find("7")->alias, "Ethernet 2");
+
+    ASSERT_FALSE(table.find("8"));
+    ASSERT_FALSE(table.find("Ethernet"));
+    ASSERT_FALSE(table.find(""));
+}
+
+TEST(InterfaceTableTests, TestRulesMatchTheInterfaceLuid)
+{
+    size_t callCount{0};
+    InterfaceTable table{fakeInterfaces(callCount)};
+
+    FilterBatch batch{testDisplayData, "test"};
+    lower("block out on \"Wi-Fi\" to {1.1.1.1, 123::1}\n"
+          "block out on \"Wi-Fi\" to 2.2.2.2\n"
+          "permit out on \"Ethernet 2\" all\n",
+          batch, {}, WeightAllocator{}, table.resolver());
+
+    ASSERT_EQ(callCount, 1);
+    ASSERT_EQ(batch.size(), 5);
+    for(size_t i = 0; i < batch.size(); ++i)
+    {
+        const FWPM_FILTER &filter = batch.filters()[i];
+        const auto conditions = std::span{filter.filterCondition, filter.numFilterConditions};
+        const auto it = std::ranges::find(conditions, FWPM_CONDITION_IP_LOCAL_INTERFACE,
+                                          &FWPM_FILTER_CONDITION::fieldKey);
+        ASSERT_NE(it, conditions.end());
+        ASSERT_EQ(it->conditionValue.type, FWP_UINT64);
+        ASSERT_EQ(*it->conditionValue.uint64, i < 3 ? 0x47000001000000 : 0x6000001000000);
+    }
+}
+
+TEST(InterfaceTableTests, TestUnknownInterfaceFailsTheRule)
+{
+    size_t callCount{0};
+    InterfaceTable table{fakeInterfaces(callCount)};
+
+    FilterBatch batch{testDisplayData, "test"};
+    ASSERT_THROW(
+        lower("block out on \"Bluetooth\" all", batch, {}, WeightAllocator{}, table.resolver()),
+        std::runtime_error);
+    // Nor can a rule name an interface when there's nothing to resolve it
+    ASSERT_THROW(lower("block out on \"Wi-Fi\" all", batch), std::runtime_error);
+}
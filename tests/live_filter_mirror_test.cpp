@@ -0,0 +1,219 @@
+#include <engine/live_filter_mirror.h>
+#include <engine/memory_engine.h>
+#include <gtest/gtest.h>
+
+using namespace wfpk;
+
+namespace
+{
+const std::vector<GUID> mirroredLayers = {FWPM_LAYER_ALE_AUTH_CONNECT_V4};
+
+FilterId addFilter(MemoryEngine &engine, const GUID &layerKey = FWPM_LAYER_ALE_AUTH_CONNECT_V4,
+                   FWP_ACTION_TYPE action = FWP_ACTION_BLOCK)
+{
+    FWP_V4_ADDR_AND_MASK address{0x01010101, ~0U};
+    FWPM_FILTER_CONDITION condition{};
+    condition.fieldKey = FWPM_CONDITION_IP_REMOTE_ADDRESS;
+    condition.conditionValue.type = FWP_V4_ADDR_MASK;
+    condition.conditionValue.v4AddrMask = &address;
+
+    FWPM_FILTER filter{};
+    filter.layerKey = layerKey;
+    filter.subLayerKey = PIA_SUBLAYER_KEY;
+    filter.providerKey = &PIA_PROVIDER_KEY;
+    filter.action.type = action;
+    filter.numFilterConditions = 1;
+    filter.filterCondition = &condition;
+
+    FilterId id{};
+    EXPECT_EQ(engine.tryAdd(filter, id), ERROR_SUCCESS);
+    return id;
+}
+}
+
+TEST(LiveFilterMirrorTests, TestLoadsTheFiltersOfItsLayers)
+{
+    MemoryEngine engine;
+    const auto first = addFilter(engine);
+    const auto second = addFilter(engine);
+    const auto otherLayer = addFilter(engine, FWPM_LAYER_ALE_AUTH_RECV_ACCEPT_V4);
+
+    LiveFilterMirror mirror{engine, mirroredLayers};
+
+    ASSERT_EQ(mirror.size(), 2);
+    ASSERT_TRUE(mirror.contains(first));
+    ASSERT_TRUE(mirror.contains(second));
+    ASSERT_FALSE(mirror.contains(otherLayer));
+    ASSERT_EQ(mirror.find(first)->filterCondition->conditionValue.v4AddrMask->addr, 0x01010101);
+}
+
+TEST(LiveFilterMirrorTests, TestAppliesChangesOnSync)
+{
+    MemoryEngine engine;
+    const auto kept = addFilter(engine);
+    const auto deleted = addFilter(engine);
+    LiveFilterMirror mirror{engine, mirroredLayers};
+    const auto epoch = mirror.filterEpoch();
+
+    const auto added = addFilter(engine, FWPM_LAYER_ALE_AUTH_CONNECT_V4, FWP_ACTION_PERMIT);
+    addFilter(engine, FWPM_LAYER_ALE_AUTH_RECV_ACCEPT_V4);
+    engine.deleteFilterById(deleted);
+
+    // Nothing changes until the changes are applied
+    ASSERT_TRUE(mirror.contains(deleted));
+    ASSERT_FALSE(mirror.contains(added));
+
+    ASSERT_GT(mirror.sync(), epoch);
+    ASSERT_EQ(mirror.size(), 2);
+    ASSERT_TRUE(mirror.contains(kept));
+    ASSERT_TRUE(mirror.contains(added));
+    ASSERT_FALSE(mirror.contains(deleted));
+    ASSERT_EQ(mirror.find(added)->action.type, FWP_ACTION_PERMIT);
+    ASSERT_EQ(mirror.resyncCount(), 0);
+
+    // Nothing to apply, so the rows are still valid
+    const auto synced = mirror.filterEpoch();
+    ASSERT_EQ(mirror.sync(), synced);
+}
+
+TEST(LiveFilterMirrorTests, TestSeesTransactionsOnlyOnceCommitted)
+{
+    MemoryEngine engine;
+    LiveFilterMirror mirror{engine, mirroredLayers};
+
+    engine.beginTransaction();
+    const auto aborted = addFilter(engine);
+    engine.abortTransaction();
+
+    engine.beginTransaction();
+    const auto committed = addFilter(engine);
+    mirror.sync();
+    ASSERT_FALSE(mirror.contains(committed));
+    engine.commitTransaction();
+
+    mirror.sync();
+    ASSERT_TRUE(mirror.contains(committed));
+    ASSERT_FALSE(mirror.contains(aborted));
+    ASSERT_EQ(mirror.size(), 1);
+}
+
+TEST(LiveFilterMirrorTests, TestSkipsFiltersAddedAndDeletedBetweenSyncs)
+{
+    MemoryEngine engine;
+    LiveFilterMirror mirror{engine, mirroredLayers};
+    const auto epoch = mirror.filterEpoch();
+
+    engine.deleteFilterById(addFilter(engine));
+
+    ASSERT_EQ(mirror.sync(), epoch);
+    ASSERT_EQ(mirror.size(), 0);
+}
+
+TEST(LiveFilterMirrorTests, TestResyncRecoversMissedChanges)
+{
+    MemoryEngine engine;
+    const auto deleted = addFilter(engine);
+    LiveFilterMirror mirror{engine, mirroredLayers};
+
+    engine.dropChanges(2);
+    const auto added = addFilter(engine);
+    engine.deleteFilterById(deleted);
+    mirror.sync();
+    ASSERT_FALSE(mirror.contains(added));
+    ASSERT_TRUE(mirror.contains(deleted));
+
+    const auto epoch = mirror.filterEpoch();
+    mirror.resync();
+    ASSERT_GT(mirror.filterEpoch(), epoch);
+    ASSERT_EQ(mirror.resyncCount(), 1);
+    ASSERT_TRUE(mirror.contains(added));
+    ASSERT_FALSE(mirror.contains(deleted));
+}
+
+TEST(LiveFilterMirrorTests, TestResyncsWhenTheQueueOverflows)
+{
+    MemoryEngine engine;
+    LiveFilterMirror mirror{engine, mirroredLayers, 4};
+
+    std::vector<FilterId> added;
+    for(int i = 0; i < 10; ++i)
+    {
+        added.push_back(addFilter(engine));
+    }
+
+    engine.resetRoundTrips();
+    mirror.sync();
+    ASSERT_EQ(mirror.resyncCount(), 1);
+    ASSERT_EQ(mirror.size(), added.size());
+    // One enumeration rather than a fetch per filter
+    ASSERT_EQ(engine.roundTrips(), 1);
+}
+
+TEST(LiveFilterMirrorTests, TestSelectSkipsDeletedFiltersAndCompacts)
+{
+    MemoryEngine engine;
+    std::vector<FilterId> ids;
+    for(int i = 0; i < 100; ++i)
+    {
+        ids.push_back(addFilter(engine, FWPM_LAYER_ALE_AUTH_CONNECT_V4,
+                                i % 2 ? FWP_ACTION_BLOCK : FWP_ACTION_PERMIT));
+    }
+    LiveFilterMirror mirror{engine, mirroredLayers};
+
+    for(size_t i = 0; i < 30; ++i)
+    {
+        engine.deleteFilterById(ids[i]);
+    }
+    mirror.sync();
+    ASSERT_EQ(mirror.select({}).size(), 70);
+    ASSERT_EQ(mirror.select({.actionTypes = {FWP_ACTION_BLOCK}}).size(), 35);
+
+    // Most rows are now deleted ones, so the mirror is rebuilt
+    for(size_t i = 30; i < 80; ++i)
+    {
+        engine.deleteFilterById(ids[i]);
+    }
+    mirror.sync();
+    const auto rows = mirror.select({});
+    ASSERT_EQ(rows.size(), 20);
+    for(size_t i = 0; i < rows.size(); ++i)
+    {
+        ASSERT_EQ(mirror.filter(rows[i]).filterId, ids[80 + i]);
+    }
+    ASSERT_EQ(mirror.find(ids[99])->action.type, FWP_ACTION_BLOCK);
+}
+
+TEST(LiveFilterMirrorTests, TestProviderAndSubLayerChangesChangeTheirEpochs)
+{
+    MemoryEngine engine;
+    LiveFilterMirror mirror{engine, mirroredLayers};
+    const auto filterEpoch = mirror.filterEpoch();
+    const auto providerEpoch = mirror.providerEpoch();
+    const auto subLayerEpoch = mirror.subLayerEpoch();
+
+    FWPM_PROVIDER provider{};
+    provider.providerKey = PIA_PROVIDER_KEY;
+    engine.tryAddProvider(provider);
+    mirror.sync();
+    ASSERT_GT(mirror.providerEpoch(), providerEpoch);
+    ASSERT_EQ(mirror.subLayerEpoch(), subLayerEpoch);
+
+    FWPM_SUBLAYER subLayer{};
+    subLayer.subLayerKey = PIA_SUBLAYER_KEY;
+    engine.tryAddSubLayer(subLayer);
+    mirror.sync();
+    ASSERT_GT(mirror.subLayerEpoch(), subLayerEpoch);
+    ASSERT_EQ(mirror.filterEpoch(), filterEpoch);
+}
+
+TEST(LiveFilterMirrorTests, TestUnsubscribesWhenDestroyed)
+{
+    MemoryEngine engine;
+    {
+        LiveFilterMirror mirror{engine, mirroredLayers};
+    }
+
+    // Nothing is notified to the destroyed mirror
+    addFilter(engine);
+    ASSERT_EQ(engine.filterCount(), 1);
+}
@@ -0,0 +1,192 @@
+#include <pipeline/load_pipeline.h>
+#include <apply/filter_plan.h>
+#include <engine/memory_engine.h>
+#include "test_rules.h"
+#include <gtest/gtest.h>
+#include <sstream>
+
+using namespace wfpk;
+
+namespace
+{
+std::string manyRules(size_t count)
+{
+    std::string rules;
+    for(size_t i = 0; i < count; ++i)
+    {
+        // Some rules span lines
+        rules += std::format(i % 3 ? "block out to 10.{}.{}.0/24 port {}\n"
+                                   : "block out\n  to 10.{}.{}.0/24\n  port {}\n",
+                             i / 256, i % 256, i % 1000);
+    }
+    return rules;
+}
+
+// Small segments and queues, so every stage has to wait on the others
+constexpr LoadPipeline<MemoryEngine>::Tuning kSmallTuning{256, 1};
+}
+
+TEST(LoadPipelineTests, TestQueueKeepsOrderUnderBackpressure)
+{
+    SpscQueue<size_t> queue{"test", 2};
+    constexpr size_t kCount = 10'000;
+
+    std::jthread producer{[&] {
+        for(size_t i = 0; i < kCount; ++i)
+        {
+            queue.push(i);
+        }
+        queue.close();
+    }};
+
+    size_t expected{0};
+    while(auto value = queue.pop())
+    {
+        ASSERT_EQ(*value, expected++);
+    }
+    producer.join();
+
+    ASSERT_EQ(expected, kCount);
+    ASSERT_EQ(queue.stats().pushCount, kCount);
+    ASSERT_LE(queue.stats().maxOccupancy, 2);
+    ASSERT_GE(queue.stats().averageOccupancy(), 1.0);
+}
+
+TEST(LoadPipelineTests, TestCancelWakesBothEnds)
+{
+    SpscQueue<int> full{"full", 1};
+    SpscQueue<int> empty{"empty", 1};
+    full.push(1);
+
+    std::jthread producer{[&] { ASSERT_FALSE(full.push(2)); }};
+    std::jthread consumer{[&] { ASSERT_FALSE(empty.pop().has_value()); }};
+
+    full.cancel();
+    empty.cancel();
+}
+
+TEST(LoadPipelineTests, TestRuleBoundaries)
+{
+    ASSERT_EQ(lastRuleBoundary(""), 0);
+    ASSERT_EQ(lastRuleBoundary("block out all\n"), 0);
+    ASSERT_EQ(lastRuleBoundary("block out all\n  permit in all"), 14);
+    // A rule spanning lines isn't cut
+    ASSERT_EQ(lastRuleBoundary("block out all\npermit in\n  to 1.1.1.1\n"), 14);
+    // Nor is a string
+    ASSERT_EQ(lastRuleBoundary("block out all\npermit out from \"C:\\a\nblock\"\n"), 14);
+}
+
+TEST(LoadPipelineTests, TestSegmentsAreWholeRules)
+{
+    const std::string source = manyRules(200);
+    std::istringstream stream{source};
+    RuleSegmenter segmenter{stream, 100};
+
+    size_t ruleCount{0};
+    std::string joined;
+    uint32_t expectedLine{1};
+    while(auto segment = segmenter.next())
+    {
+        ASSERT_EQ(segment->start.line, expectedLine);
+        expectedLine += static_cast<uint32_t>(std::ranges::count(segment->text, '\n'));
+
+        auto ruleset = Parser{Lexer{segment->text, segment->start}}.parse();
+        ASSERT_NE(ruleset, nullptr);
+        ruleCount += ruleset->children().size();
+        joined += segment->text;
+    }
+
+    ASSERT_EQ(ruleCount, 200);
+    ASSERT_EQ(joined, source);
+    ASSERT_EQ(segmenter.bytesRead(), source.size());
+}
+
+TEST(LoadPipelineTests, TestMatchesSequentialLoad)
+{
+    const std::string source = manyRules(500);
+    const auto plan = planRuleset(source, testDisplayData, "test");
+
+    MemoryEngine engine;
+    LoadPipeline pipeline{engine, testDisplayData, "test", {}, WeightAllocator{}, kSmallTuning};
+    std::optional<RulesetFingerprint> recorded;
+    pipeline.beforeCommit("Append", [&](const auto &fingerprint) {
+        EXPECT_TRUE(engine.inTransaction());
+        recorded = fingerprint;
+        return true;
+    });
+
+    std::istringstream stream{source};
+    const auto result = pipeline.run(stream);
+
+    ASSERT_EQ(result.filterIds.size(), plan.batch.size());
+    for(size_t i = 0; i < plan.batch.size(); ++i)
+    {
+        // Same filters, keys and weights in the same order
+        const FWPM_FILTER *pFilter = engine.findFilter(result.filterIds[i]);
+        ASSERT_NE(pFilter, nullptr);
+        ASSERT_EQ(pFilter->filterKey, plan.batch.filters()[i].filterKey);
+        ASSERT_EQ(*pFilter->weight.uint64, *plan.batch.filters()[i].weight.uint64);
+    }
+    ASSERT_TRUE(result.committed);
+    ASSERT_EQ(recorded, rulesetFingerprint(plan.batch.filters(), "Append"));
+    ASSERT_FALSE(engine.inTransaction());
+
+    const auto &stages = result.stats.stages;
+    ASSERT_EQ(stages.size(), 4);
+    ASSERT_EQ(stages[0].count, source.size());
+    ASSERT_EQ(stages[1].count, 500);
+    ASSERT_EQ(stages[2].count, plan.batch.size());
+    ASSERT_EQ(stages[3].count, plan.batch.size());
+    ASSERT_EQ(result.stats.queues.size(), 3);
+    ASSERT_GT(result.stats.queues[0].pushCount, 1);
+    ASSERT_FALSE(result.stats.toString().empty());
+}
+
+TEST(LoadPipelineTests, TestFingerprintHookCanRollBack)
+{
+    const std::string source = manyRules(300);
+    const auto plan = planRuleset(source, testDisplayData, "test");
+    const auto installed = rulesetFingerprint(plan.batch.filters(), "Append");
+
+    // As a load of an unchanged ruleset is
+    MemoryEngine engine;
+    LoadPipeline pipeline{engine, testDisplayData, "test", {}, WeightAllocator{}, kSmallTuning};
+    pipeline.beforeCommit("Append",
+                          [&](const auto &fingerprint) { return fingerprint != installed; });
+    std::istringstream stream{source};
+    const auto result = pipeline.run(stream);
+
+    ASSERT_FALSE(result.committed);
+    ASSERT_TRUE(result.filterIds.empty());
+    ASSERT_EQ(engine.filterCount(), 0);
+    ASSERT_FALSE(engine.inTransaction());
+}
+
+TEST(LoadPipelineTests, TestParseErrorRollsBack)
+{
+    const std::string source = manyRules(300) + "block sideways\n" + manyRules(300);
+
+    MemoryEngine engine;
+    LoadPipeline pipeline{engine, testDisplayData, "test", {}, WeightAllocator{}, kSmallTuning};
+    std::istringstream stream{source};
+
+    ASSERT_THROW(pipeline.run(stream), std::runtime_error);
+    ASSERT_EQ(engine.filterCount(), 0);
+    ASSERT_FALSE(engine.inTransaction());
+}
+
+TEST(LoadPipelineTests, TestAddErrorRollsBack)
+{
+    MemoryEngine engine;
+    engine.failAddAfter(100);
+
+    LoadPipeline pipeline{engine, testDisplayData, "test", {}, WeightAllocator{}, kSmallTuning};
+    bool hookCalled{false};
+    pipeline.beforeCommit("Append", [&](const auto &) { return hookCalled = true; });
+    std::istringstream stream{manyRules(1000)};
+
+    ASSERT_THROW(pipeline.run(stream), WfpError);
+    ASSERT_FALSE(hookCalled);
+    ASSERT_EQ(engine.filterCount(), 0);
+    ASSERT_FALSE(engine.inTransaction());
+}
@@ -0,0 +1,108 @@
+#include <engine/object_name_cache.h>
+#include <gtest/gtest.h>
+
+using namespace wfpk;
+
+namespace
+{
+const GUID kFirstKey{0x1111, 0x2222, 0x3333, {1, 2, 3, 4, 5, 6, 7, 8}};
+const GUID kSecondKey{0x4444, 0x5555, 0x6666, {1, 2, 3, 4, 5, 6, 7, 8}};
+const GUID kMissingKey{0x7777, 0x8888, 0x9999, {1, 2, 3, 4, 5, 6, 7, 8}};
+
+// Names the first two keys, counting every fetch
+struct CountingFetch
+{
+    size_t fetchCount{0};
+
+    auto fetch() -> ObjectNameCache::FetchFunc
+    {
+        return [this](const GUID &key) -> std::optional<std::string> {
+            ++fetchCount;
+            if(key == kFirstKey)
+            {
+                return "Private Internet Access";
+            }
+            if(key == kSecondKey)
+            {
+                return "Windows Defender Firewall";
+            }
+            return {};
+        };
+    }
+};
+}
+
+TEST(ObjectNameCacheTests, TestFetchesEachKeyOnce)
+{
+    CountingFetch fetch;
+    ObjectNameCache cache{fetch.fetch()};
+
+    // As listing asks for a filter's names, for many filters of two providers
+    for(int i = 0; i < 1000; ++i)
+    {
+        const auto *pNames = cache.find(i % 2 ? kFirstKey : kSecondKey);
+        ASSERT_NE(pNames, nullptr);
+    }
+
+    ASSERT_EQ(fetch.fetchCount, 2);
+    ASSERT_EQ(cache.stats().hits, 998);
+    ASSERT_EQ(cache.stats().misses, 2);
+    ASSERT_EQ(cache.find(kFirstKey)->displayName, "Private Internet Access");
+    ASSERT_EQ(cache.find(kFirstKey)->lowercaseName, "private internet access");
+}
+
+TEST(ObjectNameCacheTests, TestCachesAbsentKeys)
+{
+    CountingFetch fetch;
+    ObjectNameCache cache{fetch.fetch()};
+
+    ASSERT_EQ(cache.find(kMissingKey), nullptr);
+    ASSERT_EQ(cache.find(kMissingKey), nullptr);
+
+    ASSERT_EQ(fetch.fetchCount, 1);
+    ASSERT_EQ(cache.stats().absent, 1);
+    ASSERT_EQ(cache.size(), 1);
+}
+
+TEST(ObjectNameCacheTests, TestCanRefetchAbsentKeys)
+{
+    CountingFetch fetch;
+    ObjectNameCache cache{fetch.fetch(), ObjectNameCache::AbsentKeys::Refetched};
+
+    ASSERT_EQ(cache.find(kMissingKey), nullptr);
+    ASSERT_EQ(cache.find(kMissingKey), nullptr);
+    ASSERT_NE(cache.find(kFirstKey), nullptr);
+
+    ASSERT_EQ(fetch.fetchCount, 3);
+    ASSERT_EQ(cache.stats().absent, 2);
+    ASSERT_EQ(cache.size(), 1);
+}
+
+TEST(ObjectNameCacheTests, TestClearRefetches)
+{
+    CountingFetch fetch;
+    ObjectNameCache cache{fetch.fetch()};
+
+    cache.find(kFirstKey);
+    cache.clear();
+    cache.find(kFirstKey);
+
+    ASSERT_EQ(fetch.fetchCount, 2);
+    ASSERT_EQ(cache.stats().toString(), "0 hits, 2 misses (0 absent)");
+}
+
+TEST(ObjectNameCacheTests, TestFetchErrorsAreNotCached)
+{
+    bool fail{true};
+    ObjectNameCache cache{[&](const GUID &) -> std::optional<std::string> {
+        if(fail)
+        {
+            throw std::runtime_error{"FwpmProviderGetByKey failed"};
+        }
+        return "Provider";
+    }};
+
+    ASSERT_THROW(cache.find(kFirstKey), std::runtime_error);
+    fail = false;
+    ASSERT_EQ(cache.find(kFirstKey)->displayName, "Provider");
+}
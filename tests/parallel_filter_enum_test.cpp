@@ -0,0 +1,182 @@
+#include <engine/parallel_filter_enum.h>
+#include <sha1.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <set>
+
+using namespace wfpk;
+using namespace std::chrono_literals;
+
+namespace
+{
+auto testLayer(size_t i) -> GUID
+{
+    return nameBasedGuid(ZeroGuid, std::format("layer{}", i));
+}
+
+// Installed filters by layer, shared by every session
+struct FakeBfe
+{
+    std::unordered_map<GUID, std::vector<FWPM_FILTER>> filtersByLayer;
+    // Round trip time of each layer's enumeration
+    std::unordered_map<GUID, std::chrono::milliseconds> latencyByLayer;
+    std::atomic<size_t> sessionCount{0};
+    std::mutex mutex;
+    std::set<std::thread::id> sessionThreads;
+};
+
+// A session on the fake BFE - sessions are used by one thread at a time
+class FakeSession
+{
+public:
+    explicit FakeSession(FakeBfe &bfe)
+        : _bfe{bfe}
+        , _thread{std::this_thread::get_id()}
+    {
+        ++_bfe.sessionCount;
+        std::lock_guard lock{_bfe.mutex};
+        _bfe.sessionThreads.insert(_thread);
+    }
+
+public:
+    // The query isn't modeled
+    template <typename IterFuncT>
+    void enumerateFiltersForLayer(const GUID &layerKey, IterFuncT func, const FilterQuery & = {})
+    {
+        EXPECT_EQ(std::this_thread::get_id(), _thread);
+        if(const auto it = _bfe.latencyByLayer.find(layerKey); it != _bfe.latencyByLayer.end())
+        {
+            std::this_thread::sleep_for(it->second);
+        }
+
+        auto &filters = _bfe.filtersByLayer.at(layerKey);
+        for(auto &filter : filters)
+        {
+            func(std::shared_ptr<FWPM_FILTER>{std::shared_ptr<void>{}, &filter});
+        }
+    }
+
+private:
+    FakeBfe &_bfe;
+    std::thread::id _thread;
+};
+
+// Each layer i has i + 1 filters, numbered by layer
+auto fakeBfe(size_t layerCount, std::vector<GUID> &layers) -> std::unique_ptr<FakeBfe>
+{
+    auto pBfe = std::make_unique<FakeBfe>();
+    for(size_t i = 0; i < layerCount; ++i)
+    {
+        layers.push_back(testLayer(i));
+        auto &filters = pBfe->filtersByLayer[layers.back()];
+        for(size_t j = 0; j <= i; ++j)
+        {
+            FWPM_FILTER filter{};
+            filter.filterId = i * 1000 + j;
+            filter.layerKey = layers.back();
+            filters.push_back(filter);
+        }
+    }
+    return pBfe;
+}
+}
+
+TEST(ParallelFilterEnumTests, TestMergesInLayerOrder)
+{
+    std::vector<GUID> layers;
+    auto pBfe = fakeBfe(8, layers);
+    // The first layers finish last
+    for(size_t i = 0; i < layers.size(); ++i)
+    {
+        pBfe->latencyByLayer[layers[i]] = std::chrono::milliseconds{(layers.size() - i) * 5};
+    }
+
+    ParallelFilterEnum<FakeSession> layerEnum{
+        layers, [&] { return std::make_unique<FakeSession>(*pBfe); }, 4};
+    const auto filters = layerEnum.enumerate();
+
+    ASSERT_EQ(filters.size(), layers.size());
+    for(size_t i = 0; i < layers.size(); ++i)
+    {
+        ASSERT_EQ(filters[i].size(), i + 1);
+        for(size_t j = 0; j < filters[i].size(); ++j)
+        {
+            ASSERT_EQ(filters[i][j]->filterId, i * 1000 + j);
+        }
+    }
+
+    std::vector<FilterId> ids;
+    layerEnum.forEach([&](const auto &pFilter) { ids.push_back(pFilter->filterId); });
+    ASSERT_EQ(ids.size(), 36);
+    ASSERT_TRUE(std::ranges::is_sorted(ids));
+}
+
+TEST(ParallelFilterEnumTests, TestEachWorkerHasItsOwnSession)
+{
+    std::vector<GUID> layers;
+    auto pBfe = fakeBfe(11, layers);
+
+    ParallelFilterEnum<FakeSession> layerEnum{
+        layers, [&] { return std::make_unique<FakeSession>(*pBfe); }, 4};
+    layerEnum.enumerate();
+
+    // One per worker, each opened on (and only used from) its worker's thread
+    ASSERT_EQ(pBfe->sessionCount, 4);
+    ASSERT_FALSE(pBfe->sessionThreads.contains(std::this_thread::get_id()));
+}
+
+TEST(ParallelFilterEnumTests, TestLayersOverlap)
+{
+    std::vector<GUID> layers;
+    auto pBfe = fakeBfe(8, layers);
+    for(const auto &layer : layers)
+    {
+        pBfe->latencyByLayer[layer] = 50ms;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    ParallelFilterEnum<FakeSession> layerEnum{
+        layers, [&] { return std::make_unique<FakeSession>(*pBfe); }, layers.size()};
+    layerEnum.enumerate();
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    // 400ms one after another - generously bounded, as the host may be busy
+    ASSERT_LT(elapsed, 250ms);
+}
+
+TEST(ParallelFilterEnumTests, TestErrorsArePropagated)
+{
+    std::vector<GUID> layers;
+    auto pBfe = fakeBfe(4, layers);
+    // Not a layer the fake BFE knows
+    layers.insert(layers.begin() + 2, testLayer(100));
+
+    ParallelFilterEnum<FakeSession> layerEnum{
+        layers, [&] { return std::make_unique<FakeSession>(*pBfe); }, 2};
+    ASSERT_THROW(layerEnum.enumerate(), std::out_of_range);
+}
+
+TEST(ParallelFilterEnumTests, TestFailedSessionsAreCoveredByOthers)
+{
+    std::vector<GUID> layers;
+    auto pBfe = fakeBfe(6, layers);
+
+    // Only the first session opens
+    std::atomic<size_t> opened{0};
+    auto openFirstSession = [&] {
+        if(opened++ > 0)
+        {
+            throw std::runtime_error{"no session"};
+        }
+        return std::make_unique<FakeSession>(*pBfe);
+    };
+    ParallelFilterEnum<FakeSession> layerEnum{layers, openFirstSession, 3};
+    const auto filters = layerEnum.enumerate();
+    ASSERT_EQ(filters.back().size(), 6);
+
+    // No session at all
+    ParallelFilterEnum<FakeSession> failingEnum{
+        layers, []() -> std::unique_ptr<FakeSession> { throw std::runtime_error{"no session"}; },
+        3};
+    ASSERT_THROW(failingEnum.enumerate(), std::runtime_error);
+}
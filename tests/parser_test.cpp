@@ -141,6 +141,17 @@ TEST(ParserTests, TestTransportProtocol)
     ASSERT_EQ(conditions.transportProtocol, FilterConditions::TransportProtocol::Tcp);
 }
 
+TEST(ParserTests, TestInterfaceName)
+{
+    auto conditions = filterConditionsFor(R"(block out on "Ethernet 2" to 1.1.1.1)");
+    ASSERT_EQ(conditions.interfaceName, "Ethernet 2");
+    ASSERT_EQ(conditions.destIps.v4, (std::vector<std::string>{"1.1.1.1"}));
+
+    // The name must be quoted
+    auto tree = Parser{"block out on wifi all"}.parseTrace();
+    ASSERT_EQ(tree == nullptr, true);
+}
+
 TEST(ParserTests, TestErrorsForTransportProtocol)
 {
     // Only allowed 2 elements max
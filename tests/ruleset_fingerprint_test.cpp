@@ -0,0 +1,120 @@
+#include <apply/ruleset_fingerprint.h>
+#include <apply/filter_diff.h>
+#include <engine/memory_engine.h>
+#include "test_rules.h"
+#include <gtest/gtest.h>
+
+using namespace wfpk;
+
+namespace
+{
+const std::vector kTestLayers = {FWPM_LAYER_ALE_AUTH_CONNECT_V4, FWPM_LAYER_ALE_AUTH_CONNECT_V6,
+                                 FWPM_LAYER_ALE_AUTH_RECV_ACCEPT_V4,
+                                 FWPM_LAYER_ALE_AUTH_RECV_ACCEPT_V6};
+
+auto fingerprintOf(const std::string &rules, const std::string &rulesetName = "test",
+                   std::string_view variant = "append")
+{
+    return rulesetFingerprint(lower(rules, rulesetName).filters(), variant);
+}
+
+const std::string kRules = "block out to 10.0.0.0/8\npermit in all\n";
+}
+
+TEST(RulesetFingerprintTests, TestFingerprintFollowsCompiledContent)
+{
+    ASSERT_EQ(fingerprintOf(kRules), fingerprintOf(kRules));
+    // Formatting doesn't change the compiled ruleset
+    ASSERT_EQ(fingerprintOf(kRules), fingerprintOf("  block out to 10.0.0.0/8\n\npermit in all"));
+
+    ASSERT_NE(fingerprintOf(kRules), fingerprintOf("block out to 10.0.0.0/16\npermit in all\n"));
+    // Rule order decides weights
+    ASSERT_NE(fingerprintOf(kRules), fingerprintOf("permit in all\nblock out to 10.0.0.0/8\n"));
+    ASSERT_NE(fingerprintOf(kRules), fingerprintOf(kRules, "other"));
+    ASSERT_NE(fingerprintOf(kRules), fingerprintOf(kRules, "test", "diff"));
+
+    ASSERT_EQ(fingerprintString(fingerprintOf(kRules)).size(), 40);
+}
+
+TEST(RulesetFingerprintTests, TestRecordedWithTheFilters)
+{
+    MemoryEngine engine;
+    FingerprintStore fingerprints{engine};
+    ASSERT_FALSE(fingerprints.installed().has_value());
+
+    const auto batch = lower(kRules);
+    const auto fingerprint = rulesetFingerprint(batch.filters(), "append");
+
+    FilterApplier applier{engine};
+    applier.beforeCommit([&] {
+        ASSERT_TRUE(engine.inTransaction());
+        fingerprints.record(fingerprint);
+    });
+    applier.apply(batch.filters());
+
+    ASSERT_EQ(engine.providerCount(), 1);
+    ASSERT_EQ(fingerprints.installed(), fingerprint);
+
+    // An unchanged reload only needs to read the fingerprint back
+    engine.resetRoundTrips();
+    ASSERT_EQ(fingerprints.installed(), rulesetFingerprint(lower(kRules).filters(), "append"));
+    ASSERT_EQ(engine.roundTrips(), 1);
+
+    // Recording again replaces the fingerprint
+    RulesetFingerprint other{};
+    fingerprints.record(other);
+    ASSERT_EQ(engine.providerCount(), 1);
+    ASSERT_EQ(fingerprints.installed(), other);
+}
+
+TEST(RulesetFingerprintTests, TestNotRecordedIfTheApplyFails)
+{
+    MemoryEngine engine;
+    FingerprintStore fingerprints{engine};
+
+    const auto previous = fingerprintOf("block out to 1.1.1.1");
+    fingerprints.record(previous);
+
+    const auto batch = lower(kRules);
+    FilterApplier applier{engine};
+    applier.beforeCommit([&] { fingerprints.record(rulesetFingerprint(batch.filters(), "")); });
+    engine.failAddAfter(1);
+
+    ASSERT_THROW(applier.apply(batch.filters()), WfpError);
+    ASSERT_EQ(engine.filterCount(), 0);
+    ASSERT_EQ(fingerprints.installed(), previous);
+}
+
+TEST(RulesetFingerprintTests, TestDiffRecordsEvenWhenNothingDiffers)
+{
+    MemoryEngine engine;
+    FingerprintStore fingerprints{engine};
+
+    const auto batch = lower(kRules);
+    FilterApplier{engine}.apply(batch.filters());
+    ASSERT_FALSE(fingerprints.installed().has_value());
+
+    // e.g the first load after upgrading to a wfpk that records fingerprints
+    const auto fingerprint = rulesetFingerprint(batch.filters(), "diff");
+    DiffApplier applier{engine, kTestLayers};
+    applier.beforeCommit([&] { fingerprints.record(fingerprint); });
+    auto result = applier.apply(batch.filters());
+
+    ASSERT_EQ(result.addedCount + result.deletedCount, 0);
+    ASSERT_EQ(fingerprints.installed(), fingerprint);
+    ASSERT_FALSE(engine.inTransaction());
+}
+
+TEST(RulesetFingerprintTests, TestClear)
+{
+    MemoryEngine engine;
+    FingerprintStore fingerprints{engine};
+
+    // Nothing to clear isn't an error
+    fingerprints.clear();
+
+    fingerprints.record(fingerprintOf(kRules));
+    fingerprints.clear();
+    ASSERT_FALSE(fingerprints.installed().has_value());
+    ASSERT_EQ(engine.providerCount(), 0);
+}
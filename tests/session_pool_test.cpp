@@ -0,0 +1,196 @@
+#include <engine/session_pool.h>
+#include <engine/parallel_filter_enum.h>
+#include <gtest/gtest.h>
+#include <chrono>
+#include <latch>
+
+using namespace wfpk;
+using namespace std::chrono_literals;
+
+namespace
+{
+struct SessionCounts
+{
+    std::atomic<size_t> opened{0};
+    std::atomic<size_t> closed{0};
+    // Fault injection: the next open throws
+    std::atomic<bool> failNextOpen{false};
+};
+
+// A session that checks it's never used by two threads at once
+class FakeSession
+{
+public:
+    explicit FakeSession(SessionCounts &counts)
+        : _counts{counts}
+    {
+        ++_counts.opened;
+    }
+    ~FakeSession()
+    {
+        ++_counts.closed;
+    }
+
+public:
+    void use()
+    {
+        EXPECT_FALSE(_inUse.exchange(true));
+        std::this_thread::sleep_for(100us);
+        _inUse = false;
+    }
+
+    // Each layer has one filter
+    template <typename IterFuncT>
+    void enumerateFiltersForLayer(const GUID &layerKey, IterFuncT func, const FilterQuery & = {})
+    {
+        use();
+        auto pFilter = std::make_shared<FWPM_FILTER>();
+        pFilter->layerKey = layerKey;
+        func(pFilter);
+    }
+
+private:
+    SessionCounts &_counts;
+    std::atomic<bool> _inUse{false};
+};
+
+auto sessionFactory(SessionCounts &counts) -> SessionPool<FakeSession>::SessionFactory
+{
+    return [&counts] {
+        if(counts.failNextOpen.exchange(false))
+        {
+            throw std::runtime_error{"FwpmEngineOpen failed"};
+        }
+        return std::make_unique<FakeSession>(counts);
+    };
+}
+}
+
+TEST(SessionPoolTests, TestReusesReleasedSessions)
+{
+    SessionCounts counts;
+    SessionPool<FakeSession> pool{sessionFactory(counts), 4};
+
+    FakeSession *pFirst{nullptr};
+    {
+        auto session = pool.lease();
+        pFirst = session.get();
+    }
+    ASSERT_EQ(pool.idleCount(), 1);
+
+    auto session = pool.lease();
+    ASSERT_EQ(session.get(), pFirst);
+    ASSERT_EQ(counts.opened, 1);
+    ASSERT_EQ(pool.openCount(), 1);
+}
+
+TEST(SessionPoolTests, TestWaitsForASessionOnceAllAreLeased)
+{
+    SessionCounts counts;
+    SessionPool<FakeSession> pool{sessionFactory(counts), 2};
+
+    auto first = pool.lease();
+    auto second = pool.lease();
+    ASSERT_FALSE(pool.tryLease());
+
+    FakeSession *pFirst = first.get();
+    std::atomic<bool> leased{false};
+    std::jthread waiter{[&] {
+        auto third = pool.lease();
+        leased = true;
+        EXPECT_EQ(third.get(), pFirst);
+    }};
+
+    std::this_thread::sleep_for(20ms);
+    ASSERT_FALSE(leased);
+    first = {};
+    waiter.join();
+    ASSERT_TRUE(leased);
+    ASSERT_EQ(counts.opened, 2);
+    ASSERT_EQ(pool.idleCount(), 1);
+}
+
+TEST(SessionPoolTests, TestNeverSharesASessionBetweenThreads)
+{
+    SessionCounts counts;
+    SessionPool<FakeSession> pool{sessionFactory(counts), 3};
+
+    std::latch start{8};
+    {
+        std::vector<std::jthread> workers;
+        for(int i = 0; i < 8; ++i)
+        {
+            workers.emplace_back([&] {
+                start.arrive_and_wait();
+                for(int j = 0; j < 50; ++j)
+                {
+                    pool.lease()->use();
+                }
+            });
+        }
+    }
+
+    ASSERT_LE(counts.opened, 3);
+    ASSERT_EQ(pool.idleCount(), pool.openCount());
+}
+
+TEST(SessionPoolTests, TestDiscardedAndFailedSessionsFreeTheirSlot)
+{
+    SessionCounts counts;
+    SessionPool<FakeSession> pool{sessionFactory(counts), 1};
+
+    counts.failNextOpen = true;
+    ASSERT_THROW(pool.lease(), std::runtime_error);
+    ASSERT_EQ(pool.openCount(), 0);
+
+    auto session = pool.lease();
+    session.discard();
+    ASSERT_FALSE(session);
+    ASSERT_EQ(counts.closed, 1);
+    ASSERT_EQ(pool.openCount(), 0);
+
+    // The slot is free again, so a new session is opened
+    ASSERT_TRUE(pool.tryLease());
+    ASSERT_EQ(counts.opened, 2);
+}
+
+TEST(SessionPoolTests, TestShrinkingClosesSessionsAsTheyAreReleased)
+{
+    SessionCounts counts;
+    SessionPool<FakeSession> pool{sessionFactory(counts), 3};
+    {
+        auto first = pool.lease();
+        auto second = pool.lease();
+        auto third = pool.lease();
+        pool.setMaxSessions(1);
+    }
+
+    ASSERT_EQ(pool.openCount(), 1);
+    ASSERT_EQ(pool.idleCount(), 1);
+    ASSERT_EQ(counts.closed, 2);
+}
+
+TEST(SessionPoolTests, TestParallelEnumerationLeasesFromThePool)
+{
+    SessionCounts counts;
+    SessionPool<FakeSession> pool{sessionFactory(counts), 2};
+
+    std::vector<GUID> layers;
+    for(unsigned long i = 0; i < 16; ++i)
+    {
+        layers.push_back(GUID{i + 1});
+    }
+
+    // Sessions are opened by the first enumeration, and reused by the second
+    for(int i = 0; i < 2; ++i)
+    {
+        const auto filters = ParallelFilterEnum<FakeSession>{layers, pool}.enumerate();
+        ASSERT_EQ(filters.size(), layers.size());
+        for(size_t j = 0; j < layers.size(); ++j)
+        {
+            ASSERT_EQ(filters[j].front()->layerKey, layers[j]);
+        }
+    }
+    ASSERT_LE(counts.opened, 2);
+    ASSERT_EQ(pool.idleCount(), pool.openCount());
+}
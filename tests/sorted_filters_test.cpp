@@ -0,0 +1,121 @@
+#include <engine/sorted_filters.h>
+#include <gtest/gtest.h>
+
+using namespace wfpk;
+
+namespace
+{
+// Filters with each kind of weight - uint64 weights point into the fixture
+class SortedFiltersTests : public testing::Test
+{
+protected:
+    FWPM_FILTER &addUint64(UINT64 weight)
+    {
+        auto &filter = newFilter();
+        _weights.push_back(std::make_unique<UINT64>(weight));
+        filter.weight.type = FWP_UINT64;
+        filter.weight.uint64 = _weights.back().get();
+        return filter;
+    }
+
+    FWPM_FILTER &addUint8(UINT8 weight)
+    {
+        auto &filter = newFilter();
+        filter.weight.type = FWP_UINT8;
+        filter.weight.uint8 = weight;
+        return filter;
+    }
+
+    FWPM_FILTER &addEmpty()
+    {
+        return newFilter();
+    }
+
+    // The ids of the filters, heaviest first
+    auto sortedIds() -> std::vector<UINT64>
+    {
+        SortedFilters sorted;
+        sorted.reserve(_filters.size());
+        for(const auto &pFilter : _filters)
+        {
+            sorted.add(*pFilter);
+        }
+        sorted.sort();
+
+        std::vector<UINT64> ids;
+        for(const auto &entry : sorted)
+        {
+            ids.push_back(entry.pFilter->filterId);
+        }
+        return ids;
+    }
+
+private:
+    FWPM_FILTER &newFilter()
+    {
+        _filters.push_back(std::make_unique<FWPM_FILTER>());
+        _filters.back()->filterId = _filters.size();
+        return *_filters.back();
+    }
+
+private:
+    std::vector<std::unique_ptr<FWPM_FILTER>> _filters;
+    std::vector<std::unique_ptr<UINT64>> _weights;
+};
+}
+
+TEST_F(SortedFiltersTests, TestDecodesEachWeightType)
+{
+    ASSERT_EQ(filterWeight(addUint64(0x123456789)), 0x123456789);
+    ASSERT_EQ(filterWeight(addUint8(15)), UINT64{15} << 60);
+    ASSERT_EQ(filterWeight(addUint8(1)), UINT64{1} << 60);
+    ASSERT_EQ(filterWeight(addEmpty()), 0);
+
+    // A missing uint64 weight isn't dereferenced
+    auto &filter = addEmpty();
+    filter.weight.type = FWP_UINT64;
+    ASSERT_EQ(filterWeight(filter), 0);
+}
+
+TEST_F(SortedFiltersTests, TestPrefersTheEffectiveWeight)
+{
+    UINT64 effective{42};
+    auto &filter = addUint8(3);
+    filter.effectiveWeight.type = FWP_UINT64;
+    filter.effectiveWeight.uint64 = &effective;
+
+    ASSERT_EQ(filterWeight(filter), 42);
+}
+
+TEST_F(SortedFiltersTests, TestOrdersFull64BitWeights)
+{
+    // These differ only above the low byte, which used to be all that was compared
+    addUint64(0x100);
+    addUint64(0x10000000000);
+    addUint64(0x1FF);
+    addUint64(0x0FF);
+
+    ASSERT_EQ(sortedIds(), (std::vector<UINT64>{2, 3, 1, 4}));
+}
+
+TEST_F(SortedFiltersTests, TestRanksUint8WeightsAmong64BitWeights)
+{
+    addUint8(10);
+    addUint64((UINT64{10} << 60) + 1);
+    addUint64((UINT64{10} << 60) - 1);
+    addEmpty();
+    addUint8(11);
+
+    ASSERT_EQ(sortedIds(), (std::vector<UINT64>{5, 2, 1, 3, 4}));
+}
+
+TEST_F(SortedFiltersTests, TestEqualWeightsKeepTheirOrder)
+{
+    addUint64(5);
+    addUint64(7);
+    addUint64(5);
+    addUint64(7);
+    addUint64(5);
+
+    ASSERT_EQ(sortedIds(), (std::vector<UINT64>{2, 4, 1, 3, 5}));
+}
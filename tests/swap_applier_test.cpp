@@ -0,0 +1,194 @@
+#include <apply/swap_applier.h>
+#include <apply/filter_applier.h>
+#include <engine/memory_engine.h>
+#include "test_rules.h"
+#include <gtest/gtest.h>
+
+using namespace wfpk;
+
+namespace
+{
+const std::vector kTestLayers = {FWPM_LAYER_ALE_AUTH_CONNECT_V4, FWPM_LAYER_ALE_AUTH_CONNECT_V6,
+                                 FWPM_LAYER_ALE_AUTH_RECV_ACCEPT_V4,
+                                 FWPM_LAYER_ALE_AUTH_RECV_ACCEPT_V6};
+
+// The sublayer of every installed filter
+std::vector<GUID> installedSubLayers(MemoryEngine &engine)
+{
+    std::vector<GUID> subLayers;
+    for(const auto &layerKey : kTestLayers)
+    {
+        engine.enumerateFiltersForLayer(
+            layerKey, [&](const auto &pFilter) { subLayers.push_back(pFilter->subLayerKey); });
+    }
+    return subLayers;
+}
+}
+
+TEST(SwapApplierTests, TestFirstSwapCreatesASublayer)
+{
+    MemoryEngine engine;
+    const auto batch = lower("block out to 10.0.0.0/8\npermit in all");
+
+    auto result = SwapApplier{engine, kTestLayers}.apply(batch.filters());
+    ASSERT_EQ(result.retiredCount, 0);
+
+    ASSERT_EQ(result.filterIds.size(), batch.size());
+    ASSERT_EQ(result.activeSubLayerKey, WFPK_SWAP_SUBLAYER_KEYS[0]);
+    ASSERT_EQ(engine.subLayerWeight(WFPK_SWAP_SUBLAYER_KEYS[0]),
+              SwapApplier<MemoryEngine>::kBaseWeight);
+    ASSERT_EQ(engine.subLayerCount(), 1);
+
+    for(const auto &subLayerKey : installedSubLayers(engine))
+    {
+        ASSERT_EQ(subLayerKey, WFPK_SWAP_SUBLAYER_KEYS[0]);
+    }
+}
+
+TEST(SwapApplierTests, TestOldPolicyIsDeletedInTheSameTransaction)
+{
+    MemoryEngine engine;
+    SwapApplier applier{engine, kTestLayers};
+
+    const auto before = lower("block out to 1.1.1.1\nblock out to 2.2.2.2");
+    applier.apply(before.filters());
+
+    // By the commit, only the new policy's filters are left - so the old policy's
+    // blocks never override the new one's permits
+    const auto after = lower("block out to 3.3.3.3\npermit out to 1.1.1.1");
+    applier.beforeCommit([&] {
+        ASSERT_TRUE(engine.inTransaction());
+        ASSERT_EQ(engine.filterCount(), after.size());
+        for(const auto &subLayerKey : installedSubLayers(engine))
+        {
+            ASSERT_EQ(subLayerKey, WFPK_SWAP_SUBLAYER_KEYS[1]);
+        }
+    });
+    auto result = applier.apply(after.filters());
+
+    ASSERT_EQ(result.activeSubLayerKey, WFPK_SWAP_SUBLAYER_KEYS[1]);
+    ASSERT_EQ(result.activeWeight, SwapApplier<MemoryEngine>::kBaseWeight);
+    ASSERT_EQ(result.retiredCount, before.size());
+    ASSERT_EQ(engine.filterCount(), after.size());
+    ASSERT_EQ(engine.subLayerCount(), 1);
+    ASSERT_FALSE(engine.subLayerWeight(WFPK_SWAP_SUBLAYER_KEYS[0]).has_value());
+    ASSERT_FALSE(engine.inTransaction());
+}
+
+TEST(SwapApplierTests, TestSwappingTheSameRulesetAgain)
+{
+    MemoryEngine engine;
+    SwapApplier applier{engine, kTestLayers};
+    const auto batch = lower("block out to 1.1.1.1\npermit in all");
+
+    for(size_t i = 0; i < 3; ++i)
+    {
+        // Keys are per sublayer, so identical filters don't collide with the active ones
+        auto result = applier.apply(batch.filters());
+
+        ASSERT_EQ(result.activeSubLayerKey, WFPK_SWAP_SUBLAYER_KEYS[i % 2]);
+        ASSERT_EQ(engine.subLayerWeight(result.activeSubLayerKey),
+                  SwapApplier<MemoryEngine>::kBaseWeight);
+        ASSERT_EQ(engine.filterCount(), batch.size());
+        ASSERT_EQ(engine.subLayerCount(), 1);
+    }
+}
+
+TEST(SwapApplierTests, TestFailedSwapLeavesTheOldPolicy)
+{
+    MemoryEngine engine;
+    SwapApplier applier{engine, kTestLayers};
+
+    const auto before = lower("block out to 1.1.1.1\nblock out to 2.2.2.2");
+    applier.apply(before.filters());
+
+    bool hookCalled{false};
+    applier.beforeCommit([&] { hookCalled = true; });
+    engine.failAddAfter(1);
+    ASSERT_THROW(applier.apply(lower("block out to {3.3.3.3, 4.4.4.4}\npermit in all").filters()),
+                 WfpError);
+
+    ASSERT_FALSE(hookCalled);
+    ASSERT_FALSE(engine.inTransaction());
+    ASSERT_EQ(engine.filterCount(), before.size());
+    ASSERT_EQ(engine.subLayerCount(), 1);
+    ASSERT_TRUE(engine.subLayerWeight(WFPK_SWAP_SUBLAYER_KEYS[0]).has_value());
+}
+
+TEST(SwapApplierTests, TestLeftoversOfAnInterruptedSwapAreRemoved)
+{
+    MemoryEngine engine;
+    SwapApplier applier{engine, kTestLayers};
+
+    // Simulate a swap whose retiring never ran: both sublayers, with filters
+    const auto old = lower("block out to 1.1.1.1");
+    applier.apply(old.filters());
+    FWPM_SUBLAYER subLayer{};
+    subLayer.subLayerKey = WFPK_SWAP_SUBLAYER_KEYS[1];
+    subLayer.weight = SwapApplier<MemoryEngine>::kBaseWeight + 1;
+    ASSERT_EQ(engine.tryAddSubLayer(subLayer), ERROR_SUCCESS);
+    FWPM_FILTER stray{old.filters().front()};
+    stray.subLayerKey = WFPK_SWAP_SUBLAYER_KEYS[1];
+    stray.filterKey = ZeroGuid;
+    FilterId strayId{};
+    ASSERT_EQ(engine.tryAdd(stray, strayId), ERROR_SUCCESS);
+
+    const auto batch = lower("block out to 2.2.2.2");
+    auto result = applier.apply(batch.filters());
+
+    // The higher weighted sublayer was in force, so the other is the leftover
+    ASSERT_EQ(result.leftoverCount, 1);
+    ASSERT_EQ(result.activeSubLayerKey, WFPK_SWAP_SUBLAYER_KEYS[0]);
+    ASSERT_EQ(result.activeWeight, SwapApplier<MemoryEngine>::kBaseWeight);
+    ASSERT_EQ(result.retiredCount, 1);
+    ASSERT_EQ(engine.filterCount(), batch.size());
+    ASSERT_EQ(engine.subLayerCount(), 1);
+}
+
+TEST(SwapApplierTests, TestFailedRetireLeavesTheOldPolicy)
+{
+    MemoryEngine engine;
+    const auto before = lower("block out to 1.1.1.1\npermit in all");
+    SwapApplier{engine, kTestLayers}.apply(before.filters());
+
+    // The inbound filter isn't found, so the old sublayer is still in use when it's
+    // deleted - and the whole swap is rolled back
+    SwapApplier outboundOnly{engine, {FWPM_LAYER_ALE_AUTH_CONNECT_V4}};
+    ASSERT_THROW(outboundOnly.apply(lower("block out to 2.2.2.2").filters()), WfpError);
+
+    ASSERT_FALSE(engine.inTransaction());
+    ASSERT_EQ(engine.filterCount(), before.size());
+    ASSERT_EQ(engine.subLayerCount(), 1);
+    for(const auto &subLayerKey : installedSubLayers(engine))
+    {
+        ASSERT_EQ(subLayerKey, WFPK_SWAP_SUBLAYER_KEYS[0]);
+    }
+}
+
+TEST(SwapApplierTests, TestSwapReplacesAnAppendedLoad)
+{
+    MemoryEngine engine;
+    const auto appended = lower("block out to 1.1.1.1\npermit in all");
+    FilterApplier{engine}.apply(appended.filters());
+
+    // Another provider's filter in the PIA sublayer isn't part of the policy
+    FWPM_FILTER foreign = appended.filters()[0];
+    foreign.providerKey = nullptr;
+    foreign.filterKey = {
+        0x2f6d1c3a, 0x1b7e, 0x4c52, {0x9a, 0x10, 0x3e, 0x51, 0x6b, 0x22, 0x84, 0x07}};
+    FilterId foreignId{};
+    ASSERT_EQ(engine.tryAdd(foreign, foreignId), ERROR_SUCCESS);
+
+    // Nothing of the appended load is left in force alongside the swapped-in policy
+    SwapApplier applier{engine, kTestLayers};
+    const auto swapped = lower("permit out to 1.1.1.1");
+    applier.beforeCommit([&] {
+        ASSERT_EQ(engine.filterCount(), swapped.size() + 1);
+        ASSERT_EQ(engine.filterById(foreignId)->subLayerKey, PIA_SUBLAYER_KEY);
+    });
+    auto result = applier.apply(swapped.filters());
+
+    ASSERT_EQ(result.retiredCount, appended.size());
+    ASSERT_EQ(result.activeSubLayerKey, WFPK_SWAP_SUBLAYER_KEYS[0]);
+    ASSERT_EQ(engine.filterCount(), swapped.size() + 1);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <apply/filter_batch.h>
+#include <visitors/wfp_executor.h>
+#include <parser/parser.h>
+#include <string>
+
+// Lowering rulesets in tests - planRuleset() does the same on FilterBuilder's workers
+namespace wfpk
+{
+inline FWPM_DISPLAY_DATA testDisplayData{const_cast<wchar_t *>(L"test"), nullptr};
+
+// Lower rules into the given batch, on this thread
+inline void lower(const std::string &rules, FilterBatch &batch, AppIdResolver appIdResolver = {},
+                  WeightAllocator weights = WeightAllocator{},
+                  InterfaceResolver interfaceResolver = {})
+{
+    auto tree = Parser{rules}.parse();
+    tree->accept(WfpExecutor{batch, std::move(appIdResolver), std::move(weights), 0,
+                             std::move(interfaceResolver)});
+}
+
+// Lower rules into a new batch
+inline FilterBatch lower(const std::string &rules, const std::string &rulesetName = "test")
+{
+    FilterBatch batch{testDisplayData, rulesetName};
+    lower(rules, batch);
+    return batch;
+}
+}
@@ -0,0 +1,187 @@
+#include <apply/weight_allocator.h>
+#include "test_rules.h"
+#include <gtest/gtest.h>
+
+using namespace wfpk;
+
+namespace
+{
+// The weight of each filter the rules lower to
+std::vector<UINT64> weightsFor(const std::string &rules,
+                               WeightAllocator weights = WeightAllocator{})
+{
+    FilterBatch batch{testDisplayData, "test"};
+    lower(rules, batch, {}, weights);
+
+    std::vector<UINT64> result;
+    for(const auto &filter : batch.filters())
+    {
+        EXPECT_EQ(filter.weight.type, FWP_UINT64);
+        result.push_back(*filter.weight.uint64);
+    }
+    return result;
+}
+}
+
+TEST(WeightAllocatorTests, TestEarlierRulesWin)
+{
+    const auto weights = weightsFor(R"(permit out to 10.0.0.1
+                                       block out to 10.0.0.0/8
+                                       permit out inet)");
+
+    ASSERT_EQ(weights.size(), 3);
+    ASSERT_GT(weights[0], weights[1]);
+    ASSERT_GT(weights[1], weights[2]);
+
+    for(const auto weight : weights)
+    {
+        ASSERT_GE(weight, WeightAllocator::kDefaultLowest);
+        ASSERT_LE(weight, WeightAllocator::kDefaultHighest);
+    }
+}
+
+TEST(WeightAllocatorTests, TestMoreSpecificFiltersWin)
+{
+    const auto weights = weightsFor(R"(block out inet
+                                       block out to 10.0.0.0/8
+                                       permit out to 10.1.0.0/16
+                                       permit out proto tcp to 10.0.0.0/8
+                                       permit out to 10.2.0.0/16)",
+                                    WeightAllocator{WeightPolicy::Specificity});
+
+    ASSERT_EQ(weights.size(), 5);
+    // More fields beat narrower addresses, which beat fewer conditions
+    ASSERT_GT(weights[3], weights[2]);
+    ASSERT_GT(weights[2], weights[1]);
+    ASSERT_GT(weights[1], weights[0]);
+    // Equally specific filters are ranked by rule order
+    ASSERT_GT(weights[2], weights[4]);
+}
+
+TEST(WeightAllocatorTests, TestAppendingRulesKeepsExistingWeights)
+{
+    const std::string rules = "block out to 1.1.1.1\npermit out to 2.2.2.2\n";
+
+    const auto before = weightsFor(rules);
+    const auto after = weightsFor(rules + "block in all\n");
+
+    ASSERT_EQ(after.size(), before.size() + 2);
+    ASSERT_TRUE(std::ranges::equal(before, after | std::views::take(before.size())));
+}
+
+TEST(WeightAllocatorTests, TestSpecificity)
+{
+    FWP_V4_ADDR_AND_MASK wide{0x0A000000, 0xFF000000};
+    FWP_V4_ADDR_AND_MASK narrow{0x0A000001, 0xFFFFFFFF};
+
+    FWPM_FILTER_CONDITION conditions[3]{};
+    conditions[0].fieldKey = FWPM_CONDITION_IP_REMOTE_ADDRESS;
+    conditions[0].conditionValue.type = FWP_V4_ADDR_MASK;
+    conditions[0].conditionValue.v4AddrMask = &narrow;
+    conditions[1] = conditions[0];
+    conditions[1].conditionValue.v4AddrMask = &wide;
+    conditions[2].fieldKey = FWPM_CONDITION_IP_REMOTE_PORT;
+    conditions[2].conditionValue.type = FWP_UINT16;
+    conditions[2].conditionValue.uint16 = 443;
+
+    const auto specificity = [&](size_t first, size_t count) {
+        return conditionSpecificity(std::span{conditions}.subspan(first, count));
+    };
+
+    ASSERT_EQ(specificity(0, 0), 0);
+    ASSERT_EQ(specificity(0, 1), WeightAllocator::kFieldSpecificity + 32);
+    // An address field is only as specific as its widest (ORed) value
+    ASSERT_EQ(specificity(0, 2), WeightAllocator::kFieldSpecificity + 8);
+    ASSERT_EQ(specificity(1, 2), 2 * WeightAllocator::kFieldSpecificity + 8);
+}
+
+TEST(WeightAllocatorTests, TestGapsAllowInserts)
+{
+    const WeightAllocator allocator;
+
+    // Ample room between neighbouring ranks
+    ASSERT_GT(allocator.stride(), UINT64{1} << 24);
+
+    const UINT64 upper = allocator.weightFor(0, 0);
+    const UINT64 lower = allocator.weightFor(1, 0);
+    const auto inserted = WeightAllocator::between(lower, upper);
+    ASSERT_TRUE(inserted.has_value());
+    ASSERT_GT(*inserted, lower);
+    ASSERT_LT(*inserted, upper);
+
+    ASSERT_FALSE(WeightAllocator::between(5, 6).has_value());
+    ASSERT_FALSE(WeightAllocator::between(6, 5).has_value());
+}
+
+TEST(WeightAllocatorTests, TestRetainKeepsInstalledWeights)
+{
+    const WeightAllocator allocator;
+    const std::vector<UINT64> before{allocator.weightFor(0, 0), allocator.weightFor(1, 0),
+                                     allocator.weightFor(2, 0)};
+
+    // A rule inserted second: the others move down a rank, but keep their weights
+    const std::vector<UINT64> after{allocator.weightFor(0, 0), allocator.weightFor(1, 0),
+                                    allocator.weightFor(2, 0), allocator.weightFor(3, 0)};
+    const std::vector<std::optional<UINT64>> installed{before[0], std::nullopt, before[1],
+                                                       before[2]};
+    const auto retained = WeightAllocator::retain(after, installed);
+    ASSERT_TRUE(retained.has_value());
+    ASSERT_EQ((*retained)[0], before[0]);
+    ASSERT_EQ((*retained)[2], before[1]);
+    ASSERT_EQ((*retained)[3], before[2]);
+    // Slotted in between its neighbours
+    ASSERT_LT((*retained)[1], before[0]);
+    ASSERT_GT((*retained)[1], before[1]);
+}
+
+TEST(WeightAllocatorTests, TestRetainReweightsOutOfOrderFilters)
+{
+    const std::vector<UINT64> weights{50, 40, 40, 30, 20};
+    // The fourth filter is installed above the first, so it can't keep its weight - its
+    // own weight fits where it now ranks. The two weighted equally keep different weights.
+    const std::vector<std::optional<UINT64>> installed{55, 38, 36, 60, 25};
+
+    const auto retained = WeightAllocator::retain(weights, installed, 0, 100);
+    ASSERT_TRUE(retained.has_value());
+    ASSERT_EQ(*retained, (std::vector<UINT64>{55, 38, 36, 30, 25}));
+
+    // Where its own weight doesn't fit, it's put half way between its neighbours
+    const std::vector<std::optional<UINT64>> squeezed{48, std::nullopt, 40};
+    const std::vector<UINT64> squeezedWeights{50, 40, 30};
+    const auto between = WeightAllocator::retain(squeezedWeights, squeezed, 0, 100);
+    ASSERT_TRUE(between.has_value());
+    ASSERT_EQ(*between, (std::vector<UINT64>{48, 44, 40}));
+}
+
+TEST(WeightAllocatorTests, TestRetainWithoutRoom)
+{
+    const std::vector<UINT64> weights{30, 20, 10};
+
+    // Nothing fits strictly between 6 and 5
+    const std::vector<std::optional<UINT64>> installed{6, std::nullopt, 5};
+    ASSERT_FALSE(WeightAllocator::retain(weights, installed, 0, 100).has_value());
+
+    // With nothing installed, the weights are kept as they are
+    const std::vector<std::optional<UINT64>> uninstalled(weights.size());
+    const auto fresh = WeightAllocator::retain(weights, uninstalled, 0, 100);
+    ASSERT_TRUE(fresh.has_value());
+    ASSERT_EQ(*fresh, weights);
+}
+
+TEST(WeightAllocatorTests, TestLargeRulesetsStayOrdered)
+{
+    const WeightAllocator allocator;
+
+    UINT64 previous = (std::numeric_limits<UINT64>::max)();
+    for(size_t ruleIndex = 0; ruleIndex < 200'000; ++ruleIndex)
+    {
+        const UINT64 weight = allocator.weightFor(ruleIndex, WeightAllocator::kMaxSpecificity);
+        ASSERT_LT(weight, previous);
+        // The least specific filter of a rule still beats the next rule's filters
+        ASSERT_GT(allocator.weightFor(ruleIndex, 0),
+                  allocator.weightFor(ruleIndex + 1, WeightAllocator::kMaxSpecificity));
+        previous = weight;
+    }
+
+    ASSERT_THROW(allocator.weightFor(WeightAllocator::kMaxRules, 0), std::out_of_range);
+}
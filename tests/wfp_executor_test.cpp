@@ -0,0 +1,139 @@
+#include <visitors/wfp_executor.h>
+#include "test_rules.h"
+#include <gtest/gtest.h>
+
+using namespace wfpk;
+
+namespace
+{
+size_t countConditions(const FWPM_FILTER &filter, const GUID &fieldKey)
+{
+    return std::ranges::count_if(
+        std::span{filter.filterCondition, filter.numFilterConditions},
+        [&](const FWPM_FILTER_CONDITION &condition) { return condition.fieldKey == fieldKey; });
+}
+}
+
+TEST(WfpExecutorTests, TestAddressesShareOneFilter)
+{
+    std::string addresses;
+    for(int i = 0; i < 5000; ++i)
+    {
+        addresses += std::format("{}10.{}.{}.1", i == 0 ? "" : ", ", i / 256, i % 256);
+    }
+
+    FilterBatch batch{testDisplayData, "test"};
+    lower(std::format("block out to {{{}}}", addresses), batch);
+
+    ASSERT_EQ(batch.size(), 1);
+    const FWPM_FILTER &filter = batch.filters().front();
+    ASSERT_EQ(filter.layerKey, FWPM_LAYER_ALE_AUTH_CONNECT_V4);
+    ASSERT_EQ(filter.numFilterConditions, 5000);
+    ASSERT_EQ(countConditions(filter, FWPM_CONDITION_IP_REMOTE_ADDRESS), 5000);
+}
+
+TEST(WfpExecutorTests, TestOneFilterPerAddressFamily)
+{
+    FilterBatch batch{testDisplayData, "test"};
+    lower("block out to {1.1.1.1, 123::1/64, 2.2.2.2}", batch);
+
+    ASSERT_EQ(batch.size(), 2);
+    const FWPM_FILTER &v4Filter = batch.filters()[0];
+    const FWPM_FILTER &v6Filter = batch.filters()[1];
+
+    ASSERT_EQ(v4Filter.layerKey, FWPM_LAYER_ALE_AUTH_CONNECT_V4);
+    ASSERT_EQ(v4Filter.numFilterConditions, 2);
+    ASSERT_EQ(v4Filter.filterCondition[0].conditionValue.type, FWP_V4_ADDR_MASK);
+
+    ASSERT_EQ(v6Filter.layerKey, FWPM_LAYER_ALE_AUTH_CONNECT_V6);
+    ASSERT_EQ(v6Filter.numFilterConditions, 1);
+    ASSERT_EQ(v6Filter.filterCondition[0].conditionValue.type, FWP_V6_ADDR_MASK);
+    ASSERT_EQ(v6Filter.filterCondition[0].conditionValue.v6AddrMask->prefixLength, 64);
+}
+
+TEST(WfpExecutorTests, TestMismatchedFamiliesAreSkipped)
+{
+    FilterBatch batch{testDisplayData, "test"};
+    // A v4 source and a v6 dest can never match the same connection
+    lower("block out from 1.1.1.1 to 123::1", batch);
+
+    ASSERT_EQ(batch.size(), 0);
+}
+
+TEST(WfpExecutorTests, TestAllCoversBothFamilies)
+{
+    FilterBatch batch{testDisplayData, "test"};
+    lower("permit in all", batch);
+
+    ASSERT_EQ(batch.size(), 2);
+    ASSERT_EQ(batch.filters()[0].layerKey, FWPM_LAYER_ALE_AUTH_RECV_ACCEPT_V4);
+    ASSERT_EQ(batch.filters()[1].layerKey, FWPM_LAYER_ALE_AUTH_RECV_ACCEPT_V6);
+    ASSERT_EQ(batch.filters()[0].numFilterConditions, 0);
+}
+
+TEST(WfpExecutorTests, TestSourceAndDestFollowDirection)
+{
+    FilterBatch batch{testDisplayData, "test"};
+    lower(R"(block out from 1.1.1.1 to 2.2.2.2
+             block in from 1.1.1.1 to 2.2.2.2)",
+          batch);
+
+    ASSERT_EQ(batch.size(), 2);
+    const FWPM_FILTER &outFilter = batch.filters()[0];
+    const FWPM_FILTER &inFilter = batch.filters()[1];
+
+    // Outbound: we're the source
+    ASSERT_EQ(outFilter.filterCondition[0].fieldKey, FWPM_CONDITION_IP_LOCAL_ADDRESS);
+    ASSERT_EQ(outFilter.filterCondition[1].fieldKey, FWPM_CONDITION_IP_REMOTE_ADDRESS);
+    // Inbound: we're the destination
+    ASSERT_EQ(inFilter.filterCondition[0].fieldKey, FWPM_CONDITION_IP_REMOTE_ADDRESS);
+    ASSERT_EQ(inFilter.filterCondition[1].fieldKey, FWPM_CONDITION_IP_LOCAL_ADDRESS);
+}
+
+TEST(WfpExecutorTests, TestPortsAndProtocol)
+{
+    FilterBatch batch{testDisplayData, "test"};
+    lower("block out inet proto tcp to 1.1.1.1 port {80, 443}", batch);
+
+    ASSERT_EQ(batch.size(), 1);
+    const FWPM_FILTER &filter = batch.filters().front();
+    ASSERT_EQ(countConditions(filter, FWPM_CONDITION_IP_REMOTE_ADDRESS), 1);
+    ASSERT_EQ(countConditions(filter, FWPM_CONDITION_IP_REMOTE_PORT), 2);
+    ASSERT_EQ(countConditions(filter, FWPM_CONDITION_IP_PROTOCOL), 1);
+
+    const FWPM_FILTER_CONDITION &protocol = filter.filterCondition[3];
+    ASSERT_EQ(protocol.fieldKey, FWPM_CONDITION_IP_PROTOCOL);
+    ASSERT_EQ(protocol.conditionValue.uint8, IPPROTO_TCP);
+}
+
+TEST(WfpExecutorTests, TestResolvesAppId)
+{
+    const std::vector<UINT8> appId{'a', 'p', 'p'};
+    std::vector<std::string> resolved;
+
+    FilterBatch batch{testDisplayData, "test"};
+    lower("block out inet from \"C:\\app.exe\"", batch, [&](const std::string &appPath) {
+        resolved.push_back(appPath);
+        return appId;
+    });
+
+    // Resolved once, however many filters the rule needs
+    ASSERT_EQ(resolved, std::vector<std::string>{"C:\\app.exe"});
+    ASSERT_EQ(batch.size(), 1);
+
+    const FWPM_FILTER_CONDITION &condition = batch.filters().front().filterCondition[0];
+    ASSERT_EQ(condition.fieldKey, FWPM_CONDITION_ALE_APP_ID);
+    ASSERT_EQ(condition.conditionValue.type, FWP_BYTE_BLOB_TYPE);
+    const FWP_BYTE_BLOB *pBlob = condition.conditionValue.byteBlob;
+    ASSERT_TRUE(std::ranges::equal(std::span{pBlob->data, pBlob->size}, appId));
+}
+
+TEST(WfpExecutorTests, TestUnresolvedAppIdThrows)
+{
+    FilterBatch batch{testDisplayData, "test"};
+
+    ASSERT_THROW(lower("block out from \"C:\\missing.exe\"", batch), std::runtime_error);
+    ASSERT_THROW(lower("block out from \"C:\\missing.exe\"", batch,
+                       [](const std::string &) { return std::vector<UINT8>{}; }),
+                 std::runtime_error);
+}